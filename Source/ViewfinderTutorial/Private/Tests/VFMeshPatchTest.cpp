@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFMeshPatch.h"
+#include "DynamicMeshEditor.h"
+#include "Generators/RectangleMeshGenerator.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+using namespace UE::Geometry;
+
+namespace
+{
+	FDynamicMesh3 MakePatchTestGrid(int32 VertexCount)
+	{
+		FRectangleMeshGenerator Generator;
+		Generator.Width = 400.f;
+		Generator.Height = 400.f;
+		Generator.WidthVertexCount = VertexCount;
+		Generator.HeightVertexCount = VertexCount;
+		Generator.Generate();
+		return FDynamicMesh3(&Generator);
+	}
+
+	//与三角面ID和顶点顺序无关的三角面集合，用于比较两个网格体的几何是否相同
+	TArray<FString> GetPatchTestTriangles(const FDynamicMesh3& Mesh)
+	{
+		TArray<FString> Triangles;
+		for (int32 TriangleID : Mesh.TriangleIndicesItr())
+		{
+			const FIndex3i Triangle = Mesh.GetTriangle(TriangleID);
+			TArray<FString> Corners;
+			for (int32 i = 0; i < 3; i++)
+			{
+				const FVector3d Position = Mesh.GetVertex(Triangle[i]);
+				Corners.Emplace(FString::Printf(TEXT("(%.2f,%.2f,%.2f)"), Position.X, Position.Y, Position.Z));
+			}
+			Corners.Sort();
+			Triangles.Emplace(FString::Join(Corners, TEXT("")));
+		}
+		Triangles.Sort();
+		return Triangles;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVFMeshPatchRoundTripTest, "Viewfinder.Cut.MeshPatch", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVFMeshPatchRoundTripTest::RunTest(const FString& Parameters)
+{
+	const FDynamicMesh3 BaseMesh = MakePatchTestGrid(5);
+
+	//模拟切割：删除X大于0的三角面，在原来的位置加入缩小的新三角面，再压缩使三角面ID与来源不同
+	FDynamicMesh3 CutMesh = BaseMesh;
+	TArray<int32> RemovedTriangles;
+	for (int32 TriangleID : CutMesh.TriangleIndicesItr())
+	{
+		if (CutMesh.GetTriCentroid(TriangleID).X > 0.0)
+		{
+			RemovedTriangles.Emplace(TriangleID);
+		}
+	}
+	int32 NumAdded = 0;
+	for (int32 TriangleID : RemovedTriangles)
+	{
+		FVector3d A, B, C;
+		CutMesh.GetTriVertices(TriangleID, A, B, C);
+		const FVector3d Centroid = (A + B + C) / 3.0;
+		CutMesh.RemoveTriangle(TriangleID, true, false);
+
+		const int32 VertexA = CutMesh.AppendVertex(FMath::Lerp(Centroid, A, 0.5));
+		const int32 VertexB = CutMesh.AppendVertex(FMath::Lerp(Centroid, B, 0.5));
+		const int32 VertexC = CutMesh.AppendVertex(FMath::Lerp(Centroid, C, 0.5));
+		if (CutMesh.AppendTriangle(VertexA, VertexB, VertexC) >= 0)
+		{
+			NumAdded++;
+		}
+	}
+	CutMesh.CompactInPlace();
+	if (!TestTrue(TEXT("The simulated cut removes triangles"), RemovedTriangles.Num() > 0)) return false;
+
+	FVFMeshPatch Patch;
+	Patch.Build(BaseMesh, CutMesh);
+	TestEqual(TEXT("Removed triangle count"), Patch.RemovedTriangles.Num(), RemovedTriangles.Num());
+	TestEqual(TEXT("Added triangle count"), Patch.AddedMesh.TriangleCount(), NumAdded);
+
+	FDynamicMesh3 PatchedMesh;
+	if (!TestTrue(TEXT("Apply succeeds on the source mesh"), Patch.Apply(BaseMesh, PatchedMesh))) return false;
+	TestTrue(TEXT("Patched triangles match the cut mesh"), GetPatchTestTriangles(PatchedMesh) == GetPatchTestTriangles(CutMesh));
+
+	//序列化往返后补丁依然可以还原出相同的结果
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	Patch.Serialize(Writer);
+
+	FVFMeshPatch LoadedPatch;
+	FMemoryReader Reader(Data);
+	LoadedPatch.Serialize(Reader);
+	TestFalse(TEXT("Reading the patch does not fail"), Reader.IsError());
+
+	FDynamicMesh3 LoadedPatchedMesh;
+	TestTrue(TEXT("Loaded patch applies"), LoadedPatch.Apply(BaseMesh, LoadedPatchedMesh));
+	TestTrue(TEXT("Loaded patch matches the cut mesh"), GetPatchTestTriangles(LoadedPatchedMesh) == GetPatchTestTriangles(CutMesh));
+
+	//来源改变后补丁不能再应用
+	FDynamicMesh3 OtherMesh;
+	TestFalse(TEXT("Apply fails on a different source mesh"), Patch.Apply(MakePatchTestGrid(6), OtherMesh));
+	return true;
+}
+
+#endif
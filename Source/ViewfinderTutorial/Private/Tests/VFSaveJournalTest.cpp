@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFSaveJournal.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	FVFSaveDelta MakeJournalTestDelta(int32 Index)
+	{
+		FVFSaveDelta Delta;
+		Delta.HiddenComponents.Emplace(FString::Printf(TEXT("PersistentLevel.Wall_%d.StaticMeshComponent0"), Index));
+
+		//可以被压缩的数据，记录以压缩的形式写入
+		TArray<uint8> Data;
+		Data.SetNumZeroed(4096);
+		FVFSavedBackgroundPhoto& BackgroundPhoto = Delta.BackgroundPhotos.Add(FString::Printf(TEXT("PersistentLevel.VFPhoto_%d"), Index));
+		BackgroundPhoto.Texture.Data = MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data));
+		return Delta;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVFSaveJournalTest, "Viewfinder.Save.Journal", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVFSaveJournalTest::RunTest(const FString& Parameters)
+{
+	const FString SnapshotFilename = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("VFSaveJournalTest.vfsave"));
+	const FString JournalFilename = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("VFSaveJournalTest.vfjournal"));
+	constexpr int32 NumRecords = 3;
+
+	//记录每条记录写入后日志的大小，用于在记录边界或记录中间截断日志
+	TArray<int64> RecordEnds;
+	{
+		FVFSaveJournal Journal(SnapshotFilename, JournalFilename, 64 * 1024 * 1024);
+		FVFSaveState State;
+		State.MapName = TEXT("TestMap");
+		Journal.Reset(MoveTemp(State));
+		Journal.Flush();
+		RecordEnds.Emplace(IFileManager::Get().FileSize(*JournalFilename));
+		for (int32 i = 0; i < NumRecords; i++)
+		{
+			Journal.Append(MakeJournalTestDelta(i));
+			Journal.Flush();
+			RecordEnds.Emplace(IFileManager::Get().FileSize(*JournalFilename));
+		}
+	}
+
+	FVFSaveState Loaded;
+	int32 NumReplayed = 0;
+	if (!TestTrue(TEXT("Load succeeds"), FVFSaveJournal::Load(SnapshotFilename, JournalFilename, Loaded, NumReplayed))) return false;
+	TestEqual(TEXT("All records are replayed"), NumReplayed, NumRecords);
+	TestEqual(TEXT("Sequence of the last record"), Loaded.Sequence, (uint64)NumRecords);
+	TestEqual(TEXT("MapName from the snapshot"), Loaded.MapName, FString(TEXT("TestMap")));
+	TestEqual(TEXT("Hidden components from the records"), Loaded.HiddenComponents.Num(), NumRecords);
+	TestEqual(TEXT("Background photos from the records"), Loaded.BackgroundPhotos.Num(), NumRecords);
+
+	TArray<uint8> JournalData;
+	if (!TestTrue(TEXT("Read the journal back"), FFileHelper::LoadFileToArray(JournalData, *JournalFilename))) return false;
+	if (!TestEqual(TEXT("Journal size"), (int64)JournalData.Num(), RecordEnds.Last())) return false;
+
+	//写入一半的最后一条记录被忽略，之前的记录依然有效
+	AddExpectedError(TEXT("incomplete record"), EAutomationExpectedErrorFlags::Contains, 1);
+	const TArray<uint8> TornJournal(JournalData.GetData(), (int32)((RecordEnds[NumRecords - 1] + RecordEnds[NumRecords]) / 2));
+	FFileHelper::SaveArrayToFile(TornJournal, *JournalFilename);
+	TestTrue(TEXT("Load with a torn record"), FVFSaveJournal::Load(SnapshotFilename, JournalFilename, Loaded, NumReplayed));
+	TestEqual(TEXT("Records before the torn record are replayed"), NumReplayed, NumRecords - 1);
+	TestEqual(TEXT("Sequence before the torn record"), Loaded.Sequence, (uint64)(NumRecords - 1));
+
+	//第二条记录的数据损坏时，从它开始的记录都不会被重放
+	AddExpectedError(TEXT("checksum mismatch"), EAutomationExpectedErrorFlags::Contains, 1);
+	TArray<uint8> CorruptJournal = JournalData;
+	CorruptJournal[(int32)RecordEnds[2] - 1] ^= 0xFF;
+	FFileHelper::SaveArrayToFile(CorruptJournal, *JournalFilename);
+	TestTrue(TEXT("Load with a corrupt record"), FVFSaveJournal::Load(SnapshotFilename, JournalFilename, Loaded, NumReplayed));
+	TestEqual(TEXT("Records before the corrupt record are replayed"), NumReplayed, 1);
+	TestEqual(TEXT("Sequence before the corrupt record"), Loaded.Sequence, (uint64)1);
+
+	//日志不存在时只读取快照
+	IFileManager::Get().Delete(*JournalFilename);
+	TestTrue(TEXT("Load without a journal"), FVFSaveJournal::Load(SnapshotFilename, JournalFilename, Loaded, NumReplayed));
+	TestEqual(TEXT("No records without a journal"), NumReplayed, 0);
+	TestEqual(TEXT("Sequence of the snapshot"), Loaded.Sequence, (uint64)0);
+
+	IFileManager::Get().Delete(*SnapshotFilename);
+	return true;
+}
+
+#endif
@@ -0,0 +1,308 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFSaveFile.h"
+#include "VFSaveState.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	FVFSaveBlob MakeSaveTestBlob(int32 Size, uint8 Seed)
+	{
+		TArray<uint8> Data;
+		Data.SetNumUninitialized(Size);
+		for (int32 i = 0; i < Size; i++)
+		{
+			Data[i] = (uint8)(i * 31 + Seed);
+		}
+		FVFSaveBlob Blob;
+		Blob.Data = MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data));
+		return Blob;
+	}
+
+	bool IsSameBlobData(const FVFSaveBlob& A, const FVFSaveBlob& B)
+	{
+		return A.IsValid() && B.IsValid() && *A.Data == *B.Data;
+	}
+
+	FVFSavedPhoto MakeSaveTestPhoto(uint64 PhotoId, const FVFSaveBlob& Texture, const FVFSaveBlob& Mesh)
+	{
+		FVFSavedPhoto Photo;
+		Photo.PhotoId = PhotoId;
+		Photo.CaptureFOVAngle = 90.f;
+		Photo.MaxCaptureDistance = 5000.f;
+		Photo.BackgroundDistance = 4000.f;
+		Photo.CaptureSize = FVector2D(640.0, 480.0);
+		Photo.TakeTransformNoScale = FTransform(FRotator(0.0, 45.0, 0.0), FVector(100.0, 200.0, 300.0));
+		Photo.PhotoClass = TEXT("/Script/ViewfinderTutorial.VFPhoto");
+		Photo.RenderTarget = Texture;
+		Photo.BackgroundRenderTarget = Texture;
+		Photo.Materials = { TEXT("/Game/Materials/M_Test.M_Test") };
+		Photo.MaterialIndices = { 0 };
+
+		FVFSavedPhoto::FActor& Actor = Photo.Actors.AddDefaulted_GetRef();
+		Actor.Class = TEXT("/Script/Engine.StaticMeshActor");
+		Actor.RelativeTransform = FTransform(FVector(10.0, 0.0, 0.0));
+		Actor.FirstComponent = 0;
+		Actor.NumComponents = 1;
+
+		FVFSavedPhoto::FComponent& Component = Photo.Components.AddDefaulted_GetRef();
+		Component.Name = TEXT("StaticMeshComponent0");
+		Component.StaticMesh.Path = TEXT("/Game/Meshes/SM_Test.SM_Test");
+		Component.FirstMaterial = 0;
+		Component.NumMaterials = 1;
+		Component.CollisionEnabled = 3;
+
+		Photo.MeshRecord = Mesh;
+		return Photo;
+	}
+
+	FString GetSaveTestFilename(const TCHAR* Name)
+	{
+		return FPaths::Combine(FPaths::AutomationTransientDir(), Name);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVFSaveFileTest, "Viewfinder.Save.File", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVFSaveFileTest::RunTest(const FString& Parameters)
+{
+	const FString Filename = GetSaveTestFilename(TEXT("VFSaveFileTest.vfsave"));
+
+	//可压缩、不可压缩与空的块
+	TArray<uint8> Compressible;
+	Compressible.SetNumZeroed(64 * 1024);
+	TArray<uint8> Incompressible;
+	FRandomStream Random(1234);
+	for (int32 i = 0; i < 257; i++)
+	{
+		Incompressible.Emplace((uint8)Random.RandRange(0, 255));
+	}
+	const TArray<uint8> Empty;
+
+	FVFSaveFileWriter Writer;
+	TestEqual(TEXT("First chunk index"), Writer.AddChunk(EVFSaveChunkType::Texture, Compressible), 0);
+	TestEqual(TEXT("Second chunk index"), Writer.AddChunk(EVFSaveChunkType::Mesh, Incompressible), 1);
+	TestEqual(TEXT("Third chunk index"), Writer.AddChunk(EVFSaveChunkType::World, Empty), 2);
+	if (!TestTrue(TEXT("Save succeeds"), Writer.Save(Filename))) return false;
+	TestTrue(TEXT("Compressible chunk is compressed"), IFileManager::Get().FileSize(*Filename) < Compressible.Num());
+
+	{
+		FVFSaveFileReader Reader;
+		if (!TestTrue(TEXT("Open succeeds"), Reader.Open(Filename))) return false;
+		TestEqual(TEXT("Chunk count"), Reader.GetNumChunks(), 3);
+		TestTrue(TEXT("Chunk types"), Reader.GetChunkType(0) == EVFSaveChunkType::Texture && Reader.GetChunkType(1) == EVFSaveChunkType::Mesh && Reader.GetChunkType(2) == EVFSaveChunkType::World);
+		TestEqual(TEXT("FindChunk finds the world chunk"), Reader.FindChunk(EVFSaveChunkType::World), 2);
+		TestEqual(TEXT("FindChunk without a matching chunk"), Reader.FindChunk(EVFSaveChunkType::MeshPatch), (int32)INDEX_NONE);
+
+		//块可以按任意顺序读取
+		TArray<uint8> Data;
+		TestTrue(TEXT("Load incompressible chunk"), Reader.LoadChunk(1, Data) && Data == Incompressible);
+		TestTrue(TEXT("Load compressible chunk"), Reader.LoadChunk(0, Data) && Data == Compressible);
+		TestTrue(TEXT("Load empty chunk"), Reader.LoadChunk(2, Data) && Data.IsEmpty());
+		TestFalse(TEXT("Load invalid chunk index"), Reader.LoadChunk(3, Data));
+	}
+
+	//截断的文件依然可以读取块表，但超出文件的块无法读取
+	TArray<uint8> FileData;
+	if (!TestTrue(TEXT("Read the file back"), FFileHelper::LoadFileToArray(FileData, *Filename))) return false;
+	FileData.SetNum(FileData.Num() - 16);
+	FFileHelper::SaveArrayToFile(FileData, *Filename);
+	{
+		FVFSaveFileReader Reader;
+		TArray<uint8> Data;
+		TestTrue(TEXT("Open truncated file"), Reader.Open(Filename));
+		TestTrue(TEXT("Load chunk before the truncation"), Reader.LoadChunk(0, Data) && Data == Compressible);
+		TestFalse(TEXT("Load chunk past the truncation"), Reader.LoadChunk(1, Data));
+	}
+
+	//不是存档的文件
+	AddExpectedError(TEXT("is not a save file"), EAutomationExpectedErrorFlags::Contains, 1);
+	FFileHelper::SaveStringToFile(TEXT("Not a save file"), *Filename);
+	{
+		FVFSaveFileReader Reader;
+		TestFalse(TEXT("Open rejects a foreign file"), Reader.Open(Filename));
+	}
+
+	IFileManager::Get().Delete(*Filename);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVFSaveStateTest, "Viewfinder.Save.State", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVFSaveStateTest::RunTest(const FString& Parameters)
+{
+	const FString Filename = GetSaveTestFilename(TEXT("VFSaveStateTest.vfsave"));
+	const FVFSaveBlob Texture = MakeSaveTestBlob(1024, 1);
+	const FVFSaveBlob Mesh = MakeSaveTestBlob(512, 2);
+	const FVFSaveBlob Patch = MakeSaveTestBlob(128, 3);
+
+	FVFSaveState State;
+	State.MapName = TEXT("TestMap");
+	State.PawnTransform = FTransform(FVector(1.0, 2.0, 3.0));
+	State.ControlRotation = FRotator(10.0, 20.0, 0.0);
+	State.JournalId = FGuid::NewGuid();
+	State.Sequence = 7;
+	State.Photos.Emplace(MakeSaveTestPhoto(42, Texture, Mesh));
+	State.HiddenComponents.Add(TEXT("PersistentLevel.Wall.StaticMeshComponent0"));
+	State.InstancedComponents.Add(TEXT("PersistentLevel.Trees.Foliage"), TArray<FTransform>{ FTransform(FVector(0.0, 0.0, 0.0)), FTransform(FVector(100.0, 0.0, 0.0)) });
+
+	FVFSavedActor& SpawnedActor = State.SpawnedActors.Add(TEXT("PersistentLevel.StaticMeshActor_1"));
+	SpawnedActor.Class = TEXT("/Script/Engine.StaticMeshActor");
+	SpawnedActor.Transform = FTransform(FVector(5.0, 5.0, 5.0));
+	FVFSavedComponent& SpawnedComponent = SpawnedActor.Components.AddDefaulted_GetRef();
+	SpawnedComponent.Name = TEXT("StaticMeshComponent0");
+	SpawnedComponent.bIsHidden = true;
+	SpawnedComponent.StaticMesh.Path = TEXT("/Game/Meshes/SM_Test.SM_Test");
+	SpawnedComponent.StaticMesh.Mesh = Mesh;
+
+	FVFSavedGeneratedComponent& GeneratedComponent = State.GeneratedComponents.Add(TEXT("PersistentLevel.Wall.DynamicMeshComponent_0"));
+	GeneratedComponent.OwnerPath = TEXT("PersistentLevel.Wall");
+	GeneratedComponent.Transform = FTransform(FVector(0.0, 50.0, 0.0));
+	GeneratedComponent.PatchSource = TEXT("/Game/Meshes/SM_Wall.SM_Wall");
+	GeneratedComponent.Mesh = Patch;
+	GeneratedComponent.Materials = { TEXT("/Game/Materials/M_Test.M_Test") };
+
+	FVFSavedBackgroundPhoto& BackgroundPhoto = State.BackgroundPhotos.Add(TEXT("PersistentLevel.VFPhoto_0"));
+	BackgroundPhoto.Class = TEXT("/Script/ViewfinderTutorial.VFPhoto");
+	BackgroundPhoto.Texture = Texture;
+
+	if (!TestTrue(TEXT("SaveToFile succeeds"), State.SaveToFile(Filename))) return false;
+
+	//共享的数据只写入一次：纹理、网格体、补丁与World块
+	{
+		FVFSaveFileReader Reader;
+		TestTrue(TEXT("Open the save"), Reader.Open(Filename));
+		TestEqual(TEXT("Shared blobs are written once"), Reader.GetNumChunks(), 4);
+	}
+
+	FVFSaveState Loaded;
+	if (!TestTrue(TEXT("LoadFromFile succeeds"), Loaded.LoadFromFile(Filename))) return false;
+	TestEqual(TEXT("MapName"), Loaded.MapName, State.MapName);
+	TestTrue(TEXT("PawnTransform"), Loaded.PawnTransform.Equals(State.PawnTransform));
+	TestTrue(TEXT("ControlRotation"), Loaded.ControlRotation.Equals(State.ControlRotation));
+	TestTrue(TEXT("JournalId"), Loaded.JournalId == State.JournalId);
+	TestEqual(TEXT("Sequence"), Loaded.Sequence, State.Sequence);
+
+	if (TestEqual(TEXT("Photo count"), Loaded.Photos.Num(), 1))
+	{
+		const FVFSavedPhoto& Photo = Loaded.Photos[0];
+		TestEqual(TEXT("PhotoId"), Photo.PhotoId, (uint64)42);
+		TestEqual(TEXT("CaptureFOVAngle"), Photo.CaptureFOVAngle, 90.f);
+		TestTrue(TEXT("TakeTransformNoScale"), Photo.TakeTransformNoScale.Equals(State.Photos[0].TakeTransformNoScale));
+		TestTrue(TEXT("RenderTarget"), IsSameBlobData(Photo.RenderTarget, Texture));
+		TestTrue(TEXT("Blobs shared before saving are shared after loading"), Photo.RenderTarget.Data == Photo.BackgroundRenderTarget.Data);
+		TestTrue(TEXT("MeshRecord"), IsSameBlobData(Photo.MeshRecord, Mesh));
+		TestEqual(TEXT("Component name"), Photo.Components.Num() == 1 ? Photo.Components[0].Name : NAME_None, FName(TEXT("StaticMeshComponent0")));
+		TestEqual(TEXT("Actor component range"), Photo.Actors.Num() == 1 ? Photo.Actors[0].NumComponents : 0, 1);
+	}
+	TestTrue(TEXT("HiddenComponents"), Loaded.HiddenComponents.Contains(TEXT("PersistentLevel.Wall.StaticMeshComponent0")));
+	const TArray<FTransform>* Instances = Loaded.InstancedComponents.Find(TEXT("PersistentLevel.Trees.Foliage"));
+	TestTrue(TEXT("InstancedComponents"), Instances && Instances->Num() == 2 && (*Instances)[1].Equals(FTransform(FVector(100.0, 0.0, 0.0))));
+
+	const FVFSavedActor* LoadedActor = Loaded.SpawnedActors.Find(TEXT("PersistentLevel.StaticMeshActor_1"));
+	TestTrue(TEXT("SpawnedActors"), LoadedActor && LoadedActor->Components.Num() == 1 && LoadedActor->Components[0].bIsHidden && IsSameBlobData(LoadedActor->Components[0].StaticMesh.Mesh, Mesh));
+
+	const FVFSavedGeneratedComponent* LoadedGenerated = Loaded.GeneratedComponents.Find(TEXT("PersistentLevel.Wall.DynamicMeshComponent_0"));
+	TestTrue(TEXT("GeneratedComponents"), LoadedGenerated && LoadedGenerated->PatchSource == GeneratedComponent.PatchSource && IsSameBlobData(LoadedGenerated->Mesh, Patch));
+
+	const FVFSavedBackgroundPhoto* LoadedBackground = Loaded.BackgroundPhotos.Find(TEXT("PersistentLevel.VFPhoto_0"));
+	TestTrue(TEXT("BackgroundPhotos"), LoadedBackground && IsSameBlobData(LoadedBackground->Texture, Texture));
+
+	//读取失败时不改变状态
+	FVFSaveState Untouched;
+	Untouched.MapName = TEXT("Untouched");
+	TestFalse(TEXT("Missing file"), Untouched.LoadFromFile(GetSaveTestFilename(TEXT("VFSaveStateMissing.vfsave"))));
+	TestEqual(TEXT("Failed load keeps the state"), Untouched.MapName, FString(TEXT("Untouched")));
+
+	//越界的材质索引会在读取时被拒绝
+	State.Photos[0].MaterialIndices = { 5 };
+	TestTrue(TEXT("SaveToFile with an invalid index"), State.SaveToFile(Filename));
+	AddExpectedError(TEXT("is corrupted"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse(TEXT("LoadFromFile rejects an invalid index"), Untouched.LoadFromFile(Filename));
+	TestEqual(TEXT("Rejected load keeps the state"), Untouched.MapName, FString(TEXT("Untouched")));
+
+	IFileManager::Get().Delete(*Filename);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVFSaveDeltaTest, "Viewfinder.Save.Delta", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVFSaveDeltaTest::RunTest(const FString& Parameters)
+{
+	const FVFSaveBlob Texture = MakeSaveTestBlob(256, 4);
+	const FVFSaveBlob Patch = MakeSaveTestBlob(64, 5);
+
+	FVFSaveState State;
+	State.Sequence = 7;
+	State.Photos.Emplace(MakeSaveTestPhoto(42, Texture, FVFSaveBlob()));
+	State.HiddenComponents.Add(TEXT("PersistentLevel.Wall.StaticMeshComponent0"));
+	State.GeneratedComponents.Add(TEXT("PersistentLevel.Wall.DynamicMeshComponent_0")).Mesh = Patch;
+	State.BackgroundPhotos.Add(TEXT("PersistentLevel.VFPhoto_0")).Texture = Texture;
+
+	FVFSaveDelta Delta;
+	Delta.Sequence = 8;
+	Delta.bHasPawn = true;
+	Delta.PawnTransform = FTransform(FVector(7.0, 8.0, 9.0));
+	Delta.AddedPhotos.Emplace(MakeSaveTestPhoto(43, Texture, FVFSaveBlob()));
+	Delta.RemovedPhotos.Emplace(42);
+	Delta.HiddenComponents.Emplace(TEXT("PersistentLevel.Floor.StaticMeshComponent0"));
+	Delta.ShownComponents.Emplace(TEXT("PersistentLevel.Wall.StaticMeshComponent0"));
+	Delta.RenamedGeneratedComponents.Emplace(TEXT("PersistentLevel.Wall.DynamicMeshComponent_0"), TEXT("PersistentLevel.Wall.StaticMeshComponent_1"));
+	FVFSavedGeneratedComponent& AddedComponent = Delta.GeneratedComponents.Add(TEXT("PersistentLevel.Floor.DynamicMeshComponent_2"));
+	AddedComponent.PatchSource = TEXT("/Game/Meshes/SM_Floor.SM_Floor");
+	AddedComponent.Mesh = Patch;
+	Delta.RemovedBackgroundPhotos.Emplace(TEXT("PersistentLevel.VFPhoto_0"));
+	TestFalse(TEXT("Delta is not empty"), Delta.IsEmpty());
+	TestTrue(TEXT("Default delta is empty"), FVFSaveDelta().IsEmpty());
+
+	//日志记录中的数据直接写在记录内
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	Delta.Serialize(Writer, 2);
+
+	FVFSaveDelta Loaded;
+	FMemoryReader Reader(Data);
+	Loaded.Serialize(Reader, 2);
+	if (!TestFalse(TEXT("Reading the delta does not fail"), Reader.IsError())) return false;
+	TestEqual(TEXT("Sequence"), Loaded.Sequence, (uint64)8);
+	TestTrue(TEXT("Added photo texture"), Loaded.AddedPhotos.Num() == 1 && IsSameBlobData(Loaded.AddedPhotos[0].RenderTarget, Texture));
+
+	Loaded.ApplyTo(State);
+	TestEqual(TEXT("Sequence after apply"), State.Sequence, (uint64)8);
+	TestTrue(TEXT("Pawn after apply"), State.PawnTransform.Equals(Delta.PawnTransform));
+	TestTrue(TEXT("Photos after apply"), State.Photos.Num() == 1 && State.Photos[0].PhotoId == 43);
+	TestTrue(TEXT("Hidden components after apply"), State.HiddenComponents.Num() == 1 && State.HiddenComponents.Contains(TEXT("PersistentLevel.Floor.StaticMeshComponent0")));
+	const FVFSavedGeneratedComponent* Renamed = State.GeneratedComponents.Find(TEXT("PersistentLevel.Wall.StaticMeshComponent_1"));
+	TestTrue(TEXT("Renamed component keeps its mesh"), Renamed && IsSameBlobData(Renamed->Mesh, Patch));
+	TestFalse(TEXT("Renamed component leaves its old path"), State.GeneratedComponents.Contains(TEXT("PersistentLevel.Wall.DynamicMeshComponent_0")));
+	const FVFSavedGeneratedComponent* Added = State.GeneratedComponents.Find(TEXT("PersistentLevel.Floor.DynamicMeshComponent_2"));
+	TestTrue(TEXT("Added component keeps its patch source"), Added && Added->PatchSource == AddedComponent.PatchSource);
+	TestTrue(TEXT("Background photos after apply"), State.BackgroundPhotos.IsEmpty());
+
+	//版本1的日志没有补丁来源
+	TArray<uint8> Version1Data;
+	FMemoryWriter Version1Writer(Version1Data);
+	Delta.Serialize(Version1Writer, 1);
+	FVFSaveDelta Version1Loaded;
+	FMemoryReader Version1Reader(Version1Data);
+	Version1Loaded.Serialize(Version1Reader, 1);
+	const FVFSavedGeneratedComponent* Version1Component = Version1Loaded.GeneratedComponents.Find(TEXT("PersistentLevel.Floor.DynamicMeshComponent_2"));
+	TestTrue(TEXT("Version 1 record has no patch source"), !Version1Reader.IsError() && Version1Component && Version1Component->PatchSource.IsEmpty());
+
+	//截断的记录在读取时出错，而不是分配过多的内存
+	Data.SetNum(Data.Num() / 2);
+	FVFSaveDelta Truncated;
+	FMemoryReader TruncatedReader(Data);
+	Truncated.Serialize(TruncatedReader, 2);
+	TestTrue(TEXT("Truncated record fails to read"), TruncatedReader.IsError());
+	return true;
+}
+
+#endif
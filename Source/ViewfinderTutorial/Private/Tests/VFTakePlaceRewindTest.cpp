@@ -0,0 +1,212 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFCutGeometrySubsystem.h"
+#include "VFPhoto.h"
+#include "VFPhotoTakerPlacerComponent.h"
+#include "Components/DynamicMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "Generators/GridBoxMeshGenerator.h"
+#include "Misc/AutomationTest.h"
+#include "UDynamicMesh.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+using namespace UE::Geometry;
+
+namespace
+{
+	/**
+	 * 摄像机位于原点朝向X轴，前方有三个立方体：正中的完全位于视锥内，第二个跨越视锥的边界，第三个位于视锥外。
+	 * 与基准测试相同，在无渲染的新世界中进行，测试结束时销毁。
+	 */
+	struct FVFRewindTestScene
+	{
+		UWorld* World = nullptr;
+		UVFPhotoTakerPlacerComponent* Placer = nullptr;
+		UStaticMeshComponent* InsideComponent = nullptr;
+		UStaticMeshComponent* EdgeComponent = nullptr;
+		UStaticMeshComponent* OutsideComponent = nullptr;
+		FVFAPhotoTakeParams TakeParams;
+
+		bool Create(FAutomationTestBase& Test)
+		{
+			UStaticMesh* PyramidMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Game/Viewfinder/Assets/SM_Pyramid.SM_Pyramid"));
+			if (!Test.TestNotNull(TEXT("Load the pyramid mesh"), PyramidMesh)) return false;
+
+			World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("VFRewindTest"));
+			FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+			WorldContext.SetCurrentWorld(World);
+			World->InitializeActorsForPlay(FURL());
+			World->BeginPlay();
+
+			FGridBoxMeshGenerator Generator;
+			Generator.Box = FOrientedBox3d(FVector3d::Zero(), FVector3d(50.0));
+			Generator.EdgeVertices = FIndex3i(4, 4, 4);
+			const FDynamicMesh3 BoxMesh(&Generator.Generate());
+			UStaticMesh* BoxStaticMesh = UVFCutGeometrySubsystem::CreateTransientStaticMesh(World, BoxMesh, nullptr, false);
+
+			//32度的视野在600处的半宽约为172
+			InsideComponent = SpawnBox(BoxStaticMesh, FVector(600.0, 0.0, 0.0));
+			EdgeComponent = SpawnBox(BoxStaticMesh, FVector(600.0, 172.0, 0.0));
+			OutsideComponent = SpawnBox(BoxStaticMesh, FVector(600.0, 400.0, 0.0));
+
+			AActor* PlacerActor = World->SpawnActor<AActor>();
+			Placer = NewObject<UVFPhotoTakerPlacerComponent>(PlacerActor);
+			Placer->SetMobility(EComponentMobility::Movable);
+			Placer->SetStaticMesh(PyramidMesh);
+			PlacerActor->SetRootComponent(Placer);
+			Placer->RegisterComponent();
+
+			TakeParams.PhotoClass = AVFPhoto::StaticClass();
+			TakeParams.CaptureSize = FVector2D(256.0, 256.0);
+			return true;
+		}
+
+		void Destroy()
+		{
+			if (!World) return;
+			GEngine->DestroyWorldContext(World);
+			World->DestroyWorld(false);
+			World = nullptr;
+		}
+
+		UStaticMeshComponent* SpawnBox(UStaticMesh* Mesh, const FVector& Location)
+		{
+			AStaticMeshActor* Actor = World->SpawnActor<AStaticMeshActor>(Location, FRotator::ZeroRotator);
+			UStaticMeshComponent* Component = Actor->GetStaticMeshComponent();
+			Component->SetMobility(EComponentMobility::Movable);
+			Component->SetStaticMesh(Mesh);
+			Component->SetCollisionProfileName(FName("BlockAll"));
+			Component->SetGenerateOverlapEvents(true);
+			return Component;
+		}
+
+		//三个立方体所属Actor上所有可见组件的三角面数量，包括切割生成的组件
+		int32 GetVisibleTriangles() const
+		{
+			int32 NumTriangles = 0;
+			for (const UStaticMeshComponent* BoxComponent : {InsideComponent, EdgeComponent, OutsideComponent})
+			{
+				TInlineComponentArray<UPrimitiveComponent*> Components(BoxComponent->GetOwner());
+				for (const UPrimitiveComponent* Component : Components)
+				{
+					if (Component->IsVisible())
+					{
+						NumTriangles += GetTrianglesForRewindTest(Component);
+					}
+				}
+			}
+			return NumTriangles;
+		}
+
+		static int32 GetTrianglesForRewindTest(const UPrimitiveComponent* Component)
+		{
+			if (const UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+			{
+				return DynamicMeshComponent->GetDynamicMesh()->GetTriangleCount();
+			}
+			const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component);
+			return StaticMeshComponent && StaticMeshComponent->GetStaticMesh() ? StaticMeshComponent->GetStaticMesh()->GetNumTriangles(0) : 0;
+		}
+	};
+
+	bool IsShownForRewindTest(const UPrimitiveComponent* Component)
+	{
+		return Component->IsVisible() && Component->GetCollisionEnabled() != ECollisionEnabled::NoCollision && !Component->ComponentHasTag(FName("VFHidden"));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVFTakePlaceRewindTest, "Viewfinder.Place.Rewind", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVFTakePlaceRewindTest::RunTest(const FString& Parameters)
+{
+	FVFRewindTestScene Scene;
+	if (!Scene.Create(*this))
+	{
+		Scene.Destroy();
+		return false;
+	}
+	const int32 SceneTriangles = Scene.GetVisibleTriangles();
+	const int32 BoxTriangles = FVFRewindTestScene::GetTrianglesForRewindTest(Scene.InsideComponent);
+	TestEqual(TEXT("Scene triangles"), SceneTriangles, BoxTriangles * 3);
+
+	//拍照不改变场景
+	const FVFPhotoInfo Photo = Scene.Placer->TakePhotoWithParamAssigned(Scene.TakeParams);
+	TestTrue(TEXT("Take a photo"), Photo.IsValid());
+	TestTrue(TEXT("Take keeps the scene shown"), IsShownForRewindTest(Scene.InsideComponent) && IsShownForRewindTest(Scene.EdgeComponent) && IsShownForRewindTest(Scene.OutsideComponent));
+	TestEqual(TEXT("Take keeps the triangles"), Scene.GetVisibleTriangles(), SceneTriangles);
+
+	//放置时视锥内的立方体被隐藏，跨越边界的立方体由切割后的组件代替，视锥外的立方体不变
+	const FVFPhotoPlaceRecord PhotoPlaceRecord = Scene.Placer->PlacePhoto(Photo, 0.f);
+	TestTrue(TEXT("Place hides the inside box"), !IsShownForRewindTest(Scene.InsideComponent) && PhotoPlaceRecord.HiddenComponents.Contains(Scene.InsideComponent));
+	TestTrue(TEXT("Place hides the edge box"), !IsShownForRewindTest(Scene.EdgeComponent) && PhotoPlaceRecord.HiddenComponents.Contains(Scene.EdgeComponent));
+	TestTrue(TEXT("Place keeps the outside box"), IsShownForRewindTest(Scene.OutsideComponent) && !PhotoPlaceRecord.HiddenComponents.Contains(Scene.OutsideComponent));
+	if (!TestEqual(TEXT("Place generates one cut piece"), PhotoPlaceRecord.GeneratedComponents.Num(), 1))
+	{
+		Scene.Destroy();
+		return false;
+	}
+	UPrimitiveComponent* GeneratedComponent = PhotoPlaceRecord.GeneratedComponents[0];
+	const int32 GeneratedTriangles = FVFRewindTestScene::GetTrianglesForRewindTest(GeneratedComponent);
+	TestTrue(TEXT("The cut piece is shown"), IsShownForRewindTest(GeneratedComponent) && GeneratedComponent->GetOwner() == Scene.EdgeComponent->GetOwner());
+	TestTrue(FString::Printf(TEXT("The cut piece has %d triangles"), GeneratedTriangles), GeneratedTriangles > 0);
+	TestEqual(TEXT("Place triangles"), Scene.GetVisibleTriangles(), BoxTriangles + GeneratedTriangles);
+
+	//回溯后场景与拍照时相同，被缓存的切割结果被隐藏并只保留补丁
+	Scene.Placer->UndoPlacePhoto(PhotoPlaceRecord);
+	TestTrue(TEXT("Undo shows the hidden boxes"), IsShownForRewindTest(Scene.InsideComponent) && IsShownForRewindTest(Scene.EdgeComponent));
+	TestTrue(TEXT("Undo keeps the outside box"), IsShownForRewindTest(Scene.OutsideComponent));
+	TestFalse(TEXT("Undo hides the cut piece"), GeneratedComponent->IsVisible());
+	TestEqual(TEXT("Undo releases the cut piece mesh"), FVFRewindTestScene::GetTrianglesForRewindTest(GeneratedComponent), 0);
+	TestEqual(TEXT("Undo triangles"), Scene.GetVisibleTriangles(), SceneTriangles);
+
+	Scene.Destroy();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVFTakePlaceRedoTest, "Viewfinder.Place.CacheRedo", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVFTakePlaceRedoTest::RunTest(const FString& Parameters)
+{
+	FVFRewindTestScene Scene;
+	if (!Scene.Create(*this))
+	{
+		Scene.Destroy();
+		return false;
+	}
+	const int32 SceneTriangles = Scene.GetVisibleTriangles();
+
+	const FVFPhotoInfo Photo = Scene.Placer->TakePhotoWithParamAssigned(Scene.TakeParams);
+	const FVFPhotoPlaceRecord PhotoPlaceRecord = Scene.Placer->PlacePhoto(Photo, 0.f);
+	if (!TestEqual(TEXT("Place generates one cut piece"), PhotoPlaceRecord.GeneratedComponents.Num(), 1))
+	{
+		Scene.Destroy();
+		return false;
+	}
+	UPrimitiveComponent* GeneratedComponent = PhotoPlaceRecord.GeneratedComponents[0];
+	const int32 GeneratedTriangles = FVFRewindTestScene::GetTrianglesForRewindTest(GeneratedComponent);
+	const int32 PlaceTriangles = Scene.GetVisibleTriangles();
+	Scene.Placer->UndoPlacePhoto(PhotoPlaceRecord);
+
+	//以相同的条件重做时从缓存恢复：组件与拍照时相同，网格体由补丁还原
+	const FVFPhotoPlaceRecord RedoPlaceRecord = Scene.Placer->PlacePhoto(Photo, 0.f);
+	TestTrue(TEXT("Redo reuses the cached cut piece"), RedoPlaceRecord.GeneratedComponents == PhotoPlaceRecord.GeneratedComponents);
+	TestTrue(TEXT("Redo reuses the cached background photo"), RedoPlaceRecord.BackgroundPhoto == PhotoPlaceRecord.BackgroundPhoto);
+	TestTrue(TEXT("Redo shows the cut piece"), IsShownForRewindTest(GeneratedComponent));
+	TestEqual(TEXT("Redo restores the cut piece triangles"), FVFRewindTestScene::GetTrianglesForRewindTest(GeneratedComponent), GeneratedTriangles);
+	TestTrue(TEXT("Redo hides the same boxes"), !IsShownForRewindTest(Scene.InsideComponent) && !IsShownForRewindTest(Scene.EdgeComponent) && IsShownForRewindTest(Scene.OutsideComponent));
+	TestEqual(TEXT("Redo triangles"), Scene.GetVisibleTriangles(), PlaceTriangles);
+
+	//重做之后再次回溯
+	Scene.Placer->UndoPlacePhoto(RedoPlaceRecord);
+	TestFalse(TEXT("Second undo hides the cut piece"), GeneratedComponent->IsVisible());
+	TestEqual(TEXT("Second undo triangles"), Scene.GetVisibleTriangles(), SceneTriangles);
+
+	Scene.Destroy();
+	return true;
+}
+
+#endif
@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFTextureCodec.h"
+#include "Engine/Texture2D.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	FColor DecodeRGB565ForTest(uint16 Color)
+	{
+		const int32 R = Color >> 11 & 31;
+		const int32 G = Color >> 5 & 63;
+		const int32 B = Color & 31;
+		return FColor(R << 3 | R >> 2, G << 2 | G >> 4, B << 3 | B >> 2);
+	}
+
+	//按BC1的规则解码一个像素，独立于编码器的实现
+	FColor DecodeBC1PixelForTest(const TArray<uint8>& Blocks, int32 Width, int32 X, int32 Y)
+	{
+		const int32 BlocksX = FMath::DivideAndRoundUp(Width, 4);
+		const uint8* Block = &Blocks[(Y / 4 * BlocksX + X / 4) * 8];
+		const uint16 Color0 = Block[0] | Block[1] << 8;
+		const uint16 Color1 = Block[2] | Block[3] << 8;
+		const FColor P0 = DecodeRGB565ForTest(Color0);
+		const FColor P1 = DecodeRGB565ForTest(Color1);
+
+		const int32 PixelIndex = Y % 4 * 4 + X % 4;
+		const int32 Index = Block[4 + PixelIndex / 4] >> (PixelIndex % 4 * 2) & 3;
+		switch (Index)
+		{
+		case 0: return P0;
+		case 1: return P1;
+		case 2: return Color0 > Color1 ? FColor((P0.R * 2 + P1.R) / 3, (P0.G * 2 + P1.G) / 3, (P0.B * 2 + P1.B) / 3) : FColor((P0.R + P1.R) / 2, (P0.G + P1.G) / 2, (P0.B + P1.B) / 2);
+		default: return Color0 > Color1 ? FColor((P0.R + P1.R * 2) / 3, (P0.G + P1.G * 2) / 3, (P0.B + P1.B * 2) / 3) : FColor::Black;
+		}
+	}
+
+	int32 GetColorErrorForTest(const FColor& A, const FColor& B)
+	{
+		return FMath::Max3(FMath::Abs(A.R - B.R), FMath::Abs(A.G - B.G), FMath::Abs(A.B - B.B));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVFTextureCodecTest, "Viewfinder.Save.TextureCodec", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FVFTextureCodecTest::RunTest(const FString& Parameters)
+{
+	//宽高不是4的倍数：左侧的块是纯色，右侧的块只有包围盒对角线上的两种颜色，边缘的块重复最后的像素
+	constexpr int32 Width = 7;
+	constexpr int32 Height = 5;
+	const FColor SolidColor(200, 100, 50);
+	const FColor CheckerColors[2] = { FColor(40, 40, 40), FColor(220, 200, 180) };
+	TArray<FColor> Pixels;
+	for (int32 Y = 0; Y < Height; Y++)
+	{
+		for (int32 X = 0; X < Width; X++)
+		{
+			Pixels.Emplace(X < 4 ? SolidColor : CheckerColors[(X + Y) % 2]);
+		}
+	}
+
+	TArray<uint8> Blocks;
+	FVFTextureCodec::CompressBC1(Pixels, Width, Height, Blocks);
+	if (!TestEqual(TEXT("BC1 size"), (int64)Blocks.Num(), FVFTextureCodec::GetBC1Size(Width, Height))) return false;
+	TestEqual(TEXT("BC1 size is 8 bytes per 4x4 block"), FVFTextureCodec::GetBC1Size(Width, Height), (int64)(2 * 2 * 8));
+
+	//纯色只有RGB565的量化误差，两种颜色的块还有端点向内收缩的误差
+	int32 SolidError = 0;
+	int32 CheckerError = 0;
+	for (int32 Y = 0; Y < Height; Y++)
+	{
+		for (int32 X = 0; X < Width; X++)
+		{
+			const int32 Error = GetColorErrorForTest(DecodeBC1PixelForTest(Blocks, Width, X, Y), Pixels[Y * Width + X]);
+			int32& MaxError = X < 4 ? SolidError : CheckerError;
+			MaxError = FMath::Max(MaxError, Error);
+		}
+	}
+	TestTrue(FString::Printf(TEXT("Solid block error %d"), SolidError), SolidError <= 8);
+	TestTrue(FString::Printf(TEXT("Two color block error %d"), CheckerError), CheckerError <= 24);
+
+	//BC1纹理直接复制块：编码、解码、再编码得到相同的数据
+	UTexture2D* Texture = UTexture2D::CreateTransient(8, 8, PF_DXT1);
+	if (!TestNotNull(TEXT("Create BC1 texture"), Texture)) return false;
+	{
+		TArray<uint8> TextureBlocks;
+		TArray<FColor> TexturePixels;
+		for (int32 i = 0; i < 8 * 8; i++)
+		{
+			TexturePixels.Emplace(i % 3 ? SolidColor : CheckerColors[i % 2]);
+		}
+		FVFTextureCodec::CompressBC1(TexturePixels, 8, 8, TextureBlocks);
+
+		FTexture2DMipMap& Mip = Texture->GetPlatformData()->Mips[0];
+		void* MipData = Mip.BulkData.Lock(LOCK_READ_WRITE);
+		FMemory::Memcpy(MipData, TextureBlocks.GetData(), TextureBlocks.Num());
+		Mip.BulkData.Unlock();
+	}
+
+	TArray<uint8> Encoded;
+	if (!TestTrue(TEXT("Encode BC1 texture"), FVFTextureCodec::Encode(Texture, Encoded))) return false;
+	UTexture2D* Decoded = FVFTextureCodec::Decode(Encoded);
+	if (!TestNotNull(TEXT("Decode"), Decoded)) return false;
+	TestTrue(TEXT("Decoded size and format"), Decoded->GetSizeX() == 8 && Decoded->GetSizeY() == 8 && Decoded->GetPixelFormat() == PF_DXT1);
+
+	TArray<uint8> Reencoded;
+	TestTrue(TEXT("Encode decoded texture"), FVFTextureCodec::Encode(Decoded, Reencoded));
+	TestTrue(TEXT("Round trip keeps the data"), Reencoded == Encoded);
+
+	//无效的数据
+	TArray<uint8> Truncated = Encoded;
+	Truncated.SetNum(Truncated.Num() - 1);
+	TestNull(TEXT("Decode truncated data"), FVFTextureCodec::Decode(Truncated));
+	TestNull(TEXT("Decode empty data"), FVFTextureCodec::Decode(TArray<uint8>()));
+	TestFalse(TEXT("Encode null texture"), FVFTextureCodec::Encode(nullptr, Encoded));
+	return true;
+}
+
+#endif
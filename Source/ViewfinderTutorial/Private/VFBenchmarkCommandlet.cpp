@@ -0,0 +1,199 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFBenchmarkCommandlet.h"
+#include "VFCutGeometrySubsystem.h"
+#include "VFMemory.h"
+#include "VFPhoto.h"
+#include "VFPhotoTakerPlacerComponent.h"
+#include "Dom/JsonObject.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "Generators/GridBoxMeshGenerator.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+using namespace UE::Geometry;
+
+namespace
+{
+	//摄像机位于原点朝向X轴，合成场景位于此距离处，网格体的间距略大于其尺寸，使边缘的网格体跨越视锥的边界
+	constexpr double SceneDistance = 600.0;
+	constexpr double MeshSize = 100.0;
+	constexpr double MeshSpacing = 120.0;
+}
+
+UVFBenchmarkCommandlet::UVFBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UVFBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 NumMeshes = 16;
+	int32 NumTriangles = 2000;
+	int32 NumIterations = 5;
+	float PlaceAngle = 45.f;
+	FString PyramidPath = TEXT("/Game/Viewfinder/Assets/SM_Pyramid.SM_Pyramid");
+	FString BaseName = FString::Printf(TEXT("VFBenchmark-%s"), *FDateTime::Now().ToString());
+	FParse::Value(*Params, TEXT("Meshes="), NumMeshes);
+	FParse::Value(*Params, TEXT("Triangles="), NumTriangles);
+	FParse::Value(*Params, TEXT("Iterations="), NumIterations);
+	FParse::Value(*Params, TEXT("PlaceAngle="), PlaceAngle);
+	FParse::Value(*Params, TEXT("Pyramid="), PyramidPath);
+	FParse::Value(*Params, TEXT("Output="), BaseName);
+
+	TArray<FVFBenchmarkIteration> Iterations;
+	if (!RunScenario(NumMeshes, NumTriangles, NumIterations, PlaceAngle, PyramidPath, Iterations)) return 1;
+
+	return WriteResults(BaseName, Params, Iterations) ? 0 : 1;
+}
+
+bool UVFBenchmarkCommandlet::RunScenario(int32 NumMeshes, int32 NumTriangles, int32 NumIterations, float PlaceAngle, const FString& PyramidPath, TArray<FVFBenchmarkIteration>& OutIterations)
+{
+	UStaticMesh* PyramidMesh = LoadObject<UStaticMesh>(nullptr, *PyramidPath);
+	if (!PyramidMesh)
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFBenchmark: failed to load pyramid mesh %s."), *PyramidPath);
+		return false;
+	}
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("VFBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	SpawnSyntheticScene(World, CreateSyntheticMesh(NumTriangles), NumMeshes);
+
+	AActor* PlacerActor = World->SpawnActor<AActor>();
+	Placer = NewObject<UVFPhotoTakerPlacerComponent>(PlacerActor);
+	Placer->SetMobility(EComponentMobility::Movable);
+	Placer->SetStaticMesh(PyramidMesh);
+	PlacerActor->SetRootComponent(Placer);
+	Placer->RegisterComponent();
+
+	//照片只需要数据，无渲染时渲染目标不会分配显存，尺寸只影响内存统计
+	FVFAPhotoTakeParams TakeParams;
+	TakeParams.PhotoClass = AVFPhoto::StaticClass();
+	TakeParams.CaptureSize = FVector2D(256.0, 256.0);
+
+	//每次迭代拍摄新的照片，第一次放置不会命中被撤销的放置的缓存，测量的总是完整的流程。之后的重做测量缓存的恢复
+	for (int32 IterationIndex = 0; IterationIndex < NumIterations; IterationIndex++)
+	{
+		FVFBenchmarkIteration& Iteration = OutIterations.AddDefaulted_GetRef();
+		FVFOperationStats::SetActive(&Iteration.Stats);
+
+		const FVFPhotoInfo Photo = Placer->TakePhotoWithParamAssigned(TakeParams);
+		const FVFPhotoPlaceRecord PhotoPlaceRecord = Placer->PlacePhoto(Photo, PlaceAngle);
+		Iteration.NumGeneratedComponents = PhotoPlaceRecord.GeneratedComponents.Num();
+		Iteration.NumHiddenComponents = PhotoPlaceRecord.HiddenComponents.Num();
+		for (const UPrimitiveComponent* GeneratedComponent : PhotoPlaceRecord.GeneratedComponents)
+		{
+			Iteration.GeneratedBytes += FVFMemory::GetComponentBytes(GeneratedComponent);
+		}
+		Iteration.PayloadBytes = Photo.IsValid() ? FVFMemory::GetPayloadBytes(*Photo.Payload) : 0;
+
+		//与玩家回溯相同：撤销，以相同的条件重做，再次撤销
+		Placer->UndoPlacePhoto(PhotoPlaceRecord);
+		const FVFPhotoPlaceRecord RedoPlaceRecord = Placer->PlacePhoto(Photo, PlaceAngle);
+		Iteration.bRedoFromCache = RedoPlaceRecord.GeneratedComponents == PhotoPlaceRecord.GeneratedComponents && RedoPlaceRecord.BackgroundPhoto == PhotoPlaceRecord.BackgroundPhoto;
+		Placer->UndoPlacePhoto(RedoPlaceRecord);
+
+		FVFOperationStats::SetActive(nullptr);
+		UE_LOG(LogViewfinder, Display, TEXT("VFBenchmark: iteration %d, %d generated, %d hidden, redo %s."),
+			IterationIndex, Iteration.NumGeneratedComponents, Iteration.NumHiddenComponents, Iteration.bRedoFromCache ? TEXT("from cache") : TEXT("recomputed"));
+	}
+
+	Placer = nullptr;
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+void UVFBenchmarkCommandlet::SpawnSyntheticScene(UWorld* World, UStaticMesh* Mesh, int32 NumMeshes)
+{
+	const int32 GridSize = FMath::CeilToInt(FMath::Sqrt((float)NumMeshes));
+	const double GridOffset = (GridSize - 1) * MeshSpacing * 0.5;
+	for (int32 MeshIndex = 0; MeshIndex < NumMeshes; MeshIndex++)
+	{
+		const FVector Location(SceneDistance, MeshIndex % GridSize * MeshSpacing - GridOffset, MeshIndex / GridSize * MeshSpacing - GridOffset);
+		AStaticMeshActor* Actor = World->SpawnActor<AStaticMeshActor>(Location, FRotator::ZeroRotator);
+		UStaticMeshComponent* StaticMeshComponent = Actor->GetStaticMeshComponent();
+		StaticMeshComponent->SetMobility(EComponentMobility::Movable);
+		StaticMeshComponent->SetStaticMesh(Mesh);
+		StaticMeshComponent->SetCollisionProfileName(FName("BlockAll"));
+		StaticMeshComponent->SetGenerateOverlapEvents(true);
+	}
+}
+
+UStaticMesh* UVFBenchmarkCommandlet::CreateSyntheticMesh(int32 NumTriangles)
+{
+	//每个面被细分为(EdgeVertices - 1)^2个四边形
+	const int32 EdgeVertices = FMath::Max(2, 1 + FMath::RoundToInt(FMath::Sqrt(NumTriangles / 12.f)));
+	FGridBoxMeshGenerator Generator;
+	Generator.Box = FOrientedBox3d(FVector3d::Zero(), FVector3d(MeshSize * 0.5));
+	Generator.EdgeVertices = FIndex3i(EdgeVertices, EdgeVertices, EdgeVertices);
+	const FDynamicMesh3 Mesh(&Generator.Generate());
+	UE_LOG(LogViewfinder, Display, TEXT("VFBenchmark: synthetic mesh with %d triangles."), Mesh.TriangleCount());
+
+	return UVFCutGeometrySubsystem::CreateTransientStaticMesh(this, Mesh, nullptr, false);
+}
+
+bool UVFBenchmarkCommandlet::WriteResults(const FString& BaseName, const FString& Params, const TArray<FVFBenchmarkIteration>& Iterations) const
+{
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("Viewfinder/Benchmark");
+
+	FString Csv = TEXT("Iteration,Stage,Count,Milliseconds,MemoryDeltaKB,TrianglesIn,TrianglesOut\n");
+	TArray<TSharedPtr<FJsonValue>> JsonIterations;
+	for (int32 IterationIndex = 0; IterationIndex < Iterations.Num(); IterationIndex++)
+	{
+		const FVFBenchmarkIteration& Iteration = Iterations[IterationIndex];
+		TSharedRef<FJsonObject> JsonIteration = MakeShared<FJsonObject>();
+		JsonIteration->SetNumberField(TEXT("GeneratedComponents"), Iteration.NumGeneratedComponents);
+		JsonIteration->SetNumberField(TEXT("HiddenComponents"), Iteration.NumHiddenComponents);
+		JsonIteration->SetNumberField(TEXT("GeneratedBytes"), Iteration.GeneratedBytes);
+		JsonIteration->SetNumberField(TEXT("PayloadBytes"), Iteration.PayloadBytes);
+		JsonIteration->SetBoolField(TEXT("RedoFromCache"), Iteration.bRedoFromCache);
+
+		TArray<TSharedPtr<FJsonValue>> JsonStages;
+		for (const FVFOperationStats::FStage& Stage : Iteration.Stats.Stages)
+		{
+			Csv += FString::Printf(TEXT("%d,%s,%d,%.3f,%.1f,%lld,%lld\n"), IterationIndex, *Stage.Name.ToString(), Stage.Count,
+				Stage.Seconds * 1000.0, Stage.MemoryDelta / 1024.0, Stage.TrianglesIn, Stage.TrianglesOut);
+
+			TSharedRef<FJsonObject> JsonStage = MakeShared<FJsonObject>();
+			JsonStage->SetStringField(TEXT("Name"), Stage.Name.ToString());
+			JsonStage->SetNumberField(TEXT("Count"), Stage.Count);
+			JsonStage->SetNumberField(TEXT("Milliseconds"), Stage.Seconds * 1000.0);
+			JsonStage->SetNumberField(TEXT("MemoryDeltaBytes"), Stage.MemoryDelta);
+			JsonStage->SetNumberField(TEXT("TrianglesIn"), Stage.TrianglesIn);
+			JsonStage->SetNumberField(TEXT("TrianglesOut"), Stage.TrianglesOut);
+			JsonStages.Emplace(MakeShared<FJsonValueObject>(JsonStage));
+		}
+		JsonIteration->SetArrayField(TEXT("Stages"), JsonStages);
+		JsonIterations.Emplace(MakeShared<FJsonValueObject>(JsonIteration));
+	}
+
+	TSharedRef<FJsonObject> JsonRoot = MakeShared<FJsonObject>();
+	JsonRoot->SetStringField(TEXT("Params"), Params);
+	JsonRoot->SetArrayField(TEXT("Iterations"), JsonIterations);
+	FString Json;
+	FJsonSerializer::Serialize(JsonRoot, TJsonWriterFactory<>::Create(&Json));
+
+	const FString CsvPath = Directory / BaseName + TEXT(".csv");
+	const FString JsonPath = Directory / BaseName + TEXT(".json");
+	if (!FFileHelper::SaveStringToFile(Csv, *CsvPath) || !FFileHelper::SaveStringToFile(Json, *JsonPath))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFBenchmark: failed to write results to %s."), *Directory);
+		return false;
+	}
+	UE_LOG(LogViewfinder, Display, TEXT("VFBenchmark: results written to %s and %s."), *CsvPath, *JsonPath);
+	return true;
+}
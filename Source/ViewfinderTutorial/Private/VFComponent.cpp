@@ -4,9 +4,21 @@
 #include "VFComponent.h"
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
+#include "VFCutGeometrySubsystem.h"
+#include "VFHitchWatchdog.h"
+#include "VFInputRecording.h"
 #include "VFPhoto.h"
+#include "VFMemory.h"
 #include "VFPhotoTakerPlacerComponent.h"
+#include "VFPoolSubsystem.h"
+#include "VFSaveSubsystem.h"
+#include "VFStats.h"
+#include "Components/DynamicMeshComponent.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectIterator.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
 
 UVFComponent::UVFComponent()
 {
@@ -40,13 +52,50 @@ void UVFComponent::BeginPlay()
 			InputComponent->BindAction(RotatePhotoAction, ETriggerEvent::Triggered, this, &UVFComponent::RotatePhoto);
 			InputComponent->BindAction(BacktrackAction, ETriggerEvent::Triggered, this, &UVFComponent::StartRewind);
 		}
+
+		BeginInputRecordingOrReplay(PlayerController);
 	}
 
 	GetWorld()->GetTimerManager().SetTimer(RewindTimerHandle, this, &UVFComponent::DoRewindRecord, RewindRecordTimeStep, true);
+	GetWorld()->GetTimerManager().SetTimer(MemoryStatsPollTimerHandle, this, &UVFComponent::PollMemoryStats, FMath::Max(MemoryStatsInterval, 0.01f), true, 0.f);
+
+	//生成的组件被烘焙为静态网格体后，替换回溯记录中的组件
+	if (UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>())
+	{
+		CutGeometrySubsystem->OnComponentReplaced.AddUObject(this, &UVFComponent::ReplaceComponentReferences);
+	}
+
+	//预先创建相框，第一次瞄准时不需要添加组件
+	if (UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>())
+	{
+		PoolSubsystem->WarmUpComponents(GetOwner(), UStaticMeshComponent::StaticClass(), PoolSubsystem->GetPhotoFrameWarmUpCount());
+	}
+}
+
+void UVFComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (bIsRecordingInput)
+	{
+		bIsRecordingInput = false;
+		InputRecording->NumSteps = InputStep;
+		if (InputRecording->SaveToFile(InputRecordingPath))
+		{
+			UE_LOG(LogViewfinder, Display, TEXT("Input recording with %d steps, %d samples and %d events written to %s."),
+				InputRecording->NumSteps, InputRecording->Samples.Num(), InputRecording->Events.Num(), *InputRecordingPath);
+		}
+		else
+		{
+			UE_LOG(LogViewfinder, Warning, TEXT("Failed to write the input recording to %s."), *InputRecordingPath);
+		}
+	}
+	GetWorld()->GetTimerManager().ClearTimer(InputTimerHandle);
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void UVFComponent::ToggleCameraOrPhoto()
 {
+	RecordInputEvent(EVFInputEvent::ToggleCameraOrPhoto);
 	if (bIsAiming || bIsCatching) return;
 	
 	bIsUsingCamera = !bIsUsingCamera;
@@ -54,6 +103,7 @@ void UVFComponent::ToggleCameraOrPhoto()
 
 void UVFComponent::Aim()
 {
+	RecordInputEvent(EVFInputEvent::Aim);
 	if (bIsCatching) return;
 
 	//如果正在使用摄像机，则显示相框，并将其设置在正确的变换上
@@ -62,7 +112,11 @@ void UVFComponent::Aim()
 		UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
 		if (Component)
 		{
-			PhotoFrame = Cast<UStaticMeshComponent>(GetOwner()->AddComponentByClass(UStaticMeshComponent::StaticClass(), true, FTransform(), false));
+			//对象池不可用时直接生成新的相框
+			UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>();
+			PhotoFrame = PoolSubsystem
+				? PoolSubsystem->AcquireComponent<UStaticMeshComponent>(GetOwner())
+				: Cast<UStaticMeshComponent>(GetOwner()->AddComponentByClass(UStaticMeshComponent::StaticClass(), true, FTransform(), false));
 			if (PhotoFrame)
 			{
 				PhotoFrame->SetStaticMesh(PhotoFrameMesh);
@@ -83,6 +137,32 @@ void UVFComponent::Aim()
 	else
 	{
 		TakeOutPhoto();
+
+		if (bSpeculativePlacement)
+		{
+			LastAimTransform = FTransform::Identity;
+			GetWorld()->GetTimerManager().SetTimer(SpeculativeTimerHandle, this, &UVFComponent::PollSpeculativePlacement, SpeculativePollInterval, true);
+		}
+
+		if (bPlacementPreview)
+		{
+			UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>();
+			PreviewComponent = PoolSubsystem
+				? PoolSubsystem->AcquireComponent<UDynamicMeshComponent>(GetOwner())
+				: Cast<UDynamicMeshComponent>(GetOwner()->AddComponentByClass(UDynamicMeshComponent::StaticClass(), true, FTransform(), false));
+			if (PreviewComponent)
+			{
+				//预览网格体位于世界空间
+				PreviewComponent->SetWorldTransform(FTransform::Identity);
+				PreviewComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+				PreviewComponent->SetHiddenInSceneCapture(true);
+				PreviewComponent->SetCastShadow(false);
+				PreviewComponent->SetMaterial(0, PreviewMaterial);
+				PreviewComponent->ComponentTags.Emplace(FName("NonCapture"));
+			}
+			LastPreviewTransform = FTransform::Identity;
+			GetWorld()->GetTimerManager().SetTimer(PreviewTimerHandle, this, &UVFComponent::UpdatePlacementPreview, PreviewInterval, true, 0.f);
+		}
 	}
 
 	bIsAiming = true;
@@ -90,17 +170,46 @@ void UVFComponent::Aim()
 
 void UVFComponent::AimEnd()
 {
+	RecordInputEvent(EVFInputEvent::AimEnd);
 	if (bIsUsingCamera)
 	{
 		if (PhotoFrame)
 		{
-			PhotoFrame->DestroyComponent();
+			if (UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>())
+			{
+				PoolSubsystem->ReleaseComponent(PhotoFrame);
+			}
+			else
+			{
+				PhotoFrame->DestroyComponent();
+			}
+			PhotoFrame = nullptr;
 		}
 	}
 	else
 	{
 		CurrentRotatedAngle = 0.f;
 		WithdrawPhoto();
+
+		GetWorld()->GetTimerManager().ClearTimer(SpeculativeTimerHandle);
+		GetWorld()->GetTimerManager().ClearTimer(PreviewTimerHandle);
+		if (UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>())
+		{
+			Component->CancelSpeculativePlace();
+			Component->CancelPlacePreview();
+		}
+		if (PreviewComponent)
+		{
+			if (UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>())
+			{
+				PoolSubsystem->ReleaseComponent(PreviewComponent);
+			}
+			else
+			{
+				PreviewComponent->DestroyComponent();
+			}
+			PreviewComponent = nullptr;
+		}
 	}
 
 	bIsAiming = false;
@@ -108,6 +217,7 @@ void UVFComponent::AimEnd()
 
 void UVFComponent::SwitchPhoto()
 {
+	RecordInputEvent(EVFInputEvent::SwitchPhoto);
 	if (bIsUsingCamera || bIsAiming || bIsCatching) return;
 	
 	int TargetIndex;
@@ -124,6 +234,7 @@ void UVFComponent::SwitchPhoto()
 
 void UVFComponent::RotatePhoto(const FInputActionValue& InputValue)
 {
+	RecordInputEvent(EVFInputEvent::RotatePhoto, InputValue.Get<float>());
 	if (bIsUsingCamera || !bIsAiming || bIsCatching) return;
 
 	const float Value = InputValue.Get<float>();
@@ -132,38 +243,67 @@ void UVFComponent::RotatePhoto(const FInputActionValue& InputValue)
 	const float Delta = CurrentRotatedAngle - Prev;
 	ApplyRotatedAngleDeltaToPhoto(Delta);
 
-	
+	//提前计算的结果对应旋转前的角度
+	if (UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>())
+	{
+		Component->CancelSpeculativePlace();
+	}
 }
 
 void UVFComponent::TakeOrPlacePhoto()
 {
+	RecordInputEvent(EVFInputEvent::TakeOrPlacePhoto);
 	if (!bIsAiming || bIsCatching) return;
 	
 	UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
 	if (!Component) return;
 		
+	FVFHitchWatchdog HitchWatchdog(bIsUsingCamera ? TEXT("Take") : TEXT("Place"));
 	if (bIsUsingCamera)
 	{
+		HitchWatchdog.SetPhoto(0, Component->GetDefaultPhotoTakeParams(), 0.f);
 		TakePhotoUsingComponent(Component);
+
+		//结束瞄准是拍照的一部分，重放拍照时会再次调用，不单独记录
+		TGuardValue<bool> RecordingGuard(bIsRecordingInput, false);
 		AimEnd();
 	}
 	else if (Photos.IsValidIndex(CurrentPhotoIndex))
 	{
 		//放置照片
-		AVFPhoto* Photo = Photos[CurrentPhotoIndex];
+		const FVFPhotoInfo Photo = Photos[CurrentPhotoIndex];
+		if (Photo.IsValid())
+		{
+			HitchWatchdog.SetPhoto(Photo.PhotoId, Photo.Payload->PhotoTakeParams, CurrentRotatedAngle);
+		}
+		HitchWatchdog.CapturePlacementBundle();
+		FVFAutosaveScope AutosaveScope(GetWorld());
 		FVFPhotoPlaceRecord PhotoPlaceRecord = Component->PlacePhoto(Photo, CurrentRotatedAngle);
+		AutosaveScope.Touch(PhotoPlaceRecord);
+		//回溯计时器的第一步之前没有记录，放置也需要能被回溯
+		if (RewindRecords.IsEmpty())
+		{
+			DoRewindRecord();
+		}
 		RewindRecords.Last().Action = 2;
 		RewindRecords.Last().PhotoPlaceRecord = MakeShared<FVFPhotoPlaceRecord>(PhotoPlaceRecord);
+
+		//放置的结果在一段时间没有被回溯后烘焙为静态网格体
+		UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>();
+		CutGeometrySubsystem->RequestBake(PhotoPlaceRecord.GeneratedComponents, CutGeometrySubsystem->GetBakeIdleTimeout());
 		
 		//移除照片
-		Photo->Destroy();
-		Photos.RemoveAt(CurrentPhotoIndex);
-		SetCurrentPhotoByIndex(Photos.IsValidIndex(CurrentPhotoIndex) ? CurrentPhotoIndex : (Photos.IsValidIndex(CurrentPhotoIndex - 1) ? CurrentPhotoIndex - 1 : CurrentPhotoIndex + 1));
+		RemovePhoto(Photo.PhotoId);
+		AutosaveScope.RemovePhoto(Photo.PhotoId);
+		ClearPlacementPreview();
 	}
+
+	RequestMemoryStatsUpdate();
 }
 
 void UVFComponent::StartRewind()
 {
+	RecordInputEvent(EVFInputEvent::Backtrack);
 	for (const FVFRewindRecord& BacktrackRecord : RewindRecords)
 	{
 		if (BacktrackRecord.Action != 0)
@@ -181,24 +321,101 @@ void UVFComponent::StartRewind()
 	}
 }
 
-void UVFComponent::AddPhoto(AVFPhoto* InPhoto)
+void UVFComponent::AddPhoto(const FVFPhotoInfo& InPhoto)
 {
-	Photos.Emplace(InPhoto);
+	if (!InPhoto.IsValid()) return;
+	
+	PhotoIndexMap.Emplace(InPhoto.PhotoId, Photos.Emplace(InPhoto));
 	SetCurrentPhotoByIndex(Photos.Num() - 1);
+}
+
+const FVFPhotoInfo* UVFComponent::FindPhotoById(uint64 PhotoId) const
+{
+	const int32* Index = PhotoIndexMap.Find(PhotoId);
+	return Index ? &Photos[*Index] : nullptr;
+}
+
+void UVFComponent::ResetPlacements()
+{
+	ClearPlacementPreview();
 	if (UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>())
 	{
-		InPhoto->AttachToComponent(Component, FAttachmentTransformRules::KeepWorldTransform);
-		WithdrawPhoto();
+		Component->ResetPlaceCache();
+	}
+
+	//被隐藏的组件会被重新显示，不能再被压缩；照片资源仍然按原来的方式退役
+	RewindRecords.Reset();
+	GetWorld()->GetTimerManager().ClearTimer(RewindTimerHandle);
+	PendingCompactComponents.Reset();
+
+	//读取可能打断了进行中的回溯
+	APlayerController* PlayerController = Cast<APlayerController>(Cast<APawn>(GetOwner())->GetController());
+	if (PlayerController && !bIsReplayingInput)
+	{
+		PlayerController->EnableInput(PlayerController);
 	}
 }
 
+void UVFComponent::RestorePhotos(const TArray<FVFPhotoInfo>& InPhotos)
+{
+	//读取存档后地图已经改变，回溯记录无法再还原，从当前位置重新开始记录
+	RewindRecords.Reset();
+	GetWorld()->GetTimerManager().ClearTimer(RewindTimerHandle);
+	GetWorld()->GetTimerManager().SetTimer(RewindTimerHandle, this, &UVFComponent::DoRewindRecord, RewindRecordTimeStep, true);
+	DoRewindRecord();
+
+	Photos.Reset();
+	PhotoIndexMap.Reset();
+	CurrentPhotoIndex = -1;
+	SetCurrentPhotoByIndex(CurrentPhotoIndex);
+	for (const FVFPhotoInfo& Photo : InPhotos)
+	{
+		AddPhoto(Photo);
+	}
+}
+
+void UVFComponent::RemovePhoto(uint64 PhotoId)
+{
+	int32 Index;
+	if (!PhotoIndexMap.RemoveAndCopyValue(PhotoId, Index)) return;
+
+	Photos.RemoveAt(Index);
+	for (int32 i = Index; i < Photos.Num(); i++)
+	{
+		PhotoIndexMap[Photos[i].PhotoId] = i;
+	}
+	SetCurrentPhotoByIndex(Photos.IsValidIndex(CurrentPhotoIndex) ? CurrentPhotoIndex : (Photos.IsValidIndex(CurrentPhotoIndex - 1) ? CurrentPhotoIndex - 1 : CurrentPhotoIndex + 1));
+}
+
+AVFPhoto* UVFComponent::GetDisplayPhoto(const FVFPhotoInfo& PhotoInfo)
+{
+	const TSubclassOf<AVFPhoto> PhotoClass = PhotoInfo.Payload->PhotoTakeParams.PhotoClass;
+	if (DisplayPhoto && DisplayPhoto->GetClass() == PhotoClass) return DisplayPhoto;
+
+	if (DisplayPhoto)
+	{
+		DisplayPhoto->Destroy();
+		DisplayPhoto = nullptr;
+	}
+
+	UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
+	if (!Component || !PhotoClass) return nullptr;
+
+	DisplayPhoto = Cast<AVFPhoto>(GetWorld()->SpawnActor(PhotoClass));
+	if (DisplayPhoto)
+	{
+		DisplayPhoto->AttachToComponent(Component, FAttachmentTransformRules::KeepWorldTransform);
+	}
+	return DisplayPhoto;
+}
+
 void UVFComponent::ApplyRotatedAngleDeltaToPhoto(float DeltaAngle)
 {
 	UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
 	if (!Component) return;
 
-	if (!Photos.IsValidIndex(CurrentPhotoIndex)) return;
-	AVFPhoto* Photo = Photos[CurrentPhotoIndex];
+	if (!Photos.IsValidIndex(CurrentPhotoIndex) || !DisplayPhoto) return;
+	AVFPhoto* Photo = DisplayPhoto;
 	
 	FVector RotationAxis = Component->GetForwardVector();
 	float RotationAngleDegrees = DeltaAngle;
@@ -211,6 +428,8 @@ void UVFComponent::ApplyRotatedAngleDeltaToPhoto(float DeltaAngle)
 
 void UVFComponent::DoRewindRecord()
 {
+	FVFHitchWatchdog HitchWatchdog(TEXT("RewindRecord"));
+	VF_SCOPED_STAGE(RewindRecord);
 	FVFRewindRecord BacktrackRecord;
 	BacktrackRecord.ActorTransform = GetOwner()->GetActorTransform();
 	BacktrackRecord.ControlRotation = Cast<APawn>(GetOwner())->GetControlRotation();
@@ -218,12 +437,306 @@ void UVFComponent::DoRewindRecord()
 	RewindRecords.Emplace(BacktrackRecord);
 	if (RewindRecords.Num() > MaxRewindTime / RewindRecordTimeStep)
 	{
+		const FVFRewindRecord ExpiredRecord = MoveTemp(RewindRecords[0]);
 		RewindRecords.RemoveAt(0);
+		RetireExpiredRewindRecord(ExpiredRecord);
+	}
+}
+
+void UVFComponent::RetireExpiredRewindRecord(const FVFRewindRecord& ExpiredRecord)
+{
+	if (ExpiredRecord.Action != 2 || !ExpiredRecord.PhotoPlaceRecord) return;
+	const FVFPhotoPlaceRecord& PhotoPlaceRecord = *ExpiredRecord.PhotoPlaceRecord;
+
+	//被隐藏的组件将永远不会再显示，包括地图原有的组件与更早的放置生成的组件
+	SIZE_T FreedBytes = 0;
+	for (UPrimitiveComponent* HiddenComponent : PhotoPlaceRecord.HiddenComponents)
+	{
+		if (IsValid(HiddenComponent))
+		{
+			FreedBytes += FVFMemory::GetComponentBytes(HiddenComponent);
+			PendingCompactComponents.Emplace(HiddenComponent);
+		}
+	}
+
+	//照片已经无法再回到物品栏，但照片数据可能仍被其它记录或工作线程持有，等所有持有者释放后再释放其资源
+	const TSharedPtr<const FVFPhotoPayload>& Payload = PhotoPlaceRecord.PhotoInfo.Payload;
+	if (Payload)
+	{
+		FVFRetiredPhotoResources& Resources = RetiredPhotoResources.AddDefaulted_GetRef();
+		Resources.Payload = Payload;
+		Resources.RenderTarget = Payload->RenderTarget.Get();
+		Resources.DynamicMeshRecord = Payload->DynamicMeshRecord.Get();
+	}
+	FreedBytes += ReleaseRetiredPhotoResources();
+
+	//放置已经无法回溯，生成的组件可以合并并立即烘焙
+	UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>();
+	CutGeometrySubsystem->RequestMerge(PhotoPlaceRecord.GeneratedComponents);
+	CutGeometrySubsystem->RequestBake(PhotoPlaceRecord.GeneratedComponents, 0.f);
+
+	UE_LOG(LogViewfinder, Log, TEXT("Retired placement of photo %llu: %d hidden components, %.1f KB freed."),
+		PhotoPlaceRecord.PhotoInfo.PhotoId, PhotoPlaceRecord.HiddenComponents.Num(), FreedBytes / 1024.f);
+
+	if ((PendingCompactComponents.Num() || RetiredPhotoResources.Num()) && !GetWorld()->GetTimerManager().IsTimerActive(CompactTimerHandle))
+	{
+		GetWorld()->GetTimerManager().SetTimer(CompactTimerHandle, this, &UVFComponent::DoCompactComponents, CompactTimeStep, true);
+	}
+
+	RequestMemoryStatsUpdate();
+}
+
+SIZE_T UVFComponent::ReleaseRetiredPhotoResources()
+{
+	check(IsInGameThread());
+	SIZE_T FreedBytes = 0;
+	for (int32 i = RetiredPhotoResources.Num() - 1; i >= 0; i--)
+	{
+		//弱指针失效后照片数据已被销毁且无法再被任何地方取得，其资源只剩此处的引用
+		const FVFRetiredPhotoResources& Resources = RetiredPhotoResources[i];
+		if (Resources.Payload.IsValid()) continue;
+
+		if (UTexture* RenderTarget = Resources.RenderTarget.Get())
+		{
+			FreedBytes += RenderTarget->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+			RenderTarget->ReleaseResource();
+		}
+		if (UDynamicMesh* DynamicMeshRecord = Resources.DynamicMeshRecord.Get())
+		{
+			FreedBytes += FVFMemory::GetDynamicMeshBytes(DynamicMeshRecord->GetMeshRef());
+			DynamicMeshRecord->Reset();
+		}
+		RetiredPhotoResources.RemoveAtSwap(i, 1, false);
+	}
+	return FreedBytes;
+}
+
+void UVFComponent::CollectMemoryReport(FVFMemoryReport& Report) const
+{
+	for (const FVFPhotoInfo& Photo : Photos)
+	{
+		Report.AddEntry(FString::Printf(TEXT("Photo %llu"), Photo.PhotoId), Report.AddPayload(Photo.Payload.Get()));
+	}
+
+	//较新的放置更可能被回溯，共享的组件计入较新的放置
+	for (int32 i = RewindRecords.Num() - 1; i >= 0; i--)
+	{
+		const FVFRewindRecord& RewindRecord = RewindRecords[i];
+		if (!RewindRecord.PhotoPlaceRecord) continue;
+
+		const FVFPhotoPlaceRecord& PhotoPlaceRecord = *RewindRecord.PhotoPlaceRecord;
+		const float Age = (RewindRecords.Num() - 1 - i) * RewindRecordTimeStep;
+		Report.AddEntry(FString::Printf(TEXT("Placement %llu (%.1fs ago)"), PhotoPlaceRecord.PhotoInfo.PhotoId, Age), Report.AddPlaceRecord(PhotoPlaceRecord));
+	}
+
+	if (const UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>())
+	{
+		Component->CollectMemoryReport(Report);
+	}
+
+	SIZE_T PendingCompactBytes = 0;
+	for (const TWeakObjectPtr<UPrimitiveComponent>& PendingComponent : PendingCompactComponents)
+	{
+		PendingCompactBytes += Report.AddHiddenComponent(PendingComponent.Get());
+	}
+	Report.AddEntry(TEXT("Pending compact"), PendingCompactBytes);
+
+	const SIZE_T RewindRecordBytes = RewindRecords.GetAllocatedSize() + PendingCompactComponents.GetAllocatedSize();
+	Report.RewindRecordBytes += RewindRecordBytes;
+	Report.AddEntry(FString::Printf(TEXT("Rewind history (%d records)"), RewindRecords.Num()), RewindRecordBytes);
+}
+
+void UVFComponent::RequestMemoryStatsUpdate()
+{
+	FTimerManager& TimerManager = GetWorld()->GetTimerManager();
+	if (!TimerManager.IsTimerActive(MemoryStatsTimerHandle))
+	{
+		TimerManager.SetTimer(MemoryStatsTimerHandle, this, &UVFComponent::UpdateMemoryStats, FMath::Max(MemoryStatsInterval, 0.01f), false);
 	}
 }
 
+bool UVFComponent::IsCollectingMemoryStats() const
+{
+	bool bIsCollecting = MemoryBudgetMB > 0.f;
+#if STATS
+	bIsCollecting |= FThreadStats::IsCollectingData();
+#endif
+#if CSV_PROFILER
+	bIsCollecting |= FCsvProfiler::Get()->IsCapturing();
+#endif
+	return bIsCollecting;
+}
+
+void UVFComponent::PollMemoryStats()
+{
+	const bool bIsCollecting = IsCollectingMemoryStats();
+	if (bIsCollecting && !bWasCollectingMemoryStats)
+	{
+		UpdateMemoryStats();
+	}
+	bWasCollectingMemoryStats = bIsCollecting;
+}
+
+void UVFComponent::UpdateMemoryStats()
+{
+	if (!IsCollectingMemoryStats()) return;
+
+	FVFMemoryReport Report;
+	CollectMemoryReport(Report);
+
+	SET_MEMORY_STAT(STAT_VF_TotalMemory, Report.GetTotalBytes());
+	SET_MEMORY_STAT(STAT_VF_PhotoMemory, Report.PhotoBytes);
+	SET_MEMORY_STAT(STAT_VF_HiddenMemory, Report.HiddenBytes);
+	SET_MEMORY_STAT(STAT_VF_GeneratedMemory, Report.GeneratedBytes);
+	SET_MEMORY_STAT(STAT_VF_RewindRecordMemory, Report.RewindRecordBytes);
+	CSV_CUSTOM_STAT(Viewfinder, MemoryMB, Report.GetTotalBytes() / (1024.f * 1024.f), ECsvCustomStatOp::Set);
+
+	if (MemoryBudgetMB <= 0.f) return;
+
+	const bool bWasOverMemoryBudget = bIsOverMemoryBudget;
+	bIsOverMemoryBudget = Report.GetTotalBytes() > MemoryBudgetMB * 1024.f * 1024.f;
+	if (bIsOverMemoryBudget && !bWasOverMemoryBudget)
+	{
+		UE_LOG(LogViewfinder, Warning, TEXT("Viewfinder memory %.1f MB exceeds the budget of %.1f MB. Consider a shorter rewind window or fewer photos."),
+			Report.GetTotalBytes() / (1024.f * 1024.f), MemoryBudgetMB);
+		Report.Log(10);
+	}
+}
+
+void UVFComponent::ReplaceComponentReferences(UPrimitiveComponent* OldComponent, UPrimitiveComponent* NewComponent)
+{
+	for (FVFRewindRecord& RewindRecord : RewindRecords)
+	{
+		if (!RewindRecord.PhotoPlaceRecord) continue;
+
+		for (UPrimitiveComponent*& GeneratedComponent : RewindRecord.PhotoPlaceRecord->GeneratedComponents)
+		{
+			if (GeneratedComponent == OldComponent) GeneratedComponent = NewComponent;
+		}
+		for (UPrimitiveComponent*& HiddenComponent : RewindRecord.PhotoPlaceRecord->HiddenComponents)
+		{
+			if (HiddenComponent == OldComponent) HiddenComponent = NewComponent;
+		}
+	}
+	for (TWeakObjectPtr<UPrimitiveComponent>& PendingComponent : PendingCompactComponents)
+	{
+		if (PendingComponent == OldComponent) PendingComponent = NewComponent;
+	}
+}
+
+void UVFComponent::DoCompactComponents()
+{
+	VF_SCOPED_STAGE(RewindCompact);
+	UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>();
+	int32 NumCompacted = 0;
+	while (PendingCompactComponents.Num() && NumCompacted < MaxCompactComponentsPerStep)
+	{
+		UPrimitiveComponent* Component = PendingCompactComponents.Pop(false).Get();
+		if (!Component || Component->IsBeingDestroyed()) continue;
+		NumCompacted++;
+
+		//放置生成的组件归还到对象池，归还时会释放网格体数据，超出对象池容量的组件会被销毁
+		if (Component->ComponentHasTag(FName("VFGenerated")))
+		{
+			GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>()->SetMeshPatch(Component, nullptr);
+			PoolSubsystem->ReleaseComponent(Component);
+			continue;
+		}
+
+		//地图原有的组件，如果是根组件则保留组件本身，只释放网格体与物理
+		if (Component == Component->GetOwner()->GetRootComponent())
+		{
+			Component->SetSimulatePhysics(false);
+			if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+			{
+				const EComponentMobility::Type PrevMobility = StaticMeshComponent->Mobility;
+				StaticMeshComponent->SetMobility(EComponentMobility::Movable);
+				StaticMeshComponent->SetStaticMesh(nullptr);
+				StaticMeshComponent->SetMobility(PrevMobility);
+			}
+			else if (UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+			{
+				DynamicMeshComponent->GetDynamicMesh()->Reset();
+			}
+			continue;
+		}
+
+		//挂载在此组件上的子组件会被挂载到它的父组件上，销毁后存档无法再通过标签找到此组件
+		GetWorld()->GetSubsystem<UVFSaveSubsystem>()->AddDestroyedComponent(Component);
+		Component->DestroyComponent(true);
+	}
+
+	//放置退役时仍被持有的照片数据通常在工作线程的任务结束后释放，仍被长期持有的留到下次放置退役时再检查
+	if (RetiredPhotoResources.Num() && ReleaseRetiredPhotoResources())
+	{
+		RequestMemoryStatsUpdate();
+	}
+
+	if (PendingCompactComponents.Num() == 0)
+	{
+		GetWorld()->GetTimerManager().ClearTimer(CompactTimerHandle);
+	}
+}
+
+void UVFComponent::PollSpeculativePlacement()
+{
+	UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
+	if (!Component || bIsUsingCamera || !bIsAiming || !Photos.IsValidIndex(CurrentPhotoIndex)) return;
+
+	//瞄准在两次检查之间发生了变化，之前的结果已经失效
+	const FTransform AimTransform(Component->GetComponentQuat(), Component->GetComponentLocation());
+	if (!AimTransform.Equals(LastAimTransform) || CurrentRotatedAngle != LastAimRotatedAngle)
+	{
+		LastAimTransform = AimTransform;
+		LastAimRotatedAngle = CurrentRotatedAngle;
+		Component->CancelSpeculativePlace();
+		return;
+	}
+
+	Component->BeginSpeculativePlace(Photos[CurrentPhotoIndex], CurrentRotatedAngle);
+}
+
+void UVFComponent::UpdatePlacementPreview()
+{
+	UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
+	if (!Component || !PreviewComponent || bIsUsingCamera || !bIsAiming || !Photos.IsValidIndex(CurrentPhotoIndex)) return;
+
+	UE::Geometry::FDynamicMesh3 PreviewMesh;
+	if (Component->FetchPlacePreview(PreviewMesh))
+	{
+		PreviewComponent->GetDynamicMesh()->SetMesh(MoveTemp(PreviewMesh));
+	}
+
+	//瞄准没有改变时不需要重新计算
+	const FTransform AimTransform(Component->GetComponentQuat(), Component->GetComponentLocation());
+	if (AimTransform.Equals(LastPreviewTransform) && CurrentRotatedAngle == LastPreviewRotatedAngle) return;
+
+	if (Component->RequestPlacePreview(Photos[CurrentPhotoIndex], CurrentRotatedAngle, PreviewMaxTrianglesPerMesh, PreviewMaxComponents))
+	{
+		LastPreviewTransform = AimTransform;
+		LastPreviewRotatedAngle = CurrentRotatedAngle;
+	}
+}
+
+void UVFComponent::ClearPlacementPreview()
+{
+	if (UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>())
+	{
+		Component->CancelPlacePreview();
+	}
+	if (PreviewComponent)
+	{
+		PreviewComponent->GetDynamicMesh()->Reset();
+	}
+
+	//使下次更新时重新开始预览计算
+	LastPreviewTransform = FTransform::Identity;
+}
+
 void UVFComponent::DoRewind()
 {
+	FVFHitchWatchdog HitchWatchdog(TEXT("Rewind"));
+	VF_SCOPED_STAGE(RewindPlayback);
 	if (RewindRecords.Num() == 0)
 	{
 		GetWorld()->GetTimerManager().ClearTimer(RewindTimerHandle);
@@ -240,96 +753,96 @@ void UVFComponent::DoRewind()
 		RewindRecords.RemoveAt(RewindRecords.Num() - 1);
 		return;
 	}
+
+	//撤销会隐藏或回收放置生成的对象，需要在撤销之前记录它们
+	FVFAutosaveScope AutosaveScope(GetWorld());
 	if (RewindRecord.Action == 1)
 	{
-		if (RewindRecord.PhotoTakeInfo)
-		{
-			for (AVFPhoto* Photo : Photos)
-			{
-				if (*RewindRecord.PhotoTakeInfo == Photo->GetPhotoInfo())
-				{
-					if (Photo)
-					{
-						Photos.Remove(Photo);
-						SetCurrentPhotoByIndex(Photos.IsValidIndex(CurrentPhotoIndex) ? CurrentPhotoIndex : (Photos.IsValidIndex(CurrentPhotoIndex - 1) ? CurrentPhotoIndex - 1 : CurrentPhotoIndex + 1));
-						Photo->Destroy();
-					}
-					break;
-				}
-			}
-		}
+		RemovePhoto(RewindRecord.PhotoTakeId);
+		AutosaveScope.RemovePhoto(RewindRecord.PhotoTakeId);
 	}
 	else if (RewindRecord.Action == 2)
 	{
 		TSharedPtr<FVFPhotoPlaceRecord> PhotoPlaceRecord = RewindRecord.PhotoPlaceRecord;
 		if (PhotoPlaceRecord)
 		{
-			for (UPrimitiveComponent* GeneratedComponent : PhotoPlaceRecord->GeneratedComponents)
-			{
-				GeneratedComponent->DestroyComponent();
-			}
-
-			for (AActor* SpawnedActor : PhotoPlaceRecord->SpawnedActors)
-			{
-				SpawnedActor->Destroy();
-			}
-
-			for (UPrimitiveComponent* HiddenComponent : PhotoPlaceRecord->HiddenComponents)
-			{
-				HiddenComponent->SetVisibility(true);
-				HiddenComponent->SetGenerateOverlapEvents(true);
-				HiddenComponent->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-			}
-
-			if (PhotoPlaceRecord && PhotoPlaceRecord->BackgroundPhoto)
+			//放置的结果会被缓存，再次以相同的条件放置时直接恢复
+			UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
+			AutosaveScope.Touch(*PhotoPlaceRecord);
+			if (Component)
 			{
-				PhotoPlaceRecord->BackgroundPhoto->Destroy();
+				Component->UndoPlacePhoto(*PhotoPlaceRecord);
 			}
 
-			if (PhotoPlaceRecord && PhotoPlaceRecord->PhotoInfo.PhotoTakeParams.PhotoClass)
-			{
-				AVFPhoto* Photo = Cast<AVFPhoto>(GetWorld()->SpawnActor(PhotoPlaceRecord->PhotoInfo.PhotoTakeParams.PhotoClass));
-				Photo->SetPhotoInfo(PhotoPlaceRecord->PhotoInfo);
-				AddPhoto(Photo);
-			}
+			//放回的照片与放置记录共享照片数据
+			AddPhoto(PhotoPlaceRecord->PhotoInfo);
+			AutosaveScope.AddPhoto(PhotoPlaceRecord->PhotoInfo);
 		}
 	}
 
+	ClearPlacementPreview();
+
 	if (RewindRecords.Num())
 	{
 		RewindRecords.RemoveAt(RewindRecords.Num() - 1);
 	}
+	//重放输入时玩家的输入保持禁用
 	APlayerController* PlayerController = Cast<APlayerController>(Cast<APawn>(GetOwner())->GetController());
-	if (PlayerController)
+	if (PlayerController && !bIsReplayingInput)
 	{
 		PlayerController->EnableInput(PlayerController);
 	}
 	GetWorld()->GetTimerManager().ClearTimer(RewindTimerHandle);
 	GetWorld()->GetTimerManager().SetTimer(RewindTimerHandle, this, &UVFComponent::DoRewindRecord, RewindRecordTimeStep, true);
+
+	RequestMemoryStatsUpdate();
 }
 
 void UVFComponent::TakePhotoUsingComponent(UVFPhotoTakerPlacerComponent* InComponent)
 {
-	AVFPhoto* Photo = InComponent->TakePhoto();
+	FVFAutosaveScope AutosaveScope(GetWorld());
+	const FVFPhotoInfo Photo = InComponent->TakePhoto();
+	if (!Photo.IsValid()) return;
 	AddPhoto(Photo);
+	AutosaveScope.AddPhoto(Photo);
 		
+	if (RewindRecords.IsEmpty())
+	{
+		DoRewindRecord();
+	}
 	RewindRecords.Last().Action = 1;
-	RewindRecords.Last().PhotoTakeInfo = MakeShared<FVFPhotoInfo>(Photo->GetPhotoInfo());
+	RewindRecords.Last().PhotoTakeId = Photo.PhotoId;
 }
 
 void UVFComponent::SetCurrentPhotoByIndex(int Index)
 {
-	if (Photos.IsValidIndex(CurrentPhotoIndex))
+	ClearPlacementPreview();
+	if (!Photos.IsValidIndex(Index))
 	{
-		AVFPhoto* Photo = Photos[CurrentPhotoIndex];
-		Photo->GetPhotoMesh()->SetVisibility(false);
+		if (DisplayPhoto)
+		{
+			DisplayPhoto->GetPhotoMesh()->SetVisibility(false);
+		}
+		return;
 	}
-	
-	if (!Photos.IsValidIndex(Index)) return;
 	CurrentPhotoIndex = Index;
 
-	AVFPhoto* Photo = Photos[CurrentPhotoIndex];
+	//所有照片共用同一个Actor，只需要替换显示的纹理
+	AVFPhoto* Photo = GetDisplayPhoto(Photos[CurrentPhotoIndex]);
+	if (!Photo) return;
+	Photo->SetPhotoInfo(Photos[CurrentPhotoIndex]);
 	Photo->GetPhotoMesh()->SetVisibility(true);
+
+	//新照片的宽高比可能不同，放置后的旋转角度也不再适用，按当前状态重新设置位置、旋转与缩放
+	CurrentRotatedAngle = 0.f;
+	if (bIsAiming && !bIsUsingCamera)
+	{
+		TakeOutPhoto();
+	}
+	else
+	{
+		WithdrawPhoto();
+	}
 }
 
 void UVFComponent::TakeOutPhoto()
@@ -337,16 +850,16 @@ void UVFComponent::TakeOutPhoto()
 	UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
 	if (!Component) return;
 
-	if (!Photos.IsValidIndex(CurrentPhotoIndex)) return;
-	AVFPhoto* Photo = Photos[CurrentPhotoIndex];
+	if (!Photos.IsValidIndex(CurrentPhotoIndex) || !DisplayPhoto) return;
+	AVFPhoto* Photo = DisplayPhoto;
 
 	Photo->SetActorLocation(Component->GetComponentLocation() + Component->GetForwardVector() * PhotoPlaceDistance);
 	Photo->SetActorRotation(Component->GetComponentRotation());
 	ApplyRotatedAngleDeltaToPhoto(CurrentRotatedAngle);
 
-	const float AspectRatio = Photo->GetPhotoInfo().PhotoTakeParams.GetAspectRatio();
+	const float AspectRatio = Photo->GetPhotoInfo().Payload->PhotoTakeParams.GetAspectRatio();
 	float BaseScaleXY = PhotoPlaceDistance / 100.f *  UKismetMathLibrary::DegTan(Component->GetCaptureFOVAngle() / 2.f);
-	const FVector2D& AspectRatioScale = FVector2D(Photo->GetPhotoInfo().PhotoTakeParams.GetAspectRatio() > 1.f ? 1.f : AspectRatio, AspectRatio < 1.f ? 1.f : 1.f / AspectRatio);
+	const FVector2D& AspectRatioScale = FVector2D(Photo->GetPhotoInfo().Payload->PhotoTakeParams.GetAspectRatio() > 1.f ? 1.f : AspectRatio, AspectRatio < 1.f ? 1.f : 1.f / AspectRatio);
 	Photo->SetActorScale3D(FVector(1.0, BaseScaleXY * AspectRatioScale.X, BaseScaleXY * AspectRatioScale.Y));
 }
 
@@ -355,13 +868,152 @@ void UVFComponent::WithdrawPhoto()
 	UVFPhotoTakerPlacerComponent* Component = GetOwner()->FindComponentByClass<UVFPhotoTakerPlacerComponent>();
 	if (!Component) return;
 
-	if (!Photos.IsValidIndex(CurrentPhotoIndex)) return;
-	AVFPhoto* Photo = Photos[CurrentPhotoIndex];
+	if (!Photos.IsValidIndex(CurrentPhotoIndex) || !DisplayPhoto) return;
+	AVFPhoto* Photo = DisplayPhoto;
 
 	Photo->SetActorLocation(Component->GetComponentLocation() + Component->GetForwardVector() * PhotoPlaceDistance + Component->GetRightVector() * -16.f + Component->GetUpVector() * -8.f);
 	Photo->SetActorRotation(Component->GetComponentRotation());
 
-	const float AspectRatio = Photo->GetPhotoInfo().PhotoTakeParams.GetAspectRatio();
+	const float AspectRatio = Photo->GetPhotoInfo().Payload->PhotoTakeParams.GetAspectRatio();
 	const FVector2D& AspectRatioScale = FVector2D(AspectRatio > 1.f ? 1.f : AspectRatio, AspectRatio < 1.f ? 1.f : 1.f / AspectRatio);
 	Photo->SetActorScale3D(FVector(1.0, 0.036 * AspectRatioScale.X, 0.036 * AspectRatioScale.Y));
 }
+
+void UVFComponent::BeginInputRecordingOrReplay(APlayerController* PlayerController)
+{
+	FString ReplayPath;
+	if (FParse::Value(FCommandLine::Get(), TEXT("VFReplay="), ReplayPath))
+	{
+		InputRecording = MakeShared<FVFInputRecording>();
+		if (!InputRecording->LoadFromFile(ReplayPath))
+		{
+			UE_LOG(LogViewfinder, Error, TEXT("Failed to load the input recording %s."), *ReplayPath);
+			InputRecording.Reset();
+			return;
+		}
+		if (InputRecording->MapName != GetWorld()->GetMapName())
+		{
+			UE_LOG(LogViewfinder, Warning, TEXT("Input recording %s was recorded in %s, replaying in %s."), *ReplayPath, *InputRecording->MapName, *GetWorld()->GetMapName());
+		}
+
+		//-VFReplayLoops=N重复重放N次用于长时间的测试，之后的每次重放都从上一次结束时的关卡状态开始
+		int32 NumLoops = 1;
+		FParse::Value(FCommandLine::Get(), TEXT("VFReplayLoops="), NumLoops);
+		ReplayLoopsRemaining = FMath::Max(NumLoops, 1) - 1;
+
+		PlayerController->DisableInput(PlayerController);
+		bIsReplayingInput = true;
+		//与录制相同，第一步在下一帧进行，步数与录制时对应
+		GetWorld()->GetTimerManager().SetTimer(InputTimerHandle, this, &UVFComponent::ReplayInputStep, InputRecording->StepSeconds, true, 0.f);
+		UE_LOG(LogViewfinder, Display, TEXT("Replaying %s, %d steps of %.4f s."), *ReplayPath, InputRecording->NumSteps, InputRecording->StepSeconds);
+		return;
+	}
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("VFRecordInput")) || FParse::Value(FCommandLine::Get(), TEXT("VFRecordInput="), InputRecordingPath))
+	{
+		if (InputRecordingPath.IsEmpty())
+		{
+			InputRecordingPath = FPaths::ProjectSavedDir() / TEXT("Viewfinder/Input") / FString::Printf(TEXT("%s-%s.vfinput"), *GetWorld()->GetMapName(), *FDateTime::Now().ToString());
+		}
+		InputRecording = MakeShared<FVFInputRecording>();
+		InputRecording->MapName = GetWorld()->GetMapName();
+		InputRecording->StepSeconds = RewindRecordTimeStep;
+		bIsRecordingInput = true;
+		GetWorld()->GetTimerManager().SetTimer(InputTimerHandle, this, &UVFComponent::RecordInputStep, InputRecording->StepSeconds, true, 0.f);
+	}
+}
+
+void UVFComponent::RecordInputEvent(EVFInputEvent Event, float Value)
+{
+	if (!bIsRecordingInput) return;
+
+	//事件在下一步的变换之前重放
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	InputRecording->AddEvent(InputStep, Event, Value, Pawn->GetActorTransform(), Pawn->GetControlRotation());
+}
+
+void UVFComponent::RecordInputStep()
+{
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	InputRecording->AddSample(InputStep, Pawn->GetActorTransform(), Pawn->GetControlRotation());
+	InputStep++;
+}
+
+void UVFComponent::ReplayInputStep()
+{
+	const FVFInputRecording& Recording = *InputRecording;
+	APawn* Pawn = Cast<APawn>(GetOwner());
+	while (NextReplayEvent < Recording.Events.Num() && Recording.Events[NextReplayEvent].Step <= InputStep)
+	{
+		//拍照与放置的结果取决于事件发生时的视角，先恢复录制时的精确位姿
+		const FVFInputRecording::FEvent& Event = Recording.Events[NextReplayEvent++];
+		Pawn->SetActorLocationAndRotation(Event.Location, Event.ActorRotation, false, nullptr, ETeleportType::TeleportPhysics);
+		if (AController* Controller = Pawn->GetController())
+		{
+			Controller->SetControlRotation(Event.ControlRotation);
+		}
+		DispatchInputEvent(Event.Type, Event.Value);
+	}
+
+	while (NextReplaySample < Recording.Samples.Num() && Recording.Samples[NextReplaySample].Step <= InputStep)
+	{
+		const FVFInputRecording::FSample& Sample = Recording.Samples[NextReplaySample++];
+		Pawn->SetActorLocationAndRotation(FVector(Sample.Location), FRotator(Sample.ActorRotation), false, nullptr, ETeleportType::TeleportPhysics);
+		if (AController* Controller = Pawn->GetController())
+		{
+			Controller->SetControlRotation(FRotator(Sample.ControlRotation));
+		}
+	}
+
+	InputStep++;
+	if (InputStep < Recording.NumSteps) return;
+
+	FVFMemoryReport Report;
+	CollectMemoryReport(Report);
+	UE_LOG(LogViewfinder, Display, TEXT("Input replay finished, %d loops remaining, viewfinder %.1f MB, process %.1f MB."),
+		ReplayLoopsRemaining, Report.GetTotalBytes() / 1048576.0, FPlatformMemory::GetStats().UsedPhysical / 1048576.0);
+	if (ReplayLoopsRemaining-- > 0)
+	{
+		InputStep = 0;
+		NextReplaySample = 0;
+		NextReplayEvent = 0;
+		return;
+	}
+
+	bIsReplayingInput = false;
+	GetWorld()->GetTimerManager().ClearTimer(InputTimerHandle);
+	Report.Log();
+	if (FParse::Param(FCommandLine::Get(), TEXT("VFReplayExit")))
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void UVFComponent::DispatchInputEvent(EVFInputEvent Event, float Value)
+{
+	switch (Event)
+	{
+	case EVFInputEvent::ToggleCameraOrPhoto: ToggleCameraOrPhoto(); break;
+	case EVFInputEvent::TakeOrPlacePhoto: TakeOrPlacePhoto(); break;
+	case EVFInputEvent::Aim: Aim(); break;
+	case EVFInputEvent::AimEnd: AimEnd(); break;
+	case EVFInputEvent::SwitchPhoto: SwitchPhoto(); break;
+	case EVFInputEvent::RotatePhoto: RotatePhoto(FInputActionValue(Value)); break;
+	case EVFInputEvent::Backtrack: StartRewind(); break;
+	}
+}
+
+static FAutoConsoleCommandWithWorld MemoryCommand(
+	TEXT("vf.Memory"),
+	TEXT("Prints the memory held by photos, rewind history, cached placements and cut geometry, attributed to each photo and placement."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		for (TObjectIterator<UVFComponent> It; It; ++It)
+		{
+			if (It->GetWorld() != World) continue;
+
+			FVFMemoryReport Report;
+			It->CollectMemoryReport(Report);
+			Report.Log();
+		}
+	}));
@@ -0,0 +1,771 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFCutGeometrySubsystem.h"
+#include "VFMemory.h"
+#include "VFMeshPatch.h"
+#include "VFPoolSubsystem.h"
+#include "VFSaveSubsystem.h"
+#include "VFScratchMeshPool.h"
+#include "Async/Async.h"
+#include "CompGeom/ConvexHull3.h"
+#include "Components/DynamicMeshComponent.h"
+#include "DynamicMeshEditor.h"
+#include "Engine/StaticMesh.h"
+#include "EngineUtils.h"
+#include "GeometryScript/MeshAssetFunctions.h"
+#include "MeshDescription.h"
+#include "MeshSimplification.h"
+#include "Selections/MeshConnectedComponents.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "StaticMeshAttributes.h"
+#include "StaticMeshResources.h"
+#include "TimerManager.h"
+#include "UDynamicMesh.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+using namespace UE::Geometry;
+
+//在工作线程中进行的烘焙，输入为游戏线程中复制的网格体。
+struct FVFBakeTask
+{
+	TWeakObjectPtr<UDynamicMeshComponent> Component;
+	TWeakObjectPtr<UDynamicMesh> SourceMesh;
+	int32 SourceTriangleCount = 0;
+	int32 NumMaterials = 0;
+	bool bSimulatePhysics = false;
+	double StartTime = 0.0;
+
+	FDynamicMesh3 Mesh;
+	int32 NumLODs = 1;
+	float LODReductionFactor = 0.5f;
+	float ConvexCollisionTolerance = 0.1f;
+
+	//工作线程的输出，在Future完成前不能读取。没有凸包时使用复杂碰撞
+	TArray<FMeshDescription> LODMeshDescriptions;
+	TArray<TArray<FVector>> CollisionHulls;
+	TFuture<void> Future;
+};
+
+namespace
+{
+	FName GetMaterialSlotName(int32 MaterialIndex)
+	{
+		return FName(TEXT("Material"), MaterialIndex + 1);
+	}
+
+	/**
+	 * 将动态网格体转换为静态网格体的网格体描述，多边形组与材质一一对应。
+	 * 顶点实例按照顶点、法线与UV共享，避免每个三角面角都成为一个渲染顶点。
+	 */
+	void ConvertToMeshDescription(const FDynamicMesh3& Mesh, int32 NumMaterials, FMeshDescription& OutMeshDescription)
+	{
+		FStaticMeshAttributes Attributes(OutMeshDescription);
+		Attributes.Register();
+		TVertexAttributesRef<FVector3f> Positions = Attributes.GetVertexPositions();
+		TVertexInstanceAttributesRef<FVector3f> Normals = Attributes.GetVertexInstanceNormals();
+		TVertexInstanceAttributesRef<FVector2f> UVs = Attributes.GetVertexInstanceUVs();
+		TPolygonGroupAttributesRef<FName> MaterialSlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+
+		TArray<FVertexID> VertexIDs;
+		VertexIDs.Init(INDEX_NONE, Mesh.MaxVertexID());
+		OutMeshDescription.ReserveNewVertices(Mesh.VertexCount());
+		for (int32 VertexID : Mesh.VertexIndicesItr())
+		{
+			const FVertexID NewVertexID = OutMeshDescription.CreateVertex();
+			Positions[NewVertexID] = FVector3f(Mesh.GetVertex(VertexID));
+			VertexIDs[VertexID] = NewVertexID;
+		}
+
+		TArray<FPolygonGroupID> PolygonGroupIDs;
+		for (int32 MaterialIndex = 0; MaterialIndex < FMath::Max(NumMaterials, 1); MaterialIndex++)
+		{
+			const FPolygonGroupID PolygonGroupID = OutMeshDescription.CreatePolygonGroup();
+			MaterialSlotNames[PolygonGroupID] = GetMaterialSlotName(MaterialIndex);
+			PolygonGroupIDs.Emplace(PolygonGroupID);
+		}
+
+		const FDynamicMeshNormalOverlay* NormalOverlay = Mesh.HasAttributes() ? Mesh.Attributes()->PrimaryNormals() : nullptr;
+		const FDynamicMeshUVOverlay* UVOverlay = Mesh.HasAttributes() ? Mesh.Attributes()->PrimaryUV() : nullptr;
+		const FDynamicMeshMaterialAttribute* MaterialIDs = Mesh.HasAttributes() ? Mesh.Attributes()->GetMaterialID() : nullptr;
+
+		//顶点、法线元素与UV元素相同的三角面角共享一个顶点实例，没有法线时每个三角面使用自己的面法线
+		TMap<FIndex3i, FVertexInstanceID> VertexInstanceIDs;
+		OutMeshDescription.ReserveNewTriangles(Mesh.TriangleCount());
+		for (int32 TriangleID : Mesh.TriangleIndicesItr())
+		{
+			const FIndex3i Triangle = Mesh.GetTriangle(TriangleID);
+			const bool bHasNormals = NormalOverlay && NormalOverlay->IsSetTriangle(TriangleID);
+			const bool bHasUVs = UVOverlay && UVOverlay->IsSetTriangle(TriangleID);
+			const FIndex3i NormalTriangle = bHasNormals ? NormalOverlay->GetTriangle(TriangleID) : FIndex3i::Invalid();
+			const FIndex3i UVTriangle = bHasUVs ? UVOverlay->GetTriangle(TriangleID) : FIndex3i::Invalid();
+
+			FVertexInstanceID TriangleInstanceIDs[3];
+			for (int32 i = 0; i < 3; i++)
+			{
+				const FIndex3i Key(Triangle[i], bHasNormals ? NormalTriangle[i] : -1 - TriangleID, bHasUVs ? UVTriangle[i] : -1);
+				if (const FVertexInstanceID* ExistingInstanceID = VertexInstanceIDs.Find(Key))
+				{
+					TriangleInstanceIDs[i] = *ExistingInstanceID;
+					continue;
+				}
+
+				const FVertexInstanceID InstanceID = OutMeshDescription.CreateVertexInstance(VertexIDs[Triangle[i]]);
+				Normals[InstanceID] = bHasNormals ? NormalOverlay->GetElement(NormalTriangle[i]) : FVector3f(Mesh.GetTriNormal(TriangleID));
+				UVs.Set(InstanceID, 0, bHasUVs ? UVOverlay->GetElement(UVTriangle[i]) : FVector2f::ZeroVector);
+				VertexInstanceIDs.Emplace(Key, InstanceID);
+				TriangleInstanceIDs[i] = InstanceID;
+			}
+
+			const int32 MaterialIndex = MaterialIDs ? FMath::Clamp(MaterialIDs->GetValue(TriangleID), 0, PolygonGroupIDs.Num() - 1) : 0;
+			OutMeshDescription.CreateTriangle(PolygonGroupIDs[MaterialIndex], MakeArrayView(TriangleInstanceIDs));
+		}
+	}
+
+	double GetTriangleVolume(const FVector3d& A, const FVector3d& B, const FVector3d& C)
+	{
+		return A.Dot(B.Cross(C)) / 6.0;
+	}
+
+	/**
+	 * 每个连通部分以其顶点的凸包作为简单碰撞。
+	 * 凸包比网格体大出Tolerance倍以上时凹陷处会被凸包挡住，此时返回false，整个网格体沿用复杂碰撞。
+	 */
+	bool BuildConvexCollision(const FDynamicMesh3& Mesh, float Tolerance, TArray<TArray<FVector>>& OutHulls)
+	{
+		FMeshConnectedComponents Components(&Mesh);
+		Components.FindConnectedTriangles();
+		for (int32 ComponentIndex = 0; ComponentIndex < Components.Num(); ComponentIndex++)
+		{
+			TArray<FVector> Points;
+			TMap<int32, int32> PointIndices;
+			double MeshVolume = 0.0;
+			for (int32 TriangleID : Components[ComponentIndex].Indices)
+			{
+				const FIndex3i Triangle = Mesh.GetTriangle(TriangleID);
+				MeshVolume += GetTriangleVolume(Mesh.GetVertex(Triangle.A), Mesh.GetVertex(Triangle.B), Mesh.GetVertex(Triangle.C));
+				for (int32 i = 0; i < 3; i++)
+				{
+					if (!PointIndices.Contains(Triangle[i]))
+					{
+						PointIndices.Emplace(Triangle[i], Points.Emplace(Mesh.GetVertex(Triangle[i])));
+					}
+				}
+			}
+
+			//共面的部分没有凸包
+			FConvexHull3d Hull;
+			if (!Hull.Solve(TArrayView<const FVector3d>(Points))) return false;
+			double HullVolume = 0.0;
+			for (const FIndex3i& Triangle : Hull.GetTriangles())
+			{
+				HullVolume += GetTriangleVolume(Points[Triangle.A], Points[Triangle.B], Points[Triangle.C]);
+			}
+			if (FMath::Abs(HullVolume) - FMath::Abs(MeshVolume) > FMath::Abs(HullVolume) * Tolerance) return false;
+
+			OutHulls.Emplace(MoveTemp(Points));
+		}
+		return OutHulls.Num() > 0;
+	}
+
+	int32 CountTriangles(const UStaticMesh* StaticMesh)
+	{
+		const FStaticMeshRenderData* RenderData = StaticMesh ? StaticMesh->GetRenderData() : nullptr;
+		return RenderData && RenderData->LODResources.Num() ? RenderData->LODResources[0].GetNumTriangles() : 0;
+	}
+}
+
+void UVFCutGeometrySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (bEnableBake || bEnableMerge)
+	{
+		InWorld.GetTimerManager().SetTimer(BakeTimerHandle, FTimerDelegate::CreateUObject(this, &UVFCutGeometrySubsystem::TickCutGeometry), BakeTimeStep, true);
+	}
+}
+
+void UVFCutGeometrySubsystem::Deinitialize()
+{
+	//工作线程只使用自己的数据，等待其结束后丢弃结果
+	if (CurrentBake)
+	{
+		CurrentBake->Future.Wait();
+		CurrentBake.Reset();
+	}
+	PendingBakes.Empty();
+	PendingMerges.Empty();
+	MeshPatches.Empty();
+	ContentStamps.Empty();
+	PatchSourceMeshes.Empty();
+
+	Super::Deinitialize();
+}
+
+void UVFCutGeometrySubsystem::RequestBake(const TArray<UPrimitiveComponent*>& Components, float Delay)
+{
+	if (!bEnableBake) return;
+
+	const double ReadyTime = GetWorld()->GetTimeSeconds() + Delay;
+	for (UPrimitiveComponent* Component : Components)
+	{
+		UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component);
+		if (!IsValid(DynamicMeshComponent)) continue;
+
+		//已经在队列中的组件只会提前烘焙时间
+		FBakeRequest* ExistingRequest = PendingBakes.FindByPredicate([DynamicMeshComponent](const FBakeRequest& Request) { return Request.Component == DynamicMeshComponent; });
+		if (ExistingRequest)
+		{
+			ExistingRequest->ReadyTime = FMath::Min(ExistingRequest->ReadyTime, ReadyTime);
+			continue;
+		}
+		PendingBakes.Add({DynamicMeshComponent, ReadyTime});
+	}
+}
+
+void UVFCutGeometrySubsystem::RequestMerge(const TArray<UPrimitiveComponent*>& Components)
+{
+	if (!bEnableMerge) return;
+
+	for (UPrimitiveComponent* Component : Components)
+	{
+		if (IsValid(Component))
+		{
+			PendingMerges.AddUnique(Component);
+		}
+	}
+}
+
+void UVFCutGeometrySubsystem::TickCutGeometry()
+{
+	//先合并再烘焙，合并的结果会作为一个组件被烘焙
+	MergePendingComponents();
+	if (!bEnableBake) return;
+
+	if (CurrentBake)
+	{
+		if (!CurrentBake->Future.IsReady()) return;
+
+		TSharedPtr<FVFBakeTask> Task = MoveTemp(CurrentBake);
+		FinishBake(*Task);
+	}
+	StartNextBake();
+}
+
+void UVFCutGeometrySubsystem::StartNextBake()
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	for (int32 i = 0; i < PendingBakes.Num(); i++)
+	{
+		if (PendingBakes[i].ReadyTime > Now) continue;
+
+		UDynamicMeshComponent* Component = PendingBakes[i].Component.Get();
+		PendingBakes.RemoveAt(i--);
+
+		//已经被之后的放置隐藏的组件会被压缩，不需要烘焙
+		if (!IsValid(Component) || Component->IsBeingDestroyed() || !Component->IsVisible()) continue;
+
+		//仍在运动的物理组件还没有稳定，稍后再烘焙
+		if (Component->IsSimulatingPhysics() && Component->RigidBodyIsAwake())
+		{
+			PendingBakes.Add({Component, Now + BakeIdleTimeout});
+			continue;
+		}
+
+		TSharedPtr<FVFBakeTask> Task = MakeShared<FVFBakeTask>();
+		Task->Component = Component;
+		Task->SourceMesh = Component->GetDynamicMesh();
+		Task->SourceTriangleCount = Component->GetDynamicMesh()->GetTriangleCount();
+		Task->NumMaterials = Component->GetNumMaterials();
+		Task->bSimulatePhysics = Component->IsSimulatingPhysics();
+		Task->StartTime = FPlatformTime::Seconds();
+		Task->Mesh = Component->GetDynamicMesh()->GetMeshRef();
+		Task->NumLODs = FMath::Clamp(NumBakeLODs, 1, MAX_STATIC_MESH_LODS);
+		Task->LODReductionFactor = LODReductionFactor;
+		Task->ConvexCollisionTolerance = ConvexCollisionTolerance;
+
+		Task->Future = Async(EAsyncExecution::ThreadPool, [Task]()
+		{
+			Task->LODMeshDescriptions.SetNum(Task->NumLODs);
+			FDynamicMesh3 LODMesh = Task->Mesh;
+			for (int32 LODIndex = 0; LODIndex < Task->NumLODs; LODIndex++)
+			{
+				if (LODIndex > 0)
+				{
+					FQEMSimplification Simplifier(&LODMesh);
+					Simplifier.SimplifyToTriangleCount(FMath::Max(4, FMath::RoundToInt(LODMesh.TriangleCount() * Task->LODReductionFactor)));
+				}
+				ConvertToMeshDescription(LODMesh, Task->NumMaterials, Task->LODMeshDescriptions[LODIndex]);
+			}
+
+			//模拟物理的组件使用一个凸包作为简单碰撞，凸包由物理烘焙时生成，使用最低一级LOD的顶点即可
+			if (Task->bSimulatePhysics)
+			{
+				TArray<FVector>& CollisionPoints = Task->CollisionHulls.AddDefaulted_GetRef();
+				for (int32 VertexID : LODMesh.VertexIndicesItr())
+				{
+					CollisionPoints.Emplace(LODMesh.GetVertex(VertexID));
+				}
+			}
+			else
+			{
+				if (!BuildConvexCollision(Task->Mesh, Task->ConvexCollisionTolerance, Task->CollisionHulls))
+				{
+					Task->CollisionHulls.Reset();
+				}
+			}
+		});
+		CurrentBake = Task;
+		return;
+	}
+}
+
+UStaticMesh* UVFCutGeometrySubsystem::BuildStaticMesh(FVFBakeTask& Task)
+{
+	UDynamicMeshComponent* Component = Task.Component.Get();
+	UStaticMesh* StaticMesh = NewObject<UStaticMesh>(this, NAME_None, RF_Transient);
+	for (int32 MaterialIndex = 0; MaterialIndex < FMath::Max(Task.NumMaterials, 1); MaterialIndex++)
+	{
+		StaticMesh->GetStaticMaterials().Emplace(Component->GetMaterial(MaterialIndex), GetMaterialSlotName(MaterialIndex));
+	}
+
+	TArray<const FMeshDescription*> MeshDescriptions;
+	for (const FMeshDescription& MeshDescription : Task.LODMeshDescriptions)
+	{
+		MeshDescriptions.Emplace(&MeshDescription);
+	}
+
+	//之后的放置需要在运行时读取静态网格体的顶点，复杂碰撞也需要CPU访问
+	UStaticMesh::FBuildMeshDescriptionsParams Params;
+	Params.bFastBuild = true;
+	Params.bAllowCpuAccess = true;
+	Params.bBuildSimpleCollision = false;
+	StaticMesh->BuildFromMeshDescriptions(MeshDescriptions, Params);
+
+	FStaticMeshRenderData* RenderData = StaticMesh->GetRenderData();
+	if (RenderData)
+	{
+		float ScreenSize = 1.f;
+		for (int32 LODIndex = 0; LODIndex < RenderData->LODResources.Num(); LODIndex++)
+		{
+			RenderData->ScreenSize[LODIndex].Default = ScreenSize;
+			ScreenSize *= LODReductionFactor;
+		}
+	}
+
+	//凸包同时用于查询与物理，只有凹陷过多的静止几何体沿用动态网格体的复杂碰撞
+	StaticMesh->CreateBodySetup();
+	UBodySetup* BodySetup = StaticMesh->GetBodySetup();
+	if (Task.CollisionHulls.Num())
+	{
+		for (TArray<FVector>& CollisionHull : Task.CollisionHulls)
+		{
+			FKConvexElem ConvexElem;
+			ConvexElem.VertexData = MoveTemp(CollisionHull);
+			ConvexElem.UpdateElemBox();
+			BodySetup->AggGeom.ConvexElems.Emplace(ConvexElem);
+		}
+		BodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+	}
+	else
+	{
+		BodySetup->CollisionTraceFlag = CTF_UseComplexAsSimple;
+	}
+	BodySetup->CreatePhysicsMeshes();
+
+	return StaticMesh;
+}
+
+UStaticMesh* UVFCutGeometrySubsystem::CreateTransientStaticMesh(UObject* Outer, const FDynamicMesh3& Mesh, UMaterialInterface* Material, bool bConvexCollision)
+{
+	UStaticMesh* StaticMesh = NewObject<UStaticMesh>(Outer, NAME_None, RF_Transient);
+	StaticMesh->GetStaticMaterials().Emplace(Material, GetMaterialSlotName(0));
+
+	FMeshDescription MeshDescription;
+	ConvertToMeshDescription(Mesh, 1, MeshDescription);
+	UStaticMesh::FBuildMeshDescriptionsParams Params;
+	Params.bFastBuild = true;
+	Params.bAllowCpuAccess = true;
+	Params.bBuildSimpleCollision = false;
+	StaticMesh->BuildFromMeshDescriptions({&MeshDescription}, Params);
+
+	StaticMesh->CreateBodySetup();
+	UBodySetup* BodySetup = StaticMesh->GetBodySetup();
+	if (bConvexCollision)
+	{
+		FKConvexElem ConvexElem;
+		for (int32 VertexID : Mesh.VertexIndicesItr())
+		{
+			ConvexElem.VertexData.Emplace(Mesh.GetVertex(VertexID));
+		}
+		ConvexElem.UpdateElemBox();
+		BodySetup->AggGeom.ConvexElems.Emplace(ConvexElem);
+		BodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+	}
+	else
+	{
+		BodySetup->CollisionTraceFlag = CTF_UseComplexAsSimple;
+	}
+	BodySetup->CreatePhysicsMeshes();
+
+	return StaticMesh;
+}
+
+UStaticMesh* UVFCutGeometrySubsystem::GetPatchSource(const UPrimitiveComponent* Component) const
+{
+	if (!Component) return nullptr;
+	if (Component->ComponentHasTag(FName("VFGenerated")))
+	{
+		const TSharedPtr<const FVFMeshPatch> Patch = GetMeshPatch(Component);
+		return Patch ? Patch->SourceMesh.Get() : nullptr;
+	}
+	const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component);
+	return StaticMeshComponent ? StaticMeshComponent->GetStaticMesh() : nullptr;
+}
+
+bool UVFCutGeometrySubsystem::CopyPatchSourceMesh(UStaticMesh* SourceMesh, UDynamicMesh* OutMesh)
+{
+	TEnumAsByte<EGeometryScriptOutcomePins> Pins;
+	UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
+		SourceMesh,
+		OutMesh,
+		FGeometryScriptCopyMeshFromAssetOptions(),
+		FGeometryScriptMeshReadLOD(),
+		Pins);
+	return Pins == EGeometryScriptOutcomePins::Success;
+}
+
+TSharedPtr<const FVFMeshPatch> UVFCutGeometrySubsystem::GetMeshPatch(const UPrimitiveComponent* Component) const
+{
+	return MeshPatches.FindRef(Component);
+}
+
+void UVFCutGeometrySubsystem::SetMeshPatch(UPrimitiveComponent* Component, TSharedPtr<const FVFMeshPatch> Patch)
+{
+	if (!Component) return;
+	if (!Patch)
+	{
+		MeshPatches.Remove(Component);
+		return;
+	}
+
+	if (UStaticMesh* SourceMesh = Patch->SourceMesh.Get())
+	{
+		PatchSourceMeshes.Emplace(SourceMesh);
+	}
+	MeshPatches.Emplace(Component, MoveTemp(Patch));
+}
+
+bool UVFCutGeometrySubsystem::MaterializeMeshPatch(const FVFMeshPatch& Patch, FDynamicMesh3& OutMesh)
+{
+	UStaticMesh* SourceMesh = Patch.SourceMesh.Get();
+	if (!SourceMesh) return false;
+
+	FVFScopedScratchMesh SourceCopyScope(GetScratchMeshPool());
+	return CopyPatchSourceMesh(SourceMesh, SourceCopyScope.Get()) && Patch.Apply(SourceCopyScope.Get()->GetMeshRef(), OutMesh);
+}
+
+void UVFCutGeometrySubsystem::ReleasePatchedMesh(UPrimitiveComponent* Component)
+{
+	UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component);
+	if (!DynamicMeshComponent || !MeshPatches.Contains(DynamicMeshComponent)) return;
+
+	UDynamicMesh* DynamicMesh = DynamicMeshComponent->GetDynamicMesh();
+	if (DynamicMesh->GetTriangleCount() == 0) return;
+
+	NumReleasedMeshes++;
+	ReleasedMeshBytes += FVFMemory::GetDynamicMeshBytes(DynamicMesh->GetMeshRef());
+	DynamicMesh->Reset();
+}
+
+void UVFCutGeometrySubsystem::RestorePatchedMesh(UPrimitiveComponent* Component)
+{
+	//切割结果一定有三角面，有补丁却没有三角面的网格体就是被释放的网格体
+	UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component);
+	if (!DynamicMeshComponent || DynamicMeshComponent->GetDynamicMesh()->GetTriangleCount() > 0) return;
+	const TSharedPtr<const FVFMeshPatch> Patch = GetMeshPatch(DynamicMeshComponent);
+	if (!Patch) return;
+
+	FDynamicMesh3 Mesh;
+	if (!MaterializeMeshPatch(*Patch, Mesh))
+	{
+		UE_LOG(LogViewfinder, Warning, TEXT("Cannot restore the mesh of %s: its source %s has changed or is unavailable."),
+			*DynamicMeshComponent->GetName(), *GetNameSafe(Patch->SourceMesh.Get()));
+		return;
+	}
+
+	NumMaterializedMeshes++;
+	DynamicMeshComponent->GetDynamicMesh()->SetMesh(MoveTemp(Mesh));
+	DynamicMeshComponent->UpdateCollision(false);
+}
+
+uint64 UVFCutGeometrySubsystem::GetContentStamp(const UPrimitiveComponent* Component) const
+{
+	return ContentStamps.FindRef(Component);
+}
+
+void UVFCutGeometrySubsystem::TouchContent(UPrimitiveComponent* Component)
+{
+	if (!Component) return;
+	ContentStamps.Emplace(Component, ++LastContentStamp);
+}
+
+UVFScratchMeshPool* UVFCutGeometrySubsystem::GetScratchMeshPool()
+{
+	if (!ScratchMeshPool)
+	{
+		ScratchMeshPool = NewObject<UVFScratchMeshPool>(this);
+	}
+	return ScratchMeshPool;
+}
+
+void UVFCutGeometrySubsystem::FinishBake(FVFBakeTask& Task)
+{
+	UDynamicMeshComponent* Component = Task.Component.Get();
+
+	//转换期间组件被隐藏、回收或网格体被替换，结果已经失效
+	const bool bIsValid = IsValid(Component) && !Component->IsBeingDestroyed() && Component->IsVisible()
+		&& Component->GetDynamicMesh() == Task.SourceMesh.Get() && Component->GetDynamicMesh()->GetTriangleCount() == Task.SourceTriangleCount;
+	if (!bIsValid)
+	{
+		NumDiscarded++;
+		return;
+	}
+
+	UStaticMesh* StaticMesh = BuildStaticMesh(Task);
+	UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>();
+	UStaticMeshComponent* BakedComponent = PoolSubsystem->AcquireComponent<UStaticMeshComponent>(Component->GetOwner());
+	if (!BakedComponent)
+	{
+		NumDiscarded++;
+		return;
+	}
+
+	BakedComponent->SetWorldTransform(Component->GetComponentTransform());
+	BakedComponent->SetStaticMesh(StaticMesh);
+	for (int32 MaterialIndex = 0; MaterialIndex < Task.NumMaterials; MaterialIndex++)
+	{
+		BakedComponent->SetMaterial(MaterialIndex, Component->GetMaterial(MaterialIndex));
+	}
+	BakedComponent->ComponentTags = Component->ComponentTags;
+	BakedComponent->AttachToComponent(Component->GetAttachParent(), FAttachmentTransformRules::KeepWorldTransform);
+	for (USceneComponent* Child : TArray<USceneComponent*>(Component->GetAttachChildren()))
+	{
+		Child->AttachToComponent(BakedComponent, FAttachmentTransformRules::KeepWorldTransform);
+	}
+	BakedComponent->SetCollisionResponseToChannels(Component->GetCollisionResponseToChannels());
+	BakedComponent->SetCollisionEnabled(Component->GetCollisionEnabled());
+	BakedComponent->SetGenerateOverlapEvents(Component->GetGenerateOverlapEvents());
+	BakedComponent->SetSimulatePhysics(Task.bSimulatePhysics);
+
+	const int32 DynamicTriangles = Task.SourceTriangleCount;
+	for (TWeakObjectPtr<UPrimitiveComponent>& PendingMerge : PendingMerges)
+	{
+		if (PendingMerge == Component) PendingMerge = BakedComponent;
+	}
+	OnComponentReplaced.Broadcast(Component, BakedComponent);
+	FVFAutosaveScope(GetWorld()).Rename(Component, BakedComponent);
+	SetMeshPatch(BakedComponent, GetMeshPatch(Component));
+	SetMeshPatch(Component, nullptr);
+	//烘焙不改变几何体，新组件沿用原有的标记
+	ContentStamps.Emplace(BakedComponent, GetContentStamp(Component));
+	ContentStamps.Remove(Component);
+	PoolSubsystem->ReleaseComponent(Component);
+
+	NumBaked++;
+	const double BakeSeconds = FPlatformTime::Seconds() - Task.StartTime;
+	TotalBakeSeconds += BakeSeconds;
+	UE_LOG(LogViewfinder, Verbose, TEXT("Baked %s: %d triangles, %d LODs, %.1f ms."),
+		*BakedComponent->GetName(), DynamicTriangles, Task.LODMeshDescriptions.Num(), BakeSeconds * 1000.0);
+}
+
+void UVFCutGeometrySubsystem::MergePendingComponents()
+{
+	if (PendingMerges.Num() < 2) return;
+
+	//按所属Actor、材质与碰撞设置分组，被之后的放置隐藏或已被回收的组件不再合并
+	TMap<FString, TArray<UPrimitiveComponent*>> Groups;
+	for (const TWeakObjectPtr<UPrimitiveComponent>& PendingMerge : PendingMerges)
+	{
+		UPrimitiveComponent* Component = PendingMerge.Get();
+		if (!IsValid(Component) || Component->IsBeingDestroyed() || !Component->IsVisible()) continue;
+		if (!Component->ComponentHasTag(FName("VFGenerated")) || Component->IsSimulatingPhysics()) continue;
+		if (!Component->GetOwner() || !Component->GetOwner()->GetRootComponent()) continue;
+
+		FString GroupKey = FString::Printf(TEXT("%s|%d|%s"), *Component->GetOwner()->GetPathName(), (int32)Component->GetCollisionEnabled(), *Component->GetCollisionProfileName().ToString());
+		for (int32 MaterialIndex = 0; MaterialIndex < Component->GetNumMaterials(); MaterialIndex++)
+		{
+			GroupKey += TEXT("|") + GetPathNameSafe(Component->GetMaterial(MaterialIndex));
+		}
+		Groups.FindOrAdd(GroupKey).Emplace(Component);
+	}
+	PendingMerges.Empty();
+
+	for (TPair<FString, TArray<UPrimitiveComponent*>>& Group : Groups)
+	{
+		//单独的组件等待之后的组件一起合并
+		if (Group.Value.Num() < 2)
+		{
+			PendingMerges.Append(Group.Value);
+			continue;
+		}
+
+		if (UPrimitiveComponent* MergedComponent = MergeComponents(Group.Value))
+		{
+			RequestBake({MergedComponent}, 0.f);
+		}
+	}
+}
+
+UPrimitiveComponent* UVFCutGeometrySubsystem::MergeComponents(const TArray<UPrimitiveComponent*>& Components)
+{
+	UPrimitiveComponent* FirstComponent = Components[0];
+	USceneComponent* RootComponent = FirstComponent->GetOwner()->GetRootComponent();
+	const FTransform& RootTransform = RootComponent->GetComponentTransform();
+
+	FDynamicMesh3 MergedMesh;
+	MergedMesh.EnableAttributes();
+	MergedMesh.Attributes()->EnableMaterialID();
+	FDynamicMeshEditor Editor(&MergedMesh);
+	FVFScopedScratchMesh StaticMeshCopyScope(GetScratchMeshPool());
+	UDynamicMesh* StaticMeshCopy = StaticMeshCopyScope.Get();
+	int32 NumDrawsBefore = 0;
+
+	for (UPrimitiveComponent* Component : Components)
+	{
+		const FDynamicMesh3* ComponentMesh = nullptr;
+		if (UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+		{
+			ComponentMesh = &DynamicMeshComponent->GetDynamicMesh()->GetMeshRef();
+		}
+		else if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+		{
+			//已经被烘焙的组件，烘焙时保留了CPU访问
+			TEnumAsByte<EGeometryScriptOutcomePins> Pins;
+			UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
+				StaticMeshComponent->GetStaticMesh(),
+				StaticMeshCopy,
+				FGeometryScriptCopyMeshFromAssetOptions(),
+				FGeometryScriptMeshReadLOD(),
+				Pins);
+			ComponentMesh = &StaticMeshCopy->GetMeshRef();
+		}
+		if (!ComponentMesh) continue;
+
+		//所有组件的网格体变换到根组件的空间中，材质ID保持不变。法线按缩放的逆转置变换并重新归一化，非均匀缩放时方向才正确
+		const FTransformSRT3d RelativeTransform(Component->GetComponentTransform().GetRelativeTransform(RootTransform));
+		FMeshIndexMappings Mappings;
+		Editor.AppendMesh(ComponentMesh, Mappings,
+			[&RelativeTransform](int32, const FVector3d& Position) { return RelativeTransform.TransformPosition(Position); },
+			[&RelativeTransform](int32, const FVector3d& Normal) { return RelativeTransform.TransformNormal(Normal); });
+		NumDrawsBefore += Component->GetNumMaterials();
+	}
+
+	UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>();
+	UDynamicMeshComponent* MergedComponent = PoolSubsystem->AcquireComponent<UDynamicMeshComponent>(FirstComponent->GetOwner());
+	if (!MergedComponent) return nullptr;
+
+	//被合并的组件被回收，合并后的组件作为新的组件记录
+	FVFAutosaveScope AutosaveScope(GetWorld());
+	for (UPrimitiveComponent* Component : Components)
+	{
+		AutosaveScope.Touch(Component);
+	}
+
+	//合并后的网格体没有单一的来源，存储完整的网格体
+	SetMeshPatch(MergedComponent, nullptr);
+	MergedComponent->ComponentTags.Emplace(FName("VFGenerated"));
+	MergedComponent->SetWorldTransform(RootTransform);
+	MergedComponent->GetDynamicMesh()->SetMesh(MoveTemp(MergedMesh));
+	MergedComponent->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepWorldTransform);
+	MergedComponent->SetCollisionResponseToChannels(FirstComponent->GetCollisionResponseToChannels());
+	MergedComponent->SetCollisionEnabled(FirstComponent->GetCollisionEnabled());
+	MergedComponent->SetGenerateOverlapEvents(true);
+	MergedComponent->EnableComplexAsSimpleCollision();
+	for (int32 MaterialIndex = 0; MaterialIndex < FirstComponent->GetNumMaterials(); MaterialIndex++)
+	{
+		MergedComponent->SetMaterial(MaterialIndex, FirstComponent->GetMaterial(MaterialIndex));
+	}
+	MergedComponent->UpdateCollision(false);
+	TouchContent(MergedComponent);
+
+	for (UPrimitiveComponent* Component : Components)
+	{
+		SetMeshPatch(Component, nullptr);
+		ContentStamps.Remove(Component);
+		PoolSubsystem->ReleaseComponent(Component);
+	}
+	AutosaveScope.Touch(MergedComponent);
+
+	//合并后每种材质一次绘制
+	const int32 NumDrawsAfter = MergedComponent->GetNumMaterials();
+	NumMergedComponents += Components.Num();
+	NumMergeResults++;
+	NumDrawsBeforeMerge += NumDrawsBefore;
+	NumDrawsAfterMerge += NumDrawsAfter;
+	UE_LOG(LogViewfinder, Verbose, TEXT("Merged %d generated components of %s: %d primitives, %d draws -> 1 primitive, %d draws."),
+		Components.Num(), *FirstComponent->GetOwner()->GetName(), Components.Num(), NumDrawsBefore, NumDrawsAfter);
+
+	return MergedComponent;
+}
+
+void UVFCutGeometrySubsystem::LogStats() const
+{
+	//统计当前放置生成的几何体的渲染与碰撞开销
+	int32 NumDynamicComponents = 0;
+	int32 NumDynamicTriangles = 0;
+	int32 NumBakedComponents = 0;
+	int32 NumBakedTriangles = 0;
+	int32 NumComplexCollisionComponents = 0;
+	for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		TInlineComponentArray<UPrimitiveComponent*> Components(*It);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			if (!Component->ComponentHasTag(FName("VFGenerated")) || !Component->IsVisible()) continue;
+
+			if (const UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+			{
+				NumDynamicComponents++;
+				NumDynamicTriangles += DynamicMeshComponent->GetDynamicMesh()->GetTriangleCount();
+				NumComplexCollisionComponents++;
+			}
+			else if (const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+			{
+				NumBakedComponents++;
+				NumBakedTriangles += CountTriangles(StaticMeshComponent->GetStaticMesh());
+				const UBodySetup* BodySetup = StaticMeshComponent->GetBodySetup();
+				if (BodySetup && BodySetup->CollisionTraceFlag == CTF_UseComplexAsSimple)
+				{
+					NumComplexCollisionComponents++;
+				}
+			}
+		}
+	}
+
+	UE_LOG(LogViewfinder, Log, TEXT("Viewfinder cut geometry: %d dynamic mesh components (%d triangles, dynamic mesh proxies), %d baked static mesh components (%d LOD0 triangles, static draw lists), %d with complex collision."),
+		NumDynamicComponents, NumDynamicTriangles, NumBakedComponents, NumBakedTriangles, NumComplexCollisionComponents);
+	UE_LOG(LogViewfinder, Log, TEXT("Viewfinder bake: %d baked, %d discarded, %d pending, %.1f ms average."),
+		NumBaked, NumDiscarded, PendingBakes.Num() + (CurrentBake ? 1 : 0), NumBaked ? TotalBakeSeconds * 1000.0 / NumBaked : 0.0);
+	UE_LOG(LogViewfinder, Log, TEXT("Viewfinder merge: %d primitives and %d draws merged into %d primitives and %d draws, %d pending."),
+		NumMergedComponents, NumDrawsBeforeMerge, NumMergeResults, NumDrawsAfterMerge, PendingMerges.Num());
+
+	//补丁的大小与切割的范围有关，释放的网格体是被隐藏的生成组件原本持有的完整网格体
+	SIZE_T PatchBytes = 0;
+	for (const TPair<TObjectKey<UPrimitiveComponent>, TSharedPtr<const FVFMeshPatch>>& MeshPatch : MeshPatches)
+	{
+		PatchBytes += MeshPatch.Value->GetAllocatedSize();
+	}
+	UE_LOG(LogViewfinder, Log, TEXT("Viewfinder mesh patches: %d patches from %d source meshes (%.1f KB), %d hidden meshes released (%.1f KB), %d restored."),
+		MeshPatches.Num(), PatchSourceMeshes.Num(), PatchBytes / 1024.f, NumReleasedMeshes, ReleasedMeshBytes / 1024.f, NumMaterializedMeshes);
+}
+
+static FAutoConsoleCommandWithWorld CutGeometryStatsCommand(
+	TEXT("vf.CutGeometry.Stats"),
+	TEXT("Prints the render and collision cost of generated cut geometry before and after baking and merging, and the size of its mesh patches."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UVFCutGeometrySubsystem* CutGeometrySubsystem = World ? World->GetSubsystem<UVFCutGeometrySubsystem>() : nullptr)
+		{
+			CutGeometrySubsystem->LogStats();
+		}
+	}));
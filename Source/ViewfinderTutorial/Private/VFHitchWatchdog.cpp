@@ -0,0 +1,195 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFHitchWatchdog.h"
+#include "VFPlacementBundle.h"
+#include "Dom/JsonObject.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/TraceAuxiliary.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "Serialization/JsonSerializer.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+static TAutoConsoleVariable<bool> CVarHitchWatchdogEnable(
+	TEXT("vf.HitchWatchdog.Enable"),
+	false,
+	TEXT("Writes a report and a trace snapshot to Saved/Viewfinder/Hitches when a take, place or rewind operation exceeds vf.HitchWatchdog.ThresholdMs."));
+
+static TAutoConsoleVariable<bool> CVarHitchWatchdogCaptureBundle(
+	TEXT("vf.HitchWatchdog.CaptureBundle"),
+	false,
+	TEXT("Also writes a placement bundle with each place hitch report. Copying the meshes makes every placement slower while enabled."));
+
+static TAutoConsoleVariable<float> CVarHitchWatchdogThresholdMs(
+	TEXT("vf.HitchWatchdog.ThresholdMs"),
+	33.f,
+	TEXT("Duration in milliseconds above which a viewfinder operation is reported as a hitch."));
+
+namespace
+{
+	//时间只精确到秒，同一秒内的多次操作以帧号与序号区分
+	int32 NumHitchWatchdogFiles = 0;
+}
+
+FVFHitchWatchdog::FVFHitchWatchdog(const TCHAR* InOperationName)
+	: OperationName(InOperationName)
+{
+	bIsActive = IsEnabled();
+	if (!bIsActive) return;
+
+	PrevActiveStats = FVFOperationStats::GetActive();
+	if (!PrevActiveStats)
+	{
+		FVFOperationStats::SetActive(&Stats);
+	}
+	StartTime = FPlatformTime::Seconds();
+}
+
+FVFHitchWatchdog::~FVFHitchWatchdog()
+{
+	if (Bundle)
+	{
+		FVFPlacementBundle::SetActive(nullptr);
+	}
+
+	double Milliseconds = 0.0;
+	double ThresholdMilliseconds = 0.0;
+	bool bIsHitch = false;
+	if (bIsActive)
+	{
+		Milliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+		if (!PrevActiveStats)
+		{
+			FVFOperationStats::SetActive(nullptr);
+		}
+		ThresholdMilliseconds = CVarHitchWatchdogThresholdMs.GetValueOnGameThread();
+		bIsHitch = Milliseconds > ThresholdMilliseconds;
+	}
+
+	//放置包只在这里写入一次，被请求导出或随报告写入，与报告使用相同的名称
+	const bool bWriteBundle = Bundle && (bExportBundle || bIsHitch);
+	if (!bIsHitch && !bWriteBundle) return;
+
+	const FString Name = FString::Printf(TEXT("%s-%s-F%llu-%d"), OperationName, *FDateTime::Now().ToString(), (uint64)GFrameCounter, ++NumHitchWatchdogFiles);
+	FString BundlePath;
+	if (bWriteBundle)
+	{
+		BundlePath = FPaths::ProjectSavedDir() / TEXT("Viewfinder/Bundles") / Name + TEXT(".vfbundle");
+		if (!WriteBundle(BundlePath))
+		{
+			BundlePath.Reset();
+		}
+	}
+	if (bIsHitch)
+	{
+		WriteReport(FPaths::ProjectSavedDir() / TEXT("Viewfinder/Hitches") / Name, BundlePath, Milliseconds, ThresholdMilliseconds);
+	}
+}
+
+void FVFHitchWatchdog::CapturePlacementBundle()
+{
+	bExportBundle = FVFPlacementBundle::ConsumeExportRequest();
+	if (!bExportBundle && !(bIsActive && CVarHitchWatchdogCaptureBundle.GetValueOnGameThread())) return;
+	//已经有其他放置包在记录时不替换它
+	if (FVFPlacementBundle::GetActive()) return;
+
+	Bundle = MakeUnique<FVFPlacementBundle>();
+	FVFPlacementBundle::SetActive(Bundle.Get());
+}
+
+void FVFHitchWatchdog::SetPhoto(uint64 InPhotoId, const FVFAPhotoTakeParams& InPhotoTakeParams, float InRotatedAngle)
+{
+	bHasPhoto = true;
+	PhotoId = InPhotoId;
+	PhotoTakeParams = InPhotoTakeParams;
+	RotatedAngle = InRotatedAngle;
+}
+
+bool FVFHitchWatchdog::IsEnabled()
+{
+	return CVarHitchWatchdogEnable.GetValueOnGameThread();
+}
+
+void FVFHitchWatchdog::WriteReport(const FString& BaseName, const FString& BundlePath, double Milliseconds, double ThresholdMilliseconds) const
+{
+	//追踪快照包含追踪缓冲区中最近的事件，5.2之前的引擎不支持，只写入报告
+	FString SnapshotPath;
+#if ENGINE_MAJOR_VERSION > 5 || (ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 2)
+	if (FTraceAuxiliary::WriteSnapshot(*(BaseName + TEXT(".utrace"))))
+	{
+		SnapshotPath = BaseName + TEXT(".utrace");
+	}
+#endif
+
+	TSharedRef<FJsonObject> JsonRoot = MakeShared<FJsonObject>();
+	JsonRoot->SetStringField(TEXT("Operation"), OperationName);
+	JsonRoot->SetNumberField(TEXT("Milliseconds"), Milliseconds);
+	JsonRoot->SetNumberField(TEXT("ThresholdMilliseconds"), ThresholdMilliseconds);
+	JsonRoot->SetNumberField(TEXT("Frame"), GFrameCounter);
+	JsonRoot->SetStringField(TEXT("TraceSnapshot"), SnapshotPath);
+	if (!BundlePath.IsEmpty())
+	{
+		JsonRoot->SetStringField(TEXT("PlacementBundle"), BundlePath);
+	}
+
+	TArray<TSharedPtr<FJsonValue>> JsonStages;
+	for (const FVFOperationStats::FStage& Stage : Stats.Stages)
+	{
+		TSharedRef<FJsonObject> JsonStage = MakeShared<FJsonObject>();
+		JsonStage->SetStringField(TEXT("Name"), Stage.Name.ToString());
+		JsonStage->SetNumberField(TEXT("Count"), Stage.Count);
+		JsonStage->SetNumberField(TEXT("Milliseconds"), Stage.Seconds * 1000.0);
+		JsonStage->SetNumberField(TEXT("TrianglesIn"), Stage.TrianglesIn);
+		JsonStage->SetNumberField(TEXT("TrianglesOut"), Stage.TrianglesOut);
+		JsonStages.Emplace(MakeShared<FJsonValueObject>(JsonStage));
+	}
+	JsonRoot->SetArrayField(TEXT("Stages"), JsonStages);
+
+	TArray<TSharedPtr<FJsonValue>> JsonCuts;
+	for (const FVFOperationStats::FCut& Cut : Stats.Cuts)
+	{
+		TSharedRef<FJsonObject> JsonCut = MakeShared<FJsonObject>();
+		JsonCut->SetStringField(TEXT("Stage"), Cut.Stage.ToString());
+		JsonCut->SetStringField(TEXT("Component"), Cut.ComponentName);
+		JsonCut->SetNumberField(TEXT("TrianglesIn"), Cut.TrianglesIn);
+		JsonCut->SetNumberField(TEXT("TrianglesOut"), Cut.TrianglesOut);
+		JsonCuts.Emplace(MakeShared<FJsonValueObject>(JsonCut));
+	}
+	JsonRoot->SetArrayField(TEXT("Cuts"), JsonCuts);
+
+	if (bHasPhoto)
+	{
+		TSharedRef<FJsonObject> JsonPhoto = MakeShared<FJsonObject>();
+		JsonPhoto->SetStringField(TEXT("PhotoId"), FString::Printf(TEXT("%llu"), PhotoId));
+		JsonPhoto->SetNumberField(TEXT("CaptureFOVAngle"), PhotoTakeParams.CaptureFOVAngle);
+		JsonPhoto->SetNumberField(TEXT("MaxCaptureDistance"), PhotoTakeParams.MaxCaptureDistance);
+		JsonPhoto->SetNumberField(TEXT("BackgroundDistance"), PhotoTakeParams.BackgroundDistance);
+		JsonPhoto->SetStringField(TEXT("CaptureSize"), PhotoTakeParams.CaptureSize.ToString());
+		JsonPhoto->SetStringField(TEXT("TakeTransform"), PhotoTakeParams.TakeTransformNoScale.ToString());
+		JsonPhoto->SetNumberField(TEXT("RotatedAngle"), RotatedAngle);
+		JsonRoot->SetObjectField(TEXT("Photo"), JsonPhoto);
+	}
+
+	FString Json;
+	FJsonSerializer::Serialize(JsonRoot, TJsonWriterFactory<>::Create(&Json));
+	const FString ReportPath = BaseName + TEXT(".json");
+	if (!FFileHelper::SaveStringToFile(Json, *ReportPath))
+	{
+		UE_LOG(LogViewfinder, Warning, TEXT("Viewfinder %s took %.1f ms, failed to write the hitch report to %s."), OperationName, Milliseconds, *ReportPath);
+		return;
+	}
+	UE_LOG(LogViewfinder, Warning, TEXT("Viewfinder %s took %.1f ms (threshold %.1f ms), %d components cut. Hitch report written to %s."),
+		OperationName, Milliseconds, ThresholdMilliseconds, Stats.Cuts.Num(), *ReportPath);
+}
+
+bool FVFHitchWatchdog::WriteBundle(const FString& Filename) const
+{
+	if (!Bundle->SaveToFile(Filename))
+	{
+		UE_LOG(LogViewfinder, Warning, TEXT("Failed to write the placement bundle to %s."), *Filename);
+		return false;
+	}
+	UE_LOG(LogViewfinder, Display, TEXT("Placement bundle with %d components written to %s."), Bundle->Components.Num(), *Filename);
+	return true;
+}
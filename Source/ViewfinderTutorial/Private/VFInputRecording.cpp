@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFInputRecording.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+namespace
+{
+	constexpr uint32 RecordingMagic = 0x52494656; //"VFIR"
+
+	//文件格式改变时增加，不兼容的旧文件无法读取
+	constexpr int32 RecordingVersion = 2;
+
+	//读取的数量不能超过剩余数据所能容纳的元素数，损坏的文件不会分配巨大的数组
+	bool IsValidRecordingNum(FArchive& Ar, int32 Num, int64 MinElementSize)
+	{
+		if (Ar.IsError() || Num < 0 || Num > (Ar.TotalSize() - Ar.Tell()) / MinElementSize)
+		{
+			Ar.SetError();
+			return false;
+		}
+		return true;
+	}
+}
+
+void FVFInputRecording::AddSample(int32 Step, const FTransform& ActorTransform, const FRotator& ControlRotation)
+{
+	FSample Sample;
+	Sample.Step = Step;
+	Sample.Location = FVector3f(ActorTransform.GetLocation());
+	Sample.ActorRotation = FRotator3f(ActorTransform.Rotator());
+	Sample.ControlRotation = FRotator3f(ControlRotation);
+
+	if (Samples.Num())
+	{
+		const FSample& Last = Samples.Last();
+		if (Last.Location.Equals(Sample.Location) && Last.ActorRotation.Equals(Sample.ActorRotation) && Last.ControlRotation.Equals(Sample.ControlRotation)) return;
+	}
+	Samples.Emplace(Sample);
+}
+
+void FVFInputRecording::AddEvent(int32 Step, EVFInputEvent Type, float Value, const FTransform& ActorTransform, const FRotator& ControlRotation)
+{
+	FEvent& Event = Events.AddDefaulted_GetRef();
+	Event.Step = Step;
+	Event.Type = Type;
+	Event.Value = Value;
+	Event.Location = ActorTransform.GetLocation();
+	Event.ActorRotation = ActorTransform.Rotator();
+	Event.ControlRotation = ControlRotation;
+}
+
+bool FVFInputRecording::SaveToFile(const FString& Filename) const
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	const_cast<FVFInputRecording*>(this)->Serialize(Writer);
+	return FFileHelper::SaveArrayToFile(Data, *Filename);
+}
+
+bool FVFInputRecording::LoadFromFile(const FString& Filename)
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Filename)) return false;
+
+	FMemoryReader Reader(Data);
+	Serialize(Reader);
+	return !Reader.IsError();
+}
+
+void FVFInputRecording::Serialize(FArchive& Ar)
+{
+	uint32 Magic = RecordingMagic;
+	int32 Version = RecordingVersion;
+	Ar << Magic << Version;
+	if (Ar.IsLoading() && (Magic != RecordingMagic || Version != RecordingVersion))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("Unsupported input recording version %d, expected %d."), Version, RecordingVersion);
+		Ar.SetError();
+		return;
+	}
+
+	Ar << MapName << StepSeconds << NumSteps;
+
+	int32 NumSamples = Samples.Num();
+	Ar << NumSamples;
+	if (Ar.IsLoading())
+	{
+		//步数与位置、两个旋转
+		if (!IsValidRecordingNum(Ar, NumSamples, sizeof(int32) + sizeof(FVector3f) + 2 * sizeof(FRotator3f))) return;
+		Samples.SetNum(NumSamples);
+	}
+	for (FSample& Sample : Samples)
+	{
+		Ar << Sample.Step << Sample.Location << Sample.ActorRotation << Sample.ControlRotation;
+	}
+
+	int32 NumEvents = Events.Num();
+	Ar << NumEvents;
+	if (Ar.IsLoading())
+	{
+		//步数、类型与值，位置与两个旋转
+		if (!IsValidRecordingNum(Ar, NumEvents, sizeof(int32) + sizeof(uint8) + sizeof(float) + sizeof(FVector) + 2 * sizeof(FRotator))) return;
+		Events.SetNum(NumEvents);
+	}
+	for (FEvent& Event : Events)
+	{
+		Ar << Event.Step << Event.Type << Event.Value;
+		Ar << Event.Location << Event.ActorRotation << Event.ControlRotation;
+	}
+}
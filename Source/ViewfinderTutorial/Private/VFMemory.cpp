@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFMemory.h"
+#include "VFCutGeometrySubsystem.h"
+#include "VFMeshPatch.h"
+#include "VFPhoto.h"
+#include "VFPhotoTakerPlacerComponent.h"
+#include "Components/DynamicMeshComponent.h"
+#include "Engine/Texture.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+using namespace UE::Geometry;
+
+SIZE_T FVFMemory::GetDynamicMeshBytes(const FDynamicMesh3& Mesh)
+{
+	//顶点位置与引用计数、三角面的顶点与边、边的顶点与三角面
+	SIZE_T Bytes = Mesh.MaxVertexID() * (sizeof(FVector3d) + sizeof(int16))
+		+ Mesh.MaxTriangleID() * (sizeof(FIndex3i) * 2 + sizeof(int16))
+		+ Mesh.MaxEdgeID() * (sizeof(FIndex2i) * 2 + sizeof(int16));
+
+	//属性中的法线与UV通常每个三角面角一份
+	if (Mesh.HasAttributes())
+	{
+		const int32 NumOverlays = Mesh.Attributes()->NumNormalLayers() + Mesh.Attributes()->NumUVLayers();
+		Bytes += Mesh.MaxTriangleID() * NumOverlays * (sizeof(FIndex3i) + 3 * sizeof(FVector3f));
+		if (Mesh.Attributes()->HasMaterialID())
+		{
+			Bytes += Mesh.MaxTriangleID() * sizeof(int32);
+		}
+	}
+	return Bytes;
+}
+
+SIZE_T FVFMemory::GetComponentBytes(const UPrimitiveComponent* Component)
+{
+	if (!Component) return 0;
+
+	SIZE_T Bytes = const_cast<UPrimitiveComponent*>(Component)->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+	if (const UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+	{
+		Bytes += GetDynamicMeshBytes(DynamicMeshComponent->GetDynamicMesh()->GetMeshRef());
+	}
+
+	//被释放网格体的组件只剩补丁
+	const UWorld* World = Component->GetWorld();
+	const UVFCutGeometrySubsystem* CutGeometrySubsystem = World ? World->GetSubsystem<UVFCutGeometrySubsystem>() : nullptr;
+	if (CutGeometrySubsystem)
+	{
+		if (const TSharedPtr<const FVFMeshPatch> Patch = CutGeometrySubsystem->GetMeshPatch(Component))
+		{
+			Bytes += Patch->GetAllocatedSize();
+		}
+	}
+	return Bytes;
+}
+
+SIZE_T FVFMemory::GetPayloadBytes(const FVFPhotoPayload& Payload)
+{
+	SIZE_T Bytes = Payload.ActorSnapshots.GetAllocatedSize() + Payload.ComponentSnapshots.GetAllocatedSize() + Payload.MaterialIndices.GetAllocatedSize();
+	if (Payload.RenderTarget)
+	{
+		Bytes += Payload.RenderTarget->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+	}
+	if (Payload.BackgroundRenderTarget)
+	{
+		Bytes += Payload.BackgroundRenderTarget->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+	}
+	if (Payload.DynamicMeshRecord)
+	{
+		Bytes += GetDynamicMeshBytes(Payload.DynamicMeshRecord->GetMeshRef());
+	}
+	return Bytes;
+}
+
+SIZE_T FVFMemoryReport::AddPayload(const FVFPhotoPayload* Payload)
+{
+	if (!Payload || CountedObjects.Contains(Payload)) return 0;
+	CountedObjects.Emplace(Payload);
+
+	const SIZE_T Bytes = FVFMemory::GetPayloadBytes(*Payload);
+	PhotoBytes += Bytes;
+	return Bytes;
+}
+
+SIZE_T FVFMemoryReport::AddHiddenComponent(const UPrimitiveComponent* Component)
+{
+	if (!IsValid(Component) || CountedObjects.Contains(Component)) return 0;
+	CountedObjects.Emplace(Component);
+
+	const SIZE_T Bytes = FVFMemory::GetComponentBytes(Component);
+	HiddenBytes += Bytes;
+	return Bytes;
+}
+
+SIZE_T FVFMemoryReport::AddGeneratedComponent(const UPrimitiveComponent* Component)
+{
+	if (!IsValid(Component) || CountedObjects.Contains(Component)) return 0;
+	CountedObjects.Emplace(Component);
+
+	const SIZE_T Bytes = FVFMemory::GetComponentBytes(Component);
+	GeneratedBytes += Bytes;
+	return Bytes;
+}
+
+SIZE_T FVFMemoryReport::AddPlaceRecord(const FVFPhotoPlaceRecord& PhotoPlaceRecord)
+{
+	SIZE_T Bytes = AddPayload(PhotoPlaceRecord.PhotoInfo.Payload.Get());
+	for (const UPrimitiveComponent* HiddenComponent : PhotoPlaceRecord.HiddenComponents)
+	{
+		Bytes += AddHiddenComponent(HiddenComponent);
+	}
+	for (const UPrimitiveComponent* GeneratedComponent : PhotoPlaceRecord.GeneratedComponents)
+	{
+		Bytes += AddGeneratedComponent(GeneratedComponent);
+	}
+
+	const SIZE_T RecordBytes = sizeof(FVFPhotoPlaceRecord) + PhotoPlaceRecord.SpawnedActors.GetAllocatedSize() + PhotoPlaceRecord.SpawnedActorTransforms.GetAllocatedSize()
+		+ PhotoPlaceRecord.HiddenComponents.GetAllocatedSize() + PhotoPlaceRecord.GeneratedComponents.GetAllocatedSize() + PhotoPlaceRecord.RemovedInstances.GetAllocatedSize();
+	RewindRecordBytes += RecordBytes;
+	return Bytes + RecordBytes;
+}
+
+void FVFMemoryReport::Log(int32 MaxEntries) const
+{
+	UE_LOG(LogViewfinder, Log, TEXT("Viewfinder memory: %.1f KB total, %.1f KB photos, %.1f KB hidden components, %.1f KB generated components, %.1f KB rewind records."),
+		GetTotalBytes() / 1024.f, PhotoBytes / 1024.f, HiddenBytes / 1024.f, GeneratedBytes / 1024.f, RewindRecordBytes / 1024.f);
+
+	TArray<FEntry> SortedEntries = Entries;
+	SortedEntries.Sort([](const FEntry& A, const FEntry& B) { return A.Bytes > B.Bytes; });
+	for (int32 i = 0; i < FMath::Min(SortedEntries.Num(), MaxEntries); i++)
+	{
+		UE_LOG(LogViewfinder, Log, TEXT("  %-40s %10.1f KB"), *SortedEntries[i].Name, SortedEntries[i].Bytes / 1024.f);
+	}
+	if (SortedEntries.Num() > MaxEntries)
+	{
+		UE_LOG(LogViewfinder, Log, TEXT("  ... %d more entries."), SortedEntries.Num() - MaxEntries);
+	}
+}
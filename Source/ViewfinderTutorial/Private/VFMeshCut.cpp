@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFMeshCut.h"
+#include "VFStats.h"
+#include "MeshBoundaryLoops.h"
+#include "Operations/MeshBoolean.h"
+#include "Operations/MinimalHoleFiller.h"
+
+using namespace UE::Geometry;
+
+namespace
+{
+	//顶点到平面距离的容差，按厘米计。
+	constexpr double PlaneTolerance = 0.01;
+
+	FBox GetWorldBounds(const FDynamicMesh3& Mesh, const FTransform& Transform)
+	{
+		const FAxisAlignedBox3d LocalBounds = Mesh.GetBounds();
+		return FBox(LocalBounds.Min, LocalBounds.Max).TransformBy(Transform);
+	}
+}
+
+void FVFConvexVolume::BuildFromMesh(const FDynamicMesh3& Mesh, const FTransform& Transform)
+{
+	Planes.Empty();
+
+	FVector Centroid = FVector::ZeroVector;
+	for (int32 VertexID : Mesh.VertexIndicesItr())
+	{
+		Centroid += Transform.TransformPosition(Mesh.GetVertex(VertexID));
+	}
+	if (Mesh.VertexCount() == 0) return;
+	Centroid /= Mesh.VertexCount();
+
+	for (int32 TriangleID : Mesh.TriangleIndicesItr())
+	{
+		FVector A, B, C;
+		Mesh.GetTriVertices(TriangleID, A, B, C);
+		FPlane Plane(Transform.TransformPosition(A), Transform.TransformPosition(B), Transform.TransformPosition(C));
+		if (Plane.GetNormal().IsNearlyZero()) continue;
+
+		//不依赖三角面的绕序，保证法线朝向体积外侧
+		if (Plane.PlaneDot(Centroid) > 0.0)
+		{
+			Plane = Plane.Flip();
+		}
+
+		//同一个面通常由多个三角面组成，只保留一个平面
+		const bool bIsDuplicated = Planes.ContainsByPredicate([&Plane](const FPlane& Other)
+		{
+			return (Other.GetNormal() | Plane.GetNormal()) > 1.0 - UE_KINDA_SMALL_NUMBER && FMath::IsNearlyEqual(Other.W, Plane.W, PlaneTolerance);
+		});
+		if (!bIsDuplicated)
+		{
+			Planes.Emplace(Plane);
+		}
+	}
+}
+
+EVFMeshCutOutcome FVFMeshCut::Classify(const FDynamicMesh3& Mesh, const FTransform& MeshTransform, const FVFConvexVolume& Volume, EVFMeshCutOperation Operation)
+{
+	if (!Volume.IsValid()) return EVFMeshCutOutcome::Cut;
+
+	//是否所有顶点都在体积内部，以及每个平面是否所有顶点都在其外侧
+	bool bAllInside = true;
+	TArray<bool, TInlineAllocator<8>> AllOutsidePlanes;
+	AllOutsidePlanes.Init(true, Volume.Planes.Num());
+	int32 NumSeparatingPlanes = Volume.Planes.Num();
+
+	for (int32 VertexID : Mesh.VertexIndicesItr())
+	{
+		const FVector Position = MeshTransform.TransformPosition(Mesh.GetVertex(VertexID));
+		for (int32 i = 0; i < Volume.Planes.Num(); i++)
+		{
+			const double Distance = Volume.Planes[i].PlaneDot(Position);
+			if (Distance > PlaneTolerance)
+			{
+				bAllInside = false;
+			}
+			if (Distance < -PlaneTolerance && AllOutsidePlanes[i])
+			{
+				AllOutsidePlanes[i] = false;
+				NumSeparatingPlanes--;
+			}
+		}
+
+		//网格体跨越了体积的边界，无法快速判断
+		if (!bAllInside && NumSeparatingPlanes == 0) return EVFMeshCutOutcome::Cut;
+	}
+
+	//存在一个平面将网格体与凸体积分开，两者不相交
+	if (NumSeparatingPlanes > 0)
+	{
+		return Operation == EVFMeshCutOperation::Subtract ? EVFMeshCutOutcome::Unchanged : EVFMeshCutOutcome::Removed;
+	}
+	//凸体积包含了网格体的所有顶点，也就包含了整个网格体
+	return Operation == EVFMeshCutOperation::Subtract ? EVFMeshCutOutcome::Removed : EVFMeshCutOutcome::Unchanged;
+}
+
+EVFMeshCutOutcome FVFMeshCut::ApplyBoolean(
+	const FDynamicMesh3& SourceMesh, const FTransform& SourceTransform,
+	const FDynamicMesh3& ToolMesh, const FTransform& ToolTransform,
+	EVFMeshCutOperation Operation, FDynamicMesh3& OutMesh,
+	const FVFConvexVolume* ToolVolume)
+{
+	if (SourceMesh.TriangleCount() == 0) return EVFMeshCutOutcome::Unchanged;
+
+	if (ToolVolume)
+	{
+		const EVFMeshCutOutcome Outcome = Classify(SourceMesh, SourceTransform, *ToolVolume, Operation);
+		if (Outcome != EVFMeshCutOutcome::Cut) return Outcome;
+	}
+	else if (!GetWorldBounds(SourceMesh, SourceTransform).Intersect(GetWorldBounds(ToolMesh, ToolTransform)))
+	{
+		return Operation == EVFMeshCutOperation::Subtract ? EVFMeshCutOutcome::Unchanged : EVFMeshCutOutcome::Removed;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_VF_MeshBoolean);
+	VF_TRACE_STAGE(MeshBoolean);
+	FVFStats::RecordBoolean();
+
+	//与GeometryScript的ApplyMeshBoolean使用相同的默认参数：简化新生成的边，并填补切割产生的孔洞
+	FDynamicMesh3 ResultMesh;
+	FMeshBoolean Boolean(
+		&SourceMesh, FTransformSRT3d(SourceTransform),
+		&ToolMesh, FTransformSRT3d(ToolTransform),
+		&ResultMesh,
+		Operation == EVFMeshCutOperation::Subtract ? FMeshBoolean::EBooleanOp::Difference : FMeshBoolean::EBooleanOp::Intersect);
+	Boolean.bPutResultInInputSpace = true;
+	Boolean.bSimplifyAlongNewEdges = true;
+	Boolean.Compute();
+
+	if (Boolean.CreatedBoundaryEdges.Num())
+	{
+		FMeshBoundaryLoops OpenBoundary(&ResultMesh, false);
+		TSet<int32> ConsiderEdges(Boolean.CreatedBoundaryEdges);
+		OpenBoundary.EdgeFilterFunc = [&ConsiderEdges](int32 EdgeID) { return ConsiderEdges.Contains(EdgeID); };
+		OpenBoundary.Compute();
+		for (FEdgeLoop& Loop : OpenBoundary.Loops)
+		{
+			FMinimalHoleFiller Filler(&ResultMesh, Loop);
+			Filler.Fill();
+		}
+	}
+
+	if (ResultMesh.TriangleCount() == 0) return EVFMeshCutOutcome::Removed;
+
+	//切割一定会产生新的三角面，数量与包围盒都没有变化则说明网格体没有被切到
+	if (ResultMesh.TriangleCount() == SourceMesh.TriangleCount() && ResultMesh.VertexCount() == SourceMesh.VertexCount())
+	{
+		const FAxisAlignedBox3d SourceBounds = SourceMesh.GetBounds();
+		const FAxisAlignedBox3d ResultBounds = ResultMesh.GetBounds();
+		if (SourceBounds.Min.Equals(ResultBounds.Min, PlaneTolerance) && SourceBounds.Max.Equals(ResultBounds.Max, PlaneTolerance))
+		{
+			return EVFMeshCutOutcome::Unchanged;
+		}
+	}
+
+	OutMesh = MoveTemp(ResultMesh);
+	return EVFMeshCutOutcome::Cut;
+}
+
+EVFMeshCutOutcome FVFMeshCut::ApplyPlaceCut(
+	const FDynamicMesh3& SourceMesh, const FTransform& SourceTransform,
+	const FDynamicMesh3* RecordMesh, const FTransform& RecordTransform,
+	const FDynamicMesh3& PyramidMesh, const FTransform& PyramidTransform, const FVFConvexVolume& PyramidVolume,
+	EVFMeshCutOperation PyramidOperation, FDynamicMesh3& OutMesh)
+{
+	const FDynamicMesh3* CurrentMesh = &SourceMesh;
+	EVFMeshCutOutcome Outcome = EVFMeshCutOutcome::Unchanged;
+	FDynamicMesh3 RecordCutMesh;
+
+	//如果是放置照片的生成Actor阶段，则需要与照片中存储的动态网格体进行一次相交
+	if (RecordMesh)
+	{
+		Outcome = ApplyBoolean(
+			SourceMesh, SourceTransform,
+			*RecordMesh, RecordTransform,
+			EVFMeshCutOperation::Intersect, RecordCutMesh);
+		if (Outcome == EVFMeshCutOutcome::Removed) return Outcome;
+		if (Outcome == EVFMeshCutOutcome::Cut)
+		{
+			CurrentMesh = &RecordCutMesh;
+		}
+	}
+
+	//与视口Pyramid进行相交/相减
+	const EVFMeshCutOutcome PyramidOutcome = ApplyBoolean(
+		*CurrentMesh, SourceTransform,
+		PyramidMesh, PyramidTransform,
+		PyramidOperation, OutMesh, &PyramidVolume);
+	if (PyramidOutcome == EVFMeshCutOutcome::Unchanged && Outcome == EVFMeshCutOutcome::Cut)
+	{
+		OutMesh = MoveTemp(RecordCutMesh);
+		return Outcome;
+	}
+	return PyramidOutcome;
+}
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFMeshPatch.h"
+#include "VFMemory.h"
+#include "DynamicMeshEditor.h"
+#include "Operations/MergeCoincidentMeshEdges.h"
+
+using namespace UE::Geometry;
+
+namespace
+{
+	//三角面匹配的位置精度，按厘米计。boolean在世界空间中进行，保留的三角面只有变换往返带来的误差
+	constexpr double MatchPrecision = 0.001;
+
+	//三个顶点的位置与材质ID，从最小的顶点开始排列，不改变绕序
+	struct FTriangleKey
+	{
+		int64 Values[10];
+
+		bool operator==(const FTriangleKey& Other) const
+		{
+			return FMemory::Memcmp(Values, Other.Values, sizeof(Values)) == 0;
+		}
+
+		friend uint32 GetTypeHash(const FTriangleKey& Key)
+		{
+			return FCrc::MemCrc32(Key.Values, sizeof(Key.Values));
+		}
+	};
+
+	FTriangleKey MakeTriangleKey(const FDynamicMesh3& Mesh, int32 TriangleID)
+	{
+		const FIndex3i Triangle = Mesh.GetTriangle(TriangleID);
+		int64 Corners[3][3];
+		for (int32 i = 0; i < 3; i++)
+		{
+			const FVector3d Position = Mesh.GetVertex(Triangle[i]);
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				Corners[i][Axis] = (int64)FMath::RoundToDouble(Position[Axis] / MatchPrecision);
+			}
+		}
+
+		int32 First = 0;
+		for (int32 i = 1; i < 3; i++)
+		{
+			if (FMemory::Memcmp(Corners[i], Corners[First], sizeof(Corners[i])) < 0)
+			{
+				First = i;
+			}
+		}
+
+		FTriangleKey Key;
+		for (int32 i = 0; i < 3; i++)
+		{
+			FMemory::Memcpy(&Key.Values[i * 3], Corners[(First + i) % 3], sizeof(Corners[0]));
+		}
+		const FDynamicMeshMaterialAttribute* MaterialIDs = Mesh.HasAttributes() ? Mesh.Attributes()->GetMaterialID() : nullptr;
+		Key.Values[9] = MaterialIDs ? MaterialIDs->GetValue(TriangleID) : 0;
+		return Key;
+	}
+}
+
+void FVFMeshPatch::Build(const FDynamicMesh3& BaseMesh, const FDynamicMesh3& CutMesh)
+{
+	SourceTriangleCount = BaseMesh.TriangleCount();
+	SourceVertexCount = BaseMesh.VertexCount();
+	RemovedTriangles.Reset();
+	AddedMesh.Clear();
+
+	TMultiMap<FTriangleKey, int32> BaseTriangles;
+	BaseTriangles.Reserve(BaseMesh.TriangleCount());
+	for (int32 TriangleID : BaseMesh.TriangleIndicesItr())
+	{
+		BaseTriangles.Add(MakeTriangleKey(BaseMesh, TriangleID), TriangleID);
+	}
+
+	//与来源中某个三角面相同的三角面被保留，剩下的来源三角面就是被删除的三角面
+	TArray<int32> AddedTriangles;
+	for (int32 TriangleID : CutMesh.TriangleIndicesItr())
+	{
+		const FTriangleKey Key = MakeTriangleKey(CutMesh, TriangleID);
+		if (const int32* BaseTriangleID = BaseTriangles.Find(Key))
+		{
+			const int32 MatchedTriangleID = *BaseTriangleID;
+			BaseTriangles.RemoveSingle(Key, MatchedTriangleID);
+			continue;
+		}
+		AddedTriangles.Emplace(TriangleID);
+	}
+	BaseTriangles.GenerateValueArray(RemovedTriangles);
+	RemovedTriangles.Sort();
+
+	AddedMesh.EnableMatchingAttributes(CutMesh);
+	FDynamicMeshEditor Editor(&AddedMesh);
+	FMeshIndexMappings Mappings;
+	FDynamicMeshEditResult EditResult;
+	Editor.AppendTriangles(&CutMesh, AddedTriangles, Mappings, EditResult, false);
+}
+
+bool FVFMeshPatch::Apply(const FDynamicMesh3& BaseMesh, FDynamicMesh3& OutMesh) const
+{
+	if (BaseMesh.TriangleCount() != SourceTriangleCount || BaseMesh.VertexCount() != SourceVertexCount) return false;
+
+	OutMesh = BaseMesh;
+	for (int32 TriangleID : RemovedTriangles)
+	{
+		if (!OutMesh.IsTriangle(TriangleID) || OutMesh.RemoveTriangle(TriangleID, true, false) != EMeshResult::Ok) return false;
+	}
+
+	FDynamicMeshEditor Editor(&OutMesh);
+	FMeshIndexMappings Mappings;
+	Editor.AppendMesh(&AddedMesh, Mappings);
+
+	//新增的三角面与保留的三角面在切割边界上的顶点是重复的，焊接后与切割结果的拓扑相同，之后可以继续被切割
+	FMergeCoincidentMeshEdges MergeEdges(&OutMesh);
+	MergeEdges.Apply();
+	OutMesh.CompactInPlace();
+	return true;
+}
+
+SIZE_T FVFMeshPatch::GetAllocatedSize() const
+{
+	return sizeof(FVFMeshPatch) + RemovedTriangles.GetAllocatedSize() + FVFMemory::GetDynamicMeshBytes(AddedMesh);
+}
+
+void FVFMeshPatch::Serialize(FArchive& Ar)
+{
+	Ar << SourceTriangleCount << SourceVertexCount << RemovedTriangles << AddedMesh;
+}
@@ -2,12 +2,23 @@
 
 
 #include "VFPhoto.h"
-#include "Engine/StaticMeshActor.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+uint64 FVFPhotoInfo::GeneratePhotoId()
+{
+	//由GUID生成，读取存档后也不会与新拍摄的照片冲突
+	const FGuid Guid = FGuid::NewGuid();
+	const uint64 Id = ((uint64)Guid.A << 32 | Guid.B) ^ ((uint64)Guid.C << 32 | Guid.D);
+	return Id ? Id : 1;
+}
 
 AVFPhoto::AVFPhoto()
 {
-	PrimaryActorTick.bCanEverTick = true;
+	//照片没有需要每帧更新的内容
+	PrimaryActorTick.bCanEverTick = false;
 
 	PhotoMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("PhotoMesh"));
 	SetRootComponent(PhotoMesh);
@@ -23,61 +34,137 @@ void AVFPhoto::BeginPlay()
 	
 }
 
-void AVFPhoto::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
-}
-
 void AVFPhoto::SetPhotoInfo(const FVFPhotoInfo& InPhotoInfo)
 {
 	PhotoInfo = InPhotoInfo;
-	SetRenderTarget(PhotoInfo.RenderTarget);
+	SetRenderTarget(PhotoInfo.Payload ? PhotoInfo.Payload->RenderTarget : nullptr);
 
 }
 
-void AVFPhoto::AddCapturedActor(AActor* Actor, const FTransform& CameraTransform)
+void FVFPhotoPayload::AddCapturedActor(AActor* Actor, const FTransform& CameraTransform)
 {
-	FVFActorRecord ActorRecord;
-	
-	ActorRecord.Class = Actor->GetClass();
-	ActorRecord.RelativeTransform = UKismetMathLibrary::MakeRelativeTransform(Actor->GetActorTransform(), CameraTransform);
+	FVFActorSnapshot& ActorSnapshot = ActorSnapshots.AddDefaulted_GetRef();
+	ActorSnapshot.Class = Actor->GetClass();
+	ActorSnapshot.RelativeTransform = UKismetMathLibrary::MakeRelativeTransform(Actor->GetActorTransform(), CameraTransform);
+	ActorSnapshot.FirstComponent = ComponentSnapshots.Num();
 
-	//场景中大多数的Actor都是StaticMeshActor
-	if (AStaticMeshActor* StaticMeshActor = Cast<AStaticMeshActor>(Actor))
+	//场景中大多数的Actor都是StaticMeshActor，它们与其他Actor一样按组件名称记录
+	TInlineComponentArray<UStaticMeshComponent*> Components(Actor);
+	for (UStaticMeshComponent* StaticMeshComponent : Components)
 	{
-		ActorRecord.NameToMeshMap.Emplace(FString("StaticMeshComponent"), StaticMeshActor->GetStaticMeshComponent()->GetStaticMesh());
+		FVFComponentSnapshot& ComponentSnapshot = ComponentSnapshots.AddDefaulted_GetRef();
+		ComponentSnapshot.ComponentName = StaticMeshComponent->GetFName();
+		ComponentSnapshot.StaticMesh = StaticMeshComponent->GetStaticMesh();
+		ComponentSnapshot.bSimulatePhysics = StaticMeshComponent->IsSimulatingPhysics();
+		ComponentSnapshot.CollisionEnabled = StaticMeshComponent->GetCollisionEnabled();
+
+		//相同的材质在整张照片中只存储一次
+		ComponentSnapshot.FirstMaterial = MaterialIndices.Num();
+		ComponentSnapshot.NumMaterials = StaticMeshComponent->GetNumMaterials();
+		for (int32 i = 0; i < ComponentSnapshot.NumMaterials; i++)
+		{
+			MaterialIndices.Emplace(Materials.AddUnique(StaticMeshComponent->GetMaterial(i)));
+		}
 	}
-	else
+	ActorSnapshot.NumComponents = ComponentSnapshots.Num() - ActorSnapshot.FirstComponent;
+}
+
+AActor* FVFPhotoPayload::SpawnCapturedActor(UWorld* World, int32 ActorIndex, const FTransform& CameraTransform) const
+{
+	if (!ActorSnapshots.IsValidIndex(ActorIndex)) return nullptr;
+	const FVFActorSnapshot& ActorSnapshot = ActorSnapshots[ActorIndex];
+	
+	const FTransform& WorldTransform = UKismetMathLibrary::ComposeTransforms(ActorSnapshot.RelativeTransform, CameraTransform);
+	AActor* Actor = World->SpawnActorDeferred<AActor>(ActorSnapshot.Class, WorldTransform);
+	if (!Actor) return nullptr;
+
+	//存档通过此标签找到照片中生成的Actor
+	Actor->Tags.Emplace(FName("VFSpawned"));
+
+	//组件在注册之前可以直接设置网格体，只有蓝图构造脚本添加的组件需要在FinishSpawning之后处理
+	TBitArray<> AppliedComponents(false, ActorSnapshot.NumComponents);
+	auto ApplyComponentSnapshots = [this, &ActorSnapshot, &AppliedComponents](AActor* InActor)
 	{
-		TArray<UStaticMeshComponent*> Components;
-		Actor->GetComponents<UStaticMeshComponent>(Components);
+		TInlineComponentArray<UStaticMeshComponent*> Components(InActor);
 		for (UStaticMeshComponent* StaticMeshComponent : Components)
 		{
-			ActorRecord.NameToMeshMap.Emplace(StaticMeshComponent->GetName(), StaticMeshComponent->GetStaticMesh());
-		}
-		/*for (FProperty* Property = Actor->GetClass()->PropertyLink; Property; Property = Property->PropertyLinkNext)
-		{
-			FString ClassName = Property->GetCPPType();
-			if (!ClassName.Contains(FString("StaticMeshComponent"))) continue;
-	
-			FString PropertyName = Property->GetName();
-			FObjectProperty* ObjectProperty = CastField<FObjectProperty>(Property);
-			void* ValuePtr = Property->ContainerPtrToValuePtr<void>(Actor);
-			UObject* Value = ObjectProperty->GetPropertyValue(ValuePtr);
-			if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Value))
+			for (int32 i = 0; i < ActorSnapshot.NumComponents; i++)
 			{
-				ActorRecord.NameToMeshMap.Emplace(PropertyName, StaticMeshComponent->GetStaticMesh());
+				const FVFComponentSnapshot& ComponentSnapshot = ComponentSnapshots[ActorSnapshot.FirstComponent + i];
+				if (AppliedComponents[i] || ComponentSnapshot.ComponentName != StaticMeshComponent->GetFName()) continue;
+				AppliedComponents[i] = true;
+
+				const bool bIsRegistered = StaticMeshComponent->IsRegistered();
+				const EComponentMobility::Type PrevMobility = StaticMeshComponent->Mobility;
+				if (bIsRegistered)
+				{
+					StaticMeshComponent->SetMobility(EComponentMobility::Movable);
+				}
+				StaticMeshComponent->SetStaticMesh(ComponentSnapshot.StaticMesh);
+				for (int32 MaterialIndex = 0; MaterialIndex < ComponentSnapshot.NumMaterials; MaterialIndex++)
+				{
+					UMaterialInterface* Material = Materials[MaterialIndices[ComponentSnapshot.FirstMaterial + MaterialIndex]];
+					if (StaticMeshComponent->GetMaterial(MaterialIndex) != Material)
+					{
+						StaticMeshComponent->SetMaterial(MaterialIndex, Material);
+					}
+				}
+				StaticMeshComponent->SetCollisionEnabled(ComponentSnapshot.CollisionEnabled);
+				StaticMeshComponent->SetSimulatePhysics(ComponentSnapshot.bSimulatePhysics);
+				StaticMeshComponent->SetGenerateOverlapEvents(true);
+				if (bIsRegistered)
+				{
+					StaticMeshComponent->SetMobility(PrevMobility);
+				}
+				break;
 			}
-		}*/
+		}
+	};
+
+	ApplyComponentSnapshots(Actor);
+	Actor->FinishSpawning(WorldTransform);
+	if (AppliedComponents.Find(false) != INDEX_NONE)
+	{
+		ApplyComponentSnapshots(Actor);
 	}
 
-	PhotoInfo.ActorRecords.Emplace(ActorRecord);
+	//不需要逐个组件更新重叠，之后的Pyramid重叠查询会找到这些组件
+	return Actor;
+}
+
+void FVFPhotoPayload::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObject(RenderTarget);
+	Collector.AddReferencedObject(BackgroundRenderTarget);
+	Collector.AddReferencedObject(DynamicMeshRecord);
+	Collector.AddReferencedObjects(Materials);
+	for (FVFActorSnapshot& ActorSnapshot : ActorSnapshots)
+	{
+		UClass* Class = ActorSnapshot.Class;
+		Collector.AddReferencedObject(Class);
+	}
+	for (FVFComponentSnapshot& ComponentSnapshot : ComponentSnapshots)
+	{
+		Collector.AddReferencedObject(ComponentSnapshot.StaticMesh);
+	}
 }
 
 void AVFPhoto::SetRenderTarget(UTexture* Texture)
 {
-	PhotoInfo.RenderTarget = Texture;
-	UMaterialInstanceDynamic* PlaneMaterial = UMaterialInstanceDynamic::Create(PhotoMesh->GetMaterial(0), this);
-	PlaneMaterial->SetTextureParameterValue(FName("RenderTarget"), PhotoInfo.RenderTarget);
-	PhotoMesh->SetMaterial(0, PlaneMaterial);
+	if (!PhotoMaterial)
+	{
+		PhotoMaterial = UMaterialInstanceDynamic::Create(PhotoMesh->GetMaterial(0), this);
+		PhotoMesh->SetMaterial(0, PhotoMaterial);
+	}
+	PhotoMaterial->SetTextureParameterValue(FName("RenderTarget"), Texture);
+}
+
+UTexture* AVFPhoto::GetRenderTarget() const
+{
+	UTexture* Texture = nullptr;
+	if (PhotoMaterial)
+	{
+		PhotoMaterial->GetTextureParameterValue(FName("RenderTarget"), Texture);
+	}
+	return Texture;
 }
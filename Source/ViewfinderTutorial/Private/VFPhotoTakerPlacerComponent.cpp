@@ -2,16 +2,81 @@
 
 #include "VFPhotoTakerPlacerComponent.h"
 #include "VFPhoto.h"
+#include "VFMemory.h"
+#include "VFMeshCut.h"
+#include "VFMeshPatch.h"
+#include "VFPlacementBundle.h"
+#include "VFScratchMeshPool.h"
+#include "VFPoolSubsystem.h"
+#include "VFSaveSubsystem.h"
+#include "VFStats.h"
+#include "VFCutGeometrySubsystem.h"
+#include "Async/Async.h"
 #include "Components/DynamicMeshComponent.h"
+#include "Hash/CityHash.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "DynamicMeshEditor.h"
+#include "MeshSimplification.h"
 #include "Components/SceneCaptureComponent2D.h"
 #include "Engine/SceneCapture2D.h"
-#include "Engine/StaticMeshActor.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "GeometryScript/MeshAssetFunctions.h"
 #include "GeometryScript/MeshBooleanFunctions.h"
-#include "GeometryScript/MeshDecompositionFunctions.h"
-#include "GeometryScript/MeshComparisonFunctions.h"
+#include <atomic>
+
+using namespace UE::Geometry;
+
+//瞄准时在工作线程中提前计算的地图组件切割结果，只有放置时的条件与计算时完全相同才会被使用。
+struct FVFSpeculativePlacement
+{
+	uint64 PhotoId = 0;
+	FTransform PlaceTransformNoScale;
+	float RotatedAngle = 0.f;
+	FVFInputMeshKey InputMeshKey;
+
+	//游戏线程中准备的输入，工作线程只读取网格体的副本
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> Components;
+	TArray<FTransform> ComponentTransforms;
+	TArray<FDynamicMesh3> SourceMeshes;
+
+	//补丁的来源，没有来源的组件不生成补丁。切割生成的组件需要另外复制来源的网格体，其它组件的网格体本身就是来源
+	TArray<TWeakObjectPtr<UStaticMesh>> PatchSources;
+	TArray<FDynamicMesh3> PatchSourceMeshes;
+	FDynamicMesh3 PyramidMesh;
+	FTransform PyramidTransform;
+	FVFConvexVolume PyramidVolume;
+
+	//实例化组件逐实例切割的开销只与被切到的实例有关，在放置时于游戏线程中处理
+	TArray<TWeakObjectPtr<UInstancedStaticMeshComponent>> InstancedComponents;
+
+	//工作线程的输出，在Future完成前不能读取
+	TArray<EVFMeshCutOutcome> Outcomes;
+	TArray<FDynamicMesh3> CutMeshes;
+	TArray<TSharedPtr<FVFMeshPatch>> Patches;
+
+	std::atomic<bool> bCancelled = false;
+	TFuture<void> Future;
+};
+
+//瞄准时在工作线程中计算的低精度放置预览，包括将被切除的地图部分与照片中的网格体。
+struct FVFPlacePreview
+{
+	TArray<FDynamicMesh3> SourceMeshes;
+	TArray<FTransform> SourceTransforms;
+	FDynamicMesh3 RecordMesh;
+	FTransform RecordTransform;
+	FDynamicMesh3 PyramidMesh;
+	FTransform PyramidTransform;
+	FVFConvexVolume PyramidVolume;
+	int32 MaxTrianglesPerMesh = 0;
+
+	//世界空间中的预览网格体，在Future完成前不能读取
+	FDynamicMesh3 ResultMesh;
+
+	std::atomic<bool> bCancelled = false;
+	TFuture<void> Future;
+};
 
 UVFPhotoTakerPlacerComponent::UVFPhotoTakerPlacerComponent()
 {
@@ -48,16 +113,23 @@ void UVFPhotoTakerPlacerComponent::BeginPlay()
 	SetCollisionEnabled(ECollisionEnabled::NoCollision);
 	
 	SetVisibility(false);
+
+	//缓存中被撤销的放置也可能持有被烘焙的组件
+	if (UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>())
+	{
+		CutGeometrySubsystem->OnComponentReplaced.AddUObject(this, &UVFPhotoTakerPlacerComponent::ReplaceComponentReferences);
+	}
 }
 
-AVFPhoto* UVFPhotoTakerPlacerComponent::TakePhoto()
+FVFPhotoInfo UVFPhotoTakerPlacerComponent::TakePhoto()
 {
 	return TakePhotoWithParamAssigned(DefaultPhotoTakeParams);
 }
 
-AVFPhoto* UVFPhotoTakerPlacerComponent::TakePhotoWithParamAssigned(const FVFAPhotoTakeParams& Params)
+FVFPhotoInfo UVFPhotoTakerPlacerComponent::TakePhotoWithParamAssigned(const FVFAPhotoTakeParams& Params)
 {
-	if (!Params.PhotoClass) return nullptr;
+	VF_SCOPED_STAGE(Take);
+	if (!Params.PhotoClass) return FVFPhotoInfo();
 
 	const bool bShouldOverrideTakeTransform = Params.ShouldOverrideTakeTransform();
 	if (bShouldOverrideTakeTransform)
@@ -68,65 +140,68 @@ AVFPhoto* UVFPhotoTakerPlacerComponent::TakePhotoWithParamAssigned(const FVFAPho
 	
 	SetPyramidScale(Params.CaptureFOVAngle, Params.MaxCaptureDistance, Params.GetAspectRatio());
 	
-	//生成Photo Actor并拍摄照片
-	AVFPhoto* Photo = Cast<AVFPhoto>(GetWorld()->SpawnActor(Params.PhotoClass));
-	if (!Photo) return nullptr;
-	
-	ASceneCapture2D* SceneCapture = Cast<ASceneCapture2D>(GetWorld()->SpawnActor(ASceneCapture2D::StaticClass()));
-	if (!SceneCapture)
+	//拍摄照片
+	TArray<UPrimitiveComponent*> CurrentOverlappingComponents;
+	UTextureRenderTarget2D* BackgroundRenderTarget = nullptr;
+	UTextureRenderTarget2D* RenderTarget = nullptr;
 	{
-		Photo->Destroy();
-		return nullptr;
-	}
+		VF_SCOPED_STAGE(TakeCapture);
+		ASceneCapture2D* SceneCapture = Cast<ASceneCapture2D>(GetWorld()->SpawnActor(ASceneCapture2D::StaticClass()));
+		if (!SceneCapture) return FVFPhotoInfo();
 	
-	SceneCapture->SetActorLocation(GetComponentLocation());
-	SceneCapture->SetActorRotation(GetComponentRotation());
-	SceneCapture->GetCaptureComponent2D()->FOVAngle = Params.CaptureFOVAngle;
-	SceneCapture->GetCaptureComponent2D()->bCaptureEveryFrame = false;
-	SceneCapture->GetCaptureComponent2D()->bCaptureOnMovement = false;
-	SceneCapture->GetCaptureComponent2D()->bAlwaysPersistRenderingState = true;
+		SceneCapture->SetActorLocation(GetComponentLocation());
+		SceneCapture->SetActorRotation(GetComponentRotation());
+		SceneCapture->GetCaptureComponent2D()->FOVAngle = Params.CaptureFOVAngle;
+		SceneCapture->GetCaptureComponent2D()->bCaptureEveryFrame = false;
+		SceneCapture->GetCaptureComponent2D()->bCaptureOnMovement = false;
+		SceneCapture->GetCaptureComponent2D()->bAlwaysPersistRenderingState = true;
 
-	TArray<UPrimitiveComponent*> CurrentOverlappingComponents;
-	GetPyramidOverlappingComponentsFiltered(CurrentOverlappingComponents);
+		GetPyramidOverlappingComponentsFiltered(CurrentOverlappingComponents);
 	
-	//对场景捕获隐藏这些组件，拍摄一张背景
-	UTextureRenderTarget2D* BackgroundRenderTarget = NewObject<UTextureRenderTarget2D>(this);
-	BackgroundRenderTarget->InitAutoFormat(Params.CaptureSize.X, Params.CaptureSize.Y);
-	SceneCapture->GetCaptureComponent2D()->TextureTarget = BackgroundRenderTarget;
-	for (UPrimitiveComponent* CurrentOverlappingComponent : CurrentOverlappingComponents)
-	{
-		CurrentOverlappingComponent->SetHiddenInSceneCapture(true);
-	}
-	SceneCapture->GetCaptureComponent2D()->CaptureScene();
+		//对场景捕获隐藏这些组件，拍摄一张背景
+		BackgroundRenderTarget = NewObject<UTextureRenderTarget2D>(this);
+		BackgroundRenderTarget->InitAutoFormat(Params.CaptureSize.X, Params.CaptureSize.Y);
+		SceneCapture->GetCaptureComponent2D()->TextureTarget = BackgroundRenderTarget;
+		for (UPrimitiveComponent* CurrentOverlappingComponent : CurrentOverlappingComponents)
+		{
+			CurrentOverlappingComponent->SetHiddenInSceneCapture(true);
+		}
+		SceneCapture->GetCaptureComponent2D()->CaptureScene();
 
-	//还原这些Actor的对场景捕获的显示，拍摄照片
-	UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>(this);
-	RenderTarget->InitAutoFormat(Params.CaptureSize.X, Params.CaptureSize.Y);
-	SceneCapture->GetCaptureComponent2D()->TextureTarget = RenderTarget;
-	for (UPrimitiveComponent* CurrentOverlappingComponent : CurrentOverlappingComponents)
-	{
-		CurrentOverlappingComponent->SetHiddenInSceneCapture(false);
+		//还原这些Actor的对场景捕获的显示，拍摄照片
+		RenderTarget = NewObject<UTextureRenderTarget2D>(this);
+		RenderTarget->InitAutoFormat(Params.CaptureSize.X, Params.CaptureSize.Y);
+		SceneCapture->GetCaptureComponent2D()->TextureTarget = RenderTarget;
+		for (UPrimitiveComponent* CurrentOverlappingComponent : CurrentOverlappingComponents)
+		{
+			CurrentOverlappingComponent->SetHiddenInSceneCapture(false);
+		}
+		SceneCapture->GetCaptureComponent2D()->CaptureScene();
+		SceneCapture->Destroy();
 	}
-	SceneCapture->GetCaptureComponent2D()->CaptureScene();
-	SceneCapture->Destroy();
 
-	//初始化照片信息
-	FVFPhotoInfo PhotoInfo;
-	PhotoInfo.PhotoTakeParams = Params;
-	PhotoInfo.PhotoTakeParams.TakeTransformNoScale = GetComponentTransformNoScale();
-	PhotoInfo.RenderTarget = RenderTarget;
-	PhotoInfo.BackgroundRenderTarget = BackgroundRenderTarget;
-	PhotoInfo.DynamicMeshRecord = CalcMeshRecordForComponents(CurrentOverlappingComponents);
-
-	Photo->SetPhotoInfo(PhotoInfo);
+	//初始化照片信息，拍摄完成后照片数据不会再改变，之后的复制只会共享这份数据
+	TSharedRef<FVFPhotoPayload> Payload = MakeShared<FVFPhotoPayload>();
+	Payload->PhotoTakeParams = Params;
+	Payload->PhotoTakeParams.TakeTransformNoScale = GetComponentTransformNoScale();
+	Payload->RenderTarget = RenderTarget;
+	Payload->BackgroundRenderTarget = BackgroundRenderTarget;
+	Payload->DynamicMeshRecord = CalcMeshRecordForComponents(CurrentOverlappingComponents);
 	
-	TArray<AActor*> OverlappingActors;
-	GetPyramidOverlappingActorsFiltered(OverlappingActors);
-	for (AActor* OverlappingActor : OverlappingActors)
 	{
-		Photo->AddCapturedActor(OverlappingActor, GetComponentTransform());
+		VF_SCOPED_STAGE(TakeSnapshot);
+		TArray<AActor*> OverlappingActors;
+		GetPyramidOverlappingActorsFiltered(OverlappingActors);
+		for (AActor* OverlappingActor : OverlappingActors)
+		{
+			Payload->AddCapturedActor(OverlappingActor, GetComponentTransform());
+		}
 	}
 
+	FVFPhotoInfo PhotoInfo;
+	PhotoInfo.PhotoId = FVFPhotoInfo::GeneratePhotoId();
+	PhotoInfo.Payload = Payload;
+
 	//还原组件变换
 	if (bShouldOverrideTakeTransform)
 	{
@@ -134,90 +209,72 @@ AVFPhoto* UVFPhotoTakerPlacerComponent::TakePhotoWithParamAssigned(const FVFAPho
 		SetRelativeRotation(FRotator());
 	}
 	
-	return Photo;
+	return PhotoInfo;
 }
 
-FVFPhotoPlaceRecord UVFPhotoTakerPlacerComponent::PlacePhoto(AVFPhoto* PhotoToPlace, float RotatedAngle)
+FVFPhotoPlaceRecord UVFPhotoTakerPlacerComponent::PlacePhoto(const FVFPhotoInfo& PhotoToPlace, float RotatedAngle)
 {
-	if (!PhotoToPlace) return FVFPhotoPlaceRecord();
+	if (!PhotoToPlace.IsValid()) return FVFPhotoPlaceRecord();
 
+	VF_SCOPED_STAGE(Place);
 	FVFPhotoPlaceRecord PhotoPlaceRecord;
 	PhotoPlaceRecord.PlaceTransformNoScale = GetComponentTransformNoScale();
 
-	const FVFPhotoInfo& PhotoInfo = PhotoToPlace->GetPhotoInfo();
+	//放置记录与照片共享同一份照片数据
+	const FVFPhotoInfo& PhotoInfo = PhotoToPlace;
 	PhotoPlaceRecord.PhotoInfo = PhotoInfo;
+	const FVFPhotoPayload& Payload = *PhotoInfo.Payload;
 	
 	ApplyRotatedAngleDelta(RotatedAngle);
 	PhotoPlaceRecord.PlaceRotatedAngle = RotatedAngle;
 
 	//存储地图中原有的与Pyramid重叠的组件
-	SetPyramidScale(PhotoInfo.PhotoTakeParams.CaptureFOVAngle, PhotoInfo.PhotoTakeParams.BackgroundDistance, PhotoInfo.PhotoTakeParams.GetAspectRatio());
+	SetPyramidScale(Payload.PhotoTakeParams.CaptureFOVAngle, Payload.PhotoTakeParams.BackgroundDistance, Payload.PhotoTakeParams.GetAspectRatio());
 	TArray<UPrimitiveComponent*> LevelOverlappingComponents;
 	GetPyramidOverlappingComponentsFiltered(LevelOverlappingComponents);
-	PhotoPlaceRecord.HiddenComponents.Append(LevelOverlappingComponents);
-	//对地图上原来存在的Actor进行切割，剔除与Pyramid重叠的部分
-	PhotoPlaceRecord.GeneratedComponents.Append(ProcessMeshBooleanToComponents(LevelOverlappingComponents, nullptr));
+	FVFPlacementBundle* Bundle = FVFPlacementBundle::GetActive();
+	if (Bundle)
+	{
+		Bundle->PhotoId = PhotoInfo.PhotoId;
+		Bundle->PhotoTakeParams = Payload.PhotoTakeParams;
+		Bundle->PlaceTransformNoScale = PhotoPlaceRecord.PlaceTransformNoScale;
+		Bundle->PlaceRotatedAngle = RotatedAngle;
+		if (Payload.DynamicMeshRecord)
+		{
+			Bundle->RecordMesh = Payload.DynamicMeshRecord->GetMeshRef();
+		}
+		Bundle->RecordTransform = GetComponentTransformNoScale();
+		Bundle->PyramidMesh = GetPyramidMesh();
+		Bundle->LevelPyramidTransform = GetComponentTransform();
+		CaptureBundleComponents(*Bundle, LevelOverlappingComponents, false);
+	}
+	//对地图上原来存在的Actor进行切割，剔除与Pyramid重叠的部分。只有被切割或被完全剔除的组件才会被隐藏。
+	PhotoPlaceRecord.InputMeshKey = CalcInputMeshKey(PhotoInfo.PhotoId, LevelOverlappingComponents);
+	if (RestoreCachedPlacement(PhotoPlaceRecord))
+	{
+		//缓存中的结果已经包含切割，提前计算的结果不再需要
+		CancelSpeculativePlace();
+		ApplyRotatedAngleDelta(-RotatedAngle);
+		return PhotoPlaceRecord;
+	}
+	//瞄准时已经提前计算了切割结果则直接应用
+	if (!CommitSpeculativePlace(PhotoPlaceRecord))
+	{
+		VF_SCOPED_STAGE(PlaceLevelCut);
+		PhotoPlaceRecord.GeneratedComponents.Append(ProcessMeshBooleanToComponents(LevelOverlappingComponents, PhotoPlaceRecord.HiddenComponents, PhotoPlaceRecord.RemovedInstances));
+	}
 
 	//生成照片中的Actors
-	SetPyramidScale(PhotoInfo.PhotoTakeParams.CaptureFOVAngle, PhotoInfo.PhotoTakeParams.MaxCaptureDistance, PhotoInfo.PhotoTakeParams.GetAspectRatio());
+	SetPyramidScale(Payload.PhotoTakeParams.CaptureFOVAngle, Payload.PhotoTakeParams.MaxCaptureDistance, Payload.PhotoTakeParams.GetAspectRatio());
 	TArray<AActor*> ActorSpawned;
-	for (const FVFActorRecord& ActorRecord : PhotoInfo.ActorRecords)
 	{
-		const FTransform& WorldTransform = UKismetMathLibrary::ComposeTransforms(ActorRecord.RelativeTransform, GetComponentTransform());
-		AActor* Actor = GetWorld()->SpawnActor(ActorRecord.Class, &WorldTransform);
-		if (Actor)
+		VF_SCOPED_STAGE(PlaceSpawnActors);
+		for (int32 ActorIndex = 0; ActorIndex < Payload.ActorSnapshots.Num(); ActorIndex++)
 		{
-			ActorSpawned.Emplace(Actor);
-
-			//场景中大多数的Actor都是StaticMeshActor
-			if (AStaticMeshActor* StaticMeshActor = Cast<AStaticMeshActor>(Actor))
-			{
-				UStaticMeshComponent* StaticMeshComponent = StaticMeshActor->GetStaticMeshComponent();
-				if (ActorRecord.NameToMeshMap.Contains(FString("StaticMeshComponent")))
-				{
-					EComponentMobility::Type PrevMobility = StaticMeshComponent->Mobility;
-					StaticMeshComponent->SetMobility(EComponentMobility::Movable);
-					StaticMeshComponent->SetStaticMesh(ActorRecord.NameToMeshMap[FString("StaticMeshComponent")]);
-					StaticMeshComponent->SetGenerateOverlapEvents(true);
-					StaticMeshComponent->SetMobility(PrevMobility);
-					StaticMeshComponent->UpdateOverlaps();
-				}
-			}
-			else
+			if (AActor* Actor = Payload.SpawnCapturedActor(GetWorld(), ActorIndex, GetComponentTransform()))
 			{
-				TArray<UStaticMeshComponent*> Components;
-				Actor->GetComponents<UStaticMeshComponent>(Components);
-				for (UStaticMeshComponent* StaticMeshComponent : Components)
-				{
-					EComponentMobility::Type PrevMobility = StaticMeshComponent->Mobility;
-					StaticMeshComponent->SetMobility(EComponentMobility::Movable);
-					StaticMeshComponent->SetStaticMesh(ActorRecord.NameToMeshMap[StaticMeshComponent->GetName()]);
-					StaticMeshComponent->SetGenerateOverlapEvents(true);
-					StaticMeshComponent->SetMobility(PrevMobility);
-					StaticMeshComponent->UpdateOverlaps();
-				}
-				/*for (FProperty* Property = Actor->GetClass()->PropertyLink; Property; Property = Property->PropertyLinkNext)
-				{
-					FString ClassName = Property->GetCPPType();
-					if (!ClassName.Contains(FString("StaticMeshComponent"))) continue;
-
-					FString PropertyName = Property->GetName();
-					FObjectProperty* ObjectProperty = CastField<FObjectProperty>(Property);
-					void* ValuePtr = Property->ContainerPtrToValuePtr<void>(Actor);
-					UObject* Value = ObjectProperty->GetPropertyValue(ValuePtr);
-					if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Value))
-					{
-						if (ActorRecord.NameToMeshMap.Contains(PropertyName))
-						{
-							EComponentMobility::Type PrevMobility = StaticMeshComponent->Mobility;
-							StaticMeshComponent->SetMobility(EComponentMobility::Movable);
-							StaticMeshComponent->SetStaticMesh(ActorRecord.NameToMeshMap[PropertyName]);
-							StaticMeshComponent->SetGenerateOverlapEvents(true);
-							StaticMeshComponent->SetMobility(PrevMobility);
-							StaticMeshComponent->UpdateOverlaps();
-						}
-					}
-				}*/
+				ActorSpawned.Emplace(Actor);
+				PhotoPlaceRecord.SpawnedActorTransforms.Emplace(Actor->GetActorTransform());
 			}
 		}
 	}
@@ -226,32 +283,41 @@ FVFPhotoPlaceRecord UVFPhotoTakerPlacerComponent::PlacePhoto(AVFPhoto* PhotoToPl
 	//存储生成Actor后与Pyramid重叠的组件，需要排除前面原有的组件
 	TArray<UPrimitiveComponent*> GeneratedOverlappingComponents;
 	GetPyramidOverlappingComponentsFiltered(GeneratedOverlappingComponents);
-	for (UPrimitiveComponent* GeneratedOverlappingComponent : GeneratedOverlappingComponents)
+	const TSet<AActor*> ActorSpawnedSet(ActorSpawned);
+	GeneratedOverlappingComponents.RemoveAll([&ActorSpawnedSet](const UPrimitiveComponent* GeneratedOverlappingComponent)
 	{
-		if (!ActorSpawned.Contains(GeneratedOverlappingComponent->GetOwner()))
-		{
-			GeneratedOverlappingComponents.Remove(GeneratedOverlappingComponent);
-		}
+		return !ActorSpawnedSet.Contains(GeneratedOverlappingComponent->GetOwner());
+	});
+	if (Bundle)
+	{
+		Bundle->GeneratedPyramidTransform = GetComponentTransform();
+		CaptureBundleComponents(*Bundle, GeneratedOverlappingComponents, true);
 	}
 	//PhotoPlaceRecord.HiddenComponents.Append(GeneratedOverlappingComponents);
 	//对生成的Actor已重叠的组件进行切割，保留与Pyramid重叠的部分。
-	//PhotoPlaceRecord.GeneratedComponents.Append(ProcessMeshBooleanToComponents(GeneratedOverlappingComponents, PhotoInfo.DynamicMeshRecord));
-	ProcessMeshBooleanToComponents(GeneratedOverlappingComponents, PhotoInfo.DynamicMeshRecord);
+	//PhotoPlaceRecord.GeneratedComponents.Append(ProcessMeshBooleanToComponents(GeneratedOverlappingComponents, Payload.DynamicMeshRecord));
+	{
+		VF_SCOPED_STAGE(PlaceGeneratedCut);
+		TArray<UPrimitiveComponent*> GeneratedHiddenComponents;
+		TArray<FVFRemovedInstances> GeneratedRemovedInstances;
+		ProcessMeshBooleanToComponents(GeneratedOverlappingComponents, GeneratedHiddenComponents, GeneratedRemovedInstances, Payload.DynamicMeshRecord);
+	}
 
 	//在远处生成一张背景照片
 	FTransform BackgroundTransform;
-	const float ScaleZ = PhotoInfo.PhotoTakeParams.BackgroundDistance / 100.f;
-	const float BaseScaleXY = ScaleZ * UKismetMathLibrary::DegTan(PhotoInfo.PhotoTakeParams.CaptureFOVAngle / 2.f);
+	const float ScaleZ = Payload.PhotoTakeParams.BackgroundDistance / 100.f;
+	const float BaseScaleXY = ScaleZ * UKismetMathLibrary::DegTan(Payload.PhotoTakeParams.CaptureFOVAngle / 2.f);
 	const float AspectRatio = GetCaptureAspectRatio();
-	BackgroundTransform.SetLocation(GetComponentLocation() + PhotoInfo.PhotoTakeParams.BackgroundDistance * GetForwardVector());
+	BackgroundTransform.SetLocation(GetComponentLocation() + Payload.PhotoTakeParams.BackgroundDistance * GetForwardVector());
 	BackgroundTransform.SetRotation(GetComponentQuat());
 	BackgroundTransform.SetScale3D(FVector(
 		ScaleZ,
 		BaseScaleXY * (AspectRatio > 1.f ? 1.f : AspectRatio),
 		BaseScaleXY * (AspectRatio < 1.f ? 1.f : 1.f / AspectRatio)));
 	
-	AVFPhoto* BackgroundPhoto = Cast<AVFPhoto>(GetWorld()->SpawnActor(PhotoInfo.PhotoTakeParams.PhotoClass, &BackgroundTransform));
-	BackgroundPhoto->SetRenderTarget(PhotoInfo.BackgroundRenderTarget);
+	AVFPhoto* BackgroundPhoto = Cast<AVFPhoto>(GetWorld()->GetSubsystem<UVFPoolSubsystem>()->AcquireActor(Payload.PhotoTakeParams.PhotoClass, BackgroundTransform));
+	BackgroundPhoto->SetRenderTarget(Payload.BackgroundRenderTarget);
+	BackgroundPhoto->Tags.AddUnique(FName("VFBackground"));
 	//背景图片的重叠需要启用
 	BackgroundPhoto->GetPhotoMesh()->SetCollisionProfileName(FName("OverlapAll"));
 	BackgroundPhoto->GetPhotoMesh()->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
@@ -267,6 +333,592 @@ FVFPhotoPlaceRecord UVFPhotoTakerPlacerComponent::PlacePhoto(AVFPhoto* PhotoToPl
 	return PhotoPlaceRecord;
 }
 
+void UVFPhotoTakerPlacerComponent::BeginSpeculativePlace(const FVFPhotoInfo& PhotoToPlace, float RotatedAngle)
+{
+	if (!PhotoToPlace.IsValid()) return;
+
+	//与PlacePhoto相同，变换在旋转之前记录
+	const FTransform PlaceTransformNoScale = GetComponentTransformNoScale();
+	if (SpeculativePlacement
+		&& SpeculativePlacement->PhotoId == PhotoToPlace.PhotoId
+		&& SpeculativePlacement->RotatedAngle == RotatedAngle
+		&& SpeculativePlacement->PlaceTransformNoScale.Equals(PlaceTransformNoScale))
+	{
+		return;
+	}
+	CancelSpeculativePlace();
+
+	const FVFPhotoPayload& Payload = *PhotoToPlace.Payload;
+	TSharedPtr<FVFSpeculativePlacement> Speculative = MakeShared<FVFSpeculativePlacement>();
+	Speculative->PhotoId = PhotoToPlace.PhotoId;
+	Speculative->PlaceTransformNoScale = PlaceTransformNoScale;
+	Speculative->RotatedAngle = RotatedAngle;
+
+	ApplyRotatedAngleDelta(RotatedAngle);
+	SetPyramidScale(Payload.PhotoTakeParams.CaptureFOVAngle, Payload.PhotoTakeParams.BackgroundDistance, Payload.PhotoTakeParams.GetAspectRatio());
+	TArray<UPrimitiveComponent*> LevelOverlappingComponents;
+	GetPyramidOverlappingComponentsFiltered(LevelOverlappingComponents);
+	Speculative->InputMeshKey = CalcInputMeshKey(PhotoToPlace.PhotoId, LevelOverlappingComponents);
+	Speculative->PyramidMesh = GetPyramidMesh();
+	Speculative->PyramidTransform = GetComponentTransform();
+	Speculative->PyramidVolume.BuildFromMesh(Speculative->PyramidMesh, Speculative->PyramidTransform);
+	ApplyRotatedAngleDelta(-RotatedAngle);
+
+	UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>();
+	for (UPrimitiveComponent* Component : LevelOverlappingComponents)
+	{
+		if (UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(Component))
+		{
+			Speculative->InstancedComponents.Emplace(InstancedComponent);
+			continue;
+		}
+
+		FDynamicMesh3 SourceMesh;
+		if (!CopyComponentMesh(Component, SourceMesh)) continue;
+
+		UStaticMesh* PatchSource = CutGeometrySubsystem->GetPatchSource(Component);
+		FDynamicMesh3& PatchSourceMesh = Speculative->PatchSourceMeshes.AddDefaulted_GetRef();
+		if (PatchSource && Component->ComponentHasTag(FName("VFGenerated")))
+		{
+			FVFScopedScratchMesh PatchSourceCopyScope(GetScratchMeshPool());
+			if (UVFCutGeometrySubsystem::CopyPatchSourceMesh(PatchSource, PatchSourceCopyScope.Get()))
+			{
+				PatchSourceMesh = PatchSourceCopyScope.Get()->GetMeshRef();
+			}
+			else
+			{
+				PatchSource = nullptr;
+			}
+		}
+
+		Speculative->Components.Emplace(Component);
+		Speculative->ComponentTransforms.Emplace(Component->GetComponentTransform());
+		Speculative->SourceMeshes.Emplace(MoveTemp(SourceMesh));
+		Speculative->PatchSources.Emplace(PatchSource);
+	}
+	Speculative->Outcomes.Init(EVFMeshCutOutcome::Unchanged, Speculative->Components.Num());
+	Speculative->CutMeshes.SetNum(Speculative->Components.Num());
+	Speculative->Patches.SetNum(Speculative->Components.Num());
+
+	Speculative->Future = Async(EAsyncExecution::ThreadPool, [Speculative]()
+	{
+		for (int32 i = 0; i < Speculative->SourceMeshes.Num(); i++)
+		{
+			if (Speculative->bCancelled) return;
+
+			Speculative->Outcomes[i] = FVFMeshCut::ApplyPlaceCut(
+				Speculative->SourceMeshes[i], Speculative->ComponentTransforms[i],
+				nullptr, FTransform(),
+				Speculative->PyramidMesh, Speculative->PyramidTransform, Speculative->PyramidVolume,
+				EVFMeshCutOperation::Subtract, Speculative->CutMeshes[i]);
+
+			//只比较弱引用是否为空，不在工作线程中解析它
+			if (Speculative->Outcomes[i] == EVFMeshCutOutcome::Cut && !Speculative->PatchSources[i].IsExplicitlyNull())
+			{
+				const FDynamicMesh3& PatchSourceMesh = Speculative->PatchSourceMeshes[i].TriangleCount() > 0 ? Speculative->PatchSourceMeshes[i] : Speculative->SourceMeshes[i];
+				Speculative->Patches[i] = MakeShared<FVFMeshPatch>();
+				Speculative->Patches[i]->SourceMesh = Speculative->PatchSources[i];
+				Speculative->Patches[i]->Build(PatchSourceMesh, Speculative->CutMeshes[i]);
+			}
+		}
+	});
+	SpeculativePlacement = Speculative;
+}
+
+void UVFPhotoTakerPlacerComponent::CancelSpeculativePlace()
+{
+	if (!SpeculativePlacement) return;
+
+	//工作线程持有自己的引用，不需要等待其结束
+	SpeculativePlacement->bCancelled = true;
+	SpeculativePlacement.Reset();
+}
+
+bool UVFPhotoTakerPlacerComponent::CommitSpeculativePlace(FVFPhotoPlaceRecord& PhotoPlaceRecord)
+{
+	VF_SCOPED_STAGE(PlaceSpeculativeCommit);
+	TSharedPtr<FVFSpeculativePlacement> Speculative = MoveTemp(SpeculativePlacement);
+	if (!Speculative) return false;
+
+	const bool bIsSamePlacement = Speculative->PhotoId == PhotoPlaceRecord.PhotoInfo.PhotoId
+		&& Speculative->RotatedAngle == PhotoPlaceRecord.PlaceRotatedAngle
+		&& Speculative->InputMeshKey == PhotoPlaceRecord.InputMeshKey
+		&& Speculative->PlaceTransformNoScale.Equals(PhotoPlaceRecord.PlaceTransformNoScale);
+	//计算仍未完成时丢弃它并同步计算，放置不能等待工作线程队列中的其它任务
+	if (!bIsSamePlacement || !Speculative->Future.IsReady())
+	{
+		Speculative->bCancelled = true;
+		return false;
+	}
+
+	for (const TWeakObjectPtr<UPrimitiveComponent>& Component : Speculative->Components)
+	{
+		if (!Component.IsValid()) return false;
+	}
+	TArray<UPrimitiveComponent*> InstancedComponents;
+	for (const TWeakObjectPtr<UInstancedStaticMeshComponent>& InstancedComponent : Speculative->InstancedComponents)
+	{
+		if (!InstancedComponent.IsValid()) return false;
+		InstancedComponents.Emplace(InstancedComponent.Get());
+	}
+
+	for (int32 i = 0; i < Speculative->Components.Num(); i++)
+	{
+		if (Speculative->Outcomes[i] != EVFMeshCutOutcome::Unchanged)
+		{
+			FVFStats::RecordCut(TEXT("PlaceLevelCut"), Speculative->Components[i].Get(), Speculative->SourceMeshes[i].TriangleCount(),
+				Speculative->Outcomes[i] == EVFMeshCutOutcome::Cut ? Speculative->CutMeshes[i].TriangleCount() : 0);
+		}
+		if (UPrimitiveComponent* GeneratedComponent = CommitComponentCut(Speculative->Components[i].Get(), Speculative->Outcomes[i], MoveTemp(Speculative->CutMeshes[i]), Speculative->Patches[i], PhotoPlaceRecord.HiddenComponents))
+		{
+			PhotoPlaceRecord.GeneratedComponents.Emplace(GeneratedComponent);
+		}
+	}
+	if (InstancedComponents.Num())
+	{
+		PhotoPlaceRecord.GeneratedComponents.Append(ProcessMeshBooleanToComponents(InstancedComponents, PhotoPlaceRecord.HiddenComponents, PhotoPlaceRecord.RemovedInstances));
+	}
+	return true;
+}
+
+bool UVFPhotoTakerPlacerComponent::RequestPlacePreview(const FVFPhotoInfo& PhotoToPlace, float RotatedAngle, int32 MaxTrianglesPerMesh, int32 MaxComponents)
+{
+	//同一时间只进行一次预览计算，预览的开销不会影响放置
+	if (!PhotoToPlace.IsValid() || PlacePreview) return false;
+
+	const FVFPhotoPayload& Payload = *PhotoToPlace.Payload;
+	TSharedPtr<FVFPlacePreview> Preview = MakeShared<FVFPlacePreview>();
+	Preview->MaxTrianglesPerMesh = MaxTrianglesPerMesh;
+
+	ApplyRotatedAngleDelta(RotatedAngle);
+	SetPyramidScale(Payload.PhotoTakeParams.CaptureFOVAngle, Payload.PhotoTakeParams.BackgroundDistance, Payload.PhotoTakeParams.GetAspectRatio());
+	TArray<UPrimitiveComponent*> LevelOverlappingComponents;
+	GetPyramidOverlappingComponentsFiltered(LevelOverlappingComponents);
+	Preview->PyramidMesh = GetPyramidMesh();
+	Preview->PyramidTransform = GetComponentTransform();
+	Preview->PyramidVolume.BuildFromMesh(Preview->PyramidMesh, Preview->PyramidTransform);
+	if (Payload.DynamicMeshRecord)
+	{
+		Preview->RecordMesh = Payload.DynamicMeshRecord->GetMeshRef();
+	}
+	Preview->RecordTransform = GetComponentTransformNoScale();
+	ApplyRotatedAngleDelta(-RotatedAngle);
+
+	for (UPrimitiveComponent* Component : LevelOverlappingComponents)
+	{
+		if (Preview->SourceMeshes.Num() >= MaxComponents) break;
+
+		FDynamicMesh3 SourceMesh;
+		if (!CopyComponentMesh(Component, SourceMesh)) continue;
+		Preview->SourceMeshes.Emplace(MoveTemp(SourceMesh));
+		Preview->SourceTransforms.Emplace(Component->GetComponentTransform());
+	}
+
+	Preview->Future = Async(EAsyncExecution::ThreadPool, [Preview]()
+	{
+		auto Simplify = [&Preview](FDynamicMesh3& Mesh)
+		{
+			if (Mesh.TriangleCount() > Preview->MaxTrianglesPerMesh)
+			{
+				FQEMSimplification Simplifier(&Mesh);
+				Simplifier.SimplifyToTriangleCount(Preview->MaxTrianglesPerMesh);
+			}
+		};
+		Preview->ResultMesh.EnableAttributes();
+		FDynamicMeshEditor Editor(&Preview->ResultMesh);
+		auto Append = [&Editor](const FDynamicMesh3& Mesh, const FTransform& Transform)
+		{
+			//法线按缩放的逆转置变换并重新归一化，非均匀缩放时只旋转会得到错误的方向
+			const FTransformSRT3d MeshTransform(Transform);
+			FMeshIndexMappings Mappings;
+			Editor.AppendMesh(&Mesh, Mappings,
+				[&MeshTransform](int32, const FVector3d& Position) { return MeshTransform.TransformPosition(Position); },
+				[&MeshTransform](int32, const FVector3d& Normal) { return MeshTransform.TransformNormal(Normal); });
+		};
+
+		//与Pyramid相交的部分就是放置时将被切除的部分
+		for (int32 i = 0; i < Preview->SourceMeshes.Num(); i++)
+		{
+			if (Preview->bCancelled) return;
+
+			Simplify(Preview->SourceMeshes[i]);
+			FDynamicMesh3 CutMesh;
+			const EVFMeshCutOutcome Outcome = FVFMeshCut::ApplyPlaceCut(
+				Preview->SourceMeshes[i], Preview->SourceTransforms[i],
+				nullptr, FTransform(),
+				Preview->PyramidMesh, Preview->PyramidTransform, Preview->PyramidVolume,
+				EVFMeshCutOperation::Intersect, CutMesh);
+			if (Outcome == EVFMeshCutOutcome::Unchanged)
+			{
+				Append(Preview->SourceMeshes[i], Preview->SourceTransforms[i]);
+			}
+			else if (Outcome == EVFMeshCutOutcome::Cut)
+			{
+				Append(CutMesh, Preview->SourceTransforms[i]);
+			}
+		}
+
+		//照片没有网格体记录时只预览被切除的部分
+		if (Preview->bCancelled || Preview->RecordMesh.TriangleCount() == 0) return;
+		Simplify(Preview->RecordMesh);
+		Append(Preview->RecordMesh, Preview->RecordTransform);
+	});
+	PlacePreview = Preview;
+	return true;
+}
+
+bool UVFPhotoTakerPlacerComponent::FetchPlacePreview(FDynamicMesh3& OutMesh)
+{
+	if (!PlacePreview || !PlacePreview->Future.IsReady()) return false;
+
+	OutMesh = MoveTemp(PlacePreview->ResultMesh);
+	PlacePreview.Reset();
+	return true;
+}
+
+void UVFPhotoTakerPlacerComponent::CancelPlacePreview()
+{
+	if (!PlacePreview) return;
+
+	PlacePreview->bCancelled = true;
+	PlacePreview.Reset();
+}
+
+void UVFPhotoTakerPlacerComponent::CaptureBundleComponents(FVFPlacementBundle& Bundle, const TArray<UPrimitiveComponent*>& Components, bool bIsGenerated)
+{
+	for (UPrimitiveComponent* Component : Components)
+	{
+		const FString ComponentName = Component->GetPathName(GetWorld());
+		if (UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(Component))
+		{
+			//与ProcessInstancedMeshBoolean相同，相减时只记录与Pyramid包围盒重叠的实例
+			TArray<int32> InstanceIndices;
+			if (bIsGenerated)
+			{
+				for (int32 InstanceIndex = 0; InstanceIndex < InstancedComponent->GetInstanceCount(); InstanceIndex++)
+				{
+					InstanceIndices.Emplace(InstanceIndex);
+				}
+			}
+			else
+			{
+				InstanceIndices = InstancedComponent->GetInstancesOverlappingBox(Bounds.GetBox(), true);
+			}
+			if (InstanceIndices.IsEmpty()) continue;
+
+			FVFScopedScratchMesh StaticMeshCopyScope(GetScratchMeshPool());
+			TEnumAsByte<EGeometryScriptOutcomePins> Pins;
+			UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
+				InstancedComponent->GetStaticMesh(),
+				StaticMeshCopyScope.Get(),
+				FGeometryScriptCopyMeshFromAssetOptions(),
+				FGeometryScriptMeshReadLOD(),
+				Pins);
+			for (int32 InstanceIndex : InstanceIndices)
+			{
+				FTransform InstanceTransform;
+				if (!InstancedComponent->GetInstanceTransform(InstanceIndex, InstanceTransform, true)) continue;
+				Bundle.AddComponent(FString::Printf(TEXT("%s[%d]"), *ComponentName, InstanceIndex), bIsGenerated, InstanceTransform,
+					InstancedComponent->GetStaticMesh(), StaticMeshCopyScope.Get()->GetMeshRef());
+			}
+			continue;
+		}
+
+		FDynamicMesh3 Mesh;
+		if (!CopyComponentMesh(Component, Mesh)) continue;
+
+		//静态网格体资源被多个组件共享，动态网格体每个组件各不相同
+		const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component);
+		Bundle.AddComponent(ComponentName, bIsGenerated, Component->GetComponentTransform(),
+			StaticMeshComponent ? StaticMeshComponent->GetStaticMesh() : nullptr, Mesh);
+	}
+}
+
+bool UVFPhotoTakerPlacerComponent::CopyComponentMesh(UPrimitiveComponent* Component, FDynamicMesh3& OutMesh)
+{
+	if (Component->IsA<UInstancedStaticMeshComponent>()) return false;
+	if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+	{
+		FVFScopedScratchMesh StaticMeshCopyScope(GetScratchMeshPool());
+		TEnumAsByte<EGeometryScriptOutcomePins> Pins;
+		UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
+			StaticMeshComponent->GetStaticMesh(),
+			StaticMeshCopyScope.Get(),
+			FGeometryScriptCopyMeshFromAssetOptions(),
+			FGeometryScriptMeshReadLOD(),
+			Pins);
+		OutMesh = StaticMeshCopyScope.Get()->GetMeshRef();
+		return true;
+	}
+	if (UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+	{
+		OutMesh = DynamicMeshComponent->GetDynamicMesh()->GetMeshRef();
+		return true;
+	}
+	return false;
+}
+
+void UVFPhotoTakerPlacerComponent::UndoPlacePhoto(const FVFPhotoPlaceRecord& PhotoPlaceRecord)
+{
+	VF_SCOPED_STAGE(PlaceUndo);
+	UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>();
+	for (UPrimitiveComponent* HiddenComponent : PhotoPlaceRecord.HiddenComponents)
+	{
+		CutGeometrySubsystem->RestorePatchedMesh(HiddenComponent);
+		HiddenComponent->SetVisibility(true);
+		HiddenComponent->SetGenerateOverlapEvents(true);
+		HiddenComponent->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+		HiddenComponent->ComponentTags.Remove(FName("VFHidden"));
+	}
+	for (const FVFRemovedInstances& RemovedInstances : PhotoPlaceRecord.RemovedInstances)
+	{
+		if (IsValid(RemovedInstances.Component))
+		{
+			RemovedInstances.Component->AddInstances(RemovedInstances.InstanceTransforms, false, true);
+			CutGeometrySubsystem->TouchContent(RemovedInstances.Component);
+		}
+	}
+
+	//生成的组件如果模拟了物理，恢复时无法还原到生成时的状态，不进行缓存
+	//重新添加的实例索引与放置时不同，移除过实例的放置也不进行缓存
+	const bool bCanBeCached = MaxCachedPlacements > 0 && PhotoPlaceRecord.RemovedInstances.IsEmpty() && !PhotoPlaceRecord.GeneratedComponents.ContainsByPredicate([](const UPrimitiveComponent* GeneratedComponent)
+	{
+		return !IsValid(GeneratedComponent) || GeneratedComponent->IsSimulatingPhysics();
+	});
+	if (!bCanBeCached)
+	{
+		ReleasePlacementResults(PhotoPlaceRecord);
+		return;
+	}
+
+	FVFPlaceCacheEntry& Entry = PlaceCache.AddDefaulted_GetRef();
+	Entry.PhotoPlaceRecord = PhotoPlaceRecord;
+	for (UPrimitiveComponent* GeneratedComponent : PhotoPlaceRecord.GeneratedComponents)
+	{
+		Entry.GeneratedCollisionEnabled.Emplace(GeneratedComponent->GetCollisionEnabled());
+		GeneratedComponent->SetVisibility(false);
+		GeneratedComponent->SetGenerateOverlapEvents(false);
+		GeneratedComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		CutGeometrySubsystem->ReleasePatchedMesh(GeneratedComponent);
+	}
+	for (AActor* SpawnedActor : PhotoPlaceRecord.SpawnedActors)
+	{
+		if (!IsValid(SpawnedActor)) continue;
+
+		TInlineComponentArray<UPrimitiveComponent*> PrimitiveComponents(SpawnedActor);
+		for (UPrimitiveComponent* PrimitiveComponent : PrimitiveComponents)
+		{
+			if (PrimitiveComponent->IsSimulatingPhysics())
+			{
+				PrimitiveComponent->SetSimulatePhysics(false);
+				Entry.PhysicsComponents.Emplace(PrimitiveComponent);
+			}
+		}
+		SpawnedActor->SetActorHiddenInGame(true);
+		SpawnedActor->SetActorEnableCollision(false);
+	}
+	if (PhotoPlaceRecord.BackgroundPhoto)
+	{
+		PhotoPlaceRecord.BackgroundPhoto->SetActorHiddenInGame(true);
+		PhotoPlaceRecord.BackgroundPhoto->SetActorEnableCollision(false);
+	}
+
+	//超出数量时丢弃最早被撤销的放置
+	while (PlaceCache.Num() > MaxCachedPlacements)
+	{
+		ReleasePlacementResults(PlaceCache[0].PhotoPlaceRecord);
+		PlaceCache.RemoveAt(0);
+	}
+}
+
+void UVFPhotoTakerPlacerComponent::ResetPlaceCache()
+{
+	CancelSpeculativePlace();
+	CancelPlacePreview();
+	for (const FVFPlaceCacheEntry& Entry : PlaceCache)
+	{
+		ReleasePlacementResults(Entry.PhotoPlaceRecord);
+	}
+	PlaceCache.Reset();
+}
+
+void UVFPhotoTakerPlacerComponent::CollectMemoryReport(FVFMemoryReport& Report) const
+{
+	for (const FVFPlaceCacheEntry& Entry : PlaceCache)
+	{
+		const FVFPhotoPlaceRecord& CachedRecord = Entry.PhotoPlaceRecord;
+		Report.AddEntry(FString::Printf(TEXT("Cached placement %llu"), CachedRecord.PhotoInfo.PhotoId), Report.AddPlaceRecord(CachedRecord));
+	}
+}
+
+void UVFPhotoTakerPlacerComponent::ReplaceComponentReferences(UPrimitiveComponent* OldComponent, UPrimitiveComponent* NewComponent)
+{
+	for (FVFPlaceCacheEntry& Entry : PlaceCache)
+	{
+		for (UPrimitiveComponent*& GeneratedComponent : Entry.PhotoPlaceRecord.GeneratedComponents)
+		{
+			if (GeneratedComponent == OldComponent) GeneratedComponent = NewComponent;
+		}
+		for (UPrimitiveComponent*& HiddenComponent : Entry.PhotoPlaceRecord.HiddenComponents)
+		{
+			if (HiddenComponent == OldComponent) HiddenComponent = NewComponent;
+		}
+		for (TObjectPtr<UPrimitiveComponent>& PhysicsComponent : Entry.PhysicsComponents)
+		{
+			if (PhysicsComponent == OldComponent) PhysicsComponent = NewComponent;
+		}
+	}
+
+	//旧组件被归还到对象池后仍然有效，提前计算的结果不能再应用到它上面
+	if (SpeculativePlacement && SpeculativePlacement->Components.Contains(OldComponent))
+	{
+		CancelSpeculativePlace();
+	}
+}
+
+FVFInputMeshKey UVFPhotoTakerPlacerComponent::CalcInputMeshKey(uint64 PhotoId, const TArray<UPrimitiveComponent*>& Components) const
+{
+	FVFInputMeshKey Key;
+	Key.Hash = CityHash64WithSeed(reinterpret_cast<const char*>(&PhotoId), sizeof(PhotoId), 0);
+	Key.NumComponents = Components.Num();
+	auto HashBytes = [&Key](const void* Data, int64 Size)
+	{
+		Key.Hash = CityHash64WithSeed(static_cast<const char*>(Data), static_cast<uint32>(Size), Key.Hash);
+	};
+
+	//被修改过的组件以内容标记区分，烘焙替换组件后标记不变，因此先按标记排序。其余组件按唯一ID排序，与重叠查询返回的顺序无关
+	const UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>();
+	TArray<TPair<uint64, const UPrimitiveComponent*>> SortedComponents;
+	for (const UPrimitiveComponent* Component : Components)
+	{
+		SortedComponents.Emplace(CutGeometrySubsystem->GetContentStamp(Component), Component);
+	}
+	SortedComponents.Sort([](const TPair<uint64, const UPrimitiveComponent*>& A, const TPair<uint64, const UPrimitiveComponent*>& B)
+	{
+		return A.Key != B.Key ? A.Key < B.Key : A.Value->GetUniqueID() < B.Value->GetUniqueID();
+	});
+	for (const TPair<uint64, const UPrimitiveComponent*>& SortedComponent : SortedComponents)
+	{
+		const uint64 ContentStamp = SortedComponent.Key;
+		const UPrimitiveComponent* Component = SortedComponent.Value;
+		HashBytes(&ContentStamp, sizeof(ContentStamp));
+
+		//地图中没有被修改过的组件，网格体资源在运行时不会改变，组件与资源本身足以区分
+		if (ContentStamp == 0)
+		{
+			const uint32 UniqueId = Component->GetUniqueID();
+			HashBytes(&UniqueId, sizeof(UniqueId));
+			const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component);
+			const UStaticMesh* StaticMesh = StaticMeshComponent ? StaticMeshComponent->GetStaticMesh() : nullptr;
+			HashBytes(&StaticMesh, sizeof(StaticMesh));
+		}
+
+		const FTransform& Transform = Component->GetComponentTransform();
+		const FVector Location = Transform.GetLocation();
+		const FQuat Rotation = Transform.GetRotation();
+		const FVector Scale = Transform.GetScale3D();
+		const double TransformValues[] = {Location.X, Location.Y, Location.Z, Rotation.X, Rotation.Y, Rotation.Z, Rotation.W, Scale.X, Scale.Y, Scale.Z};
+		HashBytes(TransformValues, sizeof(TransformValues));
+	}
+	return Key;
+}
+
+bool UVFPhotoTakerPlacerComponent::RestoreCachedPlacement(FVFPhotoPlaceRecord& PhotoPlaceRecord)
+{
+	VF_SCOPED_STAGE(PlaceCacheRestore);
+	const int32 Index = PlaceCache.IndexOfByPredicate([this, &PhotoPlaceRecord](const FVFPlaceCacheEntry& Entry)
+	{
+		const FVFPhotoPlaceRecord& CachedRecord = Entry.PhotoPlaceRecord;
+		return CachedRecord.PhotoInfo == PhotoPlaceRecord.PhotoInfo
+			&& CachedRecord.InputMeshKey == PhotoPlaceRecord.InputMeshKey
+			&& FMath::IsNearlyEqual(CachedRecord.PlaceRotatedAngle, PhotoPlaceRecord.PlaceRotatedAngle)
+			&& CachedRecord.PlaceTransformNoScale.Equals(PhotoPlaceRecord.PlaceTransformNoScale, PlaceCacheTolerance);
+	});
+	if (Index == INDEX_NONE) return false;
+
+	FVFPlaceCacheEntry Entry = MoveTemp(PlaceCache[Index]);
+	PlaceCache.RemoveAt(Index);
+	FVFPhotoPlaceRecord& CachedRecord = Entry.PhotoPlaceRecord;
+
+	//缓存期间组件或Actor可能已经被销毁
+	const bool bIsValid = IsValid(CachedRecord.BackgroundPhoto)
+		&& !CachedRecord.HiddenComponents.ContainsByPredicate([](const UPrimitiveComponent* Component) { return !IsValid(Component); })
+		&& !CachedRecord.GeneratedComponents.ContainsByPredicate([](const UPrimitiveComponent* Component) { return !IsValid(Component); })
+		&& !CachedRecord.SpawnedActors.ContainsByPredicate([](const AActor* Actor) { return !IsValid(Actor); });
+	if (!bIsValid)
+	{
+		ReleasePlacementResults(CachedRecord);
+		return false;
+	}
+
+	UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>();
+	for (UPrimitiveComponent* HiddenComponent : CachedRecord.HiddenComponents)
+	{
+		HiddenComponent->SetVisibility(false);
+		HiddenComponent->SetGenerateOverlapEvents(false);
+		HiddenComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		HiddenComponent->ComponentTags.AddUnique(FName("VFHidden"));
+		CutGeometrySubsystem->ReleasePatchedMesh(HiddenComponent);
+	}
+	for (int32 i = 0; i < CachedRecord.GeneratedComponents.Num(); i++)
+	{
+		UPrimitiveComponent* GeneratedComponent = CachedRecord.GeneratedComponents[i];
+		CutGeometrySubsystem->RestorePatchedMesh(GeneratedComponent);
+		GeneratedComponent->SetVisibility(true);
+		GeneratedComponent->SetGenerateOverlapEvents(true);
+		GeneratedComponent->SetCollisionEnabled(Entry.GeneratedCollisionEnabled[i]);
+	}
+	for (int32 i = 0; i < CachedRecord.SpawnedActors.Num(); i++)
+	{
+		AActor* SpawnedActor = CachedRecord.SpawnedActors[i];
+		SpawnedActor->SetActorTransform(CachedRecord.SpawnedActorTransforms[i], false, nullptr, ETeleportType::ResetPhysics);
+		SpawnedActor->SetActorHiddenInGame(false);
+		SpawnedActor->SetActorEnableCollision(true);
+	}
+	for (UPrimitiveComponent* PhysicsComponent : Entry.PhysicsComponents)
+	{
+		if (IsValid(PhysicsComponent))
+		{
+			PhysicsComponent->SetSimulatePhysics(true);
+		}
+	}
+	CachedRecord.BackgroundPhoto->SetActorHiddenInGame(false);
+	CachedRecord.BackgroundPhoto->SetActorEnableCollision(true);
+
+	PhotoPlaceRecord = MoveTemp(CachedRecord);
+	return true;
+}
+
+void UVFPhotoTakerPlacerComponent::ReleasePlacementResults(const FVFPhotoPlaceRecord& PhotoPlaceRecord)
+{
+	UVFPoolSubsystem* PoolSubsystem = GetWorld()->GetSubsystem<UVFPoolSubsystem>();
+	UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>();
+	for (UPrimitiveComponent* GeneratedComponent : PhotoPlaceRecord.GeneratedComponents)
+	{
+		CutGeometrySubsystem->SetMeshPatch(GeneratedComponent, nullptr);
+		PoolSubsystem->ReleaseComponent(GeneratedComponent);
+	}
+
+	for (AActor* SpawnedActor : PhotoPlaceRecord.SpawnedActors)
+	{
+		if (IsValid(SpawnedActor))
+		{
+			//照片中的Actor被切割生成的组件随Actor一起销毁
+			TInlineComponentArray<UPrimitiveComponent*> PrimitiveComponents(SpawnedActor);
+			for (UPrimitiveComponent* PrimitiveComponent : PrimitiveComponents)
+			{
+				CutGeometrySubsystem->SetMeshPatch(PrimitiveComponent, nullptr);
+			}
+			SpawnedActor->Destroy();
+		}
+	}
+
+	if (PhotoPlaceRecord.BackgroundPhoto)
+	{
+		PoolSubsystem->ReleaseActor(PhotoPlaceRecord.BackgroundPhoto);
+	}
+}
+
 void UVFPhotoTakerPlacerComponent::SetPyramidScale(float InFOVAngle, float InMaxDistance, float AspectRatio)
 {
 	const float ScaleZ = InMaxDistance / 100.f;
@@ -324,12 +976,45 @@ void UVFPhotoTakerPlacerComponent::GetPyramidOverlappingComponentsFiltered(TArra
 
 UDynamicMesh* UVFPhotoTakerPlacerComponent::CalcMeshRecordForComponents(TArray<UPrimitiveComponent*>& Components)
 {
+	VF_SCOPED_STAGE(TakeMeshRecord);
+
+	//只有作为照片记录的结果需要长期保留
 	UDynamicMesh* DynamicMesh = NewObject<UDynamicMesh>(this);
-	UDynamicMesh* TempDynamicMesh = NewObject<UDynamicMesh>(this);
+	FVFScopedScratchMesh TempDynamicMeshScope(GetScratchMeshPool());
+	UDynamicMesh* TempDynamicMesh = TempDynamicMeshScope.Get();
 	
 	for (UPrimitiveComponent* Component : Components)
 	{
-		if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+		if (UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(Component))
+		{
+			//只记录与Pyramid包围盒重叠的实例，每个实例以自身的变换合并
+			const TArray<int32> InstanceIndices = InstancedComponent->GetInstancesOverlappingBox(Bounds.GetBox(), true);
+			if (InstanceIndices.IsEmpty()) continue;
+
+			TEnumAsByte<EGeometryScriptOutcomePins> Pins;
+			UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
+				InstancedComponent->GetStaticMesh(),
+				TempDynamicMesh,
+				FGeometryScriptCopyMeshFromAssetOptions(),
+				FGeometryScriptMeshReadLOD(),
+				Pins);
+
+			for (int32 InstanceIndex : InstanceIndices)
+			{
+				FTransform InstanceTransform;
+				if (!InstancedComponent->GetInstanceTransform(InstanceIndex, InstanceTransform, true)) continue;
+
+				UGeometryScriptLibrary_MeshBooleanFunctions::ApplyMeshBoolean(
+					DynamicMesh,
+					FTransform(),
+					TempDynamicMesh,
+					GetComponentTransformNoScale().GetRelativeTransform(InstanceTransform).Inverse(),
+					EGeometryScriptBooleanOperation::Union,
+					FGeometryScriptMeshBooleanOptions());
+				FVFStats::RecordBoolean();
+			}
+		}
+		else if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
 		{
 			TEnumAsByte<EGeometryScriptOutcomePins> Pins;
 			UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
@@ -347,6 +1032,7 @@ UDynamicMesh* UVFPhotoTakerPlacerComponent::CalcMeshRecordForComponents(TArray<U
 				GetComponentTransformNoScale().GetRelativeTransform(StaticMeshComponent->GetComponentTransform()).Inverse(),
 				EGeometryScriptBooleanOperation::Union,
 				FGeometryScriptMeshBooleanOptions());
+			FVFStats::RecordBoolean();
 		}
 		else if (UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
 		{
@@ -357,147 +1043,306 @@ UDynamicMesh* UVFPhotoTakerPlacerComponent::CalcMeshRecordForComponents(TArray<U
 				GetComponentTransformNoScale().GetRelativeTransform(DynamicMeshComponent->GetComponentTransform()).Inverse(),
 				EGeometryScriptBooleanOperation::Union,
 				FGeometryScriptMeshBooleanOptions());
+			FVFStats::RecordBoolean();
 		}
 	}
 
 	return DynamicMesh;
 }
 
-TArray<UPrimitiveComponent*> UVFPhotoTakerPlacerComponent::ProcessMeshBooleanToComponents(const TArray<UPrimitiveComponent*>& Components, UDynamicMesh* DynamicMeshRecord)
+TArray<UPrimitiveComponent*> UVFPhotoTakerPlacerComponent::ProcessMeshBooleanToComponents(const TArray<UPrimitiveComponent*>& Components, TArray<UPrimitiveComponent*>& OutHiddenComponents, TArray<FVFRemovedInstances>& OutRemovedInstances, UDynamicMesh* DynamicMeshRecord)
 {
 	TArray<UPrimitiveComponent*> GeneratedComponents;
 	
 	//以DynamicMeshRecord是否有效传入为依据，判断是处理地图中的组件还是生成的组件
 	bool bAreComponentsGenerated = DynamicMeshRecord != nullptr;
+	const TCHAR* StageName = bAreComponentsGenerated ? TEXT("PlaceGeneratedCut") : TEXT("PlaceLevelCut");
+	const EVFMeshCutOperation PyramidOperation = bAreComponentsGenerated ? EVFMeshCutOperation::Intersect : EVFMeshCutOperation::Subtract;
 	
-	//为Pyramid生成动态网格体组件，用于模型运算。
-	UDynamicMeshComponent* PyramidDynamicMesh = NewObject<UDynamicMeshComponent>(this);
-	if (PyramidDynamicMesh)
-	{
-		TEnumAsByte<EGeometryScriptOutcomePins> Pins;
-		UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
-			GetStaticMesh(),
-			PyramidDynamicMesh->GetDynamicMesh(),
-			FGeometryScriptCopyMeshFromAssetOptions(),
-			FGeometryScriptMeshReadLOD(),
-			Pins);
-	}
+	//Pyramid的动态网格体，用于模型运算。
+	const FDynamicMesh3& PyramidMesh = GetPyramidMesh();
+
+	//Pyramid是凸的，大部分组件可以在boolean之前就确定切割结果
+	FVFConvexVolume PyramidVolume;
+	PyramidVolume.BuildFromMesh(PyramidMesh, GetComponentTransform());
 
-	UDynamicMesh* PrevMesh = NewObject<UDynamicMesh>(this);
+	FVFScopedScratchMesh StaticMeshCopyScope(GetScratchMeshPool());
+	UDynamicMesh* StaticMeshCopy = StaticMeshCopyScope.Get();
+	UVFCutGeometrySubsystem* CutGeometrySubsystem = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>();
 
 	for (UPrimitiveComponent* Component : Components)
 	{
-		const FCollisionResponseContainer& CollisionResponseContainer = Component->GetCollisionResponseToChannels();
-		const ECollisionEnabled::Type CollisionEnabled = Component->GetCollisionEnabled();
-		const bool bPhysicsEnabled = Component->IsSimulatingPhysics();
-		
-		//隐藏地图中原有的模型
-		Component->SetVisibility(false);
-		Component->SetGenerateOverlapEvents(false);
-		//Component->SetSimulatePhysics(false);
-		Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-
-		UDynamicMesh* TargetMesh = NewObject<UDynamicMesh>(this);
+		//实例化组件作为一个整体隐藏并重建会生成巨大的动态网格体，需要逐实例处理
+		if (UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(Component))
+		{
+			GeneratedComponents.Append(ProcessInstancedMeshBoolean(
+				InstancedComponent, StaticMeshCopy,
+				bAreComponentsGenerated ? &DynamicMeshRecord->GetMeshRef() : nullptr,
+				PyramidVolume, PyramidOperation, OutRemovedInstances));
+			continue;
+		}
 
+		const FDynamicMesh3* SourceMesh = nullptr;
 		if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
 		{
 			TEnumAsByte<EGeometryScriptOutcomePins> Pins;
 			UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
 				StaticMeshComponent->GetStaticMesh(),
-				PrevMesh,
+				StaticMeshCopy,
 				FGeometryScriptCopyMeshFromAssetOptions(),
 				FGeometryScriptMeshReadLOD(),
 				Pins);
+			SourceMesh = &StaticMeshCopy->GetMeshRef();
 		}
 		else if (UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
 		{
-			UGeometryScriptLibrary_MeshDecompositionFunctions::CopyMeshToMesh(
-				DynamicMeshComponent->GetDynamicMesh(),
-				PrevMesh,
-				PrevMesh);
+			//动态网格体不需要复制，boolean只会读取它
+			SourceMesh = &DynamicMeshComponent->GetDynamicMesh()->GetMeshRef();
 		}
+		if (!SourceMesh) continue;
 
-		UGeometryScriptLibrary_MeshDecompositionFunctions::CopyMeshToMesh(
-				PrevMesh,
-				TargetMesh,
-				TargetMesh);
-		
-		//如果是放置照片的生成Actor阶段，则需要与照片中存储的动态网格体进行一次相交
-		if (bAreComponentsGenerated)
+		FDynamicMesh3 CutMesh;
+		const EVFMeshCutOutcome Outcome = FVFMeshCut::ApplyPlaceCut(
+			*SourceMesh, Component->GetComponentTransform(),
+			bAreComponentsGenerated ? &DynamicMeshRecord->GetMeshRef() : nullptr, GetComponentTransformNoScale(),
+			PyramidMesh, GetComponentTransform(), PyramidVolume,
+			PyramidOperation, CutMesh);
+		if (Outcome != EVFMeshCutOutcome::Unchanged)
 		{
-			UGeometryScriptLibrary_MeshBooleanFunctions::ApplyMeshBoolean(
-			TargetMesh,
-			Component->GetComponentTransform(),
-			DynamicMeshRecord,
-			GetComponentTransformNoScale(),
-			EGeometryScriptBooleanOperation::Intersection,
-			FGeometryScriptMeshBooleanOptions());
-		}
-			
-		//与视口Pyramid进行相交/相减
-		UGeometryScriptLibrary_MeshBooleanFunctions::ApplyMeshBoolean(
-			TargetMesh,
-			Component->GetComponentTransform(),
-			PyramidDynamicMesh->GetDynamicMesh(),
-			GetComponentTransform(),
-			bAreComponentsGenerated ? EGeometryScriptBooleanOperation::Intersection : EGeometryScriptBooleanOperation::Subtract,
-			FGeometryScriptMeshBooleanOptions());
-
-		bool bIsSameMesh;
-		UGeometryScriptLibrary_MeshComparisonFunctions::IsSameMeshAs(PrevMesh, TargetMesh, FGeometryScriptIsSameMeshOptions(), bIsSameMesh);
-		//只有在模型进行boolean操作的过程中完全消除，即三角面为0时，此时不需要创建动态网格体
-		if (bIsSameMesh) continue;
-
-		//之所以不直接对DynamicMeshComponent进行操作，而是也要生成新的动态网格体，是考虑到时间回溯。
-		UDynamicMeshComponent* NewDynamicMeshComponent = Cast<UDynamicMeshComponent>(Component->GetOwner()->AddComponentByClass(UDynamicMeshComponent::StaticClass(), true, FTransform(), false));
-		if (NewDynamicMeshComponent)
-		{
-			GeneratedComponents.Emplace(NewDynamicMeshComponent);
-			
-			NewDynamicMeshComponent->RegisterComponent();
-			NewDynamicMeshComponent->SetWorldTransform(Component->GetComponentTransform());
-			NewDynamicMeshComponent->SetDynamicMesh(TargetMesh);
-			
-			/**
-			 * 一般情况下，需要模拟物理的Actor通常只有根组件。
-			 * 如果根组件开启了模拟物理，则新的动态网格体需要代替根组件进行模拟物理，所以需要将根组件设置为动态网格体。
-			 */
-			/*if (bPhysicsEnabled && Component == Component->GetOwner()->GetRootComponent())
+			FVFStats::RecordCut(StageName, Component, SourceMesh->TriangleCount(), Outcome == EVFMeshCutOutcome::Cut ? CutMesh.TriangleCount() : 0);
+		}
+
+		//切割结果以相对于来源网格体资源的补丁记录，切割生成的组件需要另外复制来源
+		TSharedPtr<FVFMeshPatch> Patch;
+		UStaticMesh* PatchSource = Outcome == EVFMeshCutOutcome::Cut ? CutGeometrySubsystem->GetPatchSource(Component) : nullptr;
+		if (PatchSource)
+		{
+			FVFScopedScratchMesh PatchSourceCopyScope(GetScratchMeshPool());
+			const FDynamicMesh3* PatchSourceMesh = SourceMesh;
+			if (Component->ComponentHasTag(FName("VFGenerated")))
 			{
-				Component->GetOwner()->SetRootComponent(NewDynamicMeshComponent);
-				Component->AttachToComponent(NewDynamicMeshComponent, FAttachmentTransformRules::KeepWorldTransform);
+				PatchSourceMesh = UVFCutGeometrySubsystem::CopyPatchSourceMesh(PatchSource, PatchSourceCopyScope.Get()) ? &PatchSourceCopyScope.Get()->GetMeshRef() : nullptr;
 			}
-			else
+			if (PatchSourceMesh)
 			{
-				NewDynamicMeshComponent->AttachToComponent(Component->GetAttachParent() ? Component->GetAttachParent() : Component, FAttachmentTransformRules::KeepWorldTransform);
-			}*/
-			
-			NewDynamicMeshComponent->AttachToComponent(Component->GetAttachParent() ? Component->GetAttachParent() : Component, FAttachmentTransformRules::KeepWorldTransform);
-			NewDynamicMeshComponent->SetCollisionResponseToChannels(CollisionResponseContainer);
-			NewDynamicMeshComponent->SetCollisionEnabled(CollisionEnabled);
-			NewDynamicMeshComponent->SetGenerateOverlapEvents(true);
-			NewDynamicMeshComponent->SetSimulatePhysics(bPhysicsEnabled);
-			
-			//物理模拟无法开启复杂碰撞，但是动态网格体的简单碰撞不知道怎么手动生成。
-			if (!bPhysicsEnabled)
+				Patch = MakeShared<FVFMeshPatch>();
+				Patch->SourceMesh = PatchSource;
+				Patch->Build(*PatchSourceMesh, CutMesh);
+			}
+		}
+
+		if (UPrimitiveComponent* GeneratedComponent = CommitComponentCut(Component, Outcome, MoveTemp(CutMesh), Patch, OutHiddenComponents))
+		{
+			GeneratedComponents.Emplace(GeneratedComponent);
+		}
+	}
+	
+	return GeneratedComponents;
+}
+
+TArray<UPrimitiveComponent*> UVFPhotoTakerPlacerComponent::ProcessInstancedMeshBoolean(UInstancedStaticMeshComponent* Component, UDynamicMesh* StaticMeshCopy, const FDynamicMesh3* RecordMesh, const FVFConvexVolume& PyramidVolume, EVFMeshCutOperation PyramidOperation, TArray<FVFRemovedInstances>& OutRemovedInstances)
+{
+	TArray<UPrimitiveComponent*> GeneratedComponents;
+
+	//与Pyramid包围盒不重叠的实例一定不会被切到，相减时保持不变，相交时被完全移除，两者都不需要进行切割
+	const TArray<int32> InstanceIndices = Component->GetInstancesOverlappingBox(Bounds.GetBox(), true);
+	TArray<int32> CulledIndices;
+	if (PyramidOperation == EVFMeshCutOperation::Intersect)
+	{
+		TBitArray<> IsOverlapping(false, Component->GetInstanceCount());
+		for (int32 InstanceIndex : InstanceIndices)
+		{
+			IsOverlapping[InstanceIndex] = true;
+		}
+		for (int32 InstanceIndex = 0; InstanceIndex < Component->GetInstanceCount(); InstanceIndex++)
+		{
+			if (!IsOverlapping[InstanceIndex]) CulledIndices.Emplace(InstanceIndex);
+		}
+	}
+	if (InstanceIndices.IsEmpty() && CulledIndices.IsEmpty()) return GeneratedComponents;
+
+	//所有实例共享同一个静态网格体，只复制一次
+	TEnumAsByte<EGeometryScriptOutcomePins> Pins;
+	UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
+		Component->GetStaticMesh(),
+		StaticMeshCopy,
+		FGeometryScriptCopyMeshFromAssetOptions(),
+		FGeometryScriptMeshReadLOD(),
+		Pins);
+	const FDynamicMesh3& SourceMesh = StaticMeshCopy->GetMeshRef();
+	const FDynamicMesh3& PyramidMesh = GetPyramidMesh();
+	const bool bCanPatch = Pins == EGeometryScriptOutcomePins::Success;
+
+	TArray<int32> RemovedIndices;
+	FVFRemovedInstances RemovedInstances;
+	RemovedInstances.Component = Component;
+	for (int32 InstanceIndex : CulledIndices)
+	{
+		FTransform InstanceTransform;
+		if (!Component->GetInstanceTransform(InstanceIndex, InstanceTransform, true)) continue;
+		RemovedIndices.Emplace(InstanceIndex);
+		RemovedInstances.InstanceTransforms.Emplace(InstanceTransform);
+	}
+	for (int32 InstanceIndex : InstanceIndices)
+	{
+		FTransform InstanceTransform;
+		if (!Component->GetInstanceTransform(InstanceIndex, InstanceTransform, true)) continue;
+
+		FDynamicMesh3 CutMesh;
+		const EVFMeshCutOutcome Outcome = FVFMeshCut::ApplyPlaceCut(
+			SourceMesh, InstanceTransform,
+			RecordMesh, GetComponentTransformNoScale(),
+			PyramidMesh, GetComponentTransform(), PyramidVolume,
+			PyramidOperation, CutMesh);
+		if (Outcome == EVFMeshCutOutcome::Unchanged) continue;
+		FVFStats::RecordCut(PyramidOperation == EVFMeshCutOperation::Subtract ? TEXT("PlaceLevelCut") : TEXT("PlaceGeneratedCut"), Component,
+			SourceMesh.TriangleCount(), Outcome == EVFMeshCutOutcome::Cut ? CutMesh.TriangleCount() : 0);
+
+		//被切割的实例同样从组件中移除，由新的动态网格体代替
+		RemovedIndices.Emplace(InstanceIndex);
+		RemovedInstances.InstanceTransforms.Emplace(InstanceTransform);
+		if (Outcome == EVFMeshCutOutcome::Cut)
+		{
+			//所有实例的补丁共享组件的静态网格体作为来源
+			TSharedPtr<FVFMeshPatch> Patch;
+			if (bCanPatch)
 			{
-				NewDynamicMeshComponent->EnableComplexAsSimpleCollision();
+				Patch = MakeShared<FVFMeshPatch>();
+				Patch->SourceMesh = Component->GetStaticMesh();
+				Patch->Build(SourceMesh, CutMesh);
 			}
-			
-			for (int i = 0;i < Component->GetNumMaterials();i++)
+			if (UDynamicMeshComponent* GeneratedComponent = SpawnGeneratedComponent(Component, InstanceTransform, MoveTemp(CutMesh), Patch))
 			{
-				NewDynamicMeshComponent->SetMaterial(i, Component->GetMaterial(i));
+				GeneratedComponents.Emplace(GeneratedComponent);
 			}
-
-			//TODO 想办法在进行Boolean操作后，生成动态网格体的简单碰撞
-			NewDynamicMeshComponent->UpdateCollision(false);
 		}
 	}
-	
-	PyramidDynamicMesh->DestroyComponent();
+
+	if (RemovedIndices.Num())
+	{
+		GetWorld()->GetSubsystem<UVFSaveSubsystem>()->AddModifiedInstances(Component);
+		Component->RemoveInstances(RemovedIndices);
+		GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>()->TouchContent(Component);
+		OutRemovedInstances.Emplace(MoveTemp(RemovedInstances));
+	}
 	return GeneratedComponents;
 }
 
+UPrimitiveComponent* UVFPhotoTakerPlacerComponent::CommitComponentCut(UPrimitiveComponent* Component, EVFMeshCutOutcome Outcome, FDynamicMesh3&& CutMesh, const TSharedPtr<FVFMeshPatch>& Patch, TArray<UPrimitiveComponent*>& OutHiddenComponents)
+{
+	//网格体没有被改变，保留原有组件
+	if (Outcome == EVFMeshCutOutcome::Unchanged) return nullptr;
+
+	//新组件沿用原有组件的碰撞设置，需要在隐藏之前生成
+	UDynamicMeshComponent* NewDynamicMeshComponent = nullptr;
+	if (Outcome == EVFMeshCutOutcome::Cut)
+	{
+		NewDynamicMeshComponent = SpawnGeneratedComponent(Component, Component->GetComponentTransform(), MoveTemp(CutMesh), Patch);
+	}
+	
+	//隐藏地图中原有的模型
+	Component->SetVisibility(false);
+	Component->SetGenerateOverlapEvents(false);
+	//Component->SetSimulatePhysics(false);
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->ComponentTags.AddUnique(FName("VFHidden"));
+	OutHiddenComponents.Emplace(Component);
+
+	//被隐藏的生成组件等待回溯期间只保留补丁
+	GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>()->ReleasePatchedMesh(Component);
+
+	//网格体被完全消除时不会创建动态网格体
+	return NewDynamicMeshComponent;
+}
+
+UDynamicMeshComponent* UVFPhotoTakerPlacerComponent::SpawnGeneratedComponent(UPrimitiveComponent* SourceComponent, const FTransform& Transform, FDynamicMesh3&& CutMesh, const TSharedPtr<FVFMeshPatch>& Patch)
+{
+	const FCollisionResponseContainer& CollisionResponseContainer = SourceComponent->GetCollisionResponseToChannels();
+	const ECollisionEnabled::Type CollisionEnabled = SourceComponent->GetCollisionEnabled();
+	const bool bPhysicsEnabled = SourceComponent->IsSimulatingPhysics();
+
+	//之所以不直接对DynamicMeshComponent进行操作，而是也要生成新的动态网格体，是考虑到时间回溯。
+	UDynamicMeshComponent* NewDynamicMeshComponent = GetWorld()->GetSubsystem<UVFPoolSubsystem>()->AcquireComponent<UDynamicMeshComponent>(SourceComponent->GetOwner());
+	if (NewDynamicMeshComponent)
+	{
+		FVFStats::RecordGeneratedComponent();
+
+		//标记为放置照片生成的组件，在其被后续的放置隐藏并且无法回溯后，会被压缩销毁。
+		NewDynamicMeshComponent->ComponentTags.Emplace(FName("VFGenerated"));
+		
+		NewDynamicMeshComponent->SetWorldTransform(Transform);
+		NewDynamicMeshComponent->GetDynamicMesh()->SetMesh(MoveTemp(CutMesh));
+		GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>()->SetMeshPatch(NewDynamicMeshComponent, Patch);
+		GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>()->TouchContent(NewDynamicMeshComponent);
+		
+		/**
+		 * 一般情况下，需要模拟物理的Actor通常只有根组件。
+		 * 如果根组件开启了模拟物理，则新的动态网格体需要代替根组件进行模拟物理，所以需要将根组件设置为动态网格体。
+		 */
+		/*if (bPhysicsEnabled && SourceComponent == SourceComponent->GetOwner()->GetRootComponent())
+		{
+			SourceComponent->GetOwner()->SetRootComponent(NewDynamicMeshComponent);
+			SourceComponent->AttachToComponent(NewDynamicMeshComponent, FAttachmentTransformRules::KeepWorldTransform);
+		}
+		else
+		{
+			NewDynamicMeshComponent->AttachToComponent(SourceComponent->GetAttachParent() ? SourceComponent->GetAttachParent() : SourceComponent, FAttachmentTransformRules::KeepWorldTransform);
+		}*/
+		
+		NewDynamicMeshComponent->AttachToComponent(SourceComponent->GetAttachParent() ? SourceComponent->GetAttachParent() : SourceComponent, FAttachmentTransformRules::KeepWorldTransform);
+		NewDynamicMeshComponent->SetCollisionResponseToChannels(CollisionResponseContainer);
+		NewDynamicMeshComponent->SetCollisionEnabled(CollisionEnabled);
+		NewDynamicMeshComponent->SetGenerateOverlapEvents(true);
+		NewDynamicMeshComponent->SetSimulatePhysics(bPhysicsEnabled);
+		
+		//物理模拟无法开启复杂碰撞，但是动态网格体的简单碰撞不知道怎么手动生成。
+		if (!bPhysicsEnabled)
+		{
+			NewDynamicMeshComponent->EnableComplexAsSimpleCollision();
+		}
+		
+		for (int i = 0;i < SourceComponent->GetNumMaterials();i++)
+		{
+			NewDynamicMeshComponent->SetMaterial(i, SourceComponent->GetMaterial(i));
+		}
+
+		//TODO 想办法在进行Boolean操作后，生成动态网格体的简单碰撞
+		NewDynamicMeshComponent->UpdateCollision(false);
+	}
+	return NewDynamicMeshComponent;
+}
+
+const FDynamicMesh3& UVFPhotoTakerPlacerComponent::GetPyramidMesh()
+{
+	//Pyramid的网格体在游戏中不会改变，只需要转换一次
+	if (!PyramidMeshCache || PyramidMeshCacheSource != GetStaticMesh())
+	{
+		if (!PyramidMeshCache)
+		{
+			PyramidMeshCache = NewObject<UDynamicMesh>(this);
+		}
+		PyramidMeshCacheSource = GetStaticMesh();
+		
+		TEnumAsByte<EGeometryScriptOutcomePins> Pins;
+		UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
+			GetStaticMesh(),
+			PyramidMeshCache,
+			FGeometryScriptCopyMeshFromAssetOptions(),
+			FGeometryScriptMeshReadLOD(),
+			Pins);
+	}
+	return PyramidMeshCache->GetMeshRef();
+}
+
+UVFScratchMeshPool* UVFPhotoTakerPlacerComponent::GetScratchMeshPool()
+{
+	if (!ScratchMeshPool)
+	{
+		ScratchMeshPool = NewObject<UVFScratchMeshPool>(this);
+	}
+	return ScratchMeshPool;
+}
+
 void UVFPhotoTakerPlacerComponent::ApplyRotatedAngleDelta(float DeltaAngle)
 {
 	FVector RotationAxis = GetForwardVector();
@@ -0,0 +1,171 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFPlacementBundle.h"
+#include "VFMeshCut.h"
+#include "VFStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+using namespace UE::Geometry;
+
+namespace
+{
+	constexpr uint32 BundleMagic = 0x42504656; //"VFPB"
+
+	//文件格式改变时增加，不兼容的旧文件无法读取
+	constexpr int32 BundleVersion = 1;
+
+	bool bExportRequested = false;
+
+	//损坏的文件不应导致分配过多的内存，每个元素至少占用一个字节
+	bool IsValidBundleNum(FArchive& Ar, int32 Num)
+	{
+		if (Ar.IsError() || Num < 0 || Num > Ar.TotalSize() - Ar.Tell())
+		{
+			Ar.SetError();
+			return false;
+		}
+		return true;
+	}
+}
+
+static FAutoConsoleCommand ExportNextPlacementCommand(
+	TEXT("vf.ExportNextPlacement"),
+	TEXT("Exports the geometry inputs of the next photo placement to Saved/Viewfinder/Bundles. Replay it with -run=VFPlacementReplay -Bundle=<File>."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		bExportRequested = true;
+		UE_LOG(LogViewfinder, Display, TEXT("The next placement will be exported as a placement bundle."));
+	}));
+
+FVFPlacementBundle* FVFPlacementBundle::Active = nullptr;
+
+void FVFPlacementBundle::AddComponent(const FString& Name, bool bIsGenerated, const FTransform& Transform, const UObject* MeshSource, const FDynamicMesh3& Mesh)
+{
+	FComponent& Component = Components.AddDefaulted_GetRef();
+	Component.Name = Name;
+	Component.bIsGenerated = bIsGenerated;
+	Component.Transform = Transform;
+
+	if (const int32* MeshIndex = MeshSource ? MeshIndices.Find(MeshSource) : nullptr)
+	{
+		Component.MeshIndex = *MeshIndex;
+		return;
+	}
+	Component.MeshIndex = Meshes.Emplace(Mesh);
+	if (MeshSource)
+	{
+		MeshIndices.Add(MeshSource, Component.MeshIndex);
+	}
+}
+
+void FVFPlacementBundle::Replay(FVFOperationStats& Stats) const
+{
+	FVFOperationStats* PrevActiveStats = FVFOperationStats::GetActive();
+	FVFOperationStats::SetActive(&Stats);
+
+	//与放置时相同，先切割地图中的组件，再切割照片中生成的组件
+	for (const bool bIsGenerated : { false, true })
+	{
+		const TCHAR* StageName = bIsGenerated ? TEXT("PlaceGeneratedCut") : TEXT("PlaceLevelCut");
+		const FTransform& PyramidTransform = bIsGenerated ? GeneratedPyramidTransform : LevelPyramidTransform;
+		const EVFMeshCutOperation PyramidOperation = bIsGenerated ? EVFMeshCutOperation::Intersect : EVFMeshCutOperation::Subtract;
+
+		FVFScopedOperationTimer Timer(StageName);
+		FVFConvexVolume PyramidVolume;
+		PyramidVolume.BuildFromMesh(PyramidMesh, PyramidTransform);
+
+		for (const FComponent& Component : Components)
+		{
+			if (Component.bIsGenerated != bIsGenerated || !Meshes.IsValidIndex(Component.MeshIndex)) continue;
+
+			const FDynamicMesh3& SourceMesh = Meshes[Component.MeshIndex];
+			FDynamicMesh3 CutMesh;
+			const EVFMeshCutOutcome Outcome = FVFMeshCut::ApplyPlaceCut(
+				SourceMesh, Component.Transform,
+				bIsGenerated ? &RecordMesh : nullptr, RecordTransform,
+				PyramidMesh, PyramidTransform, PyramidVolume,
+				PyramidOperation, CutMesh);
+			if (Outcome != EVFMeshCutOutcome::Unchanged)
+			{
+				FVFOperationStats::AddCut(StageName, Component.Name, SourceMesh.TriangleCount(), Outcome == EVFMeshCutOutcome::Cut ? CutMesh.TriangleCount() : 0);
+			}
+		}
+	}
+
+	FVFOperationStats::SetActive(PrevActiveStats);
+}
+
+bool FVFPlacementBundle::SaveToFile(const FString& Filename) const
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	const_cast<FVFPlacementBundle*>(this)->Serialize(Writer);
+	return FFileHelper::SaveArrayToFile(Data, *Filename);
+}
+
+bool FVFPlacementBundle::LoadFromFile(const FString& Filename)
+{
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Filename)) return false;
+
+	FMemoryReader Reader(Data);
+	Serialize(Reader);
+	return !Reader.IsError();
+}
+
+void FVFPlacementBundle::Serialize(FArchive& Ar)
+{
+	uint32 Magic = BundleMagic;
+	int32 Version = BundleVersion;
+	Ar << Magic << Version;
+	if (Ar.IsLoading() && (Magic != BundleMagic || Version != BundleVersion))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("Unsupported placement bundle version %d, expected %d."), Version, BundleVersion);
+		Ar.SetError();
+		return;
+	}
+
+	Ar << PhotoId;
+	Ar << PhotoTakeParams.CaptureFOVAngle << PhotoTakeParams.MaxCaptureDistance << PhotoTakeParams.BackgroundDistance;
+	Ar << PhotoTakeParams.CaptureSize << PhotoTakeParams.TakeTransformNoScale;
+	Ar << PlaceTransformNoScale << PlaceRotatedAngle;
+	Ar << RecordMesh << RecordTransform;
+	Ar << PyramidMesh << LevelPyramidTransform << GeneratedPyramidTransform;
+
+	int32 NumMeshes = Meshes.Num();
+	Ar << NumMeshes;
+	if (Ar.IsLoading())
+	{
+		if (!IsValidBundleNum(Ar, NumMeshes)) return;
+		Meshes.SetNum(NumMeshes);
+	}
+	for (FDynamicMesh3& Mesh : Meshes)
+	{
+		if (Ar.IsError()) return;
+		Ar << Mesh;
+	}
+
+	int32 NumComponents = Components.Num();
+	Ar << NumComponents;
+	if (Ar.IsLoading())
+	{
+		if (!IsValidBundleNum(Ar, NumComponents)) return;
+		Components.SetNum(NumComponents);
+	}
+	for (FComponent& Component : Components)
+	{
+		if (Ar.IsError()) return;
+		Ar << Component.Name << Component.bIsGenerated << Component.MeshIndex << Component.Transform;
+	}
+}
+
+bool FVFPlacementBundle::ConsumeExportRequest()
+{
+	const bool bRequested = bExportRequested;
+	bExportRequested = false;
+	return bRequested;
+}
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFPlacementReplayCommandlet.h"
+#include "VFPlacementBundle.h"
+#include "VFStats.h"
+#include "Algo/Count.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+UVFPlacementReplayCommandlet::UVFPlacementReplayCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UVFPlacementReplayCommandlet::Main(const FString& Params)
+{
+	FString BundlePath;
+	int32 NumIterations = 10;
+	FParse::Value(*Params, TEXT("Bundle="), BundlePath);
+	FParse::Value(*Params, TEXT("Iterations="), NumIterations);
+	FString BaseName = FPaths::GetBaseFilename(BundlePath);
+	FParse::Value(*Params, TEXT("Output="), BaseName);
+
+	FVFPlacementBundle Bundle;
+	if (BundlePath.IsEmpty() || !Bundle.LoadFromFile(BundlePath))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFPlacementReplay: failed to load placement bundle %s."), *BundlePath);
+		return 1;
+	}
+	UE_LOG(LogViewfinder, Display, TEXT("VFPlacementReplay: photo %llu, %d components, %d meshes, rotated %.1f degrees."),
+		Bundle.PhotoId, Bundle.Components.Num(), Bundle.Meshes.Num(), Bundle.PlaceRotatedAngle);
+
+	FString Csv = TEXT("Iteration,Stage,Milliseconds,TrianglesIn,TrianglesOut,Cuts\n");
+	TMap<FName, TArray<double>> StageMilliseconds;
+	for (int32 IterationIndex = 0; IterationIndex < NumIterations; IterationIndex++)
+	{
+		FVFOperationStats Stats;
+		Bundle.Replay(Stats);
+
+		for (const FVFOperationStats::FStage& Stage : Stats.Stages)
+		{
+			const int32 NumCuts = Algo::CountIf(Stats.Cuts, [&Stage](const FVFOperationStats::FCut& Cut) { return Cut.Stage == Stage.Name; });
+			Csv += FString::Printf(TEXT("%d,%s,%.3f,%lld,%lld,%d\n"), IterationIndex, *Stage.Name.ToString(),
+				Stage.Seconds * 1000.0, Stage.TrianglesIn, Stage.TrianglesOut, NumCuts);
+			StageMilliseconds.FindOrAdd(Stage.Name).Emplace(Stage.Seconds * 1000.0);
+		}
+
+		//每次迭代的切割结果相同，只输出一次
+		if (IterationIndex == 0)
+		{
+			for (const FVFOperationStats::FCut& Cut : Stats.Cuts)
+			{
+				UE_LOG(LogViewfinder, Display, TEXT("VFPlacementReplay: %s %s, %lld -> %lld triangles."),
+					*Cut.Stage.ToString(), *Cut.ComponentName, Cut.TrianglesIn, Cut.TrianglesOut);
+			}
+		}
+	}
+
+	for (TPair<FName, TArray<double>>& Pair : StageMilliseconds)
+	{
+		Pair.Value.Sort();
+		UE_LOG(LogViewfinder, Display, TEXT("VFPlacementReplay: %s min %.3f ms, median %.3f ms, max %.3f ms."),
+			*Pair.Key.ToString(), Pair.Value[0], Pair.Value[Pair.Value.Num() / 2], Pair.Value.Last());
+	}
+
+	const FString CsvPath = FPaths::ProjectSavedDir() / TEXT("Viewfinder/Replay") / BaseName + TEXT(".csv");
+	if (!FFileHelper::SaveStringToFile(Csv, *CsvPath))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFPlacementReplay: failed to write results to %s."), *CsvPath);
+		return 1;
+	}
+	UE_LOG(LogViewfinder, Display, TEXT("VFPlacementReplay: results written to %s."), *CsvPath);
+	return 0;
+}
@@ -0,0 +1,197 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFPoolSubsystem.h"
+#include "Components/DynamicMeshComponent.h"
+#include "Engine/World.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+void UVFPoolSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	for (const FVFPoolWarmUpActor& WarmUpActor : WarmUpActors)
+	{
+		UClass* ActorClass = WarmUpActor.ActorClass.LoadSynchronous();
+		if (!ActorClass) continue;
+
+		for (int32 i = 0; i < WarmUpActor.Count; i++)
+		{
+			if (AActor* Actor = InWorld.SpawnActor(ActorClass))
+			{
+				ReleaseActor(Actor);
+			}
+		}
+	}
+}
+
+void UVFPoolSubsystem::Deinitialize()
+{
+	LogStats();
+	PooledActors.Empty();
+	PooledComponents.Empty();
+	
+	Super::Deinitialize();
+}
+
+AActor* UVFPoolSubsystem::AcquireActor(TSubclassOf<AActor> Class, const FTransform& Transform)
+{
+	if (!Class) return nullptr;
+
+	if (TArray<TWeakObjectPtr<AActor>>* Actors = PooledActors.Find(Class.Get()))
+	{
+		while (Actors->Num())
+		{
+			AActor* Actor = Actors->Pop(false).Get();
+			if (!IsValid(Actor)) continue;
+
+			NumHits++;
+			Actor->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+			Actor->SetActorHiddenInGame(false);
+			Actor->SetActorEnableCollision(true);
+			return Actor;
+		}
+	}
+
+	NumMisses++;
+	CountSpawn();
+	return GetWorld()->SpawnActor(Class, &Transform);
+}
+
+void UVFPoolSubsystem::ReleaseActor(AActor* Actor)
+{
+	if (!IsValid(Actor)) return;
+
+	TArray<TWeakObjectPtr<AActor>>& Actors = PooledActors.FindOrAdd(Actor->GetClass());
+	if (Actors.Num() >= MaxPooledActorsPerClass)
+	{
+		Actor->Destroy();
+		return;
+	}
+
+	Actor->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	Actor->SetActorHiddenInGame(true);
+	Actor->SetActorEnableCollision(false);
+	Actors.Emplace(Actor);
+}
+
+UActorComponent* UVFPoolSubsystem::AcquireComponent(AActor* Owner, TSubclassOf<UActorComponent> Class)
+{
+	if (!IsValid(Owner) || !Class) return nullptr;
+
+	if (TArray<TWeakObjectPtr<UActorComponent>>* Components = PooledComponents.Find(MakeTuple(TObjectKey<AActor>(Owner), TObjectKey<UClass>(Class.Get()))))
+	{
+		while (Components->Num())
+		{
+			UActorComponent* Component = Components->Pop(false).Get();
+			if (!IsValid(Component) || Component->IsBeingDestroyed()) continue;
+
+			NumHits++;
+			if (USceneComponent* SceneComponent = Cast<USceneComponent>(Component))
+			{
+				SceneComponent->SetVisibility(true);
+			}
+			return Component;
+		}
+	}
+
+	NumMisses++;
+	CountSpawn();
+	return Owner->AddComponentByClass(Class, true, FTransform(), false);
+}
+
+void UVFPoolSubsystem::ReleaseComponent(UActorComponent* Component)
+{
+	if (!IsValid(Component) || Component->IsBeingDestroyed()) return;
+
+	AActor* Owner = Component->GetOwner();
+	TArray<TWeakObjectPtr<UActorComponent>>& Components = PooledComponents.FindOrAdd(MakeTuple(TObjectKey<AActor>(Owner), TObjectKey<UClass>(Component->GetClass())));
+	
+	//动态网格体的数据在归还时释放，组件本身保留
+	if (UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+	{
+		DynamicMeshComponent->GetDynamicMesh()->Reset();
+		DynamicMeshComponent->EmptyOverrideMaterials();
+		DynamicMeshComponent->SetComplexAsSimpleCollisionEnabled(false, false);
+	}
+	//烘焙生成的静态网格体只属于这个组件，不能在对象池中保留
+	else if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+	{
+		StaticMeshComponent->SetStaticMesh(nullptr);
+		StaticMeshComponent->EmptyOverrideMaterials();
+	}
+	
+	if (!Owner || Components.Num() >= MaxPooledComponentsPerOwner)
+	{
+		Component->DestroyComponent(true);
+		return;
+	}
+
+	Component->ComponentTags.Reset();
+	if (UPrimitiveComponent* PrimitiveComponent = Cast<UPrimitiveComponent>(Component))
+	{
+		PrimitiveComponent->SetSimulatePhysics(false);
+		PrimitiveComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		PrimitiveComponent->SetGenerateOverlapEvents(false);
+	}
+	if (USceneComponent* SceneComponent = Cast<USceneComponent>(Component))
+	{
+		//挂载在此组件上的子组件需要保留在原有的层级中
+		for (USceneComponent* Child : TArray<USceneComponent*>(SceneComponent->GetAttachChildren()))
+		{
+			Child->AttachToComponent(SceneComponent->GetAttachParent(), FAttachmentTransformRules::KeepWorldTransform);
+		}
+		SceneComponent->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+		SceneComponent->SetVisibility(false);
+	}
+	Components.Emplace(Component);
+}
+
+void UVFPoolSubsystem::WarmUpComponents(AActor* Owner, TSubclassOf<UActorComponent> Class, int32 Count)
+{
+	if (!IsValid(Owner) || !Class) return;
+
+	for (int32 i = 0; i < Count; i++)
+	{
+		CountSpawn();
+		ReleaseComponent(Owner->AddComponentByClass(Class, true, FTransform(), false));
+	}
+}
+
+void UVFPoolSubsystem::CountSpawn()
+{
+	if (SpawnFrameNumber != GFrameCounter)
+	{
+		SpawnFrameNumber = GFrameCounter;
+		NumSpawnsThisFrame = 0;
+	}
+	NumSpawnsThisFrame++;
+	PeakSpawnsPerFrame = FMath::Max(PeakSpawnsPerFrame, NumSpawnsThisFrame);
+}
+
+void UVFPoolSubsystem::LogStats() const
+{
+	int32 NumPooledActors = 0;
+	for (const TPair<TObjectKey<UClass>, TArray<TWeakObjectPtr<AActor>>>& Pair : PooledActors)
+	{
+		NumPooledActors += Pair.Value.Num();
+	}
+	int32 NumPooledComponents = 0;
+	for (const TPair<TPair<TObjectKey<AActor>, TObjectKey<UClass>>, TArray<TWeakObjectPtr<UActorComponent>>>& Pair : PooledComponents)
+	{
+		NumPooledComponents += Pair.Value.Num();
+	}
+
+	UE_LOG(LogViewfinder, Log, TEXT("Viewfinder pool: hit rate %.1f%% (%d hits, %d misses), %d spawns in frame %llu, peak %d spawns per frame, %d actors and %d components pooled."),
+		GetHitRate() * 100.f, NumHits, NumMisses, NumSpawnsThisFrame, SpawnFrameNumber, PeakSpawnsPerFrame, NumPooledActors, NumPooledComponents);
+}
+
+static FAutoConsoleCommandWithWorld PoolStatsCommand(
+	TEXT("vf.Pool.Stats"),
+	TEXT("Prints the viewfinder object pool hit rate and spawn counts."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UVFPoolSubsystem* PoolSubsystem = World ? World->GetSubsystem<UVFPoolSubsystem>() : nullptr)
+		{
+			PoolSubsystem->LogStats();
+		}
+	}));
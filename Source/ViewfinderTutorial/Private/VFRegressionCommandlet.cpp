@@ -0,0 +1,228 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFRegressionCommandlet.h"
+#include "VFPlacementBundle.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+namespace
+{
+	double GetMedian(TArray<double>& Values)
+	{
+		if (Values.IsEmpty()) return 0.0;
+		Values.Sort();
+		return Values[Values.Num() / 2];
+	}
+
+	//每个阶段各次迭代的中位耗时与内存变化，三角面数量每次迭代相同，取第一次迭代的值
+	void AddStageMetrics(const FString& Prefix, const TArray<const FVFOperationStats*>& Iterations, TMap<FString, double>& OutMetrics)
+	{
+		TMap<FName, TArray<double>> StageMilliseconds;
+		TMap<FName, TArray<double>> StageMemoryDeltaKB;
+		for (const FVFOperationStats* Stats : Iterations)
+		{
+			for (const FVFOperationStats::FStage& Stage : Stats->Stages)
+			{
+				StageMilliseconds.FindOrAdd(Stage.Name).Emplace(Stage.Seconds * 1000.0);
+				StageMemoryDeltaKB.FindOrAdd(Stage.Name).Emplace(Stage.MemoryDelta / 1024.0);
+				if (Stats == Iterations[0])
+				{
+					OutMetrics.Add(Prefix + Stage.Name.ToString() + TEXT(".TrianglesIn"), Stage.TrianglesIn);
+					OutMetrics.Add(Prefix + Stage.Name.ToString() + TEXT(".TrianglesOut"), Stage.TrianglesOut);
+				}
+			}
+		}
+		for (TPair<FName, TArray<double>>& Pair : StageMilliseconds)
+		{
+			OutMetrics.Add(Prefix + Pair.Key.ToString() + TEXT(".Ms"), GetMedian(Pair.Value));
+		}
+		for (TPair<FName, TArray<double>>& Pair : StageMemoryDeltaKB)
+		{
+			OutMetrics.Add(Prefix + Pair.Key.ToString() + TEXT(".MemoryDeltaKB"), GetMedian(Pair.Value));
+		}
+	}
+}
+
+int32 UVFRegressionCommandlet::Main(const FString& Params)
+{
+	const bool bUpdateBaselines = FParse::Param(*Params, TEXT("UpdateBaselines"));
+	FString PyramidPath = TEXT("/Game/Viewfinder/Assets/SM_Pyramid.SM_Pyramid");
+	FParse::Value(*Params, TEXT("Pyramid="), PyramidPath);
+
+	TMap<FString, double> Metrics;
+	for (const FVFRegressionScenario& Scenario : Scenarios)
+	{
+		UE_LOG(LogViewfinder, Display, TEXT("VFRegression: scenario %s, %d meshes of %d triangles."), *Scenario.Name, Scenario.Meshes, Scenario.Triangles);
+		TArray<FVFBenchmarkIteration> Iterations;
+		if (!RunScenario(Scenario.Meshes, Scenario.Triangles, Scenario.Iterations, Scenario.PlaceAngle, PyramidPath, Iterations)) return 1;
+		AddScenarioMetrics(Scenario.Name + TEXT("."), Iterations, Metrics);
+	}
+
+	TArray<FString> BundleFiles;
+	const FString BundleRoot = FPaths::ProjectDir() / BundleDirectory;
+	IFileManager::Get().FindFiles(BundleFiles, *(BundleRoot / TEXT("*.vfbundle")), true, false);
+	BundleFiles.Sort();
+	int32 NumFailedBundles = 0;
+	for (const FString& BundleFile : BundleFiles)
+	{
+		if (!AddBundleMetrics(BundleRoot / BundleFile, BundleIterations, Metrics))
+		{
+			NumFailedBundles++;
+		}
+	}
+	//缺少放置包的结果既不能与基准比较，也不能作为新的基准
+	if (NumFailedBundles > 0)
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFRegression: %d placement bundles failed to load."), NumFailedBundles);
+		return 1;
+	}
+
+	Metrics.Add(TEXT("Process.PeakUsedKB"), FPlatformMemory::GetStats().PeakUsedPhysical / 1024.0);
+	Metrics.KeySort(TLess<FString>());
+
+	TSharedRef<FJsonObject> JsonMetrics = MakeShared<FJsonObject>();
+	for (const TPair<FString, double>& Pair : Metrics)
+	{
+		JsonMetrics->SetNumberField(Pair.Key, Pair.Value);
+	}
+	FString Json;
+	FJsonSerializer::Serialize(JsonMetrics, TJsonWriterFactory<>::Create(&Json));
+
+	const FString BaselineFile = FPaths::ProjectDir() / BaselinePath;
+	if (bUpdateBaselines)
+	{
+		if (!FFileHelper::SaveStringToFile(Json, *BaselineFile))
+		{
+			UE_LOG(LogViewfinder, Error, TEXT("VFRegression: failed to write baselines to %s."), *BaselineFile);
+			return 1;
+		}
+		UE_LOG(LogViewfinder, Display, TEXT("VFRegression: %d baselines written to %s."), Metrics.Num(), *BaselineFile);
+		return 0;
+	}
+
+	//本次的结果总是写入Saved，方便与基准对比或替换基准
+	FFileHelper::SaveStringToFile(Json, *(FPaths::ProjectSavedDir() / TEXT("Viewfinder/Regression") / FString::Printf(TEXT("VFRegression-%s.json"), *FDateTime::Now().ToString())));
+
+	if (!IFileManager::Get().FileExists(*BaselineFile))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFRegression: baselines %s not found, run with -UpdateBaselines to create them."), *BaselineFile);
+		return 1;
+	}
+	FString BaselineJson;
+	TSharedPtr<FJsonObject> JsonBaselines;
+	if (!FFileHelper::LoadFileToString(BaselineJson, *BaselineFile)
+		|| !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(BaselineJson), JsonBaselines) || !JsonBaselines)
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFRegression: failed to read baselines %s."), *BaselineFile);
+		return 1;
+	}
+	TMap<FString, double> Baselines;
+	for (const TPair<FString, TSharedPtr<FJsonValue>>& Pair : JsonBaselines->Values)
+	{
+		Baselines.Add(Pair.Key, Pair.Value->AsNumber());
+	}
+
+	const int32 NumRegressions = CompareWithBaselines(Baselines, Metrics);
+	if (NumRegressions > 0)
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFRegression: %d metrics regressed or missing."), NumRegressions);
+		return 1;
+	}
+	UE_LOG(LogViewfinder, Display, TEXT("VFRegression: all %d metrics within tolerance."), Metrics.Num());
+	return 0;
+}
+
+void UVFRegressionCommandlet::AddScenarioMetrics(const FString& Prefix, const TArray<FVFBenchmarkIteration>& Iterations, TMap<FString, double>& OutMetrics) const
+{
+	if (Iterations.IsEmpty()) return;
+
+	TArray<const FVFOperationStats*> Stats;
+	for (const FVFBenchmarkIteration& Iteration : Iterations)
+	{
+		Stats.Emplace(&Iteration.Stats);
+	}
+	AddStageMetrics(Prefix, Stats, OutMetrics);
+
+	OutMetrics.Add(Prefix + TEXT("GeneratedComponents"), Iterations[0].NumGeneratedComponents);
+	OutMetrics.Add(Prefix + TEXT("HiddenComponents"), Iterations[0].NumHiddenComponents);
+	OutMetrics.Add(Prefix + TEXT("GeneratedKB"), Iterations[0].GeneratedBytes / 1024.0);
+	OutMetrics.Add(Prefix + TEXT("PayloadKB"), Iterations[0].PayloadBytes / 1024.0);
+}
+
+bool UVFRegressionCommandlet::AddBundleMetrics(const FString& BundlePath, int32 NumIterations, TMap<FString, double>& OutMetrics) const
+{
+	FVFPlacementBundle Bundle;
+	if (!Bundle.LoadFromFile(BundlePath))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("VFRegression: failed to load placement bundle %s."), *BundlePath);
+		return false;
+	}
+	UE_LOG(LogViewfinder, Display, TEXT("VFRegression: bundle %s, %d components."), *FPaths::GetCleanFilename(BundlePath), Bundle.Components.Num());
+
+	TArray<FVFOperationStats> Iterations;
+	Iterations.SetNum(FMath::Max(NumIterations, 1));
+	TArray<const FVFOperationStats*> Stats;
+	for (FVFOperationStats& Iteration : Iterations)
+	{
+		Bundle.Replay(Iteration);
+		Stats.Emplace(&Iteration);
+	}
+	AddStageMetrics(FPaths::GetBaseFilename(BundlePath) + TEXT("."), Stats, OutMetrics);
+	return true;
+}
+
+double UVFRegressionCommandlet::GetAllowedIncrease(const FString& Metric, double Baseline) const
+{
+	if (Metric.EndsWith(TEXT("Ms")))
+	{
+		return FMath::Max(FMath::Abs(Baseline) * TimeTolerance, MinTimeIncreaseMs);
+	}
+	if (Metric.EndsWith(TEXT("KB")))
+	{
+		return FMath::Max(FMath::Abs(Baseline) * MemoryTolerance, MinMemoryIncreaseKB);
+	}
+	return FMath::Abs(Baseline) * CountTolerance;
+}
+
+int32 UVFRegressionCommandlet::CompareWithBaselines(const TMap<FString, double>& Baselines, const TMap<FString, double>& Metrics) const
+{
+	int32 NumRegressions = 0;
+	UE_LOG(LogViewfinder, Display, TEXT("%-56s %14s %14s %9s  %s"), TEXT("Metric"), TEXT("Baseline"), TEXT("Current"), TEXT("Change"), TEXT("Status"));
+	for (const TPair<FString, double>& Pair : Metrics)
+	{
+		const double* Baseline = Baselines.Find(Pair.Key);
+		if (!Baseline)
+		{
+			UE_LOG(LogViewfinder, Display, TEXT("%-56s %14s %14.3f %9s  New"), *Pair.Key, TEXT("-"), Pair.Value, TEXT("-"));
+			continue;
+		}
+
+		const double Change = *Baseline != 0.0 ? (Pair.Value - *Baseline) / FMath::Abs(*Baseline) * 100.0 : 0.0;
+		const bool bRegressed = Pair.Value - *Baseline > GetAllowedIncrease(Pair.Key, *Baseline);
+		if (bRegressed)
+		{
+			NumRegressions++;
+			UE_LOG(LogViewfinder, Error, TEXT("%-56s %14.3f %14.3f %+8.1f%%  Regressed"), *Pair.Key, *Baseline, Pair.Value, Change);
+		}
+		else
+		{
+			UE_LOG(LogViewfinder, Display, TEXT("%-56s %14.3f %14.3f %+8.1f%%  OK"), *Pair.Key, *Baseline, Pair.Value, Change);
+		}
+	}
+	//基准中有而本次没有的指标说明场景、放置包或阶段丢失了，同样视为失败
+	for (const TPair<FString, double>& Pair : Baselines)
+	{
+		if (!Metrics.Contains(Pair.Key))
+		{
+			NumRegressions++;
+			UE_LOG(LogViewfinder, Error, TEXT("%-56s %14.3f %14s %9s  Missing"), *Pair.Key, Pair.Value, TEXT("-"), TEXT("-"));
+		}
+	}
+	return NumRegressions;
+}
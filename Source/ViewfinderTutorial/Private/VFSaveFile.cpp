@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFSaveFile.h"
+#include "HAL/FileManager.h"
+#include "Misc/Compression.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+namespace
+{
+	constexpr uint32 SaveFileMagic = 0x56534656; //"VFSV"
+
+	//容器格式改变时增加，块内容的版本由各自的读取者管理
+	constexpr int32 SaveFileVersion = 1;
+
+	constexpr int64 HeaderSize = sizeof(uint32) + sizeof(int32) + sizeof(int32);
+	constexpr int64 EntrySize = sizeof(uint8) + sizeof(uint8) + sizeof(int64) + sizeof(int32) + sizeof(int32);
+	constexpr int64 ChunkAlignment = 16;
+
+	//一个块最多包含整个世界的状态，解压后超过此大小的块视为损坏，不会按块表中的大小分配内存
+	constexpr int32 MaxChunkSize = 1024 * 1024 * 1024;
+}
+
+int32 FVFSaveFileWriter::AddChunk(EVFSaveChunkType Type, const TArray<uint8>& Data)
+{
+	FChunk& Chunk = Chunks.AddDefaulted_GetRef();
+	Chunk.Type = Type;
+	Chunk.UncompressedSize = Data.Num();
+
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Data.Num());
+	Chunk.Data.SetNumUninitialized(CompressedSize);
+	Chunk.bIsCompressed = Data.Num() > 0
+		&& FCompression::CompressMemory(NAME_Zlib, Chunk.Data.GetData(), CompressedSize, Data.GetData(), Data.Num())
+		&& CompressedSize < Data.Num();
+	if (Chunk.bIsCompressed)
+	{
+		Chunk.Data.SetNum(CompressedSize);
+	}
+	else
+	{
+		Chunk.Data = Data;
+	}
+	return Chunks.Num() - 1;
+}
+
+bool FVFSaveFileWriter::Save(const FString& Filename) const
+{
+	TUniquePtr<FArchive> FileWriter(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!FileWriter) return false;
+
+	uint32 Magic = SaveFileMagic;
+	int32 Version = SaveFileVersion;
+	int32 NumChunks = Chunks.Num();
+	*FileWriter << Magic << Version << NumChunks;
+
+	int64 Offset = Align(HeaderSize + EntrySize * NumChunks, ChunkAlignment);
+	TArray<int64> Offsets;
+	for (const FChunk& Chunk : Chunks)
+	{
+		uint8 Type = (uint8)Chunk.Type;
+		uint8 bIsCompressed = Chunk.bIsCompressed;
+		int32 Size = Chunk.Data.Num();
+		int32 UncompressedSize = Chunk.UncompressedSize;
+		*FileWriter << Type << bIsCompressed << Offset << Size << UncompressedSize;
+		Offsets.Emplace(Offset);
+		Offset = Align(Offset + Size, ChunkAlignment);
+	}
+
+	uint8 Padding[ChunkAlignment] = {};
+	for (int32 i = 0; i < Chunks.Num(); i++)
+	{
+		FileWriter->Serialize(Padding, Offsets[i] - FileWriter->Tell());
+		FileWriter->Serialize(const_cast<uint8*>(Chunks[i].Data.GetData()), Chunks[i].Data.Num());
+	}
+	return FileWriter->Close();
+}
+
+int64 FVFSaveFileWriter::GetTotalSize() const
+{
+	int64 Size = Align(HeaderSize + EntrySize * Chunks.Num(), ChunkAlignment);
+	for (const FChunk& Chunk : Chunks)
+	{
+		Size = Align(Size + Chunk.Data.Num(), ChunkAlignment);
+	}
+	return Size;
+}
+
+bool FVFSaveFileReader::Open(const FString& Filename)
+{
+	Entries.Reset();
+	FileReader.Reset(IFileManager::Get().CreateFileReader(*Filename));
+	if (!FileReader) return false;
+	FileSize = FileReader->TotalSize();
+
+	uint32 Magic = 0;
+	int32 Version = 0;
+	int32 NumChunks = 0;
+	*FileReader << Magic << Version << NumChunks;
+	if (FileReader->IsError() || Magic != SaveFileMagic || Version != SaveFileVersion || NumChunks < 0 || HeaderSize + EntrySize * NumChunks > FileSize)
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("%s is not a save file of version %d."), *Filename, SaveFileVersion);
+		FileReader.Reset();
+		return false;
+	}
+
+	Entries.SetNum(NumChunks);
+	for (FEntry& Entry : Entries)
+	{
+		uint8 Type = 0;
+		uint8 bIsCompressed = 0;
+		*FileReader << Type << bIsCompressed << Entry.Offset << Entry.Size << Entry.UncompressedSize;
+		Entry.Type = (EVFSaveChunkType)Type;
+		Entry.bIsCompressed = bIsCompressed != 0;
+	}
+	return !FileReader->IsError();
+}
+
+bool FVFSaveFileReader::LoadChunk(int32 Index, TArray<uint8>& OutData)
+{
+	if (!FileReader || !Entries.IsValidIndex(Index)) return false;
+	const FEntry& Entry = Entries[Index];
+	if (Entry.Offset < 0 || Entry.Size < 0 || Entry.UncompressedSize < 0 || Entry.UncompressedSize > MaxChunkSize || Entry.Offset + Entry.Size > FileSize) return false;
+
+	TArray<uint8> Data;
+	Data.SetNumUninitialized(Entry.Size);
+	FileReader->Seek(Entry.Offset);
+	FileReader->Serialize(Data.GetData(), Entry.Size);
+	if (FileReader->IsError()) return false;
+
+	if (!Entry.bIsCompressed)
+	{
+		OutData = MoveTemp(Data);
+		return true;
+	}
+	OutData.SetNumUninitialized(Entry.UncompressedSize);
+	return FCompression::UncompressMemory(NAME_Zlib, OutData.GetData(), Entry.UncompressedSize, Data.GetData(), Entry.Size);
+}
+
+int32 FVFSaveFileReader::FindChunk(EVFSaveChunkType Type) const
+{
+	return Entries.IndexOfByPredicate([Type](const FEntry& Entry) { return Entry.Type == Type; });
+}
@@ -0,0 +1,236 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFSaveJournal.h"
+#include "HAL/FileManager.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+namespace
+{
+	constexpr uint32 JournalMagic = 0x4E4A4656; //"VFJN"
+	constexpr uint32 RecordMagic = 0x524A4656; //"VFJR"
+	//版本2：切割生成的组件可以存储为补丁。读取时兼容所有不高于当前版本的日志
+	constexpr int32 JournalVersion = 2;
+
+	//Magic、大小、解压后大小、CRC与是否压缩
+	constexpr int64 RecordHeaderSize = sizeof(uint32) + sizeof(int32) + sizeof(int32) + sizeof(uint32) + sizeof(uint8);
+
+	//一条记录只包含一次操作改变的对象，超过此大小的记录视为损坏
+	constexpr int32 MaxRecordSize = 256 * 1024 * 1024;
+
+	//连续追加记录时日志交给系统的最长间隔，进程崩溃时最多丢失这段时间内的记录
+	constexpr double MaxFlushInterval = 0.5;
+}
+
+FVFSaveJournal::FVFSaveJournal(const FString& InSnapshotFilename, const FString& InJournalFilename, int64 InMaxJournalSize)
+	: SnapshotFilename(InSnapshotFilename)
+	, JournalFilename(InJournalFilename)
+	, MaxJournalSize(InMaxJournalSize)
+	, Pipe(TEXT("VFSaveJournal"))
+{
+}
+
+FVFSaveJournal::~FVFSaveJournal()
+{
+	Flush();
+}
+
+void FVFSaveJournal::Reset(FVFSaveState&& InState)
+{
+	//新的日志ID使旧日志中的记录不会被重放到新的快照上，即使写入快照后来不及清空日志
+	InState.JournalId = FGuid::NewGuid();
+	NextSequence = InState.Sequence + 1;
+	LastTask = Pipe.Launch(TEXT("VFSaveJournal.Reset"), [this, NewState = MoveTemp(InState)]() mutable
+	{
+		State = MoveTemp(NewState);
+		Compact();
+	});
+}
+
+void FVFSaveJournal::Append(FVFSaveDelta&& Delta)
+{
+	Delta.Sequence = NextSequence++;
+	NumPendingRecords++;
+	LastTask = Pipe.Launch(TEXT("VFSaveJournal.Append"), [this, Delta = MoveTemp(Delta)]()
+	{
+		//之后没有等待写入的记录时交给系统，Flush等待的最后一个任务总是会交给系统
+		WriteRecord(Delta, --NumPendingRecords == 0);
+		Delta.ApplyTo(State);
+		if (!JournalWriter || JournalWriter->Tell() >= MaxJournalSize)
+		{
+			Compact();
+		}
+	});
+}
+
+void FVFSaveJournal::Flush()
+{
+	//管线中的任务按顺序执行，最后一个任务完成时之前的任务都已完成
+	if (LastTask.IsValid())
+	{
+		LastTask.Wait();
+	}
+}
+
+void FVFSaveJournal::WriteRecord(const FVFSaveDelta& Delta, bool bFlush)
+{
+	if (!JournalWriter) return;
+
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	const_cast<FVFSaveDelta&>(Delta).Serialize(Writer, JournalVersion);
+
+	TArray<uint8> Payload;
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Data.Num());
+	Payload.SetNumUninitialized(CompressedSize);
+	uint8 bIsCompressed = FCompression::CompressMemory(NAME_Zlib, Payload.GetData(), CompressedSize, Data.GetData(), Data.Num()) && CompressedSize < Data.Num();
+	if (bIsCompressed)
+	{
+		Payload.SetNum(CompressedSize);
+	}
+	else
+	{
+		Payload = MoveTemp(Data);
+	}
+
+	uint32 Magic = RecordMagic;
+	int32 Size = Payload.Num();
+	int32 UncompressedSize = bIsCompressed ? Data.Num() : Size;
+	uint32 Crc = FCrc::MemCrc32(Payload.GetData(), Size);
+	*JournalWriter << Magic << Size << UncompressedSize << Crc << bIsCompressed;
+	JournalWriter->Serialize(Payload.GetData(), Size);
+
+	const double Now = FPlatformTime::Seconds();
+	if (bFlush || Now - LastFlushTime >= MaxFlushInterval)
+	{
+		JournalWriter->Flush();
+		LastFlushTime = Now;
+	}
+	if (JournalWriter->IsError())
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("Failed to append to %s, writing a snapshot instead."), *JournalFilename);
+		JournalWriter.Reset();
+	}
+}
+
+void FVFSaveJournal::Compact()
+{
+	const double StartTime = FPlatformTime::Seconds();
+	int64 SnapshotSize = 0;
+	if (!State.SaveToFile(SnapshotFilename, &SnapshotSize)) return;
+
+	//快照中已经包含所有记录，之后的记录从空的日志开始。清空之前崩溃时，日志中的记录因序号不大于快照而被跳过
+	const int64 JournalSize = JournalWriter ? JournalWriter->Tell() : 0;
+	OpenJournal();
+	UE_LOG(LogViewfinder, Verbose, TEXT("Compacted %.1f KB of journal into %s: %.1f KB in %.1f ms."),
+		JournalSize / 1024.f, *SnapshotFilename, SnapshotSize / 1024.f, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void FVFSaveJournal::OpenJournal()
+{
+	JournalWriter.Reset(IFileManager::Get().CreateFileWriter(*JournalFilename));
+	if (!JournalWriter)
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("Failed to open %s, each change will write a snapshot instead."), *JournalFilename);
+		return;
+	}
+
+	uint32 Magic = JournalMagic;
+	int32 Version = JournalVersion;
+	*JournalWriter << Magic << Version << State.JournalId;
+	JournalWriter->Flush();
+	LastFlushTime = FPlatformTime::Seconds();
+}
+
+bool FVFSaveJournal::Load(const FString& SnapshotFilename, const FString& JournalFilename, FVFSaveState& OutState, int32& OutNumReplayed)
+{
+	OutNumReplayed = 0;
+	FVFSaveState LoadedState;
+	if (!LoadedState.LoadFromFile(SnapshotFilename)) return false;
+	OutState = MoveTemp(LoadedState);
+
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*JournalFilename));
+	if (!Reader) return true;
+
+	uint32 Magic = 0;
+	int32 Version = 0;
+	FGuid JournalId;
+	*Reader << Magic << Version << JournalId;
+	if (Reader->IsError() || Magic != JournalMagic || Version < 1 || Version > JournalVersion || JournalId != OutState.JournalId)
+	{
+		UE_LOG(LogViewfinder, Warning, TEXT("%s does not belong to %s and is ignored."), *JournalFilename, *SnapshotFilename);
+		return true;
+	}
+
+	const int64 TotalSize = Reader->TotalSize();
+	while (Reader->Tell() < TotalSize)
+	{
+		const int64 RecordOffset = Reader->Tell();
+		auto StopReplay = [&](const TCHAR* Reason)
+		{
+			UE_LOG(LogViewfinder, Warning, TEXT("Stopped replaying %s at offset %lld: %s. %d records were replayed."), *JournalFilename, RecordOffset, Reason, OutNumReplayed);
+		};
+
+		int32 Size = 0;
+		int32 UncompressedSize = 0;
+		uint32 Crc = 0;
+		uint8 bIsCompressed = 0;
+		if (TotalSize - RecordOffset < RecordHeaderSize)
+		{
+			StopReplay(TEXT("incomplete record"));
+			break;
+		}
+		*Reader << Magic << Size << UncompressedSize << Crc << bIsCompressed;
+		if (Magic != RecordMagic || Size < 0 || UncompressedSize < 0 || UncompressedSize > MaxRecordSize || Size > TotalSize - Reader->Tell())
+		{
+			StopReplay(TEXT("incomplete record"));
+			break;
+		}
+
+		TArray<uint8> Payload;
+		Payload.SetNumUninitialized(Size);
+		Reader->Serialize(Payload.GetData(), Size);
+		if (Reader->IsError() || FCrc::MemCrc32(Payload.GetData(), Size) != Crc)
+		{
+			StopReplay(TEXT("checksum mismatch"));
+			break;
+		}
+
+		TArray<uint8> Data;
+		if (bIsCompressed)
+		{
+			Data.SetNumUninitialized(UncompressedSize);
+			if (!FCompression::UncompressMemory(NAME_Zlib, Data.GetData(), UncompressedSize, Payload.GetData(), Size))
+			{
+				StopReplay(TEXT("decompression failed"));
+				break;
+			}
+		}
+		else
+		{
+			Data = MoveTemp(Payload);
+		}
+
+		FVFSaveDelta Delta;
+		FMemoryReader DeltaReader(Data);
+		Delta.Serialize(DeltaReader, Version);
+		if (DeltaReader.IsError())
+		{
+			StopReplay(TEXT("corrupted record"));
+			break;
+		}
+
+		//已经压缩进快照的记录
+		if (Delta.Sequence <= OutState.Sequence) continue;
+		if (Delta.Sequence != OutState.Sequence + 1)
+		{
+			StopReplay(TEXT("missing records"));
+			break;
+		}
+		Delta.ApplyTo(OutState);
+		OutNumReplayed++;
+	}
+	return true;
+}
@@ -0,0 +1,408 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFSaveState.h"
+#include "VFSaveFile.h"
+#include "HAL/FileManager.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+namespace
+{
+	/**
+	 * World块的格式改变时增加，读取时兼容所有不高于当前版本的存档。
+	 * 版本2：增加日志ID与序号。
+	 * 版本3：切割生成的组件可以存储为相对于来源网格体资源的补丁。
+	 */
+	constexpr int32 WorldVersion = 3;
+
+	//快照中以块的索引引用，日志记录中直接写入数据
+	using FSerializeBlob = TFunctionRef<void(FArchive&, FVFSaveBlob&, EVFSaveChunkType)>;
+
+	//损坏的存档不应导致分配过多的内存
+	bool IsValidNum(FArchive& Ar, int32 Num)
+	{
+		if (Num < 0 || Num > Ar.TotalSize() - Ar.Tell())
+		{
+			Ar.SetError();
+			return false;
+		}
+		return true;
+	}
+
+	template<typename ElementType, typename FunctionType>
+	void SerializeArray(FArchive& Ar, TArray<ElementType>& Array, FunctionType&& SerializeElement)
+	{
+		int32 Num = Array.Num();
+		Ar << Num;
+		if (Ar.IsLoading())
+		{
+			if (!IsValidNum(Ar, Num)) return;
+			Array.SetNum(Num);
+		}
+		for (ElementType& Element : Array)
+		{
+			if (Ar.IsError()) return;
+			SerializeElement(Element);
+		}
+	}
+
+	template<typename ValueType, typename FunctionType>
+	void SerializeMap(FArchive& Ar, TMap<FString, ValueType>& Map, FunctionType&& SerializeValue)
+	{
+		int32 Num = Map.Num();
+		Ar << Num;
+		if (Ar.IsSaving())
+		{
+			for (TPair<FString, ValueType>& Pair : Map)
+			{
+				Ar << Pair.Key;
+				SerializeValue(Pair.Value);
+			}
+			return;
+		}
+
+		if (!IsValidNum(Ar, Num)) return;
+		Map.Reset();
+		for (int32 i = 0; i < Num && !Ar.IsError(); i++)
+		{
+			FString Key;
+			Ar << Key;
+			SerializeValue(Map.Add(MoveTemp(Key)));
+		}
+	}
+
+	void SerializeStrings(FArchive& Ar, TArray<FString>& Strings)
+	{
+		SerializeArray(Ar, Strings, [&Ar](FString& String) { Ar << String; });
+	}
+
+	void SerializeStaticMesh(FArchive& Ar, FVFSavedStaticMesh& StaticMesh, FSerializeBlob SerializeBlob)
+	{
+		Ar << StaticMesh.Path;
+		SerializeBlob(Ar, StaticMesh.Mesh, EVFSaveChunkType::Mesh);
+	}
+
+	//照片的ID不在其中，存档中所有照片的ID在照片之前
+	void SerializePhoto(FArchive& Ar, FVFSavedPhoto& Photo, FSerializeBlob SerializeBlob)
+	{
+		Ar << Photo.CaptureFOVAngle << Photo.MaxCaptureDistance << Photo.BackgroundDistance << Photo.CaptureSize << Photo.TakeTransformNoScale << Photo.PhotoClass;
+		SerializeBlob(Ar, Photo.RenderTarget, EVFSaveChunkType::Texture);
+		SerializeBlob(Ar, Photo.BackgroundRenderTarget, EVFSaveChunkType::Texture);
+
+		SerializeStrings(Ar, Photo.Materials);
+		Ar << Photo.MaterialIndices;
+		SerializeArray(Ar, Photo.Actors, [&Ar](FVFSavedPhoto::FActor& Actor)
+		{
+			Ar << Actor.Class << Actor.RelativeTransform << Actor.FirstComponent << Actor.NumComponents;
+		});
+		SerializeArray(Ar, Photo.Components, [&Ar, SerializeBlob](FVFSavedPhoto::FComponent& Component)
+		{
+			Ar << Component.Name;
+			SerializeStaticMesh(Ar, Component.StaticMesh, SerializeBlob);
+			Ar << Component.FirstMaterial << Component.NumMaterials << Component.bSimulatePhysics << Component.CollisionEnabled;
+		});
+		SerializeBlob(Ar, Photo.MeshRecord, EVFSaveChunkType::Mesh);
+		if (!Ar.IsLoading()) return;
+
+		//照片数据中的索引在放置时直接使用，不能越界
+		const bool bIsValid = !Photo.MaterialIndices.ContainsByPredicate([&Photo](int32 Index) { return !Photo.Materials.IsValidIndex(Index); })
+			&& !Photo.Actors.ContainsByPredicate([&Photo](const FVFSavedPhoto::FActor& Actor)
+			{
+				return Actor.FirstComponent < 0 || Actor.NumComponents < 0 || Actor.FirstComponent + Actor.NumComponents > Photo.Components.Num();
+			})
+			&& !Photo.Components.ContainsByPredicate([&Photo](const FVFSavedPhoto::FComponent& Component)
+			{
+				return Component.FirstMaterial < 0 || Component.NumMaterials < 0 || Component.FirstMaterial + Component.NumMaterials > Photo.MaterialIndices.Num();
+			});
+		if (!bIsValid)
+		{
+			Ar.SetError();
+		}
+	}
+
+	void SerializeActor(FArchive& Ar, FVFSavedActor& Actor, FSerializeBlob SerializeBlob)
+	{
+		Ar << Actor.Class << Actor.Transform;
+		SerializeArray(Ar, Actor.Components, [&Ar, SerializeBlob](FVFSavedComponent& Component)
+		{
+			Ar << Component.Name << Component.Transform << Component.bIsHidden << Component.bSimulatePhysics << Component.CollisionEnabled;
+			SerializeStaticMesh(Ar, Component.StaticMesh, SerializeBlob);
+			SerializeStrings(Ar, Component.Materials);
+			Ar << Component.Instances;
+		});
+	}
+
+	void SerializeGeneratedComponent(FArchive& Ar, FVFSavedGeneratedComponent& Component, bool bHasPatchSource, FSerializeBlob SerializeBlob)
+	{
+		Ar << Component.OwnerPath << Component.AttachParentName << Component.Transform;
+		if (bHasPatchSource)
+		{
+			Ar << Component.PatchSource;
+		}
+		SerializeBlob(Ar, Component.Mesh, Component.PatchSource.IsEmpty() ? EVFSaveChunkType::Mesh : EVFSaveChunkType::MeshPatch);
+		SerializeStrings(Ar, Component.Materials);
+		Ar << Component.CollisionEnabled;
+		for (uint8& Response : Component.CollisionResponses.EnumArray)
+		{
+			Ar << Response;
+		}
+		Ar << Component.bSimulatePhysics;
+	}
+
+	void SerializeBackgroundPhoto(FArchive& Ar, FVFSavedBackgroundPhoto& BackgroundPhoto, FSerializeBlob SerializeBlob)
+	{
+		Ar << BackgroundPhoto.Class << BackgroundPhoto.Transform;
+		SerializeBlob(Ar, BackgroundPhoto.Texture, EVFSaveChunkType::Texture);
+	}
+
+	void SerializeState(FArchive& Ar, FVFSaveState& State, FSerializeBlob SerializeBlob)
+	{
+		int32 Version = WorldVersion;
+		Ar << Version;
+		if (Ar.IsLoading() && (Version < 1 || Version > WorldVersion))
+		{
+			Ar.SetError();
+			return;
+		}
+
+		Ar << State.MapName << State.PawnTransform << State.ControlRotation;
+		if (Version >= 2)
+		{
+			Ar << State.JournalId << State.Sequence;
+		}
+
+		TArray<uint64> PhotoIds;
+		for (const FVFSavedPhoto& Photo : State.Photos)
+		{
+			PhotoIds.Emplace(Photo.PhotoId);
+		}
+		Ar << PhotoIds;
+		if (Ar.IsLoading())
+		{
+			State.Photos.Reset();
+			for (uint64 PhotoId : PhotoIds)
+			{
+				State.Photos.AddDefaulted_GetRef().PhotoId = PhotoId;
+			}
+		}
+		for (FVFSavedPhoto& Photo : State.Photos)
+		{
+			if (Ar.IsError()) return;
+			SerializePhoto(Ar, Photo, SerializeBlob);
+		}
+
+		TArray<FString> HiddenComponents = State.HiddenComponents.Array();
+		SerializeStrings(Ar, HiddenComponents);
+		State.HiddenComponents = TSet<FString>(HiddenComponents);
+		SerializeMap(Ar, State.InstancedComponents, [&Ar](TArray<FTransform>& Instances) { Ar << Instances; });
+
+		SerializeMap(Ar, State.SpawnedActors, [&Ar, SerializeBlob](FVFSavedActor& Actor) { SerializeActor(Ar, Actor, SerializeBlob); });
+		SerializeMap(Ar, State.GeneratedComponents, [&Ar, Version, SerializeBlob](FVFSavedGeneratedComponent& Component) { SerializeGeneratedComponent(Ar, Component, Version >= 3, SerializeBlob); });
+		SerializeMap(Ar, State.BackgroundPhotos, [&Ar, SerializeBlob](FVFSavedBackgroundPhoto& BackgroundPhoto) { SerializeBackgroundPhoto(Ar, BackgroundPhoto, SerializeBlob); });
+	}
+
+	void SerializeInlineBlob(FArchive& Ar, FVFSaveBlob& Blob, EVFSaveChunkType)
+	{
+		bool bIsValid = Blob.IsValid();
+		Ar << bIsValid;
+		if (Ar.IsSaving())
+		{
+			if (bIsValid)
+			{
+				Ar << const_cast<TArray<uint8>&>(*Blob.Data);
+			}
+			return;
+		}
+
+		Blob.Data.Reset();
+		if (bIsValid)
+		{
+			TArray<uint8> Data;
+			Ar << Data;
+			Blob.Data = MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data));
+		}
+	}
+}
+
+bool FVFSaveState::SaveToFile(const FString& Filename, int64* OutFileSize) const
+{
+	//相同的数据在状态中共享，按数据的地址去重
+	FVFSaveFileWriter Writer;
+	TMap<const TArray<uint8>*, int32> WrittenChunks;
+	auto WriteBlob = [&Writer, &WrittenChunks](FArchive& Ar, FVFSaveBlob& Blob, EVFSaveChunkType Type)
+	{
+		int32 ChunkIndex = INDEX_NONE;
+		if (Blob.IsValid())
+		{
+			if (const int32* WrittenChunk = WrittenChunks.Find(Blob.Data.Get()))
+			{
+				ChunkIndex = *WrittenChunk;
+			}
+			else
+			{
+				ChunkIndex = Writer.AddChunk(Type, *Blob.Data);
+				WrittenChunks.Add(Blob.Data.Get(), ChunkIndex);
+			}
+		}
+		Ar << ChunkIndex;
+	};
+
+	//纹理与网格体块在序列化时写入，World块最后写入，读取时由块表找到。写入不会改变状态
+	TArray<uint8> WorldData;
+	FMemoryWriter WorldWriter(WorldData);
+	SerializeState(WorldWriter, const_cast<FVFSaveState&>(*this), WriteBlob);
+	Writer.AddChunk(EVFSaveChunkType::World, WorldData);
+
+	const FString TempFilename = Filename + TEXT(".tmp");
+	if (!Writer.Save(TempFilename) || !IFileManager::Get().Move(*Filename, *TempFilename, true, true))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("Failed to write %s."), *Filename);
+		IFileManager::Get().Delete(*TempFilename);
+		return false;
+	}
+
+	if (OutFileSize)
+	{
+		*OutFileSize = Writer.GetTotalSize();
+	}
+	return true;
+}
+
+bool FVFSaveState::LoadFromFile(const FString& Filename)
+{
+	FVFSaveFileReader Reader;
+	if (!Reader.Open(Filename)) return false;
+
+	TArray<uint8> WorldData;
+	if (!Reader.LoadChunk(Reader.FindChunk(EVFSaveChunkType::World), WorldData))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("%s has no readable world chunk."), *Filename);
+		return false;
+	}
+
+	//同一个块只读取一次，读取后的数据与写入前一样被共享。类型不符或无法读取的块视为空
+	TMap<int32, FVFSaveBlob> ReadBlobs;
+	auto ReadBlob = [&Reader, &ReadBlobs](FArchive& Ar, FVFSaveBlob& Blob, EVFSaveChunkType Type)
+	{
+		int32 ChunkIndex = INDEX_NONE;
+		Ar << ChunkIndex;
+		Blob.Data.Reset();
+		if (ChunkIndex < 0 || ChunkIndex >= Reader.GetNumChunks() || Reader.GetChunkType(ChunkIndex) != Type) return;
+		if (const FVFSaveBlob* ReadBlob = ReadBlobs.Find(ChunkIndex))
+		{
+			Blob = *ReadBlob;
+			return;
+		}
+
+		TArray<uint8> Data;
+		if (Reader.LoadChunk(ChunkIndex, Data))
+		{
+			Blob.Data = MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data));
+		}
+		ReadBlobs.Add(ChunkIndex, Blob);
+	};
+
+	FVFSaveState State;
+	FMemoryReader WorldReader(WorldData);
+	SerializeState(WorldReader, State, ReadBlob);
+	if (WorldReader.IsError())
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("%s is corrupted or was written by a newer version."), *Filename);
+		return false;
+	}
+
+	*this = MoveTemp(State);
+	return true;
+}
+
+bool FVFSaveDelta::IsEmpty() const
+{
+	return AddedPhotos.IsEmpty() && RemovedPhotos.IsEmpty()
+		&& HiddenComponents.IsEmpty() && ShownComponents.IsEmpty() && InstancedComponents.IsEmpty()
+		&& SpawnedActors.IsEmpty() && RemovedSpawnedActors.IsEmpty()
+		&& GeneratedComponents.IsEmpty() && RemovedGeneratedComponents.IsEmpty() && RenamedGeneratedComponents.IsEmpty()
+		&& BackgroundPhotos.IsEmpty() && RemovedBackgroundPhotos.IsEmpty();
+}
+
+void FVFSaveDelta::ApplyTo(FVFSaveState& State) const
+{
+	if (bHasPawn)
+	{
+		State.PawnTransform = PawnTransform;
+		State.ControlRotation = ControlRotation;
+	}
+
+	//物品栏中的照片很少，按ID线性查找
+	for (uint64 PhotoId : RemovedPhotos)
+	{
+		State.Photos.RemoveAll([PhotoId](const FVFSavedPhoto& Photo) { return Photo.PhotoId == PhotoId; });
+	}
+	for (const FVFSavedPhoto& Photo : AddedPhotos)
+	{
+		State.Photos.RemoveAll([&Photo](const FVFSavedPhoto& Existing) { return Existing.PhotoId == Photo.PhotoId; });
+		State.Photos.Emplace(Photo);
+	}
+
+	for (const FString& Path : ShownComponents)
+	{
+		State.HiddenComponents.Remove(Path);
+	}
+	State.HiddenComponents.Append(HiddenComponents);
+	State.InstancedComponents.Append(InstancedComponents);
+
+	for (const FString& Path : RemovedSpawnedActors)
+	{
+		State.SpawnedActors.Remove(Path);
+	}
+	State.SpawnedActors.Append(SpawnedActors);
+
+	for (const FString& Path : RemovedGeneratedComponents)
+	{
+		State.GeneratedComponents.Remove(Path);
+	}
+	for (const TPair<FString, FString>& Rename : RenamedGeneratedComponents)
+	{
+		FVFSavedGeneratedComponent Component;
+		if (State.GeneratedComponents.RemoveAndCopyValue(Rename.Key, Component))
+		{
+			State.GeneratedComponents.Add(Rename.Value, MoveTemp(Component));
+		}
+	}
+	State.GeneratedComponents.Append(GeneratedComponents);
+
+	for (const FString& Path : RemovedBackgroundPhotos)
+	{
+		State.BackgroundPhotos.Remove(Path);
+	}
+	State.BackgroundPhotos.Append(BackgroundPhotos);
+
+	State.Sequence = Sequence;
+}
+
+void FVFSaveDelta::Serialize(FArchive& Ar, int32 JournalVersion)
+{
+	Ar << Sequence << bHasPawn << PawnTransform << ControlRotation;
+
+	SerializeArray(Ar, AddedPhotos, [&Ar](FVFSavedPhoto& Photo)
+	{
+		Ar << Photo.PhotoId;
+		SerializePhoto(Ar, Photo, SerializeInlineBlob);
+	});
+	Ar << RemovedPhotos;
+
+	SerializeStrings(Ar, HiddenComponents);
+	SerializeStrings(Ar, ShownComponents);
+	SerializeMap(Ar, InstancedComponents, [&Ar](TArray<FTransform>& Instances) { Ar << Instances; });
+
+	SerializeMap(Ar, SpawnedActors, [&Ar](FVFSavedActor& Actor) { SerializeActor(Ar, Actor, SerializeInlineBlob); });
+	SerializeStrings(Ar, RemovedSpawnedActors);
+
+	//日志版本2：切割生成的组件可以存储为补丁
+	SerializeMap(Ar, GeneratedComponents, [&Ar, JournalVersion](FVFSavedGeneratedComponent& Component) { SerializeGeneratedComponent(Ar, Component, JournalVersion >= 2, SerializeInlineBlob); });
+	SerializeStrings(Ar, RemovedGeneratedComponents);
+	SerializeArray(Ar, RenamedGeneratedComponents, [&Ar](TPair<FString, FString>& Rename) { Ar << Rename.Key << Rename.Value; });
+
+	SerializeMap(Ar, BackgroundPhotos, [&Ar](FVFSavedBackgroundPhoto& BackgroundPhoto) { SerializeBackgroundPhoto(Ar, BackgroundPhoto, SerializeInlineBlob); });
+	SerializeStrings(Ar, RemovedBackgroundPhotos);
+}
@@ -0,0 +1,1141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFSaveSubsystem.h"
+#include "VFComponent.h"
+#include "VFCutGeometrySubsystem.h"
+#include "VFMeshPatch.h"
+#include "VFPhotoTakerPlacerComponent.h"
+#include "VFPoolSubsystem.h"
+#include "VFSaveJournal.h"
+#include "VFScratchMeshPool.h"
+#include "VFTextureCodec.h"
+#include "Components/DynamicMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "GeometryScript/MeshAssetFunctions.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeExit.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "UDynamicMesh.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+using namespace UE::Geometry;
+
+namespace
+{
+	const TCHAR* DefaultSlotName = TEXT("Quicksave");
+
+	const FName GeneratedTag("VFGenerated");
+	const FName HiddenTag("VFHidden");
+	const FName SpawnedTag("VFSpawned");
+	const FName BackgroundTag("VFBackground");
+
+	FString GetObjectPath(const UObject* Object)
+	{
+		return Object ? FSoftObjectPath(Object).ToString() : FString();
+	}
+
+	template<typename T>
+	T* LoadObjectPath(const FString& Path)
+	{
+		return Path.IsEmpty() ? nullptr : Cast<T>(FSoftObjectPath(Path).TryLoad());
+	}
+
+	template<typename T>
+	TSubclassOf<T> LoadClassPath(const FString& Path)
+	{
+		return Path.IsEmpty() ? nullptr : FSoftClassPath(Path).TryLoadClass<T>();
+	}
+
+	void GetComponentMaterials(const UPrimitiveComponent* Component, TArray<FString>& OutMaterials)
+	{
+		for (int32 i = 0; i < Component->GetNumMaterials(); i++)
+		{
+			OutMaterials.Emplace(GetObjectPath(Component->GetMaterial(i)));
+		}
+	}
+
+	void SetComponentMaterials(UPrimitiveComponent* Component, const TArray<FString>& Materials)
+	{
+		for (int32 i = 0; i < Materials.Num(); i++)
+		{
+			UMaterialInterface* Material = LoadObjectPath<UMaterialInterface>(Materials[i]);
+			if (Component->GetMaterial(i) != Material)
+			{
+				Component->SetMaterial(i, Material);
+			}
+		}
+	}
+
+	void GetInstances(const UInstancedStaticMeshComponent* Component, TArray<FTransform>& OutInstances)
+	{
+		for (int32 i = 0; i < Component->GetInstanceCount(); i++)
+		{
+			Component->GetInstanceTransform(i, OutInstances.AddDefaulted_GetRef(), false);
+		}
+	}
+
+	//被撤销后缓存或归还到对象池的Actor与组件是隐藏的，池中的组件没有标签
+	bool IsActiveGeneratedComponent(const UPrimitiveComponent* Component)
+	{
+		return IsValid(Component) && !Component->IsBeingDestroyed() && Component->ComponentHasTag(GeneratedTag) && Component->IsVisible()
+			&& Component->GetOwner() && !Component->GetOwner()->IsHidden();
+	}
+
+	bool IsActiveActor(const AActor* Actor, FName Tag)
+	{
+		return IsValid(Actor) && !Actor->IsActorBeingDestroyed() && Actor->ActorHasTag(Tag) && !Actor->IsHidden();
+	}
+
+	//与放置时隐藏被切割的组件相同
+	void HideCutComponent(UPrimitiveComponent* Component)
+	{
+		Component->SetVisibility(false);
+		Component->SetGenerateOverlapEvents(false);
+		Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Component->ComponentTags.AddUnique(HiddenTag);
+	}
+
+	//被压缩的地图根组件只保留了组件本身，无法再显示
+	bool IsCompactedComponent(const UPrimitiveComponent* Component)
+	{
+		if (const UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+		{
+			return !StaticMeshComponent->GetStaticMesh();
+		}
+		if (const UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+		{
+			return DynamicMeshComponent->GetMesh()->TriangleCount() == 0;
+		}
+		return false;
+	}
+
+	UVFComponent* FindPlayerVFComponent(UWorld* World)
+	{
+		APlayerController* PlayerController = World->GetFirstPlayerController();
+		APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+		return Pawn ? Pawn->FindComponentByClass<UVFComponent>() : nullptr;
+	}
+}
+
+void UVFSaveSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	//上一次运行没有正常结束时，自动存档中依然有它最后的状态。开始新的自动存档之前可以读取它
+	if (bEnableAutosave && InWorld.IsGameWorld() && !IsRunningCommandlet() && IFileManager::Get().FileExists(*GetSaveFilename(AutosaveSlotName)))
+	{
+		UE_LOG(LogViewfinder, Display, TEXT("An autosave exists, use \"vf.Load %s\" before taking or placing a photo to restore it."), *AutosaveSlotName);
+	}
+}
+
+void UVFSaveSubsystem::Deinitialize()
+{
+	AutosaveJournal.Reset();
+	Super::Deinitialize();
+}
+
+bool UVFSaveSubsystem::SaveGame(const FString& SlotName)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	FVFSaveState State;
+	if (!CaptureState(State))
+	{
+		UE_LOG(LogViewfinder, Warning, TEXT("Cannot save: the first player has no viewfinder component."));
+		return false;
+	}
+
+	const int32 NumPhotos = State.Photos.Num();
+	const int32 NumSpawnedActors = State.SpawnedActors.Num();
+	const int32 NumGeneratedComponents = State.GeneratedComponents.Num();
+	const FString Filename = GetSaveFilename(SlotName);
+	int64 FileSize = 0;
+	if (AutosaveJournal && SlotName == AutosaveSlotName)
+	{
+		//自动存档的文件由日志在后台写入，以这次的状态开始新的日志
+		AutosaveJournal->Reset(MoveTemp(State));
+		AutosaveJournal->Flush();
+		FileSize = IFileManager::Get().FileSize(*Filename);
+	}
+	else if (!State.SaveToFile(Filename, &FileSize))
+	{
+		return false;
+	}
+
+	UE_LOG(LogViewfinder, Display, TEXT("Saved %d photos, %d spawned actors and %d generated components to %s: %.1f KB in %.1f ms."),
+		NumPhotos, NumSpawnedActors, NumGeneratedComponents, *Filename, FileSize / 1024.f, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	return true;
+}
+
+bool UVFSaveSubsystem::LoadGame(const FString& SlotName)
+{
+	UWorld* World = GetWorld();
+	UVFComponent* VFComponent = FindPlayerVFComponent(World);
+	if (!VFComponent)
+	{
+		UE_LOG(LogViewfinder, Warning, TEXT("Cannot load: the first player has no viewfinder component."));
+		return false;
+	}
+
+	//自动存档的日志可能正在后台写入同一个文件
+	FlushAutosave();
+
+	//先读取全部内容，存档损坏时不改变地图
+	const double StartTime = FPlatformTime::Seconds();
+	const FString Filename = GetSaveFilename(SlotName);
+	FVFSaveState State;
+	int32 NumReplayed = 0;
+	if (!FVFSaveJournal::Load(Filename, GetJournalFilename(SlotName), State, NumReplayed))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("Failed to load %s."), *Filename);
+		return false;
+	}
+	const FString MapName = UWorld::RemovePIEPrefix(World->GetOutermost()->GetName());
+	if (State.MapName != MapName)
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("%s was saved in %s and cannot be loaded in %s."), *Filename, *State.MapName, *MapName);
+		return false;
+	}
+
+	//存档中的放置结果基于未被放置改变的地图，先撤销当前的放置
+	if (!RevertPlacements(State, VFComponent))
+	{
+		UE_LOG(LogViewfinder, Error, TEXT("Failed to load %s: the map has changes that cannot be reverted."), *Filename);
+		return false;
+	}
+	ApplyState(State, VFComponent);
+	UE_LOG(LogViewfinder, Display, TEXT("Loaded %d photos, %d spawned actors and %d generated components from %s with %d journal records in %.1f ms."),
+		State.Photos.Num(), State.SpawnedActors.Num(), State.GeneratedComponents.Num(), *Filename, NumReplayed, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+	//读取后生成的对象的路径与存档中不同，之后的记录只能基于重新生成的快照
+	AutosaveJournal.Reset();
+	BeginAutosave();
+	return true;
+}
+
+FString UVFSaveSubsystem::GetSaveFilename(const FString& SlotName)
+{
+	return FPaths::ProjectSavedDir() / TEXT("SaveGames") / SlotName + TEXT(".vfsave");
+}
+
+FString UVFSaveSubsystem::GetJournalFilename(const FString& SlotName)
+{
+	return FPaths::ProjectSavedDir() / TEXT("SaveGames") / SlotName + TEXT(".vfjournal");
+}
+
+void UVFSaveSubsystem::AddDestroyedComponent(UPrimitiveComponent* Component)
+{
+	if (Component && !Component->GetOwner()->ActorHasTag(SpawnedTag))
+	{
+		DestroyedComponentPaths.AddUnique(GetRelativePath(Component));
+	}
+}
+
+void UVFSaveSubsystem::AddModifiedInstances(UInstancedStaticMeshComponent* Component)
+{
+	if (Component && !ModifiedInstancedComponents.Contains(Component))
+	{
+		GetInstances(Component, ModifiedInstancedComponents.Add(Component));
+	}
+}
+
+bool UVFSaveSubsystem::BeginAutosave()
+{
+	if (AutosaveJournal) return true;
+	if (!bEnableAutosave || !GetWorld()->IsGameWorld() || IsRunningCommandlet()) return false;
+
+	//第一次改变之前的状态作为日志的基础，之后每次只记录改变
+	FVFSaveState State;
+	if (!CaptureState(State)) return false;
+
+	AutosaveJournal = MakeShared<FVFSaveJournal>(GetSaveFilename(AutosaveSlotName), GetJournalFilename(AutosaveSlotName), (int64)MaxJournalSizeKB * 1024);
+	AutosaveJournal->Reset(MoveTemp(State));
+	return true;
+}
+
+void UVFSaveSubsystem::FlushAutosave()
+{
+	if (AutosaveJournal)
+	{
+		AutosaveJournal->Flush();
+	}
+}
+
+bool UVFSaveSubsystem::CaptureState(FVFSaveState& OutState)
+{
+	UWorld* World = GetWorld();
+	UVFComponent* VFComponent = FindPlayerVFComponent(World);
+	if (!VFComponent) return false;
+
+	ON_SCOPE_EXIT
+	{
+		CapturedBlobs.Reset();
+	};
+
+	APawn* Pawn = CastChecked<APawn>(VFComponent->GetOwner());
+	OutState.MapName = UWorld::RemovePIEPrefix(World->GetOutermost()->GetName());
+	OutState.PawnTransform = Pawn->GetActorTransform();
+	OutState.ControlRotation = Pawn->GetControlRotation();
+
+	for (const FVFPhotoInfo& Photo : VFComponent->GetPhotos())
+	{
+		CapturePhoto(Photo, OutState.Photos.AddDefaulted_GetRef());
+	}
+
+	OutState.HiddenComponents.Append(DestroyedComponentPaths);
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		AActor* Actor = *It;
+		const bool bIsSpawned = Actor->ActorHasTag(SpawnedTag);
+		if (IsActiveActor(Actor, SpawnedTag))
+		{
+			CaptureSpawnedActor(Actor, OutState.SpawnedActors.Add(GetRelativePath(Actor)));
+		}
+		else if (IsActiveActor(Actor, BackgroundTag))
+		{
+			if (AVFPhoto* BackgroundPhoto = Cast<AVFPhoto>(Actor))
+			{
+				CaptureBackgroundPhoto(BackgroundPhoto, OutState.BackgroundPhotos.Add(GetRelativePath(Actor)));
+			}
+		}
+
+		TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			if (IsActiveGeneratedComponent(Component))
+			{
+				CaptureGeneratedComponent(Component, OutState.GeneratedComponents.Add(GetRelativePath(Component)));
+			}
+			//照片中生成的Actor的组件与Actor一起存储
+			else if (!bIsSpawned && !Component->ComponentHasTag(GeneratedTag) && Component->ComponentHasTag(HiddenTag))
+			{
+				OutState.HiddenComponents.Add(GetRelativePath(Component));
+			}
+		}
+	}
+
+	for (const TPair<TWeakObjectPtr<UInstancedStaticMeshComponent>, TArray<FTransform>>& ModifiedComponent : ModifiedInstancedComponents)
+	{
+		UInstancedStaticMeshComponent* Component = ModifiedComponent.Key.Get();
+		if (Component && !Component->GetOwner()->ActorHasTag(SpawnedTag))
+		{
+			GetInstances(Component, OutState.InstancedComponents.Add(GetRelativePath(Component)));
+		}
+	}
+	return true;
+}
+
+bool UVFSaveSubsystem::RevertPlacements(const FVFSaveState& State, UVFComponent* VFComponent)
+{
+	UWorld* World = GetWorld();
+
+	//先检查，无法还原时不改变地图
+	const TSet<FString> SavedHiddenComponents(State.HiddenComponents);
+	for (const FString& Path : DestroyedComponentPaths)
+	{
+		if (!SavedHiddenComponents.Contains(Path))
+		{
+			UE_LOG(LogViewfinder, Error, TEXT("%s was compacted after its placement left the rewind window but is visible in the save."), *Path);
+			return false;
+		}
+	}
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		if (It->ActorHasTag(SpawnedTag)) continue;
+
+		TInlineComponentArray<UPrimitiveComponent*> Components(*It);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			if (!Component->ComponentHasTag(GeneratedTag) && Component->ComponentHasTag(HiddenTag) && IsCompactedComponent(Component)
+				&& !SavedHiddenComponents.Contains(GetRelativePath(Component)))
+			{
+				UE_LOG(LogViewfinder, Error, TEXT("%s was compacted after its placement left the rewind window but is visible in the save."), *GetRelativePath(Component));
+				return false;
+			}
+		}
+	}
+
+	//回溯记录与缓存中的放置结果会被下面的操作销毁或归还，先丢弃对它们的引用，被撤销后缓存的放置在这里释放
+	VFComponent->ResetPlacements();
+
+	UVFPoolSubsystem* PoolSubsystem = World->GetSubsystem<UVFPoolSubsystem>();
+	UVFCutGeometrySubsystem* CutGeometrySubsystem = World->GetSubsystem<UVFCutGeometrySubsystem>();
+	for (const TPair<TWeakObjectPtr<UInstancedStaticMeshComponent>, TArray<FTransform>>& ModifiedComponent : ModifiedInstancedComponents)
+	{
+		UInstancedStaticMeshComponent* Component = ModifiedComponent.Key.Get();
+		if (IsValid(Component) && !Component->GetOwner()->ActorHasTag(SpawnedTag))
+		{
+			Component->ClearInstances();
+			Component->AddInstances(ModifiedComponent.Value, false, false);
+			CutGeometrySubsystem->TouchContent(Component);
+		}
+	}
+	ModifiedInstancedComponents.Reset();
+
+	int32 NumSpawnedActors = 0;
+	int32 NumGeneratedComponents = 0;
+	int32 NumHiddenComponents = 0;
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		AActor* Actor = *It;
+		if (!IsValid(Actor) || Actor->IsActorBeingDestroyed()) continue;
+
+		//与释放放置结果相同，照片中的Actor被切割生成的组件随Actor一起销毁
+		TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+		if (Actor->ActorHasTag(SpawnedTag))
+		{
+			for (UPrimitiveComponent* Component : Components)
+			{
+				CutGeometrySubsystem->SetMeshPatch(Component, nullptr);
+			}
+			Actor->Destroy();
+			NumSpawnedActors++;
+			continue;
+		}
+		if (IsActiveActor(Actor, BackgroundTag))
+		{
+			PoolSubsystem->ReleaseActor(Actor);
+			continue;
+		}
+
+		for (UPrimitiveComponent* Component : Components)
+		{
+			if (!IsValid(Component) || Component->IsBeingDestroyed()) continue;
+
+			if (Component->ComponentHasTag(GeneratedTag))
+			{
+				CutGeometrySubsystem->SetMeshPatch(Component, nullptr);
+				PoolSubsystem->ReleaseComponent(Component);
+				NumGeneratedComponents++;
+			}
+			//与撤销放置时显示被隐藏的组件相同，被压缩的组件在存档中同样被隐藏
+			else if (Component->ComponentHasTag(HiddenTag) && !IsCompactedComponent(Component))
+			{
+				CutGeometrySubsystem->RestorePatchedMesh(Component);
+				Component->SetVisibility(true);
+				Component->SetGenerateOverlapEvents(true);
+				Component->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+				Component->ComponentTags.Remove(HiddenTag);
+				NumHiddenComponents++;
+			}
+		}
+	}
+
+	UE_LOG(LogViewfinder, Display, TEXT("Reverted %d spawned actors, %d generated components and %d hidden components before loading."),
+		NumSpawnedActors, NumGeneratedComponents, NumHiddenComponents);
+	return true;
+}
+
+void UVFSaveSubsystem::ApplyState(const FVFSaveState& State, UVFComponent* VFComponent)
+{
+	UWorld* World = GetWorld();
+	ON_SCOPE_EXIT
+	{
+		RestoredObjects.Reset();
+		RestoredStaticMeshes.Reset();
+	};
+
+	for (const FString& Path : State.HiddenComponents)
+	{
+		if (UPrimitiveComponent* Component = Cast<UPrimitiveComponent>(FindRelativeObject(Path)))
+		{
+			HideCutComponent(Component);
+		}
+	}
+	for (const TPair<FString, TArray<FTransform>>& SavedComponent : State.InstancedComponents)
+	{
+		if (UInstancedStaticMeshComponent* Component = Cast<UInstancedStaticMeshComponent>(FindRelativeObject(SavedComponent.Key)))
+		{
+			AddModifiedInstances(Component);
+			Component->ClearInstances();
+			Component->AddInstances(SavedComponent.Value, false, false);
+			World->GetSubsystem<UVFCutGeometrySubsystem>()->TouchContent(Component);
+		}
+	}
+
+	//生成的Actor的名称与存档时不同，生成的组件按存档中的路径找到它们
+	TMap<FString, AActor*> SpawnedActors;
+	for (const TPair<FString, FVFSavedActor>& SavedActorPair : State.SpawnedActors)
+	{
+		const FVFSavedActor& SavedActor = SavedActorPair.Value;
+		TSubclassOf<AActor> Class = LoadClassPath<AActor>(SavedActor.Class);
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		AActor* Actor = Class ? World->SpawnActor(Class, &SavedActor.Transform, SpawnParameters) : nullptr;
+		if (!Actor) continue;
+		Actor->Tags.AddUnique(SpawnedTag);
+		SpawnedActors.Add(SavedActorPair.Key, Actor);
+
+		TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			//存档中没有的组件已经被压缩销毁
+			const FVFSavedComponent* SavedComponent = SavedActor.Components.FindByPredicate([Component](const FVFSavedComponent& Saved) { return Saved.Name == Component->GetFName(); });
+			if (!SavedComponent || SavedComponent->bIsHidden)
+			{
+				HideCutComponent(Component);
+				continue;
+			}
+
+			const EComponentMobility::Type PrevMobility = Component->Mobility;
+			Component->SetMobility(EComponentMobility::Movable);
+			if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+			{
+				StaticMeshComponent->SetStaticMesh(RestoreStaticMesh(SavedComponent->StaticMesh));
+			}
+			if (UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(Component))
+			{
+				InstancedComponent->ClearInstances();
+				InstancedComponent->AddInstances(SavedComponent->Instances, false, false);
+				World->GetSubsystem<UVFCutGeometrySubsystem>()->TouchContent(InstancedComponent);
+			}
+			SetComponentMaterials(Component, SavedComponent->Materials);
+			Component->SetWorldTransform(SavedComponent->Transform, false, nullptr, ETeleportType::ResetPhysics);
+			Component->SetMobility(PrevMobility);
+			Component->SetCollisionEnabled((ECollisionEnabled::Type)SavedComponent->CollisionEnabled);
+			Component->SetSimulatePhysics(SavedComponent->bSimulatePhysics);
+			Component->SetGenerateOverlapEvents(true);
+		}
+	}
+
+	UVFPoolSubsystem* PoolSubsystem = World->GetSubsystem<UVFPoolSubsystem>();
+	UVFCutGeometrySubsystem* CutGeometrySubsystem = World->GetSubsystem<UVFCutGeometrySubsystem>();
+	TArray<UPrimitiveComponent*> GeneratedComponents;
+	for (const TPair<FString, FVFSavedGeneratedComponent>& SavedComponentPair : State.GeneratedComponents)
+	{
+		const FVFSavedGeneratedComponent& SavedComponent = SavedComponentPair.Value;
+		AActor* Owner = SpawnedActors.FindRef(SavedComponent.OwnerPath);
+		if (!Owner)
+		{
+			Owner = Cast<AActor>(FindRelativeObject(SavedComponent.OwnerPath));
+		}
+		TSharedPtr<FVFMeshPatch> Patch;
+		FDynamicMesh3 Mesh;
+		if (!Owner) continue;
+		if (!(SavedComponent.PatchSource.IsEmpty() ? DecodeMesh(SavedComponent.Mesh, Mesh) : RestoreMeshPatch(SavedComponent, Mesh, Patch))) continue;
+
+		UDynamicMeshComponent* Component = PoolSubsystem->AcquireComponent<UDynamicMeshComponent>(Owner);
+		if (!Component) continue;
+
+		//与放置时生成组件的设置相同，只是网格体来自存档
+		Component->ComponentTags.Emplace(GeneratedTag);
+		Component->SetWorldTransform(SavedComponent.Transform);
+		Component->GetDynamicMesh()->SetMesh(MoveTemp(Mesh));
+		CutGeometrySubsystem->SetMeshPatch(Component, Patch);
+		CutGeometrySubsystem->TouchContent(Component);
+
+		USceneComponent* AttachParent = Owner->GetRootComponent();
+		TInlineComponentArray<USceneComponent*> SceneComponents(Owner);
+		for (USceneComponent* SceneComponent : SceneComponents)
+		{
+			if (SceneComponent != Component && SceneComponent->GetFName() == SavedComponent.AttachParentName)
+			{
+				AttachParent = SceneComponent;
+				break;
+			}
+		}
+		Component->AttachToComponent(AttachParent, FAttachmentTransformRules::KeepWorldTransform);
+		Component->SetCollisionResponseToChannels(SavedComponent.CollisionResponses);
+		Component->SetCollisionEnabled((ECollisionEnabled::Type)SavedComponent.CollisionEnabled);
+		Component->SetGenerateOverlapEvents(true);
+		Component->SetSimulatePhysics(SavedComponent.bSimulatePhysics);
+		if (!SavedComponent.bSimulatePhysics)
+		{
+			Component->EnableComplexAsSimpleCollision();
+		}
+		SetComponentMaterials(Component, SavedComponent.Materials);
+		Component->UpdateCollision(false);
+		GeneratedComponents.Emplace(Component);
+	}
+
+	//读取的放置已经无法回溯，生成的组件可以立即合并与烘焙
+	CutGeometrySubsystem->RequestMerge(GeneratedComponents);
+	CutGeometrySubsystem->RequestBake(GeneratedComponents, 0.f);
+
+	for (const TPair<FString, FVFSavedBackgroundPhoto>& SavedBackgroundPhotoPair : State.BackgroundPhotos)
+	{
+		const FVFSavedBackgroundPhoto& SavedBackgroundPhoto = SavedBackgroundPhotoPair.Value;
+		TSubclassOf<AVFPhoto> Class = LoadClassPath<AVFPhoto>(SavedBackgroundPhoto.Class);
+		AVFPhoto* BackgroundPhoto = Class ? Cast<AVFPhoto>(PoolSubsystem->AcquireActor(Class, SavedBackgroundPhoto.Transform)) : nullptr;
+		if (!BackgroundPhoto) continue;
+
+		BackgroundPhoto->Tags.AddUnique(BackgroundTag);
+		BackgroundPhoto->SetRenderTarget(RestoreTexture(SavedBackgroundPhoto.Texture));
+		BackgroundPhoto->GetPhotoMesh()->SetCollisionProfileName(FName("OverlapAll"));
+		BackgroundPhoto->GetPhotoMesh()->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+		BackgroundPhoto->GetPhotoMesh()->SetGenerateOverlapEvents(true);
+		BackgroundPhoto->GetPhotoMesh()->SetHiddenInSceneCapture(false);
+	}
+
+	TArray<FVFPhotoInfo> Photos;
+	for (const FVFSavedPhoto& SavedPhoto : State.Photos)
+	{
+		FVFPhotoInfo& Photo = Photos.AddDefaulted_GetRef();
+		Photo.PhotoId = SavedPhoto.PhotoId;
+		Photo.Payload = RestorePhoto(SavedPhoto);
+	}
+	VFComponent->RestorePhotos(Photos);
+
+	APawn* Pawn = CastChecked<APawn>(VFComponent->GetOwner());
+	Pawn->SetActorTransform(State.PawnTransform, false, nullptr, ETeleportType::ResetPhysics);
+	if (AController* Controller = Pawn->GetController())
+	{
+		Controller->SetControlRotation(State.ControlRotation);
+	}
+}
+
+void UVFSaveSubsystem::AppendAutosave(const FVFAutosaveScope& Scope)
+{
+	if (!AutosaveJournal) return;
+
+	ON_SCOPE_EXIT
+	{
+		CapturedBlobs.Reset();
+	};
+
+	FVFSaveDelta Delta;
+	for (const FVFPhotoInfo& Photo : Scope.AddedPhotos)
+	{
+		CapturePhoto(Photo, Delta.AddedPhotos.AddDefaulted_GetRef());
+	}
+	Delta.RemovedPhotos = Scope.RemovedPhotos;
+	Delta.RenamedGeneratedComponents = Scope.RenamedComponents;
+
+	//对象在作用域结束时的状态，已经被销毁或回收的对象被移除
+	for (const FVFAutosaveScope::FTouchedObject& TouchedObject : Scope.TouchedObjects)
+	{
+		UObject* Object = TouchedObject.Object.Get();
+		switch (TouchedObject.Kind)
+		{
+		case FVFAutosaveScope::EObjectKind::SpawnedActor:
+		{
+			AActor* Actor = Cast<AActor>(Object);
+			if (IsActiveActor(Actor, SpawnedTag))
+			{
+				CaptureSpawnedActor(Actor, Delta.SpawnedActors.Add(TouchedObject.Path));
+			}
+			else
+			{
+				Delta.RemovedSpawnedActors.Emplace(TouchedObject.Path);
+			}
+			break;
+		}
+		case FVFAutosaveScope::EObjectKind::BackgroundPhoto:
+		{
+			AVFPhoto* BackgroundPhoto = Cast<AVFPhoto>(Object);
+			if (IsActiveActor(BackgroundPhoto, BackgroundTag))
+			{
+				CaptureBackgroundPhoto(BackgroundPhoto, Delta.BackgroundPhotos.Add(TouchedObject.Path));
+			}
+			else
+			{
+				Delta.RemovedBackgroundPhotos.Emplace(TouchedObject.Path);
+			}
+			break;
+		}
+		case FVFAutosaveScope::EObjectKind::GeneratedComponent:
+		{
+			UPrimitiveComponent* Component = Cast<UPrimitiveComponent>(Object);
+			if (IsActiveGeneratedComponent(Component))
+			{
+				CaptureGeneratedComponent(Component, Delta.GeneratedComponents.Add(TouchedObject.Path));
+			}
+			else
+			{
+				Delta.RemovedGeneratedComponents.Emplace(TouchedObject.Path);
+			}
+			break;
+		}
+		case FVFAutosaveScope::EObjectKind::InstancedComponent:
+		{
+			if (UInstancedStaticMeshComponent* Component = Cast<UInstancedStaticMeshComponent>(Object))
+			{
+				GetInstances(Component, Delta.InstancedComponents.Add(TouchedObject.Path));
+			}
+			break;
+		}
+		case FVFAutosaveScope::EObjectKind::LevelComponent:
+		{
+			//被压缩销毁的组件依然是隐藏的
+			UPrimitiveComponent* Component = Cast<UPrimitiveComponent>(Object);
+			if (!Component || Component->ComponentHasTag(HiddenTag))
+			{
+				Delta.HiddenComponents.Emplace(TouchedObject.Path);
+			}
+			else
+			{
+				Delta.ShownComponents.Emplace(TouchedObject.Path);
+			}
+			break;
+		}
+		}
+	}
+	if (Delta.IsEmpty()) return;
+
+	if (UVFComponent* VFComponent = FindPlayerVFComponent(GetWorld()))
+	{
+		APawn* Pawn = CastChecked<APawn>(VFComponent->GetOwner());
+		Delta.bHasPawn = true;
+		Delta.PawnTransform = Pawn->GetActorTransform();
+		Delta.ControlRotation = Pawn->GetControlRotation();
+	}
+	AutosaveJournal->Append(MoveTemp(Delta));
+}
+
+void UVFSaveSubsystem::CapturePhoto(const FVFPhotoInfo& Photo, FVFSavedPhoto& OutPhoto)
+{
+	const FVFPhotoPayload& Payload = *Photo.Payload;
+	const FVFAPhotoTakeParams& Params = Payload.PhotoTakeParams;
+	OutPhoto.PhotoId = Photo.PhotoId;
+	OutPhoto.CaptureFOVAngle = Params.CaptureFOVAngle;
+	OutPhoto.MaxCaptureDistance = Params.MaxCaptureDistance;
+	OutPhoto.BackgroundDistance = Params.BackgroundDistance;
+	OutPhoto.CaptureSize = Params.CaptureSize;
+	OutPhoto.TakeTransformNoScale = Params.TakeTransformNoScale;
+	OutPhoto.PhotoClass = GetObjectPath(Params.PhotoClass.Get());
+
+	OutPhoto.RenderTarget = CaptureTexture(Payload.RenderTarget);
+	OutPhoto.BackgroundRenderTarget = CaptureTexture(Payload.BackgroundRenderTarget);
+
+	for (UMaterialInterface* Material : Payload.Materials)
+	{
+		OutPhoto.Materials.Emplace(GetObjectPath(Material));
+	}
+	OutPhoto.MaterialIndices = Payload.MaterialIndices;
+	for (const FVFActorSnapshot& ActorSnapshot : Payload.ActorSnapshots)
+	{
+		FVFSavedPhoto::FActor& Actor = OutPhoto.Actors.AddDefaulted_GetRef();
+		Actor.Class = GetObjectPath(ActorSnapshot.Class.Get());
+		Actor.RelativeTransform = ActorSnapshot.RelativeTransform;
+		Actor.FirstComponent = ActorSnapshot.FirstComponent;
+		Actor.NumComponents = ActorSnapshot.NumComponents;
+	}
+	for (const FVFComponentSnapshot& ComponentSnapshot : Payload.ComponentSnapshots)
+	{
+		FVFSavedPhoto::FComponent& Component = OutPhoto.Components.AddDefaulted_GetRef();
+		Component.Name = ComponentSnapshot.ComponentName;
+		Component.StaticMesh = CaptureStaticMesh(ComponentSnapshot.StaticMesh);
+		Component.FirstMaterial = ComponentSnapshot.FirstMaterial;
+		Component.NumMaterials = ComponentSnapshot.NumMaterials;
+		Component.bSimulatePhysics = ComponentSnapshot.bSimulatePhysics;
+		Component.CollisionEnabled = ComponentSnapshot.CollisionEnabled;
+	}
+
+	//网格体记录是放置时唯一需要的几何体，读取后不需要重新拍摄
+	OutPhoto.MeshRecord = CaptureMesh(Payload.DynamicMeshRecord);
+}
+
+void UVFSaveSubsystem::CaptureSpawnedActor(AActor* Actor, FVFSavedActor& OutActor)
+{
+	OutActor.Class = GetObjectPath(Actor->GetClass());
+	OutActor.Transform = Actor->GetActorTransform();
+
+	//切割生成的组件单独存储
+	TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+	for (UPrimitiveComponent* Component : Components)
+	{
+		if (Component->ComponentHasTag(GeneratedTag)) continue;
+
+		FVFSavedComponent& SavedComponent = OutActor.Components.AddDefaulted_GetRef();
+		SavedComponent.Name = Component->GetFName();
+		SavedComponent.Transform = Component->GetComponentTransform();
+		SavedComponent.bIsHidden = Component->ComponentHasTag(HiddenTag);
+		SavedComponent.bSimulatePhysics = Component->IsSimulatingPhysics();
+		SavedComponent.CollisionEnabled = Component->GetCollisionEnabled();
+		GetComponentMaterials(Component, SavedComponent.Materials);
+		if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+		{
+			SavedComponent.StaticMesh = CaptureStaticMesh(StaticMeshComponent->GetStaticMesh());
+		}
+		if (UInstancedStaticMeshComponent* InstancedComponent = Cast<UInstancedStaticMeshComponent>(Component))
+		{
+			GetInstances(InstancedComponent, SavedComponent.Instances);
+		}
+	}
+}
+
+void UVFSaveSubsystem::CaptureGeneratedComponent(UPrimitiveComponent* Component, FVFSavedGeneratedComponent& OutComponent)
+{
+	OutComponent.OwnerPath = GetRelativePath(Component->GetOwner());
+	OutComponent.AttachParentName = Component->GetAttachParent() ? Component->GetAttachParent()->GetFName() : NAME_None;
+	OutComponent.Transform = Component->GetComponentTransform();
+	GetComponentMaterials(Component, OutComponent.Materials);
+	OutComponent.CollisionEnabled = Component->GetCollisionEnabled();
+	OutComponent.CollisionResponses = Component->GetCollisionResponseToChannels();
+	OutComponent.bSimulatePhysics = Component->IsSimulatingPhysics();
+
+	//有补丁的组件只存储补丁，来源网格体资源以路径引用
+	const TSharedPtr<const FVFMeshPatch> Patch = GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>()->GetMeshPatch(Component);
+	UStaticMesh* PatchSource = Patch ? Patch->SourceMesh.Get() : nullptr;
+	if (PatchSource && PatchSource->IsAsset())
+	{
+		TArray<uint8> Data;
+		FMemoryWriter PatchWriter(Data);
+		const_cast<FVFMeshPatch&>(*Patch).Serialize(PatchWriter);
+		OutComponent.PatchSource = GetObjectPath(PatchSource);
+		OutComponent.Mesh.Data = MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data));
+		return;
+	}
+
+	//烘焙后的组件同样以动态网格体存储，读取后重新烘焙
+	if (UDynamicMeshComponent* DynamicMeshComponent = Cast<UDynamicMeshComponent>(Component))
+	{
+		OutComponent.Mesh = CaptureMesh(DynamicMeshComponent->GetDynamicMesh());
+	}
+	else if (UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(Component))
+	{
+		OutComponent.Mesh = CaptureMesh(StaticMeshComponent->GetStaticMesh());
+	}
+}
+
+void UVFSaveSubsystem::CaptureBackgroundPhoto(AVFPhoto* BackgroundPhoto, FVFSavedBackgroundPhoto& OutBackgroundPhoto)
+{
+	OutBackgroundPhoto.Class = GetObjectPath(BackgroundPhoto->GetClass());
+	OutBackgroundPhoto.Transform = BackgroundPhoto->GetActorTransform();
+	OutBackgroundPhoto.Texture = CaptureTexture(BackgroundPhoto->GetRenderTarget());
+}
+
+FVFSaveBlob UVFSaveSubsystem::CaptureTexture(UTexture* Texture)
+{
+	if (!Texture) return FVFSaveBlob();
+	if (const FVFSaveBlob* CapturedBlob = CapturedBlobs.Find(Texture)) return *CapturedBlob;
+
+	FVFSaveBlob Blob;
+	TArray<uint8> Data;
+	if (FVFTextureCodec::Encode(Texture, Data))
+	{
+		Blob.Data = MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data));
+	}
+	CapturedBlobs.Add(Texture, Blob);
+	return Blob;
+}
+
+FVFSaveBlob UVFSaveSubsystem::CaptureMesh(UObject* MeshSource)
+{
+	if (!MeshSource) return FVFSaveBlob();
+	if (const FVFSaveBlob* CapturedBlob = CapturedBlobs.Find(MeshSource)) return *CapturedBlob;
+
+	//布尔运算后的网格体有大量空洞，只存储紧凑的副本
+	FDynamicMesh3 Mesh;
+	if (UDynamicMesh* DynamicMesh = Cast<UDynamicMesh>(MeshSource))
+	{
+		Mesh.CompactCopy(DynamicMesh->GetMeshRef());
+	}
+	else if (UStaticMesh* StaticMesh = Cast<UStaticMesh>(MeshSource))
+	{
+		FVFScopedScratchMesh StaticMeshCopy(GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>()->GetScratchMeshPool());
+		TEnumAsByte<EGeometryScriptOutcomePins> Pins;
+		UGeometryScriptLibrary_StaticMeshFunctions::CopyMeshFromStaticMesh(
+			StaticMesh,
+			StaticMeshCopy.Get(),
+			FGeometryScriptCopyMeshFromAssetOptions(),
+			FGeometryScriptMeshReadLOD(),
+			Pins);
+		if (Pins == EGeometryScriptOutcomePins::Success)
+		{
+			Mesh.CompactCopy(StaticMeshCopy.Get()->GetMeshRef());
+		}
+	}
+
+	FVFSaveBlob Blob;
+	if (Mesh.TriangleCount() > 0)
+	{
+		TArray<uint8> Data;
+		FMemoryWriter MeshWriter(Data);
+		MeshWriter << Mesh;
+		Blob.Data = MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data));
+	}
+	CapturedBlobs.Add(MeshSource, Blob);
+	return Blob;
+}
+
+FVFSavedStaticMesh UVFSaveSubsystem::CaptureStaticMesh(UStaticMesh* StaticMesh)
+{
+	//放置烘焙生成的静态网格体不是资源，无法通过路径读取
+	FVFSavedStaticMesh SavedStaticMesh;
+	if (StaticMesh && StaticMesh->IsAsset())
+	{
+		SavedStaticMesh.Path = GetObjectPath(StaticMesh);
+	}
+	else
+	{
+		SavedStaticMesh.Mesh = CaptureMesh(StaticMesh);
+	}
+	return SavedStaticMesh;
+}
+
+TSharedPtr<FVFPhotoPayload> UVFSaveSubsystem::RestorePhoto(const FVFSavedPhoto& SavedPhoto)
+{
+	TSharedPtr<FVFPhotoPayload> Payload = MakeShared<FVFPhotoPayload>();
+	FVFAPhotoTakeParams& Params = Payload->PhotoTakeParams;
+	Params.CaptureFOVAngle = SavedPhoto.CaptureFOVAngle;
+	Params.MaxCaptureDistance = SavedPhoto.MaxCaptureDistance;
+	Params.BackgroundDistance = SavedPhoto.BackgroundDistance;
+	Params.CaptureSize = SavedPhoto.CaptureSize;
+	Params.TakeTransformNoScale = SavedPhoto.TakeTransformNoScale;
+	Params.PhotoClass = LoadClassPath<AVFPhoto>(SavedPhoto.PhotoClass);
+
+	Payload->RenderTarget = RestoreTexture(SavedPhoto.RenderTarget);
+	Payload->BackgroundRenderTarget = RestoreTexture(SavedPhoto.BackgroundRenderTarget);
+
+	for (const FString& Material : SavedPhoto.Materials)
+	{
+		Payload->Materials.Emplace(LoadObjectPath<UMaterialInterface>(Material));
+	}
+	Payload->MaterialIndices = SavedPhoto.MaterialIndices;
+	for (const FVFSavedPhoto::FActor& Actor : SavedPhoto.Actors)
+	{
+		FVFActorSnapshot& ActorSnapshot = Payload->ActorSnapshots.AddDefaulted_GetRef();
+		ActorSnapshot.Class = LoadClassPath<AActor>(Actor.Class);
+		ActorSnapshot.RelativeTransform = Actor.RelativeTransform;
+		ActorSnapshot.FirstComponent = Actor.FirstComponent;
+		ActorSnapshot.NumComponents = Actor.NumComponents;
+	}
+	for (const FVFSavedPhoto::FComponent& Component : SavedPhoto.Components)
+	{
+		FVFComponentSnapshot& ComponentSnapshot = Payload->ComponentSnapshots.AddDefaulted_GetRef();
+		ComponentSnapshot.ComponentName = Component.Name;
+		ComponentSnapshot.StaticMesh = RestoreStaticMesh(Component.StaticMesh);
+		ComponentSnapshot.FirstMaterial = Component.FirstMaterial;
+		ComponentSnapshot.NumMaterials = Component.NumMaterials;
+		ComponentSnapshot.bSimulatePhysics = Component.bSimulatePhysics;
+		ComponentSnapshot.CollisionEnabled = (ECollisionEnabled::Type)Component.CollisionEnabled;
+	}
+
+	Payload->DynamicMeshRecord = RestoreMesh(SavedPhoto.MeshRecord);
+	if (!Payload->DynamicMeshRecord)
+	{
+		Payload->DynamicMeshRecord = NewObject<UDynamicMesh>(this);
+	}
+	return Payload;
+}
+
+UTexture* UVFSaveSubsystem::RestoreTexture(const FVFSaveBlob& Blob)
+{
+	if (!Blob.IsValid()) return nullptr;
+	if (UObject** RestoredObject = RestoredObjects.Find(Blob.Data.Get())) return Cast<UTexture>(*RestoredObject);
+
+	UTexture* Texture = FVFTextureCodec::Decode(*Blob.Data);
+	RestoredObjects.Add(Blob.Data.Get(), Texture);
+	return Texture;
+}
+
+UDynamicMesh* UVFSaveSubsystem::RestoreMesh(const FVFSaveBlob& Blob)
+{
+	if (!Blob.IsValid()) return nullptr;
+	if (UObject** RestoredObject = RestoredObjects.Find(Blob.Data.Get())) return Cast<UDynamicMesh>(*RestoredObject);
+
+	UDynamicMesh* DynamicMesh = nullptr;
+	FDynamicMesh3 Mesh;
+	if (DecodeMesh(Blob, Mesh))
+	{
+		DynamicMesh = NewObject<UDynamicMesh>(this);
+		DynamicMesh->SetMesh(MoveTemp(Mesh));
+	}
+	RestoredObjects.Add(Blob.Data.Get(), DynamicMesh);
+	return DynamicMesh;
+}
+
+bool UVFSaveSubsystem::DecodeMesh(const FVFSaveBlob& Blob, FDynamicMesh3& OutMesh) const
+{
+	if (!Blob.IsValid()) return false;
+
+	FMemoryReader MeshReader(*Blob.Data);
+	MeshReader << OutMesh;
+	return !MeshReader.IsError();
+}
+
+bool UVFSaveSubsystem::RestoreMeshPatch(const FVFSavedGeneratedComponent& SavedComponent, FDynamicMesh3& OutMesh, TSharedPtr<FVFMeshPatch>& OutPatch)
+{
+	if (!SavedComponent.Mesh.IsValid()) return false;
+
+	TSharedPtr<FVFMeshPatch> Patch = MakeShared<FVFMeshPatch>();
+	FMemoryReader PatchReader(*SavedComponent.Mesh.Data);
+	Patch->Serialize(PatchReader);
+	Patch->SourceMesh = LoadObjectPath<UStaticMesh>(SavedComponent.PatchSource);
+
+	if (PatchReader.IsError() || !GetWorld()->GetSubsystem<UVFCutGeometrySubsystem>()->MaterializeMeshPatch(*Patch, OutMesh))
+	{
+		UE_LOG(LogViewfinder, Warning, TEXT("Failed to restore a generated component of %s from %s, the source mesh may have changed."), *SavedComponent.OwnerPath, *SavedComponent.PatchSource);
+		return false;
+	}
+
+	OutPatch = MoveTemp(Patch);
+	return true;
+}
+
+UStaticMesh* UVFSaveSubsystem::RestoreStaticMesh(const FVFSavedStaticMesh& SavedStaticMesh)
+{
+	if (!SavedStaticMesh.Mesh.IsValid()) return LoadObjectPath<UStaticMesh>(SavedStaticMesh.Path);
+	if (UStaticMesh** RestoredStaticMesh = RestoredStaticMeshes.Find(SavedStaticMesh.Mesh.Data.Get())) return *RestoredStaticMesh;
+
+	//只有一个材质槽，组件的材质由组件自身设置
+	FDynamicMesh3 Mesh;
+	UStaticMesh* StaticMesh = DecodeMesh(SavedStaticMesh.Mesh, Mesh) ? UVFCutGeometrySubsystem::CreateTransientStaticMesh(this, Mesh, nullptr, false) : nullptr;
+	RestoredStaticMeshes.Add(SavedStaticMesh.Mesh.Data.Get(), StaticMesh);
+	return StaticMesh;
+}
+
+FString UVFSaveSubsystem::GetRelativePath(const UObject* Object) const
+{
+	//不包含地图包名，PIE中的路径与游戏中相同
+	return Object ? Object->GetPathName(GetWorld()) : FString();
+}
+
+UObject* UVFSaveSubsystem::FindRelativeObject(const FString& Path) const
+{
+	return Path.IsEmpty() ? nullptr : StaticFindObject(UObject::StaticClass(), GetWorld(), *Path);
+}
+
+FVFAutosaveScope::FVFAutosaveScope(UWorld* World)
+{
+	UVFSaveSubsystem* Subsystem = World ? World->GetSubsystem<UVFSaveSubsystem>() : nullptr;
+	if (Subsystem && Subsystem->BeginAutosave())
+	{
+		SaveSubsystem = Subsystem;
+	}
+}
+
+FVFAutosaveScope::~FVFAutosaveScope()
+{
+	if (SaveSubsystem)
+	{
+		SaveSubsystem->AppendAutosave(*this);
+	}
+}
+
+void FVFAutosaveScope::Touch(UObject* Object)
+{
+	if (!SaveSubsystem || !IsValid(Object)) return;
+
+	EObjectKind Kind;
+	if (AActor* Actor = Cast<AActor>(Object))
+	{
+		if (Actor->ActorHasTag(SpawnedTag))
+		{
+			//生成的Actor被销毁时，其上切割生成的组件也一起被销毁
+			Kind = EObjectKind::SpawnedActor;
+			TInlineComponentArray<UPrimitiveComponent*> Components(Actor);
+			for (UPrimitiveComponent* Component : Components)
+			{
+				if (Component->ComponentHasTag(GeneratedTag))
+				{
+					Touch(Component);
+				}
+			}
+		}
+		else if (Actor->ActorHasTag(BackgroundTag))
+		{
+			Kind = EObjectKind::BackgroundPhoto;
+		}
+		else
+		{
+			return;
+		}
+	}
+	else if (UPrimitiveComponent* Component = Cast<UPrimitiveComponent>(Object))
+	{
+		AActor* Owner = Component->GetOwner();
+		if (Component->ComponentHasTag(GeneratedTag))
+		{
+			Kind = EObjectKind::GeneratedComponent;
+		}
+		//照片中生成的Actor的组件与Actor一起记录
+		else if (Owner && Owner->ActorHasTag(SpawnedTag))
+		{
+			Touch(Owner);
+			return;
+		}
+		else if (Component->IsA<UInstancedStaticMeshComponent>())
+		{
+			Kind = EObjectKind::InstancedComponent;
+		}
+		else
+		{
+			Kind = EObjectKind::LevelComponent;
+		}
+	}
+	else
+	{
+		return;
+	}
+
+	if (TouchedObjects.ContainsByPredicate([Object](const FTouchedObject& TouchedObject) { return TouchedObject.Object == Object; })) return;
+	TouchedObjects.Add({Object, SaveSubsystem->GetRelativePath(Object), Kind});
+}
+
+void FVFAutosaveScope::Touch(const FVFPhotoPlaceRecord& Record)
+{
+	if (!SaveSubsystem) return;
+
+	for (UPrimitiveComponent* Component : Record.HiddenComponents)
+	{
+		Touch(Component);
+	}
+	for (UPrimitiveComponent* Component : Record.GeneratedComponents)
+	{
+		Touch(Component);
+	}
+	for (AActor* Actor : Record.SpawnedActors)
+	{
+		Touch(Actor);
+	}
+	for (const FVFRemovedInstances& RemovedInstances : Record.RemovedInstances)
+	{
+		Touch(RemovedInstances.Component);
+	}
+	Touch(Record.BackgroundPhoto);
+}
+
+void FVFAutosaveScope::AddPhoto(const FVFPhotoInfo& Photo)
+{
+	if (SaveSubsystem && Photo.IsValid())
+	{
+		RemovedPhotos.Remove(Photo.PhotoId);
+		AddedPhotos.Emplace(Photo);
+	}
+}
+
+void FVFAutosaveScope::RemovePhoto(uint64 PhotoId)
+{
+	if (SaveSubsystem)
+	{
+		AddedPhotos.RemoveAll([PhotoId](const FVFPhotoInfo& Photo) { return Photo.PhotoId == PhotoId; });
+		RemovedPhotos.AddUnique(PhotoId);
+	}
+}
+
+void FVFAutosaveScope::Rename(const UPrimitiveComponent* OldComponent, const UPrimitiveComponent* NewComponent)
+{
+	if (SaveSubsystem && OldComponent && NewComponent)
+	{
+		RenamedComponents.Emplace(SaveSubsystem->GetRelativePath(OldComponent), SaveSubsystem->GetRelativePath(NewComponent));
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs SaveCommand(
+	TEXT("vf.Save"),
+	TEXT("Saves the photos and placements of the first player to Saved/SaveGames/<Slot>.vfsave. Usage: vf.Save [Slot]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UVFSaveSubsystem* SaveSubsystem = World ? World->GetSubsystem<UVFSaveSubsystem>() : nullptr)
+		{
+			SaveSubsystem->SaveGame(Args.Num() ? Args[0] : DefaultSlotName);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs LoadCommand(
+	TEXT("vf.Load"),
+	TEXT("Loads Saved/SaveGames/<Slot>.vfsave and replays its journal into the current map, which should not have any placements yet. Usage: vf.Load [Slot]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UVFSaveSubsystem* SaveSubsystem = World ? World->GetSubsystem<UVFSaveSubsystem>() : nullptr)
+		{
+			SaveSubsystem->LoadGame(Args.Num() ? Args[0] : DefaultSlotName);
+		}
+	}));
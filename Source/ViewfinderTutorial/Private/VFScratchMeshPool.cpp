@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFScratchMeshPool.h"
+#include "UDynamicMesh.h"
+#include "UObject/UObjectIterator.h"
+#include "ViewfinderTutorial/ViewfinderTutorial.h"
+
+UDynamicMesh* UVFScratchMeshPool::RequestMesh()
+{
+	NumRequests++;
+	
+	if (CachedMeshes.Num())
+	{
+		return CachedMeshes.Pop(false);
+	}
+
+	UDynamicMesh* Mesh = NewObject<UDynamicMesh>(this);
+	AllMeshes.Emplace(Mesh);
+	return Mesh;
+}
+
+void UVFScratchMeshPool::ReturnMesh(UDynamicMesh* Mesh)
+{
+	if (!Mesh || !ensure(AllMeshes.Contains(Mesh))) return;
+
+	Mesh->Reset();
+	CachedMeshes.AddUnique(Mesh);
+}
+
+void UVFScratchMeshPool::FreeCachedMeshes()
+{
+	for (UDynamicMesh* Mesh : CachedMeshes)
+	{
+		AllMeshes.Remove(Mesh);
+	}
+	CachedMeshes.Empty();
+}
+
+void UVFScratchMeshPool::LogStats() const
+{
+	UE_LOG(LogViewfinder, Log, TEXT("%s: %d scratch meshes created, %d in use, %d requests served."),
+		*GetPathName(), GetNumCreated(), GetNumInUse(), GetNumRequests());
+}
+
+//输出所有临时网格体对象池的状态，以及当前存活的UDynamicMesh总数，用于确认长时间游玩时GC压力没有持续增长。
+static FAutoConsoleCommand ScratchMeshPoolStatsCommand(
+	TEXT("vf.ScratchMeshPool.Stats"),
+	TEXT("Prints viewfinder scratch mesh pool usage and the number of live UDynamicMesh objects."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (TObjectIterator<UVFScratchMeshPool> It; It; ++It)
+		{
+			It->LogStats();
+		}
+
+		int32 NumLiveDynamicMeshes = 0;
+		for (TObjectIterator<UDynamicMesh> It; It; ++It)
+		{
+			NumLiveDynamicMeshes++;
+		}
+		UE_LOG(LogViewfinder, Log, TEXT("%d live UDynamicMesh objects, %d live UObjects."),
+			NumLiveDynamicMeshes, GUObjectArray.GetObjectArrayNumMinusAvailable());
+	}));
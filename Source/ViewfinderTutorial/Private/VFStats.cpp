@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFStats.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "Components/PrimitiveComponent.h"
+
+DEFINE_STAT(STAT_VF_Take);
+DEFINE_STAT(STAT_VF_TakeCapture);
+DEFINE_STAT(STAT_VF_TakeMeshRecord);
+DEFINE_STAT(STAT_VF_TakeSnapshot);
+DEFINE_STAT(STAT_VF_Place);
+DEFINE_STAT(STAT_VF_PlaceCacheRestore);
+DEFINE_STAT(STAT_VF_PlaceSpeculativeCommit);
+DEFINE_STAT(STAT_VF_PlaceLevelCut);
+DEFINE_STAT(STAT_VF_PlaceSpawnActors);
+DEFINE_STAT(STAT_VF_PlaceGeneratedCut);
+DEFINE_STAT(STAT_VF_PlaceUndo);
+DEFINE_STAT(STAT_VF_RewindRecord);
+DEFINE_STAT(STAT_VF_RewindPlayback);
+DEFINE_STAT(STAT_VF_RewindCompact);
+DEFINE_STAT(STAT_VF_MeshBoolean);
+
+DEFINE_STAT(STAT_VF_ComponentsCut);
+DEFINE_STAT(STAT_VF_TrianglesIn);
+DEFINE_STAT(STAT_VF_TrianglesOut);
+DEFINE_STAT(STAT_VF_BooleansRun);
+DEFINE_STAT(STAT_VF_ComponentsGenerated);
+
+DEFINE_STAT(STAT_VF_TotalMemory);
+DEFINE_STAT(STAT_VF_PhotoMemory);
+DEFINE_STAT(STAT_VF_HiddenMemory);
+DEFINE_STAT(STAT_VF_GeneratedMemory);
+DEFINE_STAT(STAT_VF_RewindRecordMemory);
+
+CSV_DEFINE_CATEGORY_MODULE(VIEWFINDERTUTORIAL_API, Viewfinder, true);
+
+FVFOperationStats* FVFOperationStats::Active = nullptr;
+
+FVFOperationStats::FStage& FVFOperationStats::FindOrAddStage(FName Name)
+{
+	//阶段数量很少，线性查找即可，同时保持阶段按首次出现的顺序输出
+	for (FStage& Stage : Stages)
+	{
+		if (Stage.Name == Name) return Stage;
+	}
+	FStage& Stage = Stages.AddDefaulted_GetRef();
+	Stage.Name = Name;
+	return Stage;
+}
+
+void FVFOperationStats::AddCut(const TCHAR* StageName, const UPrimitiveComponent* Component, int64 TrianglesIn, int64 TrianglesOut)
+{
+	if (!Active) return;
+
+	AddCut(StageName, Component ? Component->GetPathName(Component->GetWorld()) : FString(), TrianglesIn, TrianglesOut);
+}
+
+void FVFOperationStats::AddCut(const TCHAR* StageName, const FString& ComponentName, int64 TrianglesIn, int64 TrianglesOut)
+{
+	if (!Active) return;
+
+	FStage& Stage = Active->FindOrAddStage(StageName);
+	Stage.TrianglesIn += TrianglesIn;
+	Stage.TrianglesOut += TrianglesOut;
+
+	FCut& Cut = Active->Cuts.AddDefaulted_GetRef();
+	Cut.Stage = Stage.Name;
+	Cut.ComponentName = ComponentName;
+	Cut.TrianglesIn = TrianglesIn;
+	Cut.TrianglesOut = TrianglesOut;
+}
+
+FVFScopedOperationTimer::FVFScopedOperationTimer(const TCHAR* InStageName)
+	: StageName(InStageName)
+{
+	if (!FVFOperationStats::GetActive()) return;
+
+	StartMemory = FPlatformMemory::GetStats().UsedPhysical;
+	StartTime = FPlatformTime::Seconds();
+}
+
+FVFScopedOperationTimer::~FVFScopedOperationTimer()
+{
+	FVFOperationStats* Stats = FVFOperationStats::GetActive();
+	if (!Stats || StartTime == 0.0) return;
+
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+	FVFOperationStats::FStage& Stage = Stats->FindOrAddStage(StageName);
+	Stage.Count++;
+	Stage.Seconds += Seconds;
+	Stage.MemoryDelta += (int64)FPlatformMemory::GetStats().UsedPhysical - StartMemory;
+}
+
+void FVFStats::RecordCut(const TCHAR* StageName, const UPrimitiveComponent* Component, int64 TrianglesIn, int64 TrianglesOut)
+{
+	INC_DWORD_STAT(STAT_VF_ComponentsCut);
+	INC_DWORD_STAT_BY(STAT_VF_TrianglesIn, TrianglesIn);
+	INC_DWORD_STAT_BY(STAT_VF_TrianglesOut, TrianglesOut);
+	CSV_CUSTOM_STAT(Viewfinder, ComponentsCut, 1, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(Viewfinder, TrianglesIn, (int32)TrianglesIn, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(Viewfinder, TrianglesOut, (int32)TrianglesOut, ECsvCustomStatOp::Accumulate);
+
+	if (IsInGameThread())
+	{
+		FVFOperationStats::AddCut(StageName, Component, TrianglesIn, TrianglesOut);
+	}
+}
+
+void FVFStats::RecordBoolean()
+{
+	INC_DWORD_STAT(STAT_VF_BooleansRun);
+	CSV_CUSTOM_STAT(Viewfinder, BooleansRun, 1, ECsvCustomStatOp::Accumulate);
+}
+
+void FVFStats::RecordGeneratedComponent()
+{
+	INC_DWORD_STAT(STAT_VF_ComponentsGenerated);
+	CSV_CUSTOM_STAT(Viewfinder, ComponentsGenerated, 1, ECsvCustomStatOp::Accumulate);
+}
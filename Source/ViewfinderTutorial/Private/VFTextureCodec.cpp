@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VFTextureCodec.h"
+#include "Async/ParallelFor.h"
+#include "Engine/Texture2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	constexpr uint32 TextureMagic = 0x31434256; //"VBC1"
+
+	uint16 ToRGB565(int32 R, int32 G, int32 B)
+	{
+		return (uint16)(((R * 31 + 127) / 255) << 11 | ((G * 63 + 127) / 255) << 5 | (B * 31 + 127) / 255);
+	}
+
+	FIntVector FromRGB565(uint16 Color)
+	{
+		const int32 R = Color >> 11 & 31;
+		const int32 G = Color >> 5 & 63;
+		const int32 B = Color & 31;
+		return FIntVector(R << 3 | R >> 2, G << 2 | G >> 4, B << 3 | B >> 2);
+	}
+
+	void CompressBlock(const FColor* BlockPixels, uint8* OutBlock)
+	{
+		FIntVector Min(255), Max(0);
+		for (int32 i = 0; i < 16; i++)
+		{
+			const FIntVector Color(BlockPixels[i].R, BlockPixels[i].G, BlockPixels[i].B);
+			Min = FIntVector(FMath::Min(Min.X, Color.X), FMath::Min(Min.Y, Color.Y), FMath::Min(Min.Z, Color.Z));
+			Max = FIntVector(FMath::Max(Max.X, Color.X), FMath::Max(Max.Y, Color.Y), FMath::Max(Max.Z, Color.Z));
+		}
+
+		//端点向内收缩包围盒的1/16，减少包围盒两端少数像素对整个块的影响
+		const FIntVector Inset = (Max - Min) / 16;
+		Min += Inset;
+		Max -= Inset;
+
+		uint16 Color0 = ToRGB565(Max.X, Max.Y, Max.Z);
+		uint16 Color1 = ToRGB565(Min.X, Min.Y, Min.Z);
+		uint32 Indices = 0;
+		if (Color0 != Color1)
+		{
+			//Color0大于Color1时为四色模式
+			if (Color0 < Color1) Swap(Color0, Color1);
+
+			const FIntVector P0 = FromRGB565(Color0);
+			const FIntVector P1 = FromRGB565(Color1);
+			const FIntVector Palette[4] = { P0, P1, (P0 * 2 + P1) / 3, (P0 + P1 * 2) / 3 };
+			for (int32 i = 0; i < 16; i++)
+			{
+				const FIntVector Color(BlockPixels[i].R, BlockPixels[i].G, BlockPixels[i].B);
+				int32 BestIndex = 0;
+				int32 BestDistance = MAX_int32;
+				for (int32 PaletteIndex = 0; PaletteIndex < 4; PaletteIndex++)
+				{
+					const FIntVector Delta = Color - Palette[PaletteIndex];
+					const int32 Distance = Delta.X * Delta.X + Delta.Y * Delta.Y + Delta.Z * Delta.Z;
+					if (Distance < BestDistance)
+					{
+						BestDistance = Distance;
+						BestIndex = PaletteIndex;
+					}
+				}
+				Indices |= (uint32)BestIndex << (i * 2);
+			}
+		}
+
+		//小端序：两个端点，之后是按行排列的16个2位索引
+		OutBlock[0] = Color0 & 0xFF;
+		OutBlock[1] = Color0 >> 8;
+		OutBlock[2] = Color1 & 0xFF;
+		OutBlock[3] = Color1 >> 8;
+		for (int32 i = 0; i < 4; i++)
+		{
+			OutBlock[4 + i] = Indices >> (i * 8) & 0xFF;
+		}
+	}
+}
+
+void FVFTextureCodec::CompressBC1(const TArray<FColor>& Pixels, int32 Width, int32 Height, TArray<uint8>& OutBlocks)
+{
+	const int32 BlocksX = FMath::DivideAndRoundUp(Width, 4);
+	const int32 BlocksY = FMath::DivideAndRoundUp(Height, 4);
+	OutBlocks.SetNumUninitialized(GetBC1Size(Width, Height));
+
+	ParallelFor(BlocksY, [&Pixels, &OutBlocks, Width, Height, BlocksX](int32 BlockY)
+	{
+		FColor BlockPixels[16];
+		for (int32 BlockX = 0; BlockX < BlocksX; BlockX++)
+		{
+			for (int32 i = 0; i < 16; i++)
+			{
+				const int32 X = FMath::Min(BlockX * 4 + i % 4, Width - 1);
+				const int32 Y = FMath::Min(BlockY * 4 + i / 4, Height - 1);
+				BlockPixels[i] = Pixels[Y * Width + X];
+			}
+			CompressBlock(BlockPixels, &OutBlocks[((int64)BlockY * BlocksX + BlockX) * 8]);
+		}
+	});
+}
+
+bool FVFTextureCodec::Encode(UTexture* Texture, TArray<uint8>& OutData)
+{
+	int32 Width = 0;
+	int32 Height = 0;
+	TArray<uint8> Blocks;
+	if (UTextureRenderTarget2D* RenderTarget = Cast<UTextureRenderTarget2D>(Texture))
+	{
+		FTextureRenderTargetResource* Resource = RenderTarget->GameThread_GetRenderTargetResource();
+		if (!Resource) return false;
+
+		TArray<FColor> Pixels;
+		if (!Resource->ReadPixels(Pixels)) return false;
+		Width = RenderTarget->SizeX;
+		Height = RenderTarget->SizeY;
+		if (Pixels.Num() != Width * Height) return false;
+		CompressBC1(Pixels, Width, Height, Blocks);
+	}
+	else if (UTexture2D* Texture2D = Cast<UTexture2D>(Texture))
+	{
+		//读取存档时创建的纹理已经是BC1，直接复制块
+		FTexturePlatformData* PlatformData = Texture2D->GetPlatformData();
+		if (Texture2D->GetPixelFormat() != PF_DXT1 || !PlatformData || PlatformData->Mips.IsEmpty()) return false;
+
+		FTexture2DMipMap& Mip = PlatformData->Mips[0];
+		Width = Mip.SizeX;
+		Height = Mip.SizeY;
+		const void* Data = Mip.BulkData.LockReadOnly();
+		if (Data && Mip.BulkData.GetBulkDataSize() >= GetBC1Size(Width, Height))
+		{
+			Blocks.Append((const uint8*)Data, GetBC1Size(Width, Height));
+		}
+		Mip.BulkData.Unlock();
+		if (Blocks.IsEmpty()) return false;
+	}
+	else
+	{
+		return false;
+	}
+
+	FMemoryWriter Writer(OutData);
+	uint32 Magic = TextureMagic;
+	Writer << Magic << Width << Height << Blocks;
+	return true;
+}
+
+UTexture2D* FVFTextureCodec::Decode(const TArray<uint8>& Data)
+{
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0;
+	int32 Width = 0;
+	int32 Height = 0;
+	TArray<uint8> Blocks;
+	Reader << Magic << Width << Height;
+	if (Reader.IsError() || Magic != TextureMagic || Width <= 0 || Height <= 0) return nullptr;
+	Reader << Blocks;
+	if (Reader.IsError() || Blocks.Num() != GetBC1Size(Width, Height)) return nullptr;
+
+	UTexture2D* Texture = UTexture2D::CreateTransient(Width, Height, PF_DXT1);
+	if (!Texture) return nullptr;
+
+	FTexture2DMipMap& Mip = Texture->GetPlatformData()->Mips[0];
+	void* MipData = Mip.BulkData.Lock(LOCK_READ_WRITE);
+	FMemory::Memcpy(MipData, Blocks.GetData(), FMath::Min<int64>(Blocks.Num(), Mip.BulkData.GetBulkDataSize()));
+	Mip.BulkData.Unlock();
+
+	Texture->SRGB = true;
+	Texture->UpdateResource();
+	return Texture;
+}
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "VFStats.h"
+#include "VFBenchmarkCommandlet.generated.h"
+
+class UStaticMesh;
+class UVFPhotoTakerPlacerComponent;
+
+//一次拍照、放置与回溯的迭代结果。
+struct FVFBenchmarkIteration
+{
+	FVFOperationStats Stats;
+	int32 NumGeneratedComponents = 0;
+	int32 NumHiddenComponents = 0;
+	int64 GeneratedBytes = 0;
+	int64 PayloadBytes = 0;
+
+	//撤销后以相同条件再次放置时是否恢复了缓存中的组件
+	bool bRedoFromCache = false;
+};
+
+/**
+ * 在无渲染的环境中测量拍照、放置与回溯的耗时，如：
+ * UnrealEditor-Cmd ViewfinderTutorial -run=VFBenchmark -nullrhi -Meshes=16 -Triangles=2000 -Iterations=5
+ * 在合成场景中重复执行拍照、旋转放置、撤销、经由缓存重做与再次撤销，每次迭代的各阶段耗时、内存变化与三角面数量写入Saved/Viewfinder/Benchmark下的CSV与JSON。
+ */
+UCLASS()
+class VIEWFINDERTUTORIAL_API UVFBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UVFBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+	//在新的世界中生成合成场景，并执行NumIterations次拍照、放置与回溯。
+	bool RunScenario(int32 NumMeshes, int32 NumTriangles, int32 NumIterations, float PlaceAngle, const FString& PyramidPath, TArray<FVFBenchmarkIteration>& OutIterations);
+
+	//在摄像机前方的网格上生成NumMeshes个可切割的静态网格体Actor。
+	void SpawnSyntheticScene(UWorld* World, UStaticMesh* Mesh, int32 NumMeshes);
+
+	//生成三角面数量接近NumTriangles的细分立方体。
+	UStaticMesh* CreateSyntheticMesh(int32 NumTriangles);
+
+	bool WriteResults(const FString& BaseName, const FString& Params, const TArray<FVFBenchmarkIteration>& Iterations) const;
+
+protected:
+	UPROPERTY()
+	TObjectPtr<UVFPhotoTakerPlacerComponent> Placer;
+};
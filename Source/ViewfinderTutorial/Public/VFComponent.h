@@ -8,11 +8,16 @@
 
 class UVFPhotoTakerPlacerComponent;
 struct FVFPhotoPlaceRecord;
+struct FVFMemoryReport;
+struct FVFInputRecording;
+enum class EVFInputEvent : uint8;
 struct FInputActionValue;
 struct FVFPhotoInfo;
 class AVFPhoto;
 class UInputMappingContext;
 class UInputAction;
+class UDynamicMeshComponent;
+class UMaterialInterface;
 
 USTRUCT()
 struct FVFRewindRecord
@@ -29,10 +34,24 @@ struct FVFRewindRecord
 	UPROPERTY()
 	uint8 Action = 0;
 	
-	TSharedPtr<FVFPhotoInfo> PhotoTakeInfo;
+	//拍照时所拍摄照片的ID
+	UPROPERTY()
+	uint64 PhotoTakeId = 0;
+	
 	TSharedPtr<FVFPhotoPlaceRecord> PhotoPlaceRecord;
 };
 
+/**
+ * 已经无法回溯的放置所使用照片的纹理与网格体记录。
+ * 照片数据被共享且不可修改，工作线程中的任务也可能持有它，因此只在照片数据的所有持有者都释放后才由组件释放这些资源。
+ */
+struct FVFRetiredPhotoResources
+{
+	TWeakPtr<const FVFPhotoPayload> Payload;
+	TWeakObjectPtr<UTexture> RenderTarget;
+	TWeakObjectPtr<UDynamicMesh> DynamicMeshRecord;
+};
+
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class VIEWFINDERTUTORIAL_API UVFComponent : public UActorComponent
 {
@@ -43,6 +62,7 @@ public:
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
 	//在使用取景器摄像机和照片之间切换。
@@ -70,7 +90,32 @@ public:
 	
 	//向组件添加新的照片，并进行一些处理
 	UFUNCTION(BlueprintCallable)
-	void AddPhoto(AVFPhoto* InPhoto);
+	void AddPhoto(const FVFPhotoInfo& InPhoto);
+
+	//根据照片ID查找已拥有的照片，不存在时返回nullptr。
+	const FVFPhotoInfo* FindPhotoById(uint64 PhotoId) const;
+
+	const TArray<FVFPhotoInfo>& GetPhotos() const { return Photos; }
+
+	//已拥有照片的数量，界面显示照片数量时使用，不依赖Photos的元素类型。
+	UFUNCTION(BlueprintPure, Category = "Viewfinder")
+	int32 GetNumPhotos() const { return Photos.Num(); }
+
+	//显示当前照片的Actor，与Photos改为照片数据之前的元素类型相同，没有当前照片时返回nullptr。
+	UFUNCTION(BlueprintPure, Category = "Viewfinder")
+	AVFPhoto* GetCurrentPhoto() const { return Photos.IsValidIndex(CurrentPhotoIndex) ? DisplayPhoto.Get() : nullptr; }
+
+	//读取存档之前调用，放置的结果将被撤销或销毁，丢弃回溯记录、预览、缓存的放置与压缩队列中对它们的引用。
+	void ResetPlacements();
+
+	//以读取存档得到的照片替换已拥有的照片，之后从当前位置重新开始回溯记录。
+	void RestorePhotos(const TArray<FVFPhotoInfo>& InPhotos);
+
+	/**
+	 * 统计已拥有的照片、回溯记录中的放置、被撤销后缓存的放置与等待压缩的组件持有的内存。
+	 * 照片数据被多处共享时计入已拥有的照片，其次是最新的回溯记录。
+	 */
+	void CollectMemoryReport(FVFMemoryReport& Report) const;
 
 	//当前照片沿着组件(或者摄像机)的X轴转动此角度
 	void ApplyRotatedAngleDeltaToPhoto(float DeltaAngle);
@@ -80,6 +125,26 @@ public:
 
 	UFUNCTION()
 	void DoRewind();
+
+	//分步销毁或释放已经无法回溯的放置所隐藏的组件。
+	UFUNCTION()
+	void DoCompactComponents();
+
+	//瞄准照片时检查瞄准是否稳定，稳定时提前计算放置的切割结果。
+	UFUNCTION()
+	void PollSpeculativePlacement();
+
+	//瞄准照片时取出已完成的预览并在瞄准改变时开始新的预览计算。
+	UFUNCTION()
+	void UpdatePlacementPreview();
+
+	//录制输入时记录一步Pawn的变换。
+	UFUNCTION()
+	void RecordInputStep();
+
+	//重放输入时调用这一步记录的输入并设置Pawn的变换，重放结束后按需要循环或退出。
+	UFUNCTION()
+	void ReplayInputStep();
 	
 protected:
 	void TakePhotoUsingComponent(UVFPhotoTakerPlacerComponent* InComponent);
@@ -88,6 +153,48 @@ protected:
 	void TakeOutPhoto();
 	void WithdrawPhoto();
 	void StartRewind();
+
+	//从已拥有的照片中移除此照片。
+	void RemovePhoto(uint64 PhotoId);
+
+	//取消进行中的预览计算并清空已显示的预览，放置、回溯或切换照片后地图与照片已经改变。
+	void ClearPlacementPreview();
+
+	//获取用于显示当前照片的Actor，在照片类型改变时重新生成。
+	AVFPhoto* GetDisplayPhoto(const FVFPhotoInfo& PhotoInfo);
+
+	/**
+	 * 回溯记录移出时间窗口后，其中的放置将无法再被回溯。
+	 * 被该放置隐藏的组件将永远不会再显示，将它们加入压缩队列。照片的纹理与网格体记录等待照片数据不再被持有后释放。
+	 */
+	void RetireExpiredRewindRecord(const FVFRewindRecord& ExpiredRecord);
+
+	//释放照片数据已经不再被任何地方持有的退役资源，返回释放的字节数。只能在游戏线程中调用。
+	SIZE_T ReleaseRetiredPhotoResources();
+
+	//拍照、放置与回溯后请求更新内存统计，间隔内的多次请求合并为一次更新。
+	void RequestMemoryStatsUpdate();
+
+	//更新内存统计，超出预算时输出警告。没有预算、没有收集统计也没有CSV捕获时跳过遍历。
+	void UpdateMemoryStats();
+
+	//定期检查是否开始收集统计，开始时立即更新一次，显示的不会是开始收集之前的旧值。
+	void PollMemoryStats();
+
+	bool IsCollectingMemoryStats() const;
+
+	//生成的组件被烘焙后，将回溯记录与压缩队列中的旧组件替换为新组件。
+	void ReplaceComponentReferences(UPrimitiveComponent* OldComponent, UPrimitiveComponent* NewComponent);
+
+	/**
+	 * 命令行中有-VFRecordInput[=File]时开始录制输入，有-VFReplay=File时开始重放，重放时玩家的输入被禁用。
+	 * 只有玩家控制的Pawn上的组件会录制或重放。
+	 */
+	void BeginInputRecordingOrReplay(APlayerController* PlayerController);
+
+	//录制时记录输入事件，重放中调用的函数不会被再次记录。
+	void RecordInputEvent(EVFInputEvent Event, float Value = 0.f);
+	void DispatchInputEvent(EVFInputEvent Event, float Value);
 	
 protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Input")
@@ -124,6 +231,33 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Photo")
 	float PhotoRotateAngle = 15.f;
 	
+	//瞄准照片且保持不动时，在工作线程中提前计算放置的切割结果。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Photo")
+	bool bSpeculativePlacement = false;
+
+	//检查瞄准是否稳定的时间间隔，瞄准在两次检查之间没有改变时开始提前计算。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Photo", meta = (EditCondition = "bSpeculativePlacement"))
+	float SpeculativePollInterval = 0.1f;
+	
+	//瞄准照片时以半透明的网格体显示放置将切除的部分与照片中的物体。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Preview")
+	bool bPlacementPreview = false;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Preview", meta = (EditCondition = "bPlacementPreview"))
+	TObjectPtr<UMaterialInterface> PreviewMaterial;
+
+	//预览的更新间隔，同一时间最多只有一次预览计算。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Preview", meta = (EditCondition = "bPlacementPreview"))
+	float PreviewInterval = 0.25f;
+
+	//预览中每个网格体被简化到的最大三角面数量。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Preview", meta = (EditCondition = "bPlacementPreview"))
+	int32 PreviewMaxTrianglesPerMesh = 500;
+
+	//预览最多处理的地图组件数量，复制网格体是预览在游戏线程中的主要开销。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Preview", meta = (EditCondition = "bPlacementPreview"))
+	int32 PreviewMaxComponents = 16;
+
 	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Rewind")
 	float MaxRewindTime = 60.f;
 
@@ -132,7 +266,26 @@ protected:
 
 	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Rewind")
 	float RewindTimeRate = 5.f;
+
+	//压缩被隐藏组件的时间间隔。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Rewind")
+	float CompactTimeStep = 0.1f;
+
+	//单次压缩最多销毁的组件数量，避免在一帧内销毁过多组件。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Rewind")
+	int32 MaxCompactComponentsPerStep = 4;
 	
+	/**
+	 * 取景器持有的内存预算，按MB计，0为不限制。
+	 * 超出时输出警告与内存统计，用于确定内存受限的平台上的回溯时长与照片数量。
+	 */
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Memory")
+	float MemoryBudgetMB = 0.f;
+
+	//内存统计的最短更新间隔，按秒计。统计需要遍历照片、回溯记录与组件，开销随历史增长。
+	UPROPERTY(EditDefaultsOnly, Category = "Viewfinder|Memory")
+	float MemoryStatsInterval = 1.f;
+
 	UPROPERTY(BlueprintReadOnly, Category = "Viewfinder")
 	bool bIsUsingCamera = true;
 	
@@ -142,8 +295,16 @@ protected:
 	UPROPERTY(BlueprintReadOnly, Category = "Viewfinder")
 	bool bIsCatching;
 
+	//已拥有的照片，只是数据，不会为每张照片生成Actor。
 	UPROPERTY(BlueprintReadOnly, Category = "Viewfinder")
-	TArray<AVFPhoto*> Photos;
+	TArray<FVFPhotoInfo> Photos;
+
+	//照片ID到照片在Photos中位置的映射，与Photos保持同步。
+	TMap<uint64, int32> PhotoIndexMap;
+
+	//唯一用于显示当前照片的Actor，切换照片时只替换其材质参数。
+	UPROPERTY()
+	TObjectPtr<AVFPhoto> DisplayPhoto;
 
 	UPROPERTY(BlueprintReadOnly, Category = "Viewfinder")
 	int CurrentPhotoIndex = -1;
@@ -154,6 +315,43 @@ protected:
 	UPROPERTY()
 	TObjectPtr<UStaticMeshComponent> PhotoFrame;
 
+	UPROPERTY()
+	TObjectPtr<UDynamicMeshComponent> PreviewComponent;
+
+	//上次开始预览计算时瞄准的变换与角度。
+	FTransform LastPreviewTransform;
+	float LastPreviewRotatedAngle = 0.f;
+	FTimerHandle PreviewTimerHandle;
+
+	//上次检查时瞄准的变换与角度。
+	FTransform LastAimTransform;
+	float LastAimRotatedAngle = 0.f;
+	FTimerHandle SpeculativeTimerHandle;
+
 	TArray<FVFRewindRecord> RewindRecords;
 	FTimerHandle RewindTimerHandle;
+
+	//只在超出预算的那一次输出警告。
+	bool bIsOverMemoryBudget = false;
+	bool bWasCollectingMemoryStats = false;
+	FTimerHandle MemoryStatsTimerHandle;
+	FTimerHandle MemoryStatsPollTimerHandle;
+
+	//录制或重放的输入，两者不会同时进行。
+	TSharedPtr<FVFInputRecording> InputRecording;
+	FString InputRecordingPath;
+	bool bIsRecordingInput = false;
+	bool bIsReplayingInput = false;
+	int32 InputStep = 0;
+	int32 NextReplaySample = 0;
+	int32 NextReplayEvent = 0;
+	int32 ReplayLoopsRemaining = 0;
+	FTimerHandle InputTimerHandle;
+
+	//等待被压缩的被隐藏组件。
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> PendingCompactComponents;
+	FTimerHandle CompactTimerHandle;
+
+	//等待照片数据的其它持有者释放后再释放的照片资源，在压缩时与放置退役时检查。
+	TArray<FVFRetiredPhotoResources> RetiredPhotoResources;
 };
@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "VFCutGeometrySubsystem.generated.h"
+
+class UDynamicMesh;
+class UDynamicMeshComponent;
+class UStaticMesh;
+class UMaterialInterface;
+class UVFScratchMeshPool;
+struct FVFBakeTask;
+struct FVFMeshPatch;
+namespace UE::Geometry { class FDynamicMesh3; }
+
+//组件被替换时广播，持有旧组件的放置记录需要替换为新组件。
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnVFComponentReplaced, UPrimitiveComponent* /*OldComponent*/, UPrimitiveComponent* /*NewComponent*/);
+
+/**
+ * 管理放置生成的切割几何体。
+ * 生成的动态网格体组件在稳定后会被烘焙为临时的静态网格体，包括LOD与碰撞，并透明地替换原有组件。
+ * 网格体的转换与简化在工作线程中进行，静态网格体的构建与组件替换在游戏线程中进行，同一时间只烘焙一个组件。
+ * 已经无法回溯的生成组件可以按所属Actor与材质合并为一个组件，减少图元与绘制调用的数量。
+ * 切割生成的组件同时记录相对于来源网格体资源的补丁，被隐藏等待回溯的组件只保留补丁，重新显示时再还原完整的网格体。
+ */
+UCLASS(Config = Game)
+class VIEWFINDERTUTORIAL_API UVFCutGeometrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	//在Delay秒之后烘焙这些组件，不是动态网格体组件或已经在队列中的组件会被忽略。
+	void RequestBake(const TArray<UPrimitiveComponent*>& Components, float Delay);
+
+	/**
+	 * 将已经无法回溯的生成组件加入合并队列。
+	 * 属于同一个Actor、材质与碰撞设置相同且没有模拟物理的组件会被合并为一个动态网格体组件，每种材质一个分段。
+	 */
+	void RequestMerge(const TArray<UPrimitiveComponent*>& Components);
+
+	//放置仍然可以被回溯时，等待此时间后再烘焙。
+	float GetBakeIdleTimeout() const { return BakeIdleTimeout; }
+
+	void LogStats() const;
+
+	/**
+	 * 以与烘焙相同的方式将网格体构建为只有一个LOD与一个材质的临时静态网格体。
+	 * bConvexCollision为true时使用网格体顶点的凸包作为简单碰撞，否则使用复杂碰撞。基准测试用它生成合成场景。
+	 */
+	static UStaticMesh* CreateTransientStaticMesh(UObject* Outer, const UE::Geometry::FDynamicMesh3& Mesh, UMaterialInterface* Material, bool bConvexCollision);
+
+	/**
+	 * 组件被切割时补丁的来源：地图与照片中的静态网格体组件是其网格体资源，切割生成的组件沿用自身补丁的来源。
+	 * 合并或没有补丁的生成组件与动态网格体组件返回空，它们的切割结果存储完整的网格体。
+	 */
+	UStaticMesh* GetPatchSource(const UPrimitiveComponent* Component) const;
+
+	//以放置时复制静态网格体的相同方式转换补丁来源，三角面ID因此与生成补丁时相同。
+	static bool CopyPatchSourceMesh(UStaticMesh* SourceMesh, UDynamicMesh* OutMesh);
+
+	TSharedPtr<const FVFMeshPatch> GetMeshPatch(const UPrimitiveComponent* Component) const;
+
+	//记录组件网格体的补丁，Patch为空时移除。从对象池获取的生成组件都需要设置，归还到对象池或销毁前需要移除。
+	void SetMeshPatch(UPrimitiveComponent* Component, TSharedPtr<const FVFMeshPatch> Patch);
+
+	//由补丁生成完整的网格体，来源已经无法读取或已经改变时返回false。
+	bool MaterializeMeshPatch(const FVFMeshPatch& Patch, UE::Geometry::FDynamicMesh3& OutMesh);
+
+	//被隐藏的有补丁的动态网格体组件释放其网格体，只保留补丁。其它组件保持不变。
+	void ReleasePatchedMesh(UPrimitiveComponent* Component);
+
+	//在重新显示组件之前调用，由补丁还原被释放的网格体与碰撞。
+	void RestorePatchedMesh(UPrimitiveComponent* Component);
+
+	/**
+	 * 组件内容的标记，放置缓存以它代替网格体本身判断输入是否改变。
+	 * 生成组件的网格体与实例化组件的实例被改变时获得新的标记，释放、还原与烘焙都保留原有的标记。没有被修改过的组件返回0。
+	 */
+	uint64 GetContentStamp(const UPrimitiveComponent* Component) const;
+
+	//组件的网格体或实例被改变后调用。
+	void TouchContent(UPrimitiveComponent* Component);
+
+	FOnVFComponentReplaced OnComponentReplaced;
+
+protected:
+	void TickCutGeometry();
+
+	//合并队列中可以合并的组件，合并结果会被加入烘焙队列。
+	void MergePendingComponents();
+
+	//将同一组的组件合并到一个新的组件中，返回新的组件。
+	UPrimitiveComponent* MergeComponents(const TArray<UPrimitiveComponent*>& Components);
+
+	//开始在工作线程中转换下一个到期的组件。
+	void StartNextBake();
+
+	//由转换结果构建静态网格体并替换组件。
+	void FinishBake(FVFBakeTask& Task);
+
+	UStaticMesh* BuildStaticMesh(FVFBakeTask& Task);
+
+	UVFScratchMeshPool* GetScratchMeshPool();
+
+protected:
+	UPROPERTY(Config)
+	bool bEnableBake = true;
+
+	UPROPERTY(Config)
+	bool bEnableMerge = false;
+
+	UPROPERTY(Config)
+	float BakeIdleTimeout = 10.f;
+
+	UPROPERTY(Config)
+	float BakeTimeStep = 0.2f;
+
+	//包括LOD0在内的LOD数量，每一级的三角面数量为上一级的LODReductionFactor倍。
+	UPROPERTY(Config)
+	int32 NumBakeLODs = 3;
+
+	UPROPERTY(Config)
+	float LODReductionFactor = 0.5f;
+
+	//静止的几何体的凸包碰撞最多比网格体大出的比例，超出时使用复杂碰撞。
+	UPROPERTY(Config)
+	float ConvexCollisionTolerance = 0.1f;
+
+	struct FBakeRequest
+	{
+		TWeakObjectPtr<UDynamicMeshComponent> Component;
+		double ReadyTime = 0.0;
+	};
+	TArray<FBakeRequest> PendingBakes;
+	TSharedPtr<FVFBakeTask> CurrentBake;
+	FTimerHandle BakeTimerHandle;
+
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> PendingMerges;
+
+	int32 NumMergedComponents = 0;
+	int32 NumMergeResults = 0;
+	int32 NumDrawsBeforeMerge = 0;
+	int32 NumDrawsAfterMerge = 0;
+
+	int32 NumBaked = 0;
+	int32 NumDiscarded = 0;
+	double TotalBakeSeconds = 0.0;
+
+	TMap<TObjectKey<UPrimitiveComponent>, TSharedPtr<const FVFMeshPatch>> MeshPatches;
+
+	TMap<TObjectKey<UPrimitiveComponent>, uint64> ContentStamps;
+	uint64 LastContentStamp = 0;
+
+	//补丁只以弱引用记录来源，来源在世界中保持加载，补丁才能一直被还原
+	UPROPERTY(Transient)
+	TSet<TObjectPtr<UStaticMesh>> PatchSourceMeshes;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UVFScratchMeshPool> ScratchMeshPool;
+
+	int32 NumReleasedMeshes = 0;
+	int32 NumMaterializedMeshes = 0;
+	SIZE_T ReleasedMeshBytes = 0;
+};
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VFPhoto.h"
+#include "VFStats.h"
+
+struct FVFPlacementBundle;
+
+/**
+ * 监视一次拍照、放置或回溯操作的耗时，由vf.HitchWatchdog.Enable开启。
+ * 超过vf.HitchWatchdog.ThresholdMs时在Saved/Viewfinder/Hitches下写入报告，包括各阶段耗时、被切割的组件及其三角面数量与照片参数，
+ * 引擎支持时同时写入一份追踪快照。只在游戏线程中使用。
+ * 放置操作同时会记录放置包，vf.HitchWatchdog.CaptureBundle开启时随报告写入，vf.ExportNextPlacement请求时总是写入，都写入Saved/Viewfinder/Bundles。
+ * 报告与放置包的名称包括时间、帧号与序号，同一秒内的多次操作不会相互覆盖。
+ */
+class VIEWFINDERTUTORIAL_API FVFHitchWatchdog
+{
+public:
+	explicit FVFHitchWatchdog(const TCHAR* InOperationName);
+	~FVFHitchWatchdog();
+
+	//报告中记录的照片，放置时为被放置的照片，拍照时为拍摄参数。
+	void SetPhoto(uint64 InPhotoId, const FVFAPhotoTakeParams& InPhotoTakeParams, float InRotatedAngle);
+
+	//在放置照片之前调用，需要时记录这次放置的几何输入。
+	void CapturePlacementBundle();
+
+	static bool IsEnabled();
+
+private:
+	//BaseName不包括扩展名，BundlePath为同时写入的放置包，没有时为空。
+	void WriteReport(const FString& BaseName, const FString& BundlePath, double Milliseconds, double ThresholdMilliseconds) const;
+	bool WriteBundle(const FString& Filename) const;
+
+	const TCHAR* OperationName;
+	bool bIsActive = false;
+	double StartTime = 0.0;
+
+	//已经有其他记录者时不替换它，报告中不包括阶段耗时
+	FVFOperationStats Stats;
+	FVFOperationStats* PrevActiveStats = nullptr;
+
+	bool bHasPhoto = false;
+	uint64 PhotoId = 0;
+	FVFAPhotoTakeParams PhotoTakeParams;
+	float RotatedAngle = 0.f;
+
+	TUniquePtr<FVFPlacementBundle> Bundle;
+	bool bExportBundle = false;
+};
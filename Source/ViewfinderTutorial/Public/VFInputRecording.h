@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//UVFComponent在BeginPlay中绑定的输入动作。
+enum class EVFInputEvent : uint8
+{
+	ToggleCameraOrPhoto,
+	TakeOrPlacePhoto,
+	Aim,
+	AimEnd,
+	SwitchPhoto,
+	RotatePhoto,
+	Backtrack
+};
+
+/**
+ * 一段游戏过程中取景器的输入与Pawn的变换，按固定的步长记录，重放时以相同的步长依次调用UVFComponent的函数。
+ * 变换只在改变时记录，输入事件记录其发生前的最后一步与发生时Pawn的精确位置和控制器旋转，文件中不包含任何对象引用。
+ */
+struct VIEWFINDERTUTORIAL_API FVFInputRecording
+{
+	struct FSample
+	{
+		int32 Step = 0;
+		FVector3f Location = FVector3f::ZeroVector;
+		FRotator3f ActorRotation = FRotator3f::ZeroRotator;
+		FRotator3f ControlRotation = FRotator3f::ZeroRotator;
+	};
+
+	struct FEvent
+	{
+		int32 Step = 0;
+		EVFInputEvent Type = EVFInputEvent::ToggleCameraOrPhoto;
+
+		//RotatePhoto的输入值
+		float Value = 0.f;
+
+		//事件发生时的精确位姿，重放时在调用前设置，拍照、放置与回溯的结果不受样本精度与步长的影响
+		FVector Location = FVector::ZeroVector;
+		FRotator ActorRotation = FRotator::ZeroRotator;
+		FRotator ControlRotation = FRotator::ZeroRotator;
+	};
+
+	FString MapName;
+	float StepSeconds = 0.f;
+	int32 NumSteps = 0;
+	TArray<FSample> Samples;
+	TArray<FEvent> Events;
+
+	//与上一个样本相同时不记录。
+	void AddSample(int32 Step, const FTransform& ActorTransform, const FRotator& ControlRotation);
+	void AddEvent(int32 Step, EVFInputEvent Type, float Value, const FTransform& ActorTransform, const FRotator& ControlRotation);
+
+	bool SaveToFile(const FString& Filename) const;
+	bool LoadFromFile(const FString& Filename);
+
+	void Serialize(FArchive& Ar);
+};
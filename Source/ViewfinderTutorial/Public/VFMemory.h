@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UPrimitiveComponent;
+struct FVFPhotoPayload;
+struct FVFPhotoPlaceRecord;
+namespace UE::Geometry { class FDynamicMesh3; }
+
+//估算取景器运行时数据占用的内存，只用于统计与日志，不追求精确。
+struct VIEWFINDERTUTORIAL_API FVFMemory
+{
+	//按顶点、三角面、边及其属性的数量估算动态网格体的大小。
+	static SIZE_T GetDynamicMeshBytes(const UE::Geometry::FDynamicMesh3& Mesh);
+
+	//组件自身独占的内存，动态网格体组件包括其网格体，静态网格体资源被共享，不计算在内。
+	static SIZE_T GetComponentBytes(const UPrimitiveComponent* Component);
+
+	//照片数据中的渲染目标与网格体记录。
+	static SIZE_T GetPayloadBytes(const FVFPhotoPayload& Payload);
+};
+
+/**
+ * 取景器持有的内存，按照片、放置与回溯记录归属。
+ * 照片数据与组件可能同时被多处持有，只计入第一个添加它的条目，因此条目的添加顺序就是归属的优先级。
+ */
+struct VIEWFINDERTUTORIAL_API FVFMemoryReport
+{
+	struct FEntry
+	{
+		FString Name;
+		SIZE_T Bytes = 0;
+	};
+
+	//照片数据，包括渲染目标与网格体记录
+	SIZE_T PhotoBytes = 0;
+
+	//被放置隐藏的组件，包括等待压缩的组件
+	SIZE_T HiddenBytes = 0;
+
+	//放置生成的组件，包括被撤销后缓存的组件
+	SIZE_T GeneratedBytes = 0;
+
+	//回溯记录本身与放置记录的数组
+	SIZE_T RewindRecordBytes = 0;
+
+	TArray<FEntry> Entries;
+
+	SIZE_T GetTotalBytes() const { return PhotoBytes + HiddenBytes + GeneratedBytes + RewindRecordBytes; }
+
+	//以下函数返回新计入的字节数，已经计入的对象返回0。
+	SIZE_T AddPayload(const FVFPhotoPayload* Payload);
+	SIZE_T AddHiddenComponent(const UPrimitiveComponent* Component);
+	SIZE_T AddGeneratedComponent(const UPrimitiveComponent* Component);
+
+	//放置记录持有的照片数据、被隐藏的组件与生成的组件。
+	SIZE_T AddPlaceRecord(const FVFPhotoPlaceRecord& PhotoPlaceRecord);
+
+	void AddEntry(FString Name, SIZE_T Bytes) { Entries.Add({MoveTemp(Name), Bytes}); }
+
+	//按类别与条目输出到日志，条目按大小排序，最多输出MaxEntries个。
+	void Log(int32 MaxEntries = 20) const;
+
+private:
+	TSet<const void*> CountedObjects;
+};
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DynamicMesh/DynamicMesh3.h"
+
+//一次切割运算对网格体造成的影响，调用者根据结果选择代价最小的后续处理。
+enum class EVFMeshCutOutcome : uint8
+{
+	//网格体没有被改变，原有组件保持不变。
+	Unchanged,
+	//网格体被完全消除，只需要隐藏原有组件。
+	Removed,
+	//网格体被部分切割，需要用切割结果生成新的组件。
+	Cut
+};
+
+enum class EVFMeshCutOperation : uint8
+{
+	Subtract,
+	Intersect
+};
+
+/**
+ * 由朝外的平面围成的凸体积，用于在boolean之前对网格体进行快速分类。
+ * 拍照和放置所使用的Pyramid都是凸的。
+ */
+struct VIEWFINDERTUTORIAL_API FVFConvexVolume
+{
+	TArray<FPlane> Planes;
+
+	//由网格体的三角面构建平面，网格体本身需要是凸的。
+	void BuildFromMesh(const UE::Geometry::FDynamicMesh3& Mesh, const FTransform& Transform);
+	bool IsValid() const { return Planes.Num() >= 4; }
+};
+
+//照片放置时对网格体进行切割的运算，只处理网格体数据，不涉及组件。
+struct VIEWFINDERTUTORIAL_API FVFMeshCut
+{
+	/**
+	 * 在不进行boolean的情况下，根据网格体顶点与凸体积的位置关系判断运算结果。
+	 * 当网格体跨越了体积的边界时返回Cut，此时需要进行boolean才能得到确定的结果。
+	 */
+	static EVFMeshCutOutcome Classify(const UE::Geometry::FDynamicMesh3& Mesh, const FTransform& MeshTransform, const FVFConvexVolume& Volume, EVFMeshCutOperation Operation);
+
+	/**
+	 * 对SourceMesh进行boolean，结果位于SourceMesh的局部空间，只有在返回Cut时才会写入OutMesh。
+	 * 如果传入了工具网格体的凸体积，会先进行快速分类，大部分不相交或被完全包含的网格体不需要进行boolean。
+	 * 否则在boolean后通过比较三角面与顶点数量判断网格体是否被改变，不需要再对两个网格体进行完整的比较。
+	 */
+	static EVFMeshCutOutcome ApplyBoolean(
+		const UE::Geometry::FDynamicMesh3& SourceMesh, const FTransform& SourceTransform,
+		const UE::Geometry::FDynamicMesh3& ToolMesh, const FTransform& ToolTransform,
+		EVFMeshCutOperation Operation, UE::Geometry::FDynamicMesh3& OutMesh,
+		const FVFConvexVolume* ToolVolume = nullptr);
+
+	/**
+	 * 放置照片时对一个组件网格体的完整切割，结果位于SourceMesh的局部空间，只有在返回Cut时才会写入OutMesh。
+	 * 传入照片记录的网格体时会先与其相交，再与Pyramid进行运算。只读取传入的网格体，可以在工作线程中调用。
+	 */
+	static EVFMeshCutOutcome ApplyPlaceCut(
+		const UE::Geometry::FDynamicMesh3& SourceMesh, const FTransform& SourceTransform,
+		const UE::Geometry::FDynamicMesh3* RecordMesh, const FTransform& RecordTransform,
+		const UE::Geometry::FDynamicMesh3& PyramidMesh, const FTransform& PyramidTransform, const FVFConvexVolume& PyramidVolume,
+		EVFMeshCutOperation PyramidOperation, UE::Geometry::FDynamicMesh3& OutMesh);
+};
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DynamicMesh/DynamicMesh3.h"
+
+class UStaticMesh;
+
+/**
+ * 切割结果相对于切割前的网格体资源的补丁：被删除的三角面ID与新增的三角面。
+ * 切割通常只改变Pyramid边界附近的三角面，补丁的大小与切割的范围有关，与网格体资源的大小无关。
+ * 三角面ID来自以相同方式转换的网格体资源，资源改变后补丁无法还原。只处理网格体数据，可以在工作线程中生成与还原。
+ */
+struct VIEWFINDERTUTORIAL_API FVFMeshPatch
+{
+	//补丁的来源网格体资源，由UVFCutGeometrySubsystem保持加载
+	TWeakObjectPtr<UStaticMesh> SourceMesh;
+
+	//来源网格体的三角面与顶点数量，用于确认来源没有改变
+	int32 SourceTriangleCount = 0;
+	int32 SourceVertexCount = 0;
+
+	TArray<int32> RemovedTriangles;
+	UE::Geometry::FDynamicMesh3 AddedMesh;
+
+	/**
+	 * 比较切割前后的网格体生成补丁，两者需要位于相同的局部空间。
+	 * 位置与材质都相同的三角面视为被保留，不依赖boolean输出的三角面ID。没有匹配到的三角面只会作为新增的三角面存储，不影响还原的结果。
+	 */
+	void Build(const UE::Geometry::FDynamicMesh3& BaseMesh, const UE::Geometry::FDynamicMesh3& CutMesh);
+
+	//在来源网格体上应用补丁，BaseMesh与生成补丁时不同时返回false。
+	bool Apply(const UE::Geometry::FDynamicMesh3& BaseMesh, UE::Geometry::FDynamicMesh3& OutMesh) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+	//不包括SourceMesh，来源由存储补丁的位置以路径记录。
+	void Serialize(FArchive& Ar);
+};
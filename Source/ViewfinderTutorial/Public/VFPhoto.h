@@ -4,10 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "UObject/GCObject.h"
 #include "VFPhoto.generated.h"
 
 class AVFPhoto;
 class UDynamicMesh;
+class UMaterialInterface;
+class UMaterialInstanceDynamic;
+class UStaticMesh;
+class UStaticMeshComponent;
 
 //照片在将要拍摄或是已拍摄的参数。
 USTRUCT(BlueprintType)
@@ -55,59 +60,99 @@ struct FVFAPhotoTakeParams
 	float GetAspectRatio() const { return CaptureSize.X / CaptureSize.Y; }
 };
 
-USTRUCT()
-struct FVFActorRecord
+//照片中记录的一个静态网格体组件。
+struct FVFComponentSnapshot
 {
-	GENERATED_BODY()
+	//组件在Actor中的名称，生成Actor后用于找到对应的组件。
+	FName ComponentName;
+
+	//对于地图上的静态网格体组件，大多数情况下，其StaticMesh并非类的默认值，因此需要存储
+	TObjectPtr<UStaticMesh> StaticMesh;
+
+	//组件的材质在照片的MaterialIndices中的起始位置与数量。
+	int32 FirstMaterial = 0;
+	int32 NumMaterials = 0;
+
+	bool bSimulatePhysics = false;
+	TEnumAsByte<ECollisionEnabled::Type> CollisionEnabled = ECollisionEnabled::QueryAndPhysics;
+};
 
-	UPROPERTY(SkipSerialization)
+//照片中记录的一个Actor，其组件位于照片的ComponentSnapshots中的连续区间内。
+struct FVFActorSnapshot
+{
 	TSubclassOf<AActor> Class;
 
 	//Actor在被记录时，相对于记录者组件的变换。
-	UPROPERTY(SkipSerialization)
 	FTransform RelativeTransform;
 
-	//对于地图上的静态网格体组件，大多数情况下，其StaticMesh并非类的默认值，因此需要存储
-	UPROPERTY(SkipSerialization)
-	TMap<FString, UStaticMesh*> NameToMeshMap;
+	int32 FirstComponent = 0;
+	int32 NumComponents = 0;
 
-	//如果有需要，此结构体内可以添加更多需要存储的信息。这些信息一般为在地图中Actor指定的与Default不同的数值。
-	//或者说，存储可能与类默认值不同的数据，包括物理质量，材质等等。
+	//如果有需要，可以在组件快照中添加更多需要存储的信息。这些信息一般为在地图中Actor指定的与Default不同的数值。
 	//在TakePhoto中记录，PlacePhoto中处理。
 };
 
-USTRUCT()
-struct FVFPhotoInfo
+/**
+ * 照片在拍摄时捕获的数据，拍摄完成后不会再改变。
+ * 照片在物品栏、时间回溯与放置记录之间传递时，所有持有者共享同一份数据，复制照片只会复制引用，与场景大小无关。
+ * 其中的UObject由此结构体向GC报告引用。
+ */
+struct VIEWFINDERTUTORIAL_API FVFPhotoPayload : public FGCObject
 {
-	GENERATED_BODY()
-
-	UPROPERTY()
 	FVFAPhotoTakeParams PhotoTakeParams;
-	
-	//
-	//下方的变量仅在游戏内用于时间回溯，不会被存档序列化。
-	//
-	
-	//照片的渲染目标，也会作为照片的材质。同时，它也会被用于区分Photo的不同。
-	UPROPERTY(SkipSerialization)
+
+	//照片的渲染目标，也会作为照片的材质。
 	TObjectPtr<UTexture> RenderTarget;
 
 	//如果照片需要存储背景图片，此为背景图片。注意，它并不会被作为材质。
-	UPROPERTY(SkipSerialization)
 	TObjectPtr<UTexture> BackgroundRenderTarget;
 
-	//照片拍摄所记录到的Actors。
-	UPROPERTY(SkipSerialization)
-	TArray<FVFActorRecord> ActorRecords;
+	//照片拍摄所记录到的Actors与它们的组件，组件与材质在整张照片内使用平坦的数组存储。
+	TArray<FVFActorSnapshot> ActorSnapshots;
+	TArray<FVFComponentSnapshot> ComponentSnapshots;
+	TArray<int32> MaterialIndices;
+	TArray<TObjectPtr<UMaterialInterface>> Materials;
 
 	//照片中所有记录到的网格体的集合，生成一个动态网格体。
-	UPROPERTY(SkipSerialization)
 	TObjectPtr<UDynamicMesh> DynamicMeshRecord;
 
+	//记录一个被拍摄到的Actor，只能在照片拍摄完成前调用。
+	void AddCapturedActor(AActor* Actor, const FTransform& CameraTransform);
+
+	/**
+	 * 在相对于CameraTransform的位置生成照片中记录的Actor，并一次性设置其所有组件。
+	 * 组件尽量在注册之前设置，不需要反复切换Mobility。
+	 */
+	AActor* SpawnCapturedActor(UWorld* World, int32 ActorIndex, const FTransform& CameraTransform) const;
+
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FVFPhotoPayload"); }
+};
+
+USTRUCT(BlueprintType)
+struct FVFPhotoInfo
+{
+	GENERATED_BODY()
+
+	/**
+	 * 照片的唯一ID，在拍摄时生成，用于区分不同的照片。
+	 * 与渲染目标的指针不同，它在纹理被替换、压缩以及存档读取后依然不变。0代表无效的照片。
+	 */
+	UPROPERTY()
+	uint64 PhotoId = 0;
+
+	//照片拍摄时捕获的数据，由所有持有此照片的地方共享。
+	TSharedPtr<const FVFPhotoPayload> Payload;
+
+	bool IsValid() const { return PhotoId != 0 && Payload.IsValid(); }
+
 	bool operator==(const FVFPhotoInfo& B) const
 	{
-		return RenderTarget == B.RenderTarget;
+		return PhotoId == B.PhotoId;
 	}
+
+	//生成一个新的照片ID。
+	static uint64 GeneratePhotoId();
 };
 
 UCLASS()
@@ -120,7 +165,6 @@ public:
 	
 protected:
 	virtual void BeginPlay() override;
-	virtual void Tick(float DeltaTime) override;
 
 public:
 	UFUNCTION(BlueprintCallable, Category = "Viewfinder")
@@ -128,15 +172,20 @@ public:
 
 	void SetPhotoInfo(const FVFPhotoInfo& InPhotoInfo);
 	const FVFPhotoInfo& GetPhotoInfo() const { return PhotoInfo; }
-	void AddCapturedActor(AActor* Actor, const FTransform& CameraTransform);
 
+	//设置照片显示的纹理，不会改变照片信息。动态材质只会创建一次，之后只替换纹理参数。
 	void SetRenderTarget(UTexture* Texture);
-	void SetBackgroundRenderTarget(UTexture* Texture) { PhotoInfo.BackgroundRenderTarget = Texture; };
+
+	//照片显示的纹理，背景照片没有照片信息，存档时由此取得纹理。
+	UTexture* GetRenderTarget() const;
 
 protected:
 	UPROPERTY(VisibleAnywhere)
 	TObjectPtr<UStaticMeshComponent> PhotoMesh;
 
+	UPROPERTY()
+	TObjectPtr<UMaterialInstanceDynamic> PhotoMaterial;
+
 protected:
 	UPROPERTY()
 	FVFPhotoInfo PhotoInfo;
@@ -9,8 +9,48 @@
 class UDynamicMesh;
 class UStaticMesh;
 class UStaticMeshComponent;
+class UInstancedStaticMeshComponent;
+class UDynamicMeshComponent;
 class AVFPhoto;
+class UVFScratchMeshPool;
+struct FVFMemoryReport;
+struct FVFPlacementBundle;
+struct FVFSpeculativePlacement;
+struct FVFPlacePreview;
+struct FVFConvexVolume;
+struct FVFMeshPatch;
 enum class EGeometryScriptBooleanOperation : uint8;
+enum class EVFMeshCutOutcome : uint8;
+enum class EVFMeshCutOperation : uint8;
+namespace UE::Geometry { class FDynamicMesh3; }
+
+//放置照片时从实例化静态网格体组件中移除的实例，撤销放置时按世界变换重新添加。
+USTRUCT()
+struct FVFRemovedInstances
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<UInstancedStaticMeshComponent> Component;
+
+	UPROPERTY()
+	TArray<FTransform> InstanceTransforms;
+};
+
+//放置输入的哈希与组件数量，哈希相同时再比较组件数量，降低碰撞导致误用缓存的概率。
+USTRUCT()
+struct FVFInputMeshKey
+{
+	GENERATED_BODY()
+
+	uint64 Hash = 0;
+	int32 NumComponents = 0;
+
+	bool operator==(const FVFInputMeshKey& Other) const
+	{
+		return Hash == Other.Hash && NumComponents == Other.NumComponents;
+	}
+};
 
 //放置照片操作的信息，仅在放置后生成。
 USTRUCT(BlueprintType)
@@ -42,6 +82,10 @@ struct FVFPhotoPlaceRecord
 	UPROPERTY(SkipSerialization)
 	TArray<AActor*> SpawnedActors;
 
+	//照片中的Actor刚生成时的变换，重新恢复被撤销的放置时使用。
+	UPROPERTY(SkipSerialization)
+	TArray<FTransform> SpawnedActorTransforms;
+
 	//地图原有Actor被隐藏生成的组件
 	UPROPERTY(SkipSerialization)
 	TArray<UPrimitiveComponent*> HiddenComponents;
@@ -50,12 +94,38 @@ struct FVFPhotoPlaceRecord
 	UPROPERTY(SkipSerialization)
 	TArray<UPrimitiveComponent*> GeneratedComponents;
 
+	//地图原有的实例化组件中被切割或被完全消除的实例，它们不会被隐藏而是从组件中移除
+	UPROPERTY(SkipSerialization)
+	TArray<FVFRemovedInstances> RemovedInstances;
+
 	UPROPERTY(SkipSerialization)
 	TObjectPtr<AVFPhoto> BackgroundPhoto;
 
+	//放置前与Pyramid重叠的组件及其网格体的哈希，用于判断被撤销的放置能否直接恢复。
+	UPROPERTY(SkipSerialization)
+	FVFInputMeshKey InputMeshKey;
+
 	//此处也可以记录一些用于组件还原状态的变量，如模拟物理和碰撞启用等，如：TMap<UPrimitiveComponent*, bool> ComponentPhysicsMap;
 };
 
+//被时间回溯撤销的放置，其生成的组件与Actor被隐藏保留，以相同的条件再次放置时直接恢复。
+USTRUCT()
+struct FVFPlaceCacheEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVFPhotoPlaceRecord PhotoPlaceRecord;
+
+	//生成的组件被隐藏前的碰撞设置，与GeneratedComponents一一对应。
+	UPROPERTY()
+	TArray<TEnumAsByte<ECollisionEnabled::Type>> GeneratedCollisionEnabled;
+
+	//生成的Actor中被暂停模拟物理的组件。
+	UPROPERTY()
+	TArray<TObjectPtr<UPrimitiveComponent>> PhysicsComponents;
+};
+
 /**
  * 
  */
@@ -76,21 +146,57 @@ protected:
 	virtual void BeginPlay() override;
 
 public:
-	//执行拍摄照片的流畅并返回照片Actor。
+	//执行拍摄照片的流程并返回照片信息。照片只是数据，不会生成Actor。
 	UFUNCTION(BlueprintCallable, Category = "Viewfinder")
-	AVFPhoto* TakePhoto();
+	FVFPhotoInfo TakePhoto();
 
 	UFUNCTION(BlueprintCallable, Category = "Viewfinder")
-	AVFPhoto* TakePhotoWithParamAssigned(const FVFAPhotoTakeParams& Params);
+	FVFPhotoInfo TakePhotoWithParamAssigned(const FVFAPhotoTakeParams& Params);
 
 	//按照给定照片的参数放置。
 	UFUNCTION(BlueprintCallable, Category = "Viewfinder")
-	FVFPhotoPlaceRecord PlacePhoto(AVFPhoto* PhotoToPlace, float RotatedAngle);
+	FVFPhotoPlaceRecord PlacePhoto(const FVFPhotoInfo& PhotoToPlace, float RotatedAngle);
 
 	//void PlacePhotoWithParamAssigned(AVFPhoto* PhotoToPlace, float RotatedAngle);
+
+	/**
+	 * 在工作线程中提前计算以当前变换和角度放置照片时地图组件的切割结果，条件没有改变时不会重复计算。
+	 * 之后以相同的条件放置时直接应用结果，放置照片中的Actor仍然在放置时进行。
+	 */
+	void BeginSpeculativePlace(const FVFPhotoInfo& PhotoToPlace, float RotatedAngle);
+
+	//丢弃提前计算的结果，在瞄准的变换或角度改变时调用。
+	void CancelSpeculativePlace();
+
+	/**
+	 * 在工作线程中计算以当前变换和角度放置照片的低精度预览，网格体会被简化到MaxTrianglesPerMesh以下，最多处理MaxComponents个组件。
+	 * 上一次的预览还未取出时不会开始新的计算，返回false。
+	 */
+	bool RequestPlacePreview(const FVFPhotoInfo& PhotoToPlace, float RotatedAngle, int32 MaxTrianglesPerMesh, int32 MaxComponents);
+
+	//预览计算完成时取出位于世界空间的预览网格体。
+	bool FetchPlacePreview(UE::Geometry::FDynamicMesh3& OutMesh);
+
+	void CancelPlacePreview();
+
+	/**
+	 * 撤销一次放置，还原被隐藏的组件。
+	 * 放置的结果不会被销毁而是被隐藏并缓存，之后以相同的照片、变换与角度放置，且重叠的组件没有改变时直接恢复，不需要重新进行boolean。
+	 */
+	void UndoPlacePhoto(const FVFPhotoPlaceRecord& PhotoPlaceRecord);
+
+	//释放被撤销后缓存的放置并丢弃提前计算的结果，在读取存档之前调用。
+	void ResetPlaceCache();
 	
 	float GetCaptureFOVAngle() const { return DefaultPhotoTakeParams.CaptureFOVAngle; }
 	float GetCaptureAspectRatio() const { return DefaultPhotoTakeParams.GetAspectRatio(); }
+	const FVFAPhotoTakeParams& GetDefaultPhotoTakeParams() const { return DefaultPhotoTakeParams; }
+
+	//拍照与放置过程中使用的临时网格体对象池。
+	UVFScratchMeshPool* GetScratchMeshPool();
+
+	//将被撤销后缓存的放置计入内存统计。
+	void CollectMemoryReport(FVFMemoryReport& Report) const;
 	
 protected:
 	void SetPyramidScale(float InFOVAngle, float InMaxDistance, float AspectRatio);
@@ -107,14 +213,81 @@ protected:
 
 	/* 处理组件网格体的boolean。
 	 * 使用DynamicMeshRecord的有效性判断网格体是地图上现存的还是放置照片时生成的，并进行不同的处理。
+	 * 没有被改变的组件保持原样，被切割或被完全消除的组件会被隐藏并加入OutHiddenComponents，只有被切割的组件会生成新的组件。
+	 * 实例化组件逐实例处理，被切割或被完全消除的实例从组件中移除并加入OutRemovedInstances。
+	 */
+	TArray<UPrimitiveComponent*> ProcessMeshBooleanToComponents(const TArray<UPrimitiveComponent*>& Components, TArray<UPrimitiveComponent*>& OutHiddenComponents, TArray<FVFRemovedInstances>& OutRemovedInstances, UDynamicMesh* DynamicMeshRecord = nullptr);
+
+	/**
+	 * 逐实例切割实例化组件，组件本身不会被隐藏。
+	 * 相减时只检查与Pyramid包围盒重叠的实例，开销与实际被切到的实例数量成正比。只有被切割的实例会生成新的组件。
+	 */
+	TArray<UPrimitiveComponent*> ProcessInstancedMeshBoolean(UInstancedStaticMeshComponent* Component, UDynamicMesh* StaticMeshCopy, const UE::Geometry::FDynamicMesh3* RecordMesh, const FVFConvexVolume& PyramidVolume, EVFMeshCutOperation PyramidOperation, TArray<FVFRemovedInstances>& OutRemovedInstances);
+
+	//放置条件与提前计算时相同且计算已经完成时应用其结果，并填充放置记录。未完成的结果被丢弃，不会等待。
+	bool CommitSpeculativePlace(FVFPhotoPlaceRecord& PhotoPlaceRecord);
+
+	/**
+	 * 按照切割结果处理组件：没有改变的组件保持原样，被切割或被完全消除的组件会被隐藏并加入OutHiddenComponents。
+	 * 只有被切割的组件会生成新的组件并返回。被隐藏的生成组件只保留补丁。
 	 */
-	TArray<UPrimitiveComponent*>  ProcessMeshBooleanToComponents(const TArray<UPrimitiveComponent*>& Components, UDynamicMesh* DynamicMeshRecord = nullptr);
+	UPrimitiveComponent* CommitComponentCut(UPrimitiveComponent* Component, EVFMeshCutOutcome Outcome, UE::Geometry::FDynamicMesh3&& CutMesh, const TSharedPtr<FVFMeshPatch>& Patch, TArray<UPrimitiveComponent*>& OutHiddenComponents);
+
+	//以被切割的组件的碰撞、物理与材质设置生成承载切割结果的动态网格体组件。没有补丁来源时Patch为空，组件只有完整的网格体。
+	UDynamicMeshComponent* SpawnGeneratedComponent(UPrimitiveComponent* SourceComponent, const FTransform& Transform, UE::Geometry::FDynamicMesh3&& CutMesh, const TSharedPtr<FVFMeshPatch>& Patch);
+
+	//将重叠查询返回的组件的网格体与变换记录到正在导出的放置包，实例化组件的每个实例各记录一次。
+	void CaptureBundleComponents(FVFPlacementBundle& Bundle, const TArray<UPrimitiveComponent*>& Components, bool bIsGenerated);
+
+	//复制组件的网格体，不支持的组件返回false。实例化组件需要逐实例处理，同样返回false。
+	bool CopyComponentMesh(UPrimitiveComponent* Component, UE::Geometry::FDynamicMesh3& OutMesh);
+
+	//生成的组件被烘焙后，将缓存中的旧组件替换为新组件，并丢弃以旧组件计算的提前切割结果。
+	void ReplaceComponentReferences(UPrimitiveComponent* OldComponent, UPrimitiveComponent* NewComponent);
+
+	/**
+	 * 计算照片ID、组件变换及其内容的哈希，与重叠查询返回的顺序无关。
+	 * 被修改过的组件使用其内容标记而不读取网格体，被释放的网格体还原后、组件被烘焙替换后都得到相同的结果。
+	 */
+	FVFInputMeshKey CalcInputMeshKey(uint64 PhotoId, const TArray<UPrimitiveComponent*>& Components) const;
+
+	//查找与放置记录条件相同的缓存，找到时恢复并填充放置记录。
+	bool RestoreCachedPlacement(FVFPhotoPlaceRecord& PhotoPlaceRecord);
+
+	//销毁放置生成的组件与Actor，组件和背景照片会被归还到对象池。
+	void ReleasePlacementResults(const FVFPhotoPlaceRecord& PhotoPlaceRecord);
 
 	//组件沿着自身X轴转动此角度
 	void ApplyRotatedAngleDelta(float DeltaAngle);
 
+	//获取Pyramid的动态网格体，只在静态网格体改变时重新转换。
+	const UE::Geometry::FDynamicMesh3& GetPyramidMesh();
+
 protected:
 	//拍摄照片的默认参数
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Viewfinder")
 	FVFAPhotoTakeParams DefaultPhotoTakeParams;
+
+	//最多缓存的被撤销的放置数量。
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Viewfinder|Rewind")
+	int32 MaxCachedPlacements = 4;
+
+	//再次放置时变换与缓存的放置被视为相同的容差。
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Viewfinder|Rewind")
+	float PlaceCacheTolerance = 0.1f;
+
+	UPROPERTY(Transient)
+	TArray<FVFPlaceCacheEntry> PlaceCache;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UVFScratchMeshPool> ScratchMeshPool;
+
+	TSharedPtr<FVFSpeculativePlacement> SpeculativePlacement;
+	TSharedPtr<FVFPlacePreview> PlacePreview;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UDynamicMesh> PyramidMeshCache;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStaticMesh> PyramidMeshCacheSource;
 };
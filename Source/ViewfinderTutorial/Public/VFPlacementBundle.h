@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DynamicMesh/DynamicMesh3.h"
+#include "VFPhoto.h"
+
+struct FVFOperationStats;
+
+/**
+ * 一次放置的几何输入，可以写入单个文件并在没有地图与资源的环境中重放放置的切割，用于离线分析耗时异常的放置。
+ * 包括照片的拍摄参数与网格体记录、放置时的变换与角度，以及两次重叠查询返回的每个组件的网格体与变换。
+ * 照片的渲染目标与Actor快照引用了资源，不会被记录，生成照片中Actor的耗时也就不能重放。
+ */
+struct VIEWFINDERTUTORIAL_API FVFPlacementBundle
+{
+	//重叠查询返回的一个组件，实例化组件的每个实例各为一个条目。
+	struct FComponent
+	{
+		FString Name;
+
+		//是否是照片中生成的组件，生成的组件需要先与网格体记录相交，再与Pyramid相交
+		bool bIsGenerated = false;
+
+		//组件网格体在Meshes中的索引，使用同一个网格体的组件只记录一份网格体
+		int32 MeshIndex = INDEX_NONE;
+		FTransform Transform;
+	};
+
+	uint64 PhotoId = 0;
+	FVFAPhotoTakeParams PhotoTakeParams;
+	FTransform PlaceTransformNoScale;
+	float PlaceRotatedAngle = 0.f;
+
+	//照片的网格体记录，及其在放置时的变换
+	UE::Geometry::FDynamicMesh3 RecordMesh;
+	FTransform RecordTransform;
+
+	//切割地图组件与生成的组件时Pyramid的缩放不同
+	UE::Geometry::FDynamicMesh3 PyramidMesh;
+	FTransform LevelPyramidTransform;
+	FTransform GeneratedPyramidTransform;
+
+	TArray<UE::Geometry::FDynamicMesh3> Meshes;
+	TArray<FComponent> Components;
+
+	//添加一个组件，MeshSource相同的组件共享网格体，MeshSource为空时总是复制网格体。
+	void AddComponent(const FString& Name, bool bIsGenerated, const FTransform& Transform, const UObject* MeshSource, const UE::Geometry::FDynamicMesh3& Mesh);
+
+	/**
+	 * 以放置时相同的顺序与参数对所有组件进行切割，每个组件的耗时与三角面数量记录到Stats的PlaceLevelCut与PlaceGeneratedCut阶段。
+	 * 只读取网格体，可以在任意线程中调用。
+	 */
+	void Replay(FVFOperationStats& Stats) const;
+
+	bool SaveToFile(const FString& Filename) const;
+	bool LoadFromFile(const FString& Filename);
+
+	void Serialize(FArchive& Ar);
+
+	//当前正在记录的放置，放置照片时把几何输入写入其中，没有时不做任何事。只在游戏线程中使用。
+	static FVFPlacementBundle* GetActive() { return Active; }
+	static void SetActive(FVFPlacementBundle* InBundle) { Active = InBundle; }
+
+	//由vf.ExportNextPlacement请求导出下一次放置，调用后请求被清除。
+	static bool ConsumeExportRequest();
+
+private:
+	TMap<const UObject*, int32> MeshIndices;
+
+	static FVFPlacementBundle* Active;
+};
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "VFPlacementReplayCommandlet.generated.h"
+
+/**
+ * 重放由vf.ExportNextPlacement或卡顿监视导出的放置包中的切割，不需要加载地图与资源，如：
+ * UnrealEditor-Cmd ViewfinderTutorial -run=VFPlacementReplay -nullrhi -Bundle=Saved/Viewfinder/Bundles/Place.vfbundle -Iterations=20
+ * 每次迭代的各阶段耗时写入Saved/Viewfinder/Replay下的CSV，被切割的组件及其三角面数量只在第一次迭代后输出。
+ */
+UCLASS()
+class VIEWFINDERTUTORIAL_API UVFPlacementReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UVFPlacementReplayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "VFPoolSubsystem.generated.h"
+
+//对象池在世界开始时预先生成的Actor。
+USTRUCT()
+struct FVFPoolWarmUpActor
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	TSoftClassPtr<AActor> ActorClass;
+
+	UPROPERTY(Config)
+	int32 Count = 0;
+};
+
+/**
+ * 取景器反复生成与销毁的Actor与组件的对象池，如瞄准时的相框、放置照片时的背景照片与切割生成的动态网格体组件。
+ * 归还的对象会被隐藏并关闭碰撞，下次获取时重新启用，获取者需要重新设置其状态。
+ * 组件无法在不同的Actor之间移动，因此组件按所属Actor分别缓存。
+ */
+UCLASS(Config = Game)
+class VIEWFINDERTUTORIAL_API UVFPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	//获取一个处于指定变换的Actor，池中没有时生成新的Actor。
+	AActor* AcquireActor(TSubclassOf<AActor> Class, const FTransform& Transform);
+	void ReleaseActor(AActor* Actor);
+
+	//获取一个属于Owner的已注册组件，池中没有时添加新的组件。组件不会被挂载到任何组件上。
+	UActorComponent* AcquireComponent(AActor* Owner, TSubclassOf<UActorComponent> Class);
+	void ReleaseComponent(UActorComponent* Component);
+
+	template<typename T>
+	T* AcquireComponent(AActor* Owner)
+	{
+		return Cast<T>(AcquireComponent(Owner, T::StaticClass()));
+	}
+
+	//为Owner预先添加组件。
+	void WarmUpComponents(AActor* Owner, TSubclassOf<UActorComponent> Class, int32 Count);
+
+	int32 GetPhotoFrameWarmUpCount() const { return PhotoFrameWarmUpCount; }
+
+	float GetHitRate() const { return NumHits + NumMisses > 0 ? (float)NumHits / (NumHits + NumMisses) : 1.f; }
+	void LogStats() const;
+
+protected:
+	//记录一次新的生成，用于统计每帧的生成数量。
+	void CountSpawn();
+
+protected:
+	UPROPERTY(Config)
+	TArray<FVFPoolWarmUpActor> WarmUpActors;
+
+	UPROPERTY(Config)
+	int32 PhotoFrameWarmUpCount = 1;
+
+	//每个Actor的每种组件最多缓存的数量，超出的组件会被直接销毁。
+	UPROPERTY(Config)
+	int32 MaxPooledComponentsPerOwner = 8;
+
+	//每种Actor最多缓存的数量，超出的Actor会被直接销毁。
+	UPROPERTY(Config)
+	int32 MaxPooledActorsPerClass = 16;
+
+	TMap<TObjectKey<UClass>, TArray<TWeakObjectPtr<AActor>>> PooledActors;
+	TMap<TPair<TObjectKey<AActor>, TObjectKey<UClass>>, TArray<TWeakObjectPtr<UActorComponent>>> PooledComponents;
+
+	int32 NumHits = 0;
+	int32 NumMisses = 0;
+	int32 NumSpawnsThisFrame = 0;
+	int32 PeakSpawnsPerFrame = 0;
+	uint64 SpawnFrameNumber = 0;
+};
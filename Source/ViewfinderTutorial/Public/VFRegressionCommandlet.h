@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VFBenchmarkCommandlet.h"
+#include "VFRegressionCommandlet.generated.h"
+
+//一个固定的合成场景，每次迭代拍照、放置并撤销放置。
+USTRUCT()
+struct FVFRegressionScenario
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FString Name;
+
+	UPROPERTY(Config)
+	int32 Meshes = 16;
+
+	UPROPERTY(Config)
+	int32 Triangles = 2000;
+
+	UPROPERTY(Config)
+	float PlaceAngle = 45.f;
+
+	UPROPERTY(Config)
+	int32 Iterations = 5;
+};
+
+/**
+ * 性能回归检查，在无渲染的环境中运行配置的合成场景与BundleDirectory下的所有放置包，与基准比较，如：
+ * UnrealEditor-Cmd ViewfinderTutorial -run=VFRegression -nullrhi
+ * 任何指标超出容差或缺失、放置包无法读取或基准不存在时返回1。加上-UpdateBaselines时以本次的结果覆盖基准并返回0。
+ * 耗时与内存变化取各次迭代的中位数，三角面数量与生成的字节数是确定的，只允许很小的容差。
+ */
+UCLASS(Config = Game)
+class VIEWFINDERTUTORIAL_API UVFRegressionCommandlet : public UVFBenchmarkCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+	void AddScenarioMetrics(const FString& Prefix, const TArray<FVFBenchmarkIteration>& Iterations, TMap<FString, double>& OutMetrics) const;
+	//放置包无法读取时返回false。
+	bool AddBundleMetrics(const FString& BundlePath, int32 NumIterations, TMap<FString, double>& OutMetrics) const;
+
+	//按指标的种类返回允许的增长，超出时视为回归。
+	double GetAllowedIncrease(const FString& Metric, double Baseline) const;
+
+	//输出差异表，返回回归与缺失的指标数量。
+	int32 CompareWithBaselines(const TMap<FString, double>& Baselines, const TMap<FString, double>& Metrics) const;
+
+protected:
+	UPROPERTY(Config)
+	TArray<FVFRegressionScenario> Scenarios;
+
+	//相对于项目目录，其中的每个放置包都会被重放。
+	UPROPERTY(Config)
+	FString BundleDirectory = TEXT("Build/Viewfinder/Bundles");
+
+	UPROPERTY(Config)
+	int32 BundleIterations = 5;
+
+	//相对于项目目录，基准需要与项目一同提交。
+	UPROPERTY(Config)
+	FString BaselinePath = TEXT("Build/Viewfinder/RegressionBaselines.json");
+
+	//耗时允许的相对增长，以及不视为回归的绝对增长，短小的阶段容易受到噪声影响。
+	UPROPERTY(Config)
+	float TimeTolerance = 0.2f;
+
+	UPROPERTY(Config)
+	float MinTimeIncreaseMs = 0.5f;
+
+	//内存与分配允许的相对增长，以及不视为回归的绝对增长。
+	UPROPERTY(Config)
+	float MemoryTolerance = 0.1f;
+
+	UPROPERTY(Config)
+	float MinMemoryIncreaseKB = 256.f;
+
+	//三角面数量与组件数量允许的相对增长。
+	UPROPERTY(Config)
+	float CountTolerance = 0.01f;
+};
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//存档中块的类型，只能在末尾添加新的类型。
+enum class EVFSaveChunkType : uint8
+{
+	//照片物品栏、玩家与地图改变的描述，其中的纹理与网格体以块的索引引用
+	World,
+	//块压缩的纹理，见FVFTextureCodec
+	Texture,
+	//FDynamicMesh3
+	Mesh,
+	//FVFMeshPatch，不包括来源
+	MeshPatch,
+};
+
+/**
+ * 存档文件由文件头、块表与按16字节对齐的块组成，每个块单独压缩。
+ * 读取时先只读取块表，之后按需要定位并解压单个块，不需要把整个文件读入内存。
+ * 块在写入前只保存在内存中，Save时一次性写出。
+ */
+class VIEWFINDERTUTORIAL_API FVFSaveFileWriter
+{
+public:
+	//添加一个块并返回其索引，不小于压缩后大小的数据不会被压缩。
+	int32 AddChunk(EVFSaveChunkType Type, const TArray<uint8>& Data);
+
+	bool Save(const FString& Filename) const;
+
+	int64 GetTotalSize() const;
+
+private:
+	struct FChunk
+	{
+		EVFSaveChunkType Type;
+		bool bIsCompressed = false;
+		int32 UncompressedSize = 0;
+		TArray<uint8> Data;
+	};
+	TArray<FChunk> Chunks;
+};
+
+class VIEWFINDERTUTORIAL_API FVFSaveFileReader
+{
+public:
+	//读取文件头与块表，文件不存在或版本不兼容时返回false。
+	bool Open(const FString& Filename);
+
+	int32 GetNumChunks() const { return Entries.Num(); }
+	EVFSaveChunkType GetChunkType(int32 Index) const { return Entries[Index].Type; }
+
+	//读取并解压一个块，索引无效或数据损坏时返回false。
+	bool LoadChunk(int32 Index, TArray<uint8>& OutData);
+
+	//文件中第一个指定类型的块的索引，没有时返回INDEX_NONE。
+	int32 FindChunk(EVFSaveChunkType Type) const;
+
+private:
+	struct FEntry
+	{
+		EVFSaveChunkType Type;
+		bool bIsCompressed = false;
+		int64 Offset = 0;
+		int32 Size = 0;
+		int32 UncompressedSize = 0;
+	};
+	TArray<FEntry> Entries;
+	TUniquePtr<FArchive> FileReader;
+	int64 FileSize = 0;
+};
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/Pipe.h"
+#include "VFSaveState.h"
+
+/**
+ * 自动存档：一个快照与之后只追加的日志。
+ * 每次操作的改变作为一条记录追加到日志，记录的序列化、压缩、写入与合并在后台管线中按顺序进行，游戏线程不等待磁盘。
+ * 记录在管线排空时才交给系统，连续的操作只交给系统一次，但距离上次交给系统不会超过MaxFlushInterval。
+ * 日志超过MaxJournalSize时，后台将合并后的状态写为新的快照并清空日志，因此每次操作的开销只与其改变的对象有关，与游戏时长无关。
+ * 读取时先读取快照，再按序号重放日志中之后的记录，崩溃时写入一半的记录会被忽略。
+ */
+class VIEWFINDERTUTORIAL_API FVFSaveJournal
+{
+public:
+	FVFSaveJournal(const FString& InSnapshotFilename, const FString& InJournalFilename, int64 InMaxJournalSize);
+
+	//等待所有写入完成
+	~FVFSaveJournal();
+
+	//以State作为新的快照开始新的日志，之前的快照与日志被替换。
+	void Reset(FVFSaveState&& InState);
+
+	//为记录分配序号并追加到日志。
+	void Append(FVFSaveDelta&& Delta);
+
+	//等待已经追加的记录与快照写入完成，返回时记录已经交给系统。
+	void Flush();
+
+	/**
+	 * 读取快照并重放日志中属于它的记录，日志不存在时只读取快照。
+	 * 遇到不完整、损坏或不连续的记录时停止重放，之前的记录依然有效。快照无法读取时返回false。
+	 */
+	static bool Load(const FString& SnapshotFilename, const FString& JournalFilename, FVFSaveState& OutState, int32& OutNumReplayed);
+
+private:
+	//以下函数只在管线中调用
+	//bFlush为true时将日志交给系统，否则只在距离上次交给系统过久时交给系统
+	void WriteRecord(const FVFSaveDelta& Delta, bool bFlush);
+	void Compact();
+	void OpenJournal();
+
+	const FString SnapshotFilename;
+	const FString JournalFilename;
+	const int64 MaxJournalSize;
+
+	UE::Tasks::FPipe Pipe;
+	UE::Tasks::FTask LastTask;
+
+	//游戏线程中分配的下一个序号
+	uint64 NextSequence = 1;
+
+	//已经追加但还未写入的记录数量，管线中写入最后一条时为0
+	std::atomic<int32> NumPendingRecords = 0;
+
+	//只在管线中访问：合并了所有已写入记录的状态与打开的日志文件
+	FVFSaveState State;
+	TUniquePtr<FArchive> JournalWriter;
+	double LastFlushTime = 0.0;
+};
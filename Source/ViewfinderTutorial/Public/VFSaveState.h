@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+//存档中纹理或网格体的编码数据，创建后不再改变，在状态、日志记录与写入线程之间共享。类型由引用它的位置决定。
+struct FVFSaveBlob
+{
+	TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> Data;
+
+	bool IsValid() const { return Data.IsValid(); }
+};
+
+//资源以路径引用，放置烘焙生成的临时网格体以网格体数据存储。
+struct FVFSavedStaticMesh
+{
+	FString Path;
+	FVFSaveBlob Mesh;
+};
+
+//物品栏中的一张照片，与FVFPhotoPayload对应。
+struct FVFSavedPhoto
+{
+	struct FActor
+	{
+		FString Class;
+		FTransform RelativeTransform;
+		int32 FirstComponent = 0;
+		int32 NumComponents = 0;
+	};
+
+	struct FComponent
+	{
+		FName Name;
+		FVFSavedStaticMesh StaticMesh;
+		int32 FirstMaterial = 0;
+		int32 NumMaterials = 0;
+		bool bSimulatePhysics = false;
+		uint8 CollisionEnabled = 0;
+	};
+
+	uint64 PhotoId = 0;
+	float CaptureFOVAngle = 0.f;
+	float MaxCaptureDistance = 0.f;
+	float BackgroundDistance = 0.f;
+	FVector2D CaptureSize = FVector2D::ZeroVector;
+	FTransform TakeTransformNoScale;
+	FString PhotoClass;
+
+	FVFSaveBlob RenderTarget;
+	FVFSaveBlob BackgroundRenderTarget;
+
+	TArray<FString> Materials;
+	TArray<int32> MaterialIndices;
+	TArray<FActor> Actors;
+	TArray<FComponent> Components;
+	FVFSaveBlob MeshRecord;
+};
+
+//照片中生成的Actor的一个组件，切割生成的组件不在其中。
+struct FVFSavedComponent
+{
+	FName Name;
+	FTransform Transform;
+	bool bIsHidden = false;
+	bool bSimulatePhysics = false;
+	uint8 CollisionEnabled = 0;
+	FVFSavedStaticMesh StaticMesh;
+	TArray<FString> Materials;
+
+	//实例化组件的所有实例，相对于组件
+	TArray<FTransform> Instances;
+};
+
+struct FVFSavedActor
+{
+	FString Class;
+	FTransform Transform;
+	TArray<FVFSavedComponent> Components;
+};
+
+//切割生成的组件，属于地图中的Actor或照片中生成的Actor。
+struct FVFSavedGeneratedComponent
+{
+	FString OwnerPath;
+	FName AttachParentName;
+	FTransform Transform;
+
+	//切割结果的来源网格体资源的路径，不为空时Mesh是相对于来源的FVFMeshPatch，否则是完整的网格体
+	FString PatchSource;
+	FVFSaveBlob Mesh;
+	TArray<FString> Materials;
+	uint8 CollisionEnabled = 0;
+	FCollisionResponseContainer CollisionResponses;
+	bool bSimulatePhysics = false;
+};
+
+struct FVFSavedBackgroundPhoto
+{
+	FString Class;
+	FTransform Transform;
+	FVFSaveBlob Texture;
+};
+
+/**
+ * 存档的内容，只包含路径、数值与编码后的数据，不引用UObject，可以在任意线程中序列化与合并日志记录。
+ * 地图中的对象以相对于世界的路径索引，路径只在同一次运行中稳定，读取存档后需要重新写入完整的快照。
+ */
+struct VIEWFINDERTUTORIAL_API FVFSaveState
+{
+	FString MapName;
+	FTransform PawnTransform;
+	FRotator ControlRotation = FRotator::ZeroRotator;
+
+	//物品栏中的照片，按获得的顺序
+	TArray<FVFSavedPhoto> Photos;
+
+	//被放置隐藏或被压缩销毁的地图组件
+	TSet<FString> HiddenComponents;
+	TMap<FString, TArray<FTransform>> InstancedComponents;
+	TMap<FString, FVFSavedActor> SpawnedActors;
+	TMap<FString, FVFSavedGeneratedComponent> GeneratedComponents;
+	TMap<FString, FVFSavedBackgroundPhoto> BackgroundPhotos;
+
+	//快照所属的日志，只有相同ID的日志中的记录可以重放
+	FGuid JournalId;
+
+	//已经合并进此状态的最后一条日志记录的序号
+	uint64 Sequence = 0;
+
+	/**
+	 * 写入FVFSaveFile格式的存档，纹理与网格体各为一个块，相同的数据只写入一次。
+	 * 先写入临时文件再替换，写入中途退出时原有的存档不受影响。
+	 */
+	bool SaveToFile(const FString& Filename, int64* OutFileSize = nullptr) const;
+
+	//读取存档，文件不存在、损坏或版本不兼容时返回false，并且不改变此状态。
+	bool LoadFromFile(const FString& Filename);
+};
+
+//一次拍照、放置、回溯或几何体替换对存档的改变，只包含被改变的对象。先移除，再重命名，最后添加或替换。
+struct VIEWFINDERTUTORIAL_API FVFSaveDelta
+{
+	uint64 Sequence = 0;
+
+	FTransform PawnTransform;
+	FRotator ControlRotation = FRotator::ZeroRotator;
+	bool bHasPawn = false;
+
+	TArray<FVFSavedPhoto> AddedPhotos;
+	TArray<uint64> RemovedPhotos;
+
+	TArray<FString> HiddenComponents;
+	TArray<FString> ShownComponents;
+	TMap<FString, TArray<FTransform>> InstancedComponents;
+
+	TMap<FString, FVFSavedActor> SpawnedActors;
+	TArray<FString> RemovedSpawnedActors;
+
+	TMap<FString, FVFSavedGeneratedComponent> GeneratedComponents;
+	TArray<FString> RemovedGeneratedComponents;
+
+	//烘焙替换的组件只改变路径，不需要再次存储网格体
+	TArray<TPair<FString, FString>> RenamedGeneratedComponents;
+
+	TMap<FString, FVFSavedBackgroundPhoto> BackgroundPhotos;
+	TArray<FString> RemovedBackgroundPhotos;
+
+	bool IsEmpty() const;
+	void ApplyTo(FVFSaveState& State) const;
+
+	//记录中的纹理与网格体直接写在记录内，JournalVersion是记录所在日志的版本
+	void Serialize(FArchive& Ar, int32 JournalVersion);
+};
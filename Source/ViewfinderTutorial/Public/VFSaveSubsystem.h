@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "VFPhoto.h"
+#include "VFSaveState.h"
+#include "VFSaveSubsystem.generated.h"
+
+class UDynamicMesh;
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+class UVFComponent;
+class FVFAutosaveScope;
+class FVFSaveJournal;
+struct FVFMeshPatch;
+struct FVFPhotoPlaceRecord;
+namespace UE::Geometry { class FDynamicMesh3; }
+
+/**
+ * 照片物品栏与已放置照片的存档。存档使用FVFSaveFile的块格式，照片纹理以BC1块压缩存储，网格体记录与切割生成的网格体各为一个块。
+ * 存档记录的是放置的结果而不是放置的过程：被隐藏的地图组件、被移除的实例、照片中生成的Actor与切割生成的网格体，读取时直接还原，不需要重新进行boolean。
+ * 地图组件与Actor按相对于世界的路径引用，存档只能在同一张地图中读取，读取前会撤销地图中当前的放置。回溯记录不会被存储。
+ * 开启自动存档时，拍照、放置与回溯由FVFAutosaveScope记录为FVFSaveJournal中的记录，崩溃后可以由vf.Load Autosave恢复。
+ */
+UCLASS(Config = Game)
+class VIEWFINDERTUTORIAL_API UVFSaveSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	//将第一个玩家的照片与当前地图的改变写入存档，已经存在的存档会被覆盖。
+	bool SaveGame(const FString& SlotName);
+
+	//读取存档及其日志，还原地图的改变与第一个玩家的照片及位置。开启自动存档时，之后的自动存档以读取后的状态重新开始。
+	bool LoadGame(const FString& SlotName);
+
+	static FString GetSaveFilename(const FString& SlotName);
+	static FString GetJournalFilename(const FString& SlotName);
+
+	//地图中的组件被压缩销毁后无法再通过标签找到，由压缩者记录，读取时重新隐藏。
+	void AddDestroyedComponent(UPrimitiveComponent* Component);
+
+	//放置移除实例之前调用，存档时存储其所有实例，读取存档之前还原为第一次修改之前的实例。
+	void AddModifiedInstances(UInstancedStaticMeshComponent* Component);
+
+	//开启自动存档时，第一次调用会以地图当前的状态写入快照并开始日志。返回是否正在记录自动存档。
+	bool BeginAutosave();
+
+	//等待自动存档的写入完成。
+	void FlushAutosave();
+
+protected:
+	friend class FVFAutosaveScope;
+
+	//由第一个玩家与地图中带有标签的对象生成完整的存档，第一个玩家没有取景器组件时返回false。
+	bool CaptureState(FVFSaveState& OutState);
+
+	/**
+	 * 撤销当前地图中所有的放置结果：销毁照片中生成的Actor，归还切割生成的组件与背景照片，显示被隐藏的组件并还原被移除的实例。
+	 * 被压缩的组件无法再显示，存档中没有隐藏它们时返回false，此时地图不会被改变。
+	 */
+	bool RevertPlacements(const FVFSaveState& State, UVFComponent* VFComponent);
+	void ApplyState(const FVFSaveState& State, UVFComponent* VFComponent);
+
+	void AppendAutosave(const FVFAutosaveScope& Scope);
+
+	void CapturePhoto(const FVFPhotoInfo& Photo, FVFSavedPhoto& OutPhoto);
+	void CaptureSpawnedActor(AActor* Actor, FVFSavedActor& OutActor);
+	void CaptureGeneratedComponent(UPrimitiveComponent* Component, FVFSavedGeneratedComponent& OutComponent);
+	void CaptureBackgroundPhoto(AVFPhoto* BackgroundPhoto, FVFSavedBackgroundPhoto& OutBackgroundPhoto);
+
+	//渲染目标已经被释放的纹理记录为空。同一次存档中同一个纹理或网格体只编码一次
+	FVFSaveBlob CaptureTexture(UTexture* Texture);
+
+	//将动态网格体或静态网格体编码为网格体数据，无法复制网格体时返回空。
+	FVFSaveBlob CaptureMesh(UObject* MeshSource);
+
+	//地图中的静态网格体以路径引用，放置生成的临时网格体以网格体数据存储。
+	FVFSavedStaticMesh CaptureStaticMesh(UStaticMesh* StaticMesh);
+
+	//同一次读取中相同的数据只创建一个对象
+	TSharedPtr<FVFPhotoPayload> RestorePhoto(const FVFSavedPhoto& SavedPhoto);
+	UTexture* RestoreTexture(const FVFSaveBlob& Blob);
+	UDynamicMesh* RestoreMesh(const FVFSaveBlob& Blob);
+
+	//只在还原过程中使用的网格体直接解码到目标网格体，不创建UObject
+	bool DecodeMesh(const FVFSaveBlob& Blob, UE::Geometry::FDynamicMesh3& OutMesh) const;
+
+	//在来源网格体资源上还原存储为补丁的切割结果，来源无法读取或已经改变时返回false。
+	bool RestoreMeshPatch(const FVFSavedGeneratedComponent& SavedComponent, UE::Geometry::FDynamicMesh3& OutMesh, TSharedPtr<FVFMeshPatch>& OutPatch);
+	UStaticMesh* RestoreStaticMesh(const FVFSavedStaticMesh& SavedStaticMesh);
+
+	FString GetRelativePath(const UObject* Object) const;
+	UObject* FindRelativeObject(const FString& Path) const;
+
+protected:
+	//拍照、放置与回溯后将改变追加到自动存档的日志
+	UPROPERTY(Config)
+	bool bEnableAutosave = true;
+
+	UPROPERTY(Config)
+	FString AutosaveSlotName = TEXT("Autosave");
+
+	//日志超过此大小时，在后台将其压缩进快照
+	UPROPERTY(Config)
+	int32 MaxJournalSizeKB = 16384;
+
+	UPROPERTY(Transient)
+	TArray<FString> DestroyedComponentPaths;
+
+	//移除过实例的实例化组件与其第一次修改之前的实例
+	TMap<TWeakObjectPtr<UInstancedStaticMeshComponent>, TArray<FTransform>> ModifiedInstancedComponents;
+
+	TSharedPtr<FVFSaveJournal> AutosaveJournal;
+
+	//存档或读取期间有效
+	TMap<const UObject*, FVFSaveBlob> CapturedBlobs;
+	TMap<const TArray<uint8>*, UObject*> RestoredObjects;
+	TMap<const TArray<uint8>*, UStaticMesh*> RestoredStaticMeshes;
+};
+
+/**
+ * 将一次拍照、放置、回溯或几何体替换追加到自动存档，只在游戏线程中使用。没有开启自动存档时什么都不做。
+ * 操作会隐藏、回收或销毁的对象在操作之前Touch，操作生成的对象在操作之后Touch，作用域结束时记录所有被Touch的对象的状态，
+ * 因此记录的大小只与这次操作改变的对象有关。
+ */
+class VIEWFINDERTUTORIAL_API FVFAutosaveScope
+{
+public:
+	explicit FVFAutosaveScope(UWorld* World);
+	~FVFAutosaveScope();
+
+	void Touch(UObject* Object);
+
+	//放置记录中隐藏、生成与移除了实例的所有对象。
+	void Touch(const FVFPhotoPlaceRecord& Record);
+
+	void AddPhoto(const FVFPhotoInfo& Photo);
+	void RemovePhoto(uint64 PhotoId);
+
+	//烘焙后的组件与原组件的状态相同，只记录路径的改变。
+	void Rename(const UPrimitiveComponent* OldComponent, const UPrimitiveComponent* NewComponent);
+
+private:
+	friend class UVFSaveSubsystem;
+
+	enum class EObjectKind : uint8
+	{
+		SpawnedActor,
+		BackgroundPhoto,
+		GeneratedComponent,
+		InstancedComponent,
+		LevelComponent,
+	};
+
+	//对象可能在作用域结束前被销毁，路径与类型在Touch时记录
+	struct FTouchedObject
+	{
+		TWeakObjectPtr<UObject> Object;
+		FString Path;
+		EObjectKind Kind;
+	};
+
+	UVFSaveSubsystem* SaveSubsystem = nullptr;
+	TArray<FTouchedObject> TouchedObjects;
+	TArray<FVFPhotoInfo> AddedPhotos;
+	TArray<uint64> RemovedPhotos;
+	TArray<TPair<FString, FString>> RenamedComponents;
+};
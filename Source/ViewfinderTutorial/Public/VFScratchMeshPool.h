@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "VFScratchMeshPool.generated.h"
+
+class UDynamicMesh;
+
+/**
+ * 临时动态网格体的对象池。
+ * 拍照与放置中只在运算过程中使用的网格体从这里获取，用完后清空并归还，避免每次操作都创建新的UObject。
+ * 只有最终需要保留的结果才应该创建新的UDynamicMesh。
+ */
+UCLASS(Transient)
+class VIEWFINDERTUTORIAL_API UVFScratchMeshPool : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	//获取一个空的临时网格体，使用完毕后需要归还。
+	UDynamicMesh* RequestMesh();
+
+	//归还临时网格体，网格体数据会被清空，对象会被保留以供下次使用。
+	void ReturnMesh(UDynamicMesh* Mesh);
+
+	//释放所有空闲的临时网格体。
+	void FreeCachedMeshes();
+
+	int32 GetNumCreated() const { return AllMeshes.Num(); }
+	int32 GetNumInUse() const { return AllMeshes.Num() - CachedMeshes.Num(); }
+	int32 GetNumRequests() const { return NumRequests; }
+
+	void LogStats() const;
+
+protected:
+	UPROPERTY()
+	TArray<TObjectPtr<UDynamicMesh>> CachedMeshes;
+
+	UPROPERTY()
+	TArray<TObjectPtr<UDynamicMesh>> AllMeshes;
+
+	int32 NumRequests = 0;
+};
+
+//在作用域内从对象池借用一个临时网格体，离开作用域时自动归还。
+struct FVFScopedScratchMesh
+{
+	FVFScopedScratchMesh(UVFScratchMeshPool* InPool)
+		: Pool(InPool)
+		, Mesh(InPool->RequestMesh())
+	{
+	}
+
+	~FVFScopedScratchMesh()
+	{
+		Pool->ReturnMesh(Mesh);
+	}
+
+	UDynamicMesh* Get() const { return Mesh; }
+
+	UE_NONCOPYABLE(FVFScopedScratchMesh);
+
+private:
+	UVFScratchMeshPool* Pool;
+	UDynamicMesh* Mesh;
+};
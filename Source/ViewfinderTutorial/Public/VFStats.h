@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+
+class UPrimitiveComponent;
+
+/**
+ * 取景器的统计组，使用stat Viewfinder查看，CSV捕获中位于Viewfinder类别下。
+ * 每个阶段同时是周期计数器、Insights中的事件与CSV计时，计数器每帧清零。
+ */
+DECLARE_STATS_GROUP(TEXT("Viewfinder"), STATGROUP_Viewfinder, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Take"), STAT_VF_Take, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Take Capture"), STAT_VF_TakeCapture, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Take Mesh Record"), STAT_VF_TakeMeshRecord, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Take Snapshot"), STAT_VF_TakeSnapshot, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Place"), STAT_VF_Place, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Place Cache Restore"), STAT_VF_PlaceCacheRestore, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Place Speculative Commit"), STAT_VF_PlaceSpeculativeCommit, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Place Level Cut"), STAT_VF_PlaceLevelCut, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Place Spawn Actors"), STAT_VF_PlaceSpawnActors, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Place Generated Cut"), STAT_VF_PlaceGeneratedCut, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Place Undo"), STAT_VF_PlaceUndo, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Rewind Record"), STAT_VF_RewindRecord, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Rewind Playback"), STAT_VF_RewindPlayback, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Rewind Compact"), STAT_VF_RewindCompact, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mesh Boolean"), STAT_VF_MeshBoolean, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Components Cut"), STAT_VF_ComponentsCut, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Triangles In"), STAT_VF_TrianglesIn, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Triangles Out"), STAT_VF_TrianglesOut, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Booleans Run"), STAT_VF_BooleansRun, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Components Generated"), STAT_VF_ComponentsGenerated, STATGROUP_Viewfinder, VIEWFINDERTUTORIAL_API);
+
+//取景器持有的内存，使用stat ViewfinderMemory查看，在拍照、放置、回溯与回溯记录过期后按间隔更新。
+DECLARE_STATS_GROUP(TEXT("ViewfinderMemory"), STATGROUP_ViewfinderMemory, STATCAT_Advanced);
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Total"), STAT_VF_TotalMemory, STATGROUP_ViewfinderMemory, VIEWFINDERTUTORIAL_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Photos"), STAT_VF_PhotoMemory, STATGROUP_ViewfinderMemory, VIEWFINDERTUTORIAL_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Hidden Components"), STAT_VF_HiddenMemory, STATGROUP_ViewfinderMemory, VIEWFINDERTUTORIAL_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Generated Components"), STAT_VF_GeneratedMemory, STATGROUP_ViewfinderMemory, VIEWFINDERTUTORIAL_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Rewind Records"), STAT_VF_RewindRecordMemory, STATGROUP_ViewfinderMemory, VIEWFINDERTUTORIAL_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(VIEWFINDERTUTORIAL_API, Viewfinder);
+
+//有统计时周期计数器本身就会输出到Insights，只在没有统计的构建中单独添加事件
+#if STATS
+#define VF_TRACE_STAGE(Stage)
+#else
+#define VF_TRACE_STAGE(Stage) TRACE_CPUPROFILER_EVENT_SCOPE(Viewfinder_##Stage)
+#endif
+
+//记录一个阶段的周期计数器、Insights事件、CSV计时与FVFOperationStats。Stage为STAT_VF_之后的名称。
+#define VF_SCOPED_STAGE(Stage) \
+	SCOPE_CYCLE_COUNTER(STAT_VF_##Stage); \
+	VF_TRACE_STAGE(Stage); \
+	CSV_SCOPED_TIMING_STAT(Viewfinder, Stage); \
+	FVFScopedOperationTimer VFOperationTimer_##Stage(TEXT(#Stage))
+
+/**
+ * 拍照、放置与回溯各阶段的耗时、内存变化与三角面数量。
+ * 只有被设置为Active时才会记录，基准测试等需要逐次记录的场合使用，平时计时器不做任何事。只在游戏线程中使用。
+ */
+struct VIEWFINDERTUTORIAL_API FVFOperationStats
+{
+	struct FStage
+	{
+		FName Name;
+		int32 Count = 0;
+		double Seconds = 0.0;
+
+		//已使用物理内存的变化，包括其他线程的分配，只能作为参考
+		int64 MemoryDelta = 0;
+
+		int64 TrianglesIn = 0;
+		int64 TrianglesOut = 0;
+	};
+
+	//一个被切割或被完全消除的组件
+	struct FCut
+	{
+		FName Stage;
+		FString ComponentName;
+		int64 TrianglesIn = 0;
+		int64 TrianglesOut = 0;
+	};
+
+	TArray<FStage> Stages;
+	TArray<FCut> Cuts;
+
+	FStage& FindOrAddStage(FName Name);
+	void Reset() { Stages.Reset(); Cuts.Reset(); }
+
+	static FVFOperationStats* GetActive() { return Active; }
+	static void SetActive(FVFOperationStats* InStats) { Active = InStats; }
+
+	//记录一次切割的组件与输入输出的三角面数量。
+	static void AddCut(const TCHAR* StageName, const UPrimitiveComponent* Component, int64 TrianglesIn, int64 TrianglesOut);
+	static void AddCut(const TCHAR* StageName, const FString& ComponentName, int64 TrianglesIn, int64 TrianglesOut);
+
+private:
+	static FVFOperationStats* Active;
+};
+
+//将作用域的耗时与内存变化记录到当前Active的FVFOperationStats。
+class VIEWFINDERTUTORIAL_API FVFScopedOperationTimer
+{
+public:
+	explicit FVFScopedOperationTimer(const TCHAR* InStageName);
+	~FVFScopedOperationTimer();
+
+private:
+	const TCHAR* StageName;
+	double StartTime = 0.0;
+	int64 StartMemory = 0;
+};
+
+//更新取景器的计数器，可以在任意线程中调用。
+struct VIEWFINDERTUTORIAL_API FVFStats
+{
+	//一个组件或实例被切割或被完全消除，在游戏线程中调用时同时记录到FVFOperationStats的StageName阶段。
+	static void RecordCut(const TCHAR* StageName, const UPrimitiveComponent* Component, int64 TrianglesIn, int64 TrianglesOut);
+
+	static void RecordBoolean();
+
+	static void RecordGeneratedComponent();
+};
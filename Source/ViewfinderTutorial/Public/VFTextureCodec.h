@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTexture;
+class UTexture2D;
+
+/**
+ * 照片纹理的存档编码。纹理以BC1(DXT1)块压缩存储，每个4x4像素块8字节，为BGRA8的1/8，读取后不需要解码就能直接作为纹理使用。
+ * 编码使用块内颜色的包围盒作为端点，质量低于离线压缩工具，但足够快，可以在保存时对每张照片进行。
+ */
+struct VIEWFINDERTUTORIAL_API FVFTextureCodec
+{
+	/**
+	 * 将渲染目标或已经是BC1格式的纹理编码为存档数据。
+	 * 渲染目标的资源已经被释放，或是其他格式的纹理时返回false。读取渲染目标会等待渲染线程完成。
+	 */
+	static bool Encode(UTexture* Texture, TArray<uint8>& OutData);
+
+	//由存档数据创建临时的BC1纹理，数据无效时返回nullptr。纹理由持有它的照片数据向GC报告引用。
+	static UTexture2D* Decode(const TArray<uint8>& Data);
+
+	//将像素压缩为BC1块，宽高不是4的倍数时边缘的块重复最后的像素。
+	static void CompressBC1(const TArray<FColor>& Pixels, int32 Width, int32 Height, TArray<uint8>& OutBlocks);
+
+	static int64 GetBC1Size(int32 Width, int32 Height) { return (int64)FMath::DivideAndRoundUp(Width, 4) * FMath::DivideAndRoundUp(Height, 4) * 8; }
+};
@@ -9,6 +9,6 @@ public class ViewfinderTutorial : ModuleRules
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay", "EnhancedInput" });
-		PublicDependencyModuleNames.AddRange(new string[] { "GeometryScriptingCore", "GeometryFramework" });
+		PublicDependencyModuleNames.AddRange(new string[] { "GeometryScriptingCore", "GeometryFramework", "GeometryCore", "DynamicMesh", "MeshDescription", "StaticMeshDescription", "Json" });
 	}
 }